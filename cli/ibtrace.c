@@ -0,0 +1,412 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/**
+ * @file ibtrace.c
+ * @brief Decoder for binary function trace files
+ *
+ * Reads a file written by ib_trace_ring_flush() and prints it either as
+ * Chrome trace JSON (chrome://tracing, Perfetto) or as folded stacks with
+ * exclusive nanoseconds as the count (flamegraph.pl).
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include "ironbee_config_auto.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include <ironbee/debug.h>
+#include <ironbee/hash.h>
+#include <ironbee/list.h>
+#include <ironbee/mpool.h>
+#include <ironbee/util.h>
+
+/** Deepest call stack followed when folding. */
+#define MAX_DEPTH 512
+
+/** A decoded site. */
+typedef struct {
+    const char         *file;         /**< Source file */
+    const char         *func;         /**< Function name */
+    uint32_t            line;         /**< Source line */
+} site_t;
+
+/** A decoded thread. */
+typedef struct {
+    uint64_t            thread;       /**< Thread number */
+    uint64_t            nevents;      /**< Number of events */
+    uint64_t            dropped;      /**< Events lost to ring wrap */
+    const ib_trace_event_t *events;   /**< Events, oldest first */
+} thread_t;
+
+/** A decoded trace file. */
+typedef struct {
+    char               *buf;          /**< File contents */
+    site_t             *sites;        /**< Sites, by ID (0 unused) */
+    uint32_t            nsites;       /**< Number of sites */
+    thread_t           *threads;      /**< Threads */
+    uint32_t            nthreads;     /**< Number of threads */
+    uint64_t            base_ns;      /**< Earliest event time */
+} trace_t;
+
+/** A folded stack and its exclusive time. */
+typedef struct {
+    const char         *stack;        /**< "f1;f2;...;fn" */
+    uint64_t            ns;           /**< Exclusive nanoseconds */
+} folded_t;
+
+/** A call on the folding stack. */
+typedef struct {
+    uint32_t            site;         /**< Site ID */
+    uint64_t            start_ns;     /**< Call time */
+    uint64_t            child_ns;     /**< Time spent in callees */
+    size_t              slen;         /**< Length of stack string */
+} frame_t;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: ibtrace [--format chrome|folded] <trace file>\n"
+            "  --format chrome  Chrome trace JSON (default)\n"
+            "  --format folded  Folded stacks for flamegraph.pl\n");
+    exit(1);
+}
+
+/**
+ * Take @a len bytes from the file, failing if it is too short.
+ */
+static const char *take(const char **pos, const char *end, size_t len)
+{
+    const char *p = *pos;
+
+    if ((size_t)(end - p) < len) {
+        fprintf(stderr, "Truncated trace file\n");
+        exit(1);
+    }
+    *pos = p + len;
+    return p;
+}
+
+/**
+ * Copy a length-counted string out of the file.
+ */
+static const char *take_str(const char **pos, const char *end, size_t len)
+{
+    const char *p = take(pos, end, len);
+    char *s = malloc(len + 1);
+
+    if (s == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    memcpy(s, p, len);
+    s[len] = '\0';
+    return s;
+}
+
+static void load(trace_t *trace, const char *fn)
+{
+    ib_trace_file_header_t hdr;
+    FILE *fp;
+    long size;
+    const char *pos;
+    const char *end;
+    uint32_t n;
+
+    fp = fopen(fn, "rb");
+    if (fp == NULL) {
+        perror(fn);
+        exit(1);
+    }
+    if ( (fseek(fp, 0, SEEK_END) != 0) ||
+         ((size = ftell(fp)) < 0) ||
+         (fseek(fp, 0, SEEK_SET) != 0) )
+    {
+        perror(fn);
+        exit(1);
+    }
+    trace->buf = malloc(size);
+    if ( (trace->buf == NULL) ||
+         (fread(trace->buf, 1, size, fp) != (size_t)size) )
+    {
+        fprintf(stderr, "Failed to read %s\n", fn);
+        exit(1);
+    }
+    fclose(fp);
+
+    pos = trace->buf;
+    end = trace->buf + size;
+    memcpy(&hdr, take(&pos, end, sizeof(hdr)), sizeof(hdr));
+    if ( (memcmp(hdr.magic, IB_TRACE_RING_MAGIC, sizeof(hdr.magic)) != 0) ||
+         (hdr.version != IB_TRACE_RING_VERSION) )
+    {
+        fprintf(stderr, "%s is not a version %d trace file\n",
+                fn, IB_TRACE_RING_VERSION);
+        exit(1);
+    }
+
+    trace->nsites = hdr.nsites;
+    trace->sites = calloc(hdr.nsites + 1, sizeof(*trace->sites));
+    trace->nthreads = hdr.nthreads;
+    trace->threads = calloc(hdr.nthreads + 1, sizeof(*trace->threads));
+    if ( (trace->sites == NULL) || (trace->threads == NULL) ) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    for (n = 0; n < hdr.nsites; ++n) {
+        ib_trace_file_site_t rec;
+
+        memcpy(&rec, take(&pos, end, sizeof(rec)), sizeof(rec));
+        if ( (rec.id == 0) || (rec.id > hdr.nsites) ) {
+            fprintf(stderr, "Bad site ID %" PRIu32 "\n", rec.id);
+            exit(1);
+        }
+        trace->sites[rec.id].line = rec.line;
+        trace->sites[rec.id].file = take_str(&pos, end, rec.flen);
+        trace->sites[rec.id].func = take_str(&pos, end, rec.nlen);
+    }
+
+    trace->base_ns = UINT64_MAX;
+    for (n = 0; n < hdr.nthreads; ++n) {
+        ib_trace_file_thread_t rec;
+        thread_t *thread = &trace->threads[n];
+
+        memcpy(&rec, take(&pos, end, sizeof(rec)), sizeof(rec));
+        thread->thread = rec.thread;
+        thread->nevents = rec.nevents;
+        thread->dropped = rec.dropped;
+        thread->events = (const ib_trace_event_t *)
+            take(&pos, end, rec.nevents * sizeof(ib_trace_event_t));
+        if ( (rec.nevents > 0) && (thread->events[0].ns < trace->base_ns) ) {
+            trace->base_ns = thread->events[0].ns;
+        }
+        if (rec.dropped > 0) {
+            fprintf(stderr, "Thread %" PRIu64 ": %" PRIu64
+                    " events lost to ring wrap\n",
+                    rec.thread, rec.dropped);
+        }
+    }
+}
+
+/**
+ * Name of an event's site, tolerating IDs the file does not describe.
+ */
+static const char *site_name(const trace_t *trace, uint32_t id)
+{
+    if ( (id == 0) || (id > trace->nsites) ||
+         (trace->sites[id].func == NULL) )
+    {
+        return "?";
+    }
+    return trace->sites[id].func;
+}
+
+static void print_chrome(const trace_t *trace)
+{
+    const char *sep = "";
+    uint32_t n;
+    uint64_t e;
+
+    printf("{\"traceEvents\":[");
+    for (n = 0; n < trace->nthreads; ++n) {
+        const thread_t *thread = &trace->threads[n];
+
+        for (e = 0; e < thread->nevents; ++e) {
+            const ib_trace_event_t *ev = &thread->events[e];
+            uint32_t id = ev->site & ~IB_TRACE_EVENT_RETURN;
+            uint64_t ns = ev->ns - trace->base_ns;
+
+            printf("%s\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":1,"
+                   "\"tid\":%" PRIu64 ",\"ts\":%" PRIu64 ".%03" PRIu64,
+                   sep, site_name(trace, id),
+                   (ev->site & IB_TRACE_EVENT_RETURN) ? "E" : "B",
+                   thread->thread, ns / 1000, ns % 1000);
+            if (ev->site & IB_TRACE_EVENT_RETURN) {
+                printf(",\"args\":{\"rv\":%" PRId32 "}", ev->value);
+            }
+            printf("}");
+            sep = ",";
+        }
+    }
+    printf("\n]}\n");
+}
+
+/**
+ * Add exclusive time to a folded stack.
+ */
+static void fold_add(ib_hash_t *folded, ib_mpool_t *mp,
+                     const char *stack, uint64_t ns)
+{
+    folded_t *f;
+
+    if (ib_hash_get(folded, &f, stack) != IB_OK) {
+        f = ib_mpool_alloc(mp, sizeof(*f));
+        if (f == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        f->stack = ib_mpool_strdup(mp, stack);
+        f->ns = 0;
+        if ( (f->stack == NULL) ||
+             (ib_hash_set(folded, f->stack, f) != IB_OK) )
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    f->ns += ns;
+}
+
+static void print_folded(const trace_t *trace)
+{
+    static frame_t frames[MAX_DEPTH];
+    static char stack[MAX_DEPTH * 64];
+    ib_mpool_t *mp;
+    ib_hash_t *folded;
+    ib_list_t *list;
+    ib_list_node_t *node;
+    uint32_t n;
+    uint64_t e;
+
+    if ( (ib_mpool_create(&mp, "ibtrace", NULL) != IB_OK) ||
+         (ib_hash_create(&folded, mp) != IB_OK) ||
+         (ib_list_create(&list, mp) != IB_OK) )
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    for (n = 0; n < trace->nthreads; ++n) {
+        const thread_t *thread = &trace->threads[n];
+        size_t depth = 0;
+
+        for (e = 0; e < thread->nevents; ++e) {
+            const ib_trace_event_t *ev = &thread->events[e];
+            uint32_t id = ev->site & ~IB_TRACE_EVENT_RETURN;
+            size_t top;
+
+            if ((ev->site & IB_TRACE_EVENT_RETURN) == 0) {
+                const char *name = site_name(trace, id);
+                size_t slen = (depth > 0) ? frames[depth - 1].slen : 0;
+                size_t nlen = strlen(name);
+
+                if ( (depth == MAX_DEPTH) ||
+                     (slen + nlen + 2 > sizeof(stack)) )
+                {
+                    continue;
+                }
+                if (depth > 0) {
+                    stack[slen++] = ';';
+                }
+                memcpy(stack + slen, name, nlen + 1);
+                frames[depth].site = id;
+                frames[depth].start_ns = ev->ns;
+                frames[depth].child_ns = 0;
+                frames[depth].slen = slen + nlen;
+                ++depth;
+                continue;
+            }
+
+            /* Find the matching call; returns whose call was lost to
+             * ring wrap are ignored, calls whose return is missing are
+             * abandoned. */
+            for (top = depth; top > 0; --top) {
+                if (frames[top - 1].site == id) {
+                    break;
+                }
+            }
+            if (top == 0) {
+                continue;
+            }
+            depth = top - 1;
+            {
+                uint64_t total = ev->ns - frames[depth].start_ns;
+                uint64_t self = (total > frames[depth].child_ns) ?
+                    total - frames[depth].child_ns : 0;
+
+                stack[frames[depth].slen] = '\0';
+                fold_add(folded, mp, stack, self);
+                if (depth > 0) {
+                    frames[depth - 1].child_ns += total;
+                    stack[frames[depth - 1].slen] = '\0';
+                }
+            }
+        }
+    }
+
+    ib_hash_get_all(folded, list);
+    IB_LIST_LOOP(list, node) {
+        const folded_t *f = (const folded_t *)ib_list_node_data(node);
+
+        printf("%s %" PRIu64 "\n", f->stack, f->ns);
+    }
+
+    ib_mpool_destroy(mp);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option longopts[] = {
+        { "format", required_argument, 0, 'f' },
+        { "help", no_argument, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+    const char *format = "chrome";
+    trace_t trace;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "f:h", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'f':
+                format = optarg;
+                break;
+            default:
+                usage();
+        }
+    }
+    if (optind != argc - 1) {
+        usage();
+    }
+
+    if (ib_initialize() != IB_OK) {
+        fprintf(stderr, "Failed to initialize IronBee utilities\n");
+        return 1;
+    }
+
+    memset(&trace, 0, sizeof(trace));
+    load(&trace, argv[optind]);
+
+    if (strcmp(format, "chrome") == 0) {
+        print_chrome(&trace);
+    }
+    else if (strcmp(format, "folded") == 0) {
+        print_folded(&trace);
+    }
+    else {
+        usage();
+    }
+
+    ib_shutdown();
+    return 0;
+}
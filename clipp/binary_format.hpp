@@ -0,0 +1,109 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; CLIPP Binary Format
+ *
+ * Defines the on-disk layout of CLIPP binary capture files.
+ *
+ * A binary capture file is laid out as:
+ *
+ * - A file_header_t.
+ * - A data section: the raw bytes of every buffer of every input, in the
+ *   order they were written.
+ * - An index: for each input, an input_record_t immediately followed by
+ *   input_record_t::num_transactions transaction_record_t's.
+ *
+ * All offsets are from the beginning of the file.  All integers are in host
+ * byte order; file_header_t::byte_order is used to detect files written on
+ * a host of different endianness.  Records are 8 byte aligned so that the
+ * index can be used directly from a memory mapping.
+ *
+ * @author Christopher Alfeld <calfeld@qualys.com>
+ */
+
+#ifndef __IRONBEE__CLIPP__BINARY_FORMAT__
+#define __IRONBEE__CLIPP__BINARY_FORMAT__
+
+#include <boost/cstdint.hpp>
+
+namespace IronBee {
+namespace CLIPP {
+namespace BinaryFormat {
+
+//! Magic bytes at beginning of every binary capture file.
+static const char     c_magic[8]   = {'C', 'L', 'I', 'P', 'P', 'B', 'I', 'N'};
+//! Current format version.
+static const uint32_t c_version    = 2;
+//! Value of file_header_t::byte_order as written by this host.
+static const uint32_t c_byte_order = 0x01020304;
+
+//! File header.
+struct file_header_t
+{
+    //! Must be c_magic.
+    char     magic[8];
+    //! Format version; must be c_version.
+    uint32_t version;
+    //! Must be c_byte_order.
+    uint32_t byte_order;
+    //! Number of inputs in file.
+    uint64_t num_inputs;
+    //! Offset of index.
+    uint64_t index_offset;
+};
+
+//! Index record for a single input.
+struct input_record_t
+{
+    //! Time connection began in seconds since epoch or 0 if unknown.
+    double   timestamp;
+    //! Offset of local IP.
+    uint64_t local_ip_offset;
+    //! Offset of remote IP.
+    uint64_t remote_ip_offset;
+    //! Length of local IP.
+    uint32_t local_ip_length;
+    //! Length of remote IP.
+    uint32_t remote_ip_length;
+    //! Local port.
+    uint16_t local_port;
+    //! Remote port.
+    uint16_t remote_port;
+    //! Number of transaction_record_t's following this record.
+    uint32_t num_transactions;
+};
+
+//! Index record for a single transaction.
+struct transaction_record_t
+{
+    //! Offset of request data.
+    uint64_t request_offset;
+    //! Length of request data.
+    uint64_t request_length;
+    //! Offset of response data.
+    uint64_t response_offset;
+    //! Length of response data.
+    uint64_t response_length;
+};
+
+} // BinaryFormat
+} // CLIPP
+} // IronBee
+
+#endif
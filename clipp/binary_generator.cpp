@@ -0,0 +1,198 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; CLIPP Binary Generator Implementation
+ *
+ * @author Christopher Alfeld <calfeld@qualys.com>
+ */
+
+#include "binary_generator.hpp"
+#include "binary_format.hpp"
+
+#include <boost/make_shared.hpp>
+
+#include <stdexcept>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace IronBee {
+namespace CLIPP {
+
+using namespace BinaryFormat;
+
+//! A read only memory mapping of an entire file.
+struct BinaryGenerator::mapping_t
+{
+    //! Map @a path.
+    explicit
+    mapping_t(const string& path) :
+        data(NULL),
+        size(0)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw runtime_error("Could not open " + path);
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw runtime_error("Could not stat " + path);
+        }
+        size = st.st_size;
+
+        if (size < sizeof(file_header_t)) {
+            close(fd);
+            throw runtime_error(path + " is not a binary capture file.");
+        }
+
+        void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            throw runtime_error("Could not map " + path);
+        }
+        data = reinterpret_cast<const char*>(p);
+
+        // Data is read front to back, once.
+        madvise(p, size, MADV_SEQUENTIAL);
+    }
+
+    ~mapping_t()
+    {
+        munmap(const_cast<char*>(data), size);
+    }
+
+    //! Beginning of mapping.
+    const char* data;
+    //! Size of mapping.
+    size_t      size;
+};
+
+namespace {
+
+//! Construct buffer for @a offset and @a length, checking bounds.
+buffer_t checked_buffer(
+    const char* data,
+    size_t      size,
+    uint64_t    offset,
+    uint64_t    length
+)
+{
+    if (offset > size || length > size - offset) {
+        throw runtime_error("Binary capture file is corrupt: bad buffer.");
+    }
+    return buffer_t(data + offset, length);
+}
+
+}
+
+BinaryGenerator::BinaryGenerator()
+{
+    // nop
+}
+
+BinaryGenerator::BinaryGenerator(const std::string& path) :
+    m_mapping(boost::make_shared<mapping_t>(path))
+{
+    const file_header_t* header =
+        reinterpret_cast<const file_header_t*>(m_mapping->data);
+
+    if (memcmp(header->magic, c_magic, sizeof(c_magic)) != 0) {
+        throw runtime_error(path + " is not a binary capture file.");
+    }
+    if (header->byte_order != c_byte_order) {
+        throw runtime_error(path + " was written with other byte order.");
+    }
+    if (header->version != c_version) {
+        throw runtime_error(path + " has unsupported version.");
+    }
+    if (header->index_offset > m_mapping->size) {
+        throw runtime_error(path + " is corrupt: bad index offset.");
+    }
+
+    m_next_record = header->index_offset;
+    m_remaining   = header->num_inputs;
+}
+
+bool BinaryGenerator::operator()(input_t& out_input)
+{
+    if (m_remaining == 0) {
+        return false;
+    }
+
+    const char* data = m_mapping->data;
+    size_t      size = m_mapping->size;
+
+    if (size - m_next_record < sizeof(input_record_t)) {
+        throw runtime_error("Binary capture file is corrupt: short index.");
+    }
+    const input_record_t* record =
+        reinterpret_cast<const input_record_t*>(data + m_next_record);
+    m_next_record += sizeof(input_record_t);
+
+    out_input.local_ip = checked_buffer(
+        data, size,
+        record->local_ip_offset, record->local_ip_length
+    );
+    out_input.remote_ip = checked_buffer(
+        data, size,
+        record->remote_ip_offset, record->remote_ip_length
+    );
+    out_input.local_port  = record->local_port;
+    out_input.remote_port = record->remote_port;
+    out_input.timestamp   = record->timestamp;
+
+    if (
+        (size - m_next_record) / sizeof(transaction_record_t) <
+        record->num_transactions
+    ) {
+        throw runtime_error("Binary capture file is corrupt: short index.");
+    }
+
+    out_input.transactions.clear();
+    out_input.transactions.reserve(record->num_transactions);
+    for (uint32_t i = 0; i < record->num_transactions; ++i) {
+        const transaction_record_t* tx =
+            reinterpret_cast<const transaction_record_t*>(
+                data + m_next_record
+            );
+        m_next_record += sizeof(transaction_record_t);
+
+        out_input.transactions.push_back(input_t::transaction_t(
+            checked_buffer(data, size, tx->request_offset,
+                           tx->request_length),
+            checked_buffer(data, size, tx->response_offset,
+                           tx->response_length)
+        ));
+    }
+
+    out_input.source = m_mapping;
+    --m_remaining;
+
+    return true;
+}
+
+} // CLIPP
+} // IronBee
@@ -0,0 +1,90 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; CLIPP Binary Generator
+ *
+ * @author Christopher Alfeld <calfeld@qualys.com>
+ */
+
+#ifndef __IRONBEE__CLIPP__BINARY_GENERATOR__
+#define __IRONBEE__CLIPP__BINARY_GENERATOR__
+
+#include "input.hpp"
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdelete-non-virtual-dtor"
+#endif
+#include <boost/shared_ptr.hpp>
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+#include <string>
+
+namespace IronBee {
+namespace CLIPP {
+
+/**
+ * @class BinaryGenerator
+ * @brief Input generator from CLIPP binary capture files.
+ *
+ * Memory maps the capture file and produces input_t's whose buffers point
+ * directly into the mapping; no input data is copied or parsed.  The
+ * mapping is attached to each input_t via input_t::source, so inputs remain
+ * valid even if they outlive the generator.
+ *
+ * Binary capture files are written by BinaryWriter.  See binary_format.hpp
+ * for the format.
+ **/
+class BinaryGenerator
+{
+public:
+    //! Default Constructor.
+    /**
+     * Behavior except for assigning to is undefined.
+     **/
+    BinaryGenerator();
+
+    //! Constructor.
+    /**
+     * @param[in] path Path to binary capture file.
+     * @throw runtime_error if @a path can not be mapped or is not a valid
+     *        capture file.
+     **/
+    explicit
+    BinaryGenerator(const std::string& path);
+
+    //! Produce an input.  See input_t and input_generator_t.
+    bool operator()(input_t& out_input);
+
+private:
+    struct mapping_t;
+
+    boost::shared_ptr<mapping_t> m_mapping;
+    //! Offset of next input record.
+    size_t                       m_next_record;
+    //! Number of inputs remaining.
+    uint64_t                     m_remaining;
+};
+
+} // CLIPP
+} // IronBee
+
+#endif
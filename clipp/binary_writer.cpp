@@ -0,0 +1,143 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; CLIPP Binary Writer Implementation
+ *
+ * @author Christopher Alfeld <calfeld@qualys.com>
+ */
+
+#include "binary_writer.hpp"
+
+#include <boost/foreach.hpp>
+
+#include <stdexcept>
+#include <cstring>
+
+using namespace std;
+
+namespace IronBee {
+namespace CLIPP {
+
+using namespace BinaryFormat;
+
+namespace {
+
+//! Append the bytes of @a record to @a index.
+template <typename T>
+void append(vector<char>& index, const T& record)
+{
+    const char* p = reinterpret_cast<const char*>(&record);
+    index.insert(index.end(), p, p + sizeof(T));
+}
+
+//! Padding needed to align @a offset to 8 bytes.
+size_t padding(uint64_t offset)
+{
+    return (8 - (offset % 8)) % 8;
+}
+
+}
+
+BinaryWriter::BinaryWriter(const std::string& path) :
+    m_out(path.c_str(), ios::binary | ios::trunc),
+    m_offset(sizeof(file_header_t)),
+    m_num_inputs(0)
+{
+    if (! m_out) {
+        throw runtime_error("Could not open " + path + " for writing.");
+    }
+
+    // Placeholder header; rewritten by close().
+    file_header_t header;
+    memset(&header, 0, sizeof(header));
+    m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+uint64_t BinaryWriter::write_buffer(const buffer_t& buffer)
+{
+    uint64_t offset = m_offset;
+    if (buffer.length > 0) {
+        m_out.write(buffer.data, buffer.length);
+        m_offset += buffer.length;
+    }
+    return offset;
+}
+
+void BinaryWriter::operator()(const input_t& input)
+{
+    input_record_t record;
+    memset(&record, 0, sizeof(record));
+
+    record.local_ip_offset  = write_buffer(input.local_ip);
+    record.local_ip_length  = input.local_ip.length;
+    record.remote_ip_offset = write_buffer(input.remote_ip);
+    record.remote_ip_length = input.remote_ip.length;
+    record.local_port       = input.local_port;
+    record.remote_port      = input.remote_port;
+    record.timestamp        = input.timestamp;
+    record.num_transactions = input.transactions.size();
+    append(m_index, record);
+
+    BOOST_FOREACH(
+        const input_t::transaction_t& transaction,
+        input.transactions
+    ) {
+        transaction_record_t tx;
+        tx.request_offset  = write_buffer(transaction.request);
+        tx.request_length  = transaction.request.length;
+        tx.response_offset = write_buffer(transaction.response);
+        tx.response_length = transaction.response.length;
+        append(m_index, tx);
+    }
+
+    if (! m_out) {
+        throw runtime_error("Error writing binary capture file.");
+    }
+
+    ++m_num_inputs;
+}
+
+void BinaryWriter::close()
+{
+    static const char zeros[8] = {0};
+    size_t pad = padding(m_offset);
+    m_out.write(zeros, pad);
+    m_offset += pad;
+
+    file_header_t header;
+    memcpy(header.magic, c_magic, sizeof(c_magic));
+    header.version      = c_version;
+    header.byte_order   = c_byte_order;
+    header.num_inputs   = m_num_inputs;
+    header.index_offset = m_offset;
+
+    if (! m_index.empty()) {
+        m_out.write(&*m_index.begin(), m_index.size());
+    }
+    m_out.seekp(0, ios::beg);
+    m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_out.close();
+
+    if (! m_out) {
+        throw runtime_error("Error writing binary capture file.");
+    }
+}
+
+} // CLIPP
+} // IronBee
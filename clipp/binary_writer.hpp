@@ -0,0 +1,79 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; CLIPP Binary Writer
+ *
+ * @author Christopher Alfeld <calfeld@qualys.com>
+ */
+
+#ifndef __IRONBEE__CLIPP__BINARY_WRITER__
+#define __IRONBEE__CLIPP__BINARY_WRITER__
+
+#include "input.hpp"
+#include "binary_format.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace IronBee {
+namespace CLIPP {
+
+/**
+ * @class BinaryWriter
+ * @brief Writes inputs to a CLIPP binary capture file.
+ *
+ * Call operator()() for each input and then close().  Buffer data is
+ * written as it arrives; the index is held in memory and written by
+ * close().  A file that is not closed is not a valid capture file.
+ *
+ * @sa BinaryGenerator
+ **/
+class BinaryWriter
+{
+public:
+    //! Constructor.
+    /**
+     * @param[in] path Path to write to.  Will be truncated.
+     * @throw runtime_error if @a path can not be opened.
+     **/
+    explicit
+    BinaryWriter(const std::string& path);
+
+    //! Append @a input.
+    void operator()(const input_t& input);
+
+    //! Write index and header and close file.
+    void close();
+
+private:
+    //! Write @a buffer to data section and return its offset.
+    uint64_t write_buffer(const buffer_t& buffer);
+
+    std::ofstream     m_out;
+    uint64_t          m_offset;
+    uint64_t          m_num_inputs;
+    //! Serialized index.
+    std::vector<char> m_index;
+};
+
+} // CLIPP
+} // IronBee
+
+#endif
@@ -27,14 +27,25 @@
 #include "input.hpp"
 #include "modsec_audit_log_generator.hpp"
 #include "raw_generator.hpp"
+#include "binary_generator.hpp"
+#include "binary_writer.hpp"
 
 #include <ironbeepp/all.hpp>
 
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+#include <boost/random/variate_generator.hpp>
 
+#include <list>
 #include <string>
 
+#include <sys/time.h>
+#include <time.h>
+
 using namespace std;
 using namespace IronBee::CLIPP;
 
@@ -50,9 +61,46 @@ typedef map<string,input_factory_t> input_factory_map_t;
 
 input_generator_t init_audit_input(const string& arg);
 input_generator_t init_raw_input(const string& arg);
+input_generator_t init_binary_input(const string& arg);
 
 bool on_error(const string& message);
 
+//! Options controlling how inputs are fed to IronBee.
+struct replay_options_t
+{
+    //! Minimum chunk size; 0 means do not chunk.
+    size_t chunk_min;
+    //! Maximum chunk size; chunk sizes are uniform in [chunk_min, chunk_max].
+    size_t chunk_max;
+    //! Maximum number of simultaneously open connections.
+    size_t interleave;
+    //! If true, open connections according to input timestamps.
+    bool   timing;
+};
+
+//! State of replay that persists across input generators.
+struct replay_state_t
+{
+    //! Constructor.
+    explicit
+    replay_state_t(uint32_t seed);
+
+    //! Random number generator for chunk sizes.
+    boost::mt19937 rng;
+    //! Timestamp of first timed input or 0 if none seen yet.
+    double         first_timestamp;
+    //! Wall clock time first timed input was opened.
+    double         first_wall;
+};
+
+void parse_chunk_size(const string& arg, replay_options_t& options);
+void replay(
+    IronBee::Engine          engine,
+    input_generator_t        generator,
+    const replay_options_t&  options,
+    replay_state_t&          state
+);
+
 void load_configuration(IronBee::Engine engine, const std::string& path);
 IronBee::Connection open_connection(
     IronBee::Engine engine,
@@ -68,6 +116,15 @@ int main(int argc, char** argv)
 
     bool   show_help = false;
     string config_path;
+    string write_path;
+    string chunk_size;
+    uint32_t seed = 0;
+
+    replay_options_t replay_options;
+    replay_options.chunk_min  = 0;
+    replay_options.chunk_max  = 0;
+    replay_options.interleave = 1;
+    replay_options.timing     = false;
 
     po::options_description desc(
         "All input options can be repeated.  Inputs will be processed in the "
@@ -78,7 +135,32 @@ int main(int argc, char** argv)
     general_desc.add_options()
         ("help", po::bool_switch(&show_help), "Output help message.")
         ("config,C", po::value<string>(&config_path),
-            "IronBee config file.  REQUIRED"
+            "IronBee config file.  REQUIRED unless --write is used."
+        )
+        ("write,w", po::value<string>(&write_path),
+            "Write inputs to a binary capture file instead of sending them "
+            "to IronBee.  The file can be replayed with --binary."
+        )
+    ;
+
+    po::options_description replay_desc("Replay Options:");
+    replay_desc.add_options()
+        ("chunk-size,c", po::value<string>(&chunk_size),
+            "Send data to IronBee in chunks of this many bytes.  Use comma "
+            "separated pair min,max for chunk sizes chosen uniformly at "
+            "random in that range.  Default is to send each request and "
+            "response as a single chunk."
+        )
+        ("seed", po::value<uint32_t>(&seed),
+            "Seed for random chunk sizes."
+        )
+        ("interleave,I", po::value<size_t>(&replay_options.interleave),
+            "Keep up to this many connections open at once, sending one "
+            "chunk of each in turn.  Default is 1."
+        )
+        ("timing", po::bool_switch(&replay_options.timing),
+            "Open connections following the recorded time between inputs.  "
+            "Inputs without a timestamp are sent immediately."
         )
     ;
 
@@ -91,8 +173,11 @@ int main(int argc, char** argv)
             "Raw inputs.  Use comma separated pair: request path,response "
             "path. Raw input will use bogus connection information."
         )
+        ("binary,B", po::value<vector<string> >(),
+            "CLIPP binary capture file, as written by --write."
+        )
     ;
-    desc.add(general_desc).add(input_desc);
+    desc.add(general_desc).add(replay_desc).add(input_desc);
 
     po::basic_parsed_options<char> options
         = po::parse_command_line(argc, argv, desc);
@@ -106,31 +191,58 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    if (config_path.empty()) {
+    if (config_path.empty() && write_path.empty()) {
         cerr << "Config required." << endl;
         cout << desc << endl;
         return 1;
     }
 
+    try {
+        parse_chunk_size(chunk_size, replay_options);
+    }
+    catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    if (replay_options.interleave == 0) {
+        replay_options.interleave = 1;
+    }
+    replay_state_t replay_state(seed);
+
     // Declare input types.
     input_factory_map_t input_factory_map;
     input_factory_map["audit"] = &init_audit_input;
-    input_factory_map["raw"]   = &init_raw_input;
+    input_factory_map["raw"]    = &init_raw_input;
+    input_factory_map["binary"] = &init_binary_input;
+
+    // In write mode, inputs are converted rather than processed.
+    boost::shared_ptr<BinaryWriter> writer;
+    if (! write_path.empty()) {
+        try {
+            writer = boost::make_shared<BinaryWriter>(write_path);
+        }
+        catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
 
     // Initialize IronBee.
     IronBee::initialize();
     IronBee::ServerValue server_value(__FILE__, "clipp");
     IronBee::Engine engine = IronBee::Engine::create(server_value.get());
 
-    try {
-        load_configuration(engine, config_path);
-    }
-    catch (IronBee::error) {
-        cerr << "Error loading configuration.  See log." << endl;
-        return 1;
-    }
-    catch (const exception& e) {
-        cerr << "Error loading configuration: " << e.what() << endl;
+    if (! writer) {
+        try {
+            load_configuration(engine, config_path);
+        }
+        catch (IronBee::error) {
+            cerr << "Error loading configuration.  See log." << endl;
+            return 1;
+        }
+        catch (const exception& e) {
+            cerr << "Error loading configuration: " << e.what() << endl;
+        }
     }
 
     // Loop through the options, generating and processing input generators
@@ -158,17 +270,24 @@ int main(int argc, char** argv)
          }
 
         // Process inputs.
-        input_t input;
-        while (generator(input)) {
-            IronBee::Connection connection = open_connection(engine, input);
-            BOOST_FOREACH(
-                const input_t::transaction_t& transaction,
-                input.transactions
-            ) {
-                data_in(connection, transaction.request);
-                data_out(connection, transaction.response);
+        if (writer) {
+            input_t input;
+            while (generator(input)) {
+                (*writer)(input);
             }
-            close_connection(connection);
+        }
+        else {
+            replay(engine, generator, replay_options, replay_state);
+        }
+    }
+
+    if (writer) {
+        try {
+            writer->close();
+        }
+        catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
         }
     }
 
@@ -195,6 +314,11 @@ input_generator_t init_raw_input(const string& arg)
     );
 }
 
+input_generator_t init_binary_input(const string& arg)
+{
+    return BinaryGenerator(arg);
+}
+
 bool on_error(const string& message)
 {
     cerr << "ERROR: " << message << endl;
@@ -267,10 +391,196 @@ void data_out(IronBee::Connection connection, buffer_t response)
         response.length
     );
 
-    connection.engine().notify().connection_data_in(data);
+    connection.engine().notify().connection_data_out(data);
 }
 
 void close_connection(IronBee::Connection connection)
 {
     connection.engine().notify().connection_closed(connection);
 }
+
+void parse_chunk_size(const string& arg, replay_options_t& options)
+{
+    if (arg.empty()) {
+        return;
+    }
+
+    try {
+        size_t comma_i = arg.find_first_of(',');
+        if (comma_i == string::npos) {
+            options.chunk_min = boost::lexical_cast<size_t>(arg);
+            options.chunk_max = options.chunk_min;
+        }
+        else {
+            options.chunk_min =
+                boost::lexical_cast<size_t>(arg.substr(0, comma_i));
+            options.chunk_max =
+                boost::lexical_cast<size_t>(arg.substr(comma_i+1));
+        }
+    }
+    catch (const boost::bad_lexical_cast&) {
+        throw runtime_error("Invalid chunk size: " + arg);
+    }
+
+    if (options.chunk_min == 0 || options.chunk_max < options.chunk_min) {
+        throw runtime_error("Invalid chunk size: " + arg);
+    }
+}
+
+replay_state_t::replay_state_t(uint32_t seed) :
+    rng(seed),
+    first_timestamp(0),
+    first_wall(0)
+{
+    // nop
+}
+
+namespace {
+
+//! Current wall clock time in seconds since epoch.
+double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+//! Sleep until @a input should be opened according to its timestamp.
+void wait_for(const input_t& input, replay_state_t& state)
+{
+    if (input.timestamp == 0) {
+        return;
+    }
+
+    if (state.first_timestamp == 0) {
+        state.first_timestamp = input.timestamp;
+        state.first_wall      = now();
+        return;
+    }
+
+    double delay =
+        (input.timestamp - state.first_timestamp) -
+        (now() - state.first_wall);
+    if (delay > 0) {
+        struct timespec ts;
+        ts.tv_sec  = static_cast<time_t>(delay);
+        ts.tv_nsec = static_cast<long>((delay - ts.tv_sec) * 1e9);
+        nanosleep(&ts, NULL);
+    }
+}
+
+//! A connection in the middle of being replayed.
+struct connection_state_t
+{
+    //! Input being replayed.
+    input_t             input;
+    //! IronBee connection.
+    IronBee::Connection connection;
+    //! Index of current transaction.
+    size_t              transaction;
+    //! True iff sending response of current transaction.
+    bool                response;
+    //! Bytes of current request or response already sent.
+    size_t              offset;
+};
+
+//! Send next chunk of @a cs.  Returns false if nothing is left to send.
+bool step(
+    connection_state_t&     cs,
+    const replay_options_t& options,
+    replay_state_t&         state
+)
+{
+    while (cs.transaction < cs.input.transactions.size()) {
+        const input_t::transaction_t& tx =
+            cs.input.transactions[cs.transaction];
+        const buffer_t& buffer = cs.response ? tx.response : tx.request;
+
+        if (cs.offset >= buffer.length) {
+            // Current buffer done; advance.
+            cs.offset = 0;
+            if (cs.response) {
+                cs.response = false;
+                ++cs.transaction;
+            }
+            else {
+                cs.response = true;
+            }
+            continue;
+        }
+
+        size_t length = buffer.length - cs.offset;
+        if (options.chunk_min > 0) {
+            size_t chunk = options.chunk_min;
+            if (options.chunk_max > options.chunk_min) {
+                boost::uniform_int<size_t> dist(
+                    options.chunk_min,
+                    options.chunk_max
+                );
+                boost::variate_generator<
+                    boost::mt19937&,
+                    boost::uniform_int<size_t>
+                > random_chunk(state.rng, dist);
+                chunk = random_chunk();
+            }
+            length = min(length, chunk);
+        }
+
+        buffer_t chunk(buffer.data + cs.offset, length);
+        if (cs.response) {
+            data_out(cs.connection, chunk);
+        }
+        else {
+            data_in(cs.connection, chunk);
+        }
+        cs.offset += length;
+
+        return true;
+    }
+
+    return false;
+}
+
+}
+
+void replay(
+    IronBee::Engine          engine,
+    input_generator_t        generator,
+    const replay_options_t&  options,
+    replay_state_t&          state
+)
+{
+    list<connection_state_t> active;
+    bool more_input = true;
+
+    while (more_input || ! active.empty()) {
+        // Fill up the set of open connections.
+        while (more_input && active.size() < options.interleave) {
+            connection_state_t cs;
+            if (! generator(cs.input)) {
+                more_input = false;
+                break;
+            }
+            if (options.timing) {
+                wait_for(cs.input, state);
+            }
+            cs.connection  = open_connection(engine, cs.input);
+            cs.transaction = 0;
+            cs.response    = false;
+            cs.offset      = 0;
+            active.push_back(cs);
+        }
+
+        // Send one chunk of each open connection.
+        list<connection_state_t>::iterator i = active.begin();
+        while (i != active.end()) {
+            if (step(*i, options, state)) {
+                ++i;
+            }
+            else {
+                close_connection(i->connection);
+                i = active.erase(i);
+            }
+        }
+    }
+}
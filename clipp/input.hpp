@@ -96,6 +96,9 @@ struct input_t
   //! Remote port.
   uint16_t remote_port;
 
+  //! Time connection began in seconds since epoch or 0 if unknown.
+  double timestamp;
+
   //! A transaction for IronBee to process.
   struct transaction_t {
       //! Constructor.
@@ -40,12 +40,47 @@
 
 #include <stdexcept>
 #include <fstream>
+#include <cstring>
+
+#include <time.h>
 
 using namespace std;
 
 namespace IronBee {
 namespace CLIPP {
 
+namespace {
+
+//! Extract timestamp from section A or return 0 if not possible.
+double parse_timestamp(const string& A)
+{
+    static const boost::regex timestamp(
+        "^\\[(\\d+/\\w+/\\d+:\\d+:\\d+:\\d+) ([+-]+)(\\d\\d)(\\d\\d)\\]"
+    );
+    boost::smatch match;
+    if (! regex_search(A, match, timestamp)) {
+        return 0;
+    }
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (strptime(match.str(1).c_str(), "%d/%b/%Y:%H:%M:%S", &tm) == NULL) {
+        return 0;
+    }
+
+    int offset =
+        boost::lexical_cast<int>(match.str(3)) * 3600 +
+        boost::lexical_cast<int>(match.str(4)) * 60;
+    // Some versions of ModSecurity write negative offsets as "--hhmm".
+    if (match.str(2).find('-') != string::npos) {
+        offset = -offset;
+    }
+
+    return timegm(&tm) - offset;
+}
+
+}
+
 ModSecAuditLogGenerator::ModSecAuditLogGenerator(
     const std::string& path,
     on_error_t on_error
@@ -108,6 +143,8 @@ bool ModSecAuditLogGenerator::operator()(input_t& out_input)
         );
     }
 
+    out_input.timestamp = parse_timestamp(A);
+
     out_input.transactions.clear();
     out_input.transactions.push_back(input_t::transaction_t(
         buffer_t((*e)["B"]), buffer_t((*e)["F"])
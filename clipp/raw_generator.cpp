@@ -85,6 +85,7 @@ bool RawGenerator::operator()(input_t& out_input)
     out_input.remote_ip         = buffer_t(remote_ip);
     out_input.local_port        = local_port;
     out_input.remote_port       = remote_port;
+    out_input.timestamp         = 0;
     out_input.transactions.clear();
     out_input.transactions.push_back(
         input_t::transaction_t(
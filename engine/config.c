@@ -272,6 +272,9 @@ ib_status_t ib_cfgparser_parse_buffer(ib_cfgparser_t *cp,
 {
     IB_FTRACE_INIT();
 
+    /* Identifies the configuration for the snapshot (see snapshot.h). */
+    cp->ib->cfg_hash = ib_snapshot_hash(cp->ib->cfg_hash, buffer, length);
+
     IB_FTRACE_RET_STATUS(
         ib_cfgparser_ragel_parse_chunk(
             cp,
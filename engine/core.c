@@ -1090,8 +1090,15 @@ static ib_status_t core_data_add(ib_provider_inst_t *dpi,
     IB_FTRACE_INIT();
     /// @todo Needs to be more field-aware (handle lists, etc)
     /// @todo Needs to not allow adding if already exists (except list items)
-    ib_status_t rc = ib_hash_set_ex((ib_hash_t *)dpi->data,
-                                    (void *)name, nlen, f);
+    ib_status_t rc;
+
+    /* Fields named by a symbol are keyed by it, without hashing. */
+    if ((f->sym != NULL) && (f->sym->name == name)) {
+        rc = ib_hash_set_sym((ib_hash_t *)dpi->data, f->sym, f);
+    }
+    else {
+        rc = ib_hash_set_ex((ib_hash_t *)dpi->data, (void *)name, nlen, f);
+    }
     IB_FTRACE_RET_STATUS(rc);
 }
 
@@ -1118,6 +1125,9 @@ static ib_status_t core_data_set(ib_provider_inst_t *dpi,
 /**
  * Core data provider implementation to set a relative data field value.
  *
+ * A "key:subkey" name adjusts @a subkey of the dynamic field @a key (see
+ * ib_field_adjust_ex()).
+ *
  * @param dpi Data provider instance
  * @param name Field name
  * @param nlen Field length
@@ -1131,10 +1141,26 @@ static ib_status_t core_data_set_relative(ib_provider_inst_t *dpi,
                                           intmax_t adjval)
 {
     IB_FTRACE_INIT();
+    const char *subkey;
     ib_field_t *f;
     ib_status_t rc;
-    ib_num_t num;
-    ib_unum_t unum;
+
+    /* Dynamic "key:subkey" fields adjust their own values. */
+    subkey = (const char *)memchr(name, ':', nlen);
+    if (subkey != NULL) {
+        size_t klen = subkey - name;
+
+        rc = ib_hash_get_ex(
+            (ib_hash_t *)dpi->data,
+            &f,
+            (void *)name, klen
+        );
+        if ( (rc == IB_OK) && ib_field_is_dynamic(f) ) {
+            rc = ib_field_adjust_ex(f, (ib_num_t)adjval,
+                                    subkey + 1, nlen - klen - 1);
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
 
     rc = ib_hash_get_ex(
         (ib_hash_t *)dpi->data,
@@ -1145,37 +1171,17 @@ static ib_status_t core_data_set_relative(ib_provider_inst_t *dpi,
         IB_FTRACE_RET_STATUS(IB_ENOENT);
     }
 
-    switch (f->type) {
-        case IB_FTYPE_NUM:
-            /// @todo Make sure this is atomic
-            /// @todo Check for overflow
-            rc = ib_field_value(f, ib_ftype_num_out(&num));
-            if (rc != IB_OK) {
-                IB_FTRACE_RET_STATUS(rc);
-            }
-            num += adjval;
-            rc = ib_field_setv(f, ib_ftype_num_in(&num));
-            break;
-        case IB_FTYPE_UNUM:
-            /// @todo Make sure this is atomic
-            /// @todo Check for overflow
-            rc = ib_field_value(f, ib_ftype_unum_out(&unum));
-            if (rc != IB_OK) {
-                IB_FTRACE_RET_STATUS(rc);
-            }
-            unum += adjval;
-            rc = ib_field_setv(f, ib_ftype_unum_in(&unum));
-            break;
-        default:
-            IB_FTRACE_RET_STATUS(IB_EINVAL);
-    }
-
+    /// @todo Make sure this is atomic
+    rc = ib_field_adjust_ex(f, (ib_num_t)adjval, NULL, 0);
     IB_FTRACE_RET_STATUS(rc);
 }
 
 /**
  * Core data provider implementation to get a data field.
  *
+ * Lazy fields (see ib_field_create_lazy()) are generated the first time
+ * they are fetched.
+ *
  * @param dpi Data provider instance
  * @param name Field name
  * @param nlen Field name length
@@ -1209,6 +1215,11 @@ static ib_status_t core_data_get(ib_provider_inst_t *dpi,
             (void *)name, klen
         );
         if (rc == IB_OK) {
+            rc = ib_field_resolve_lazy(*pf);
+            if (rc != IB_OK) {
+                IB_FTRACE_RET_STATUS(rc);
+            }
+
             /* Try dynamic lookup. */
             if(ib_field_is_dynamic(*pf)) {
                 rc = ib_field_value_ex(*pf, pf, (void *)subkey, sklen);
@@ -1253,6 +1264,38 @@ static ib_status_t core_data_get(ib_provider_inst_t *dpi,
         pf,
         (void *)name, nlen
     );
+    if (rc == IB_OK) {
+        rc = ib_field_resolve_lazy(*pf);
+    }
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+/**
+ * Core data provider implementation to get a data field by symbol.
+ *
+ * @param dpi Data provider instance
+ * @param sym Field name symbol
+ * @param pf Address which field will be written
+ *
+ * @returns Status code
+ */
+static ib_status_t core_data_get_sym(ib_provider_inst_t *dpi,
+                                     const ib_symbol_t *sym,
+                                     ib_field_t **pf)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    /* "key:subkey" names need the full lookup. */
+    if (memchr(sym->name, ':', sym->nlen) != NULL) {
+        rc = core_data_get(dpi, sym->name, sym->nlen, pf);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    rc = ib_hash_get_sym((ib_hash_t *)dpi->data, pf, sym);
+    if (rc == IB_OK) {
+        rc = ib_field_resolve_lazy(*pf);
+    }
     IB_FTRACE_RET_STATUS(rc);
 }
 
@@ -1271,6 +1314,16 @@ static ib_status_t core_data_get_all(ib_provider_inst_t *dpi,
     ib_status_t rc;
 
     rc = ib_hash_get_all((ib_hash_t *)dpi->data, list);
+    if (rc == IB_OK) {
+        ib_list_node_t *node;
+
+        IB_LIST_LOOP(list, node) {
+            rc = ib_field_resolve_lazy((ib_field_t *)ib_list_node_data(node));
+            if (rc != IB_OK) {
+                IB_FTRACE_RET_STATUS(rc);
+            }
+        }
+    }
     IB_FTRACE_RET_STATUS(rc);
 }
 
@@ -1326,7 +1379,8 @@ static IB_PROVIDER_IFACE_TYPE(data) core_data_iface = {
     core_data_get,
     core_data_get_all,
     core_data_remove,
-    core_data_clear
+    core_data_clear,
+    core_data_get_sym
 };
 
 
@@ -3572,6 +3626,38 @@ static ib_status_t data_api_clear(ib_provider_inst_t *dpi)
     IB_FTRACE_RET_STATUS(rc);
 }
 
+/**
+ * Calls a registered provider interface to get a data field by symbol.
+ *
+ * Providers which do not implement get_sym are asked by name.
+ *
+ * @param dpi Data provider instance
+ * @param sym Field name symbol
+ * @param pf Address which field is written
+ *
+ * @returns Status code
+ */
+static ib_status_t data_api_get_sym(ib_provider_inst_t *dpi,
+                                    const ib_symbol_t *sym,
+                                    ib_field_t **pf)
+{
+    IB_FTRACE_INIT();
+
+    assert(dpi != NULL);
+    assert(dpi->pr != NULL);
+
+    IB_PROVIDER_IFACE_TYPE(data) *iface = (IB_PROVIDER_IFACE_TYPE(data) *)dpi->pr->iface;
+    ib_status_t rc;
+
+    if (iface->get_sym == NULL) {
+        rc = iface->get(dpi, sym->name, sym->nlen, pf);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    rc = iface->get_sym(dpi, sym, pf);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
 /**
  * Data access provider API mapping for core module.
  */
@@ -3583,6 +3669,7 @@ static IB_PROVIDER_API_TYPE(data) data_api = {
     data_api_get_all,
     data_api_remove,
     data_api_clear,
+    data_api_get_sym,
 };
 
 /**
@@ -4865,6 +4952,98 @@ static ib_status_t core_dir_param1(ib_cfgparser_t *cp,
         rc = ib_context_set_num(ctx, "buffer_res", 0);
         IB_FTRACE_RET_STATUS(rc);
     }
+    else if (strcasecmp("RuleEngineProfile", name) == 0) {
+        ib_context_t *ctx = ib_context_main(ib);
+
+        ib_log_debug2(ib, "%s: %s", name, p1_unescaped);
+        if (strcasecmp("On", p1_unescaped) == 0) {
+            rc = ib_context_set_num(ctx, "rule_profile", 1);
+            IB_FTRACE_RET_STATUS(rc);
+        }
+
+        rc = ib_context_set_num(ctx, "rule_profile", 0);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    else if (strcasecmp("RuleEngineProfileInterval", name) == 0) {
+        ib_context_t *ctx = ib_context_main(ib);
+        ib_num_t interval;
+
+        rc = ib_string_to_num(p1_unescaped, 0, &interval);
+        if ( (rc != IB_OK) || (interval < 0) ) {
+            ib_log_error(ib, "%s: Invalid interval \"%s\"",
+                         name, p1_unescaped);
+            IB_FTRACE_RET_STATUS(IB_EINVAL);
+        }
+
+        ib_log_debug2(ib, "%s: %" PRId64, name, interval);
+        rc = ib_context_set_num(ctx, "rule_profile_interval", interval);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    else if (strcasecmp("RuleEngineWorkers", name) == 0) {
+        ib_context_t *ctx = ib_context_main(ib);
+        ib_num_t workers;
+
+        rc = ib_string_to_num(p1_unescaped, 0, &workers);
+        if ( (rc != IB_OK) || (workers < 0) || (workers > 256) ) {
+            ib_log_error(ib, "%s: Invalid number of workers \"%s\"",
+                         name, p1_unescaped);
+            IB_FTRACE_RET_STATUS(IB_EINVAL);
+        }
+
+        ib_log_debug2(ib, "%s: %" PRId64, name, workers);
+        rc = ib_context_set_num(ctx, "rule_workers", workers);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    else if (strcasecmp("RuleCompileWorkers", name) == 0) {
+        ib_context_t *ctx = ib_context_main(ib);
+        ib_num_t workers;
+
+        /* "Auto" is one less than the number of CPUs (see operator.c). */
+        if (strcasecmp("Auto", p1_unescaped) == 0) {
+            workers = -1;
+        }
+        else {
+            rc = ib_string_to_num(p1_unescaped, 0, &workers);
+            if ( (rc != IB_OK) || (workers < 0) || (workers > 256) ) {
+                ib_log_error(ib, "%s: Invalid number of workers \"%s\"",
+                             name, p1_unescaped);
+                IB_FTRACE_RET_STATUS(IB_EINVAL);
+            }
+        }
+
+        ib_log_debug2(ib, "%s: %" PRId64, name, workers);
+        rc = ib_context_set_num(ctx, "rule_compile_workers", workers);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    else if (strcasecmp("FunctionTrace", name) == 0) {
+        ib_context_t *ctx = cp->cur_ctx ? cp->cur_ctx : ib_context_main(ib);
+
+        ib_log_debug2(ib, "%s: %s", name, p1_unescaped);
+        if (strcasecmp("On", p1_unescaped) == 0) {
+            rc = ib_context_set_num(ctx, "ftrace", 1);
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        else if (strcasecmp("Off", p1_unescaped) == 0) {
+            rc = ib_context_set_num(ctx, "ftrace", 0);
+            IB_FTRACE_RET_STATUS(rc);
+        }
+
+        ib_log_error(ib,
+                     "Failed to parse directive: %s \"%s\"",
+                     name,
+                     p1_unescaped);
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+    else if (strcasecmp("FunctionTraceFile", name) == 0) {
+#ifdef IB_DEBUG
+        ib_log_debug2(ib, "%s: %s", name, p1_unescaped);
+        ib_trace_ring_init(p1_unescaped, IB_TRACE_RING_EVENTS);
+#else
+        ib_log_notice(ib, "%s: Ignored; function tracing is not enabled "
+                      "in this build", name);
+#endif
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
     else if (strcasecmp("SensorId", name) == 0) {
         union {
             uint64_t uint64;
@@ -4970,6 +5149,21 @@ static ib_status_t core_dir_param1(ib_cfgparser_t *cp,
         IB_FTRACE_RET_STATUS(IB_OK);
 
     }
+    else if (strcasecmp("PcreCompileCache", name) == 0) {
+        if (cp->cur_ctx != NULL && cp->cur_ctx != ib_context_main(ib)) {
+            ib_log_error(ib, "%s is only valid in the main context", name);
+            IB_FTRACE_RET_STATUS(IB_EINVAL);
+        }
+
+        rc = ib_engine_snapshot_open(ib, p1_unescaped);
+        if (rc != IB_OK) {
+            ib_log_error(ib, "Could not open PcreCompileCache %s: %s",
+                         p1_unescaped, ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        ib_log_debug2(ib, "PcreCompileCache: %s", p1_unescaped);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
 
     ib_log_error(ib, "Unhandled directive: %s %s", name, p1_unescaped);
     IB_FTRACE_RET_STATUS(IB_EINVAL);
@@ -5351,6 +5545,47 @@ static IB_DIRMAP_INIT_STRUCTURE(core_directive_map) = {
         NULL
     ),
 
+    /* Compiled Regular Expression Cache */
+    IB_DIRMAP_INIT_PARAM1(
+        "PcreCompileCache",
+        core_dir_param1,
+        NULL
+    ),
+
+    /* Rule Engine Profiling */
+    IB_DIRMAP_INIT_PARAM1(
+        "RuleEngineProfile",
+        core_dir_param1,
+        NULL
+    ),
+    IB_DIRMAP_INIT_PARAM1(
+        "RuleEngineProfileInterval",
+        core_dir_param1,
+        NULL
+    ),
+    IB_DIRMAP_INIT_PARAM1(
+        "RuleEngineWorkers",
+        core_dir_param1,
+        NULL
+    ),
+    IB_DIRMAP_INIT_PARAM1(
+        "RuleCompileWorkers",
+        core_dir_param1,
+        NULL
+    ),
+
+    /* Function Tracing */
+    IB_DIRMAP_INIT_PARAM1(
+        "FunctionTrace",
+        core_dir_param1,
+        NULL
+    ),
+    IB_DIRMAP_INIT_PARAM1(
+        "FunctionTraceFile",
+        core_dir_param1,
+        NULL
+    ),
+
 
     /* End */
     IB_DIRMAP_INIT_LAST
@@ -5425,6 +5660,11 @@ static ib_status_t core_init(ib_engine_t *ib,
     corecfg->data               = MODULE_NAME_STR;
     corecfg->module_base_path   = X_MODULE_BASE_PATH;
     corecfg->rule_base_path     = X_RULE_BASE_PATH;
+    corecfg->rule_profile       = 0;
+    corecfg->rule_profile_interval = 300;
+    corecfg->rule_workers       = 0;
+    corecfg->rule_compile_workers = -1;
+    corecfg->ftrace             = 0;
 
     /* Define the logger provider API. */
     rc = ib_provider_define(ib, IB_PROVIDER_TYPE_LOGGER,
@@ -5718,6 +5958,42 @@ static IB_CFGMAP_INIT_STRUCTURE(core_config_map) = {
         buffer_res
     ),
 
+    /* Rule Engine Profiling */
+    IB_CFGMAP_INIT_ENTRY(
+        "rule_profile",
+        IB_FTYPE_NUM,
+        ib_core_cfg_t,
+        rule_profile
+    ),
+    IB_CFGMAP_INIT_ENTRY(
+        "rule_profile_interval",
+        IB_FTYPE_NUM,
+        ib_core_cfg_t,
+        rule_profile_interval
+    ),
+
+    /* Rule Engine Workers */
+    IB_CFGMAP_INIT_ENTRY(
+        "rule_workers",
+        IB_FTYPE_NUM,
+        ib_core_cfg_t,
+        rule_workers
+    ),
+    IB_CFGMAP_INIT_ENTRY(
+        "rule_compile_workers",
+        IB_FTYPE_NUM,
+        ib_core_cfg_t,
+        rule_compile_workers
+    ),
+
+    /* Function Tracing */
+    IB_CFGMAP_INIT_ENTRY(
+        "ftrace",
+        IB_FTYPE_NUM,
+        ib_core_cfg_t,
+        ftrace
+    ),
+
     /* Audit Log */
     IB_CFGMAP_INIT_ENTRY(
         "audit_engine",
@@ -5818,6 +6094,14 @@ static ib_status_t core_ctx_close(ib_engine_t  *ib,
         IB_FTRACE_RET_STATUS(rc);
     }
 
+    /* Index the context's rules by the fields they target */
+    rc = ib_rule_engine_ctx_close(ib, ctx);
+    if (rc != IB_OK) {
+        ib_log_alert(ib, "Failed to index rule engine context: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
     // Get the main context config, it's config, and it's logger
     main_ctx = ib_context_main(ib);
     rc = ib_context_module_config(main_ctx, ib_core_module(),
@@ -5829,6 +6113,26 @@ static ib_status_t core_ctx_close(ib_engine_t  *ib,
     }
     main_lp = main_core_config->pi.logger->pr;
 
+    /* All rules are registered by the time the main context is closed. */
+    if ( (ctx == main_ctx) && (main_core_config->rule_profile != 0) ) {
+        rc = ib_rule_engine_profile_enable(
+            ib, main_core_config->rule_profile_interval);
+        if (rc != IB_OK) {
+            ib_log_alert(ib, "Failed to enable rule profiling: %s",
+                         ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+    if ( (ctx == main_ctx) && (main_core_config->rule_workers > 0) ) {
+        rc = ib_rule_engine_workers_enable(
+            ib, main_core_config->rule_workers);
+        if (rc != IB_OK) {
+            ib_log_alert(ib, "Failed to enable rule workers: %s",
+                         ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+
 
     // Get the current context config.
     rc = ib_context_module_config(ctx, mod, (void *)&corecfg);
@@ -5913,6 +6217,11 @@ static ib_status_t core_ctx_destroy(ib_engine_t *ib,
         IB_FTRACE_RET_STATUS(IB_OK);
     }
 
+    /* Final rule profile report, while the main logger is still open. */
+    if (ctx == main_ctx) {
+        ib_rule_engine_fini(ib);
+    }
+
     rc = ib_context_module_config(main_ctx, ib_core_module(),
                                   (void *)&main_core_config);
     if (rc != IB_OK) {
@@ -56,8 +56,11 @@ typedef union {
 typedef struct {
     setvar_op_t      op;         /**< Setvar operation */
     char            *name;       /**< Field name */
+    char            *coll;       /**< Collection part of name or NULL */
+    const char      *subkey;     /**< Name within collection or NULL */
     ib_ftype_t       type;       /**< Data type */
     setvar_value_t   value;      /**< Value */
+    ib_expand_template_t *tmpl;  /**< Compiled value expansion */
 } setvar_data_t;
 
 /**
@@ -127,6 +130,30 @@ static ib_status_t act_setflag_execute(void *data,
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
+/**
+ * Execute function for the "block" action
+ * @internal
+ *
+ * @param[in] data Unused
+ * @param[in] rule The matched rule
+ * @param[in] tx IronBee transaction
+ * @param[in] flags Action instance flags
+ *
+ * @returns Status code
+ */
+static ib_status_t act_block_execute(void *data,
+                                     ib_rule_t *rule,
+                                     ib_tx_t *tx,
+                                     ib_flags_t flags)
+{
+    IB_FTRACE_INIT();
+
+    ib_log_debug_tx(tx, "Rule %s blocked transaction", ib_rule_id(rule));
+    ib_tx_mark_blocked(tx);
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
 /**
  * Event action execution callback.
  * @internal
@@ -155,7 +182,14 @@ static ib_status_t act_event_execute(void *data,
     /* Expand the message string */
     if ( (rule->meta.flags & IB_RULEMD_FLAG_EXPAND_MSG) != 0) {
         char *tmp;
-        rc = ib_data_expand_str(tx->dpi, rule->meta.msg, &tmp);
+        size_t tmplen;
+        if (rule->meta.msg_tmpl != NULL) {
+            rc = ib_data_expand_template(tx->dpi, rule->meta.msg_tmpl,
+                                         IB_TRUE, &tmp, &tmplen);
+        }
+        else {
+            rc = ib_data_expand_str(tx->dpi, rule->meta.msg, &tmp);
+        }
         if (rc != IB_OK) {
             ib_log_error_tx(tx,
                          "event: Failed to expand string '%s': %s",
@@ -189,9 +223,17 @@ static ib_status_t act_event_execute(void *data,
 
     /* Set the data */
     if (rule->meta.data != NULL) {
+        size_t exlen;
         if ( (rule->meta.flags & IB_RULEMD_FLAG_EXPAND_DATA) != 0) {
             char *tmp;
-            rc = ib_data_expand_str(tx->dpi, rule->meta.data, &tmp);
+            if (rule->meta.data_tmpl != NULL) {
+                rc = ib_data_expand_template(tx->dpi, rule->meta.data_tmpl,
+                                             IB_TRUE, &tmp, &exlen);
+            }
+            else {
+                rc = ib_data_expand_str(tx->dpi, rule->meta.data, &tmp);
+                exlen = (rc == IB_OK) ? strlen(tmp) : 0;
+            }
             if (rc != IB_OK) {
                 ib_log_error_tx(tx,
                              "event: Failed to expand data '%s': %s",
@@ -202,8 +244,9 @@ static ib_status_t act_event_execute(void *data,
         }
         else {
             expanded = rule->meta.data;
+            exlen = strlen(expanded);
         }
-        rc = ib_logevent_data_set(event, expanded, strlen(expanded));
+        rc = ib_logevent_data_set(event, expanded, exlen);
         if (rc != IB_OK) {
             ib_log_error_tx(tx,  "event: Failed to set data: %s",
                          ib_status_to_string(rc));
@@ -268,7 +311,7 @@ static ib_status_t act_setvar_create(ib_engine_t *ib,
     vlen = strlen(value);
 
     /* Create the data structure for the execute function */
-    data = ib_mpool_alloc(mp, sizeof(*data) );
+    data = ib_mpool_calloc(mp, 1, sizeof(*data) );
     if (data == NULL) {
         IB_FTRACE_RET_STATUS(IB_EALLOC);
     }
@@ -280,6 +323,19 @@ static ib_status_t act_setvar_create(ib_engine_t *ib,
     }
     memcpy(data->name, params, nlen);
 
+    /* Split "collection:name" for collections which store their own
+     * values (see act_setvar_store()). */
+    data->subkey = strchr(data->name, ':');
+    if (data->subkey != NULL) {
+        data->coll = ib_mpool_memdup(mp, data->name,
+                                     (data->subkey - data->name) + 1);
+        if (data->coll == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+        data->coll[data->subkey - data->name] = '\0';
+        ++data->subkey;
+    }
+
     /* Create the value */
     rc = ib_string_to_num_ex(value, vlen, 0, &(data->value.num));
     if (rc == IB_OK) {
@@ -298,14 +354,24 @@ static ib_status_t act_setvar_create(ib_engine_t *ib,
         if (rc != IB_OK) {
             IB_FTRACE_RET_STATUS(rc);
         }
-        else if (expand == IB_TRUE) {
-            inst->flags |= IB_ACTINST_FLAG_EXPAND;
-        }
 
         rc = ib_bytestr_dup_nulstr(&(data->value.bstr), mp, value);
         if (rc != IB_OK) {
             IB_FTRACE_RET_STATUS(rc);
         }
+
+        /* Compile the expansion against our private copy of the value */
+        if (expand == IB_TRUE) {
+            rc = ib_data_expand_compile(
+                mp,
+                (const char *)ib_bytestr_const_ptr(data->value.bstr),
+                ib_bytestr_length(data->value.bstr),
+                &(data->tmpl));
+            if (rc != IB_OK) {
+                IB_FTRACE_RET_STATUS(rc);
+            }
+            inst->flags |= IB_ACTINST_FLAG_EXPAND;
+        }
         data->type = IB_FTYPE_BYTESTR;
         data->op = SETVAR_STRSET;
     }
@@ -314,6 +380,42 @@ static ib_status_t act_setvar_create(ib_engine_t *ib,
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
+/**
+ * Store the new value of a setvar field.
+ * @internal
+ *
+ * If the name is "collection:name" and the collection is a dynamic field
+ * (e.g., a persistent collection), the collection stores the value;
+ * otherwise @a f replaces any field of the same name.
+ *
+ * @param[in] svdata Setvar data
+ * @param[in] tx IronBee transaction
+ * @param[in] f New field
+ *
+ * @returns Status code
+ */
+static ib_status_t act_setvar_store(const setvar_data_t *svdata,
+                                    ib_tx_t *tx,
+                                    ib_field_t *f)
+{
+    IB_FTRACE_INIT();
+    ib_field_t *coll;
+    ib_status_t rc;
+
+    if ( (svdata->coll != NULL) &&
+         (ib_data_get(tx->dpi, svdata->coll, &coll) == IB_OK) &&
+         ib_field_is_dynamic(coll) )
+    {
+        rc = ib_field_setv_ex(coll, f,
+                              svdata->subkey, strlen(svdata->subkey));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    ib_data_remove(tx->dpi, svdata->name, NULL);
+    rc = ib_data_add(tx->dpi, f);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
 /**
  * Execute function for the "set variable" action
  * @internal
@@ -331,7 +433,6 @@ static ib_status_t act_setvar_execute(void *cbdata,
                                       ib_flags_t flags)
 {
     IB_FTRACE_INIT();
-    ib_field_t *cur = NULL;
     ib_field_t *new;
     char *expanded = NULL;
     size_t exlen;
@@ -348,15 +449,12 @@ static ib_status_t act_setvar_execute(void *cbdata,
         bslen = ib_bytestr_length(svdata->value.bstr);
     }
 
-    /* Get the current value */
-    ib_data_get(tx->dpi, svdata->name, &cur);
-
     /* Expand the string */
     if ( (flags & IB_ACTINST_FLAG_EXPAND) != 0) {
         assert(svdata->type == IB_FTYPE_BYTESTR);
 
-        rc = ib_data_expand_str_ex(
-            tx->dpi, bsdata, bslen, IB_FALSE, &expanded, &exlen);
+        rc = ib_data_expand_template(
+            tx->dpi, svdata->tmpl, IB_FALSE, &expanded, &exlen);
         if (rc != IB_OK) {
             ib_log_error_tx(tx,
                          "setvar: Failed to expand string '%.*s': %s",
@@ -380,10 +478,6 @@ static ib_status_t act_setvar_execute(void *cbdata,
         assert(svdata->type == IB_FTYPE_BYTESTR);
         ib_bytestr_t *bs = NULL;
 
-        if (cur != NULL) {
-            ib_data_remove(tx->dpi, svdata->name, NULL);
-        }
-
         /* Create a bytestr to hold it. */
         rc = ib_bytestr_alias_mem(&bs, tx->mp, (uint8_t *)expanded, exlen);
         if (rc != IB_OK) {
@@ -408,11 +502,11 @@ static ib_status_t act_setvar_execute(void *cbdata,
             IB_FTRACE_RET_STATUS(rc);
         }
 
-        /* Add the field to the DPI */
-        rc = ib_data_add(tx->dpi, new);
+        /* Store the field */
+        rc = act_setvar_store(svdata, tx, new);
         if (rc != IB_OK) {
             ib_log_error_tx(tx,
-                         "setvar: Failed to add field %s: %s",
+                         "setvar: Failed to store field %s: %s",
                          svdata->name, ib_status_to_string(rc));
             IB_FTRACE_RET_STATUS(rc);
         }
@@ -422,10 +516,6 @@ static ib_status_t act_setvar_execute(void *cbdata,
     else if (svdata->op == SETVAR_NUMSET) {
         assert(svdata->type == IB_FTYPE_NUM);
 
-        if (cur != NULL) {
-            ib_data_remove(tx->dpi, svdata->name, NULL);
-        }
-
         /* Create the new field */
         rc = ib_field_create(
             &new,
@@ -441,11 +531,11 @@ static ib_status_t act_setvar_execute(void *cbdata,
             IB_FTRACE_RET_STATUS(rc);
         }
 
-        /* Add the field to the DPI */
-        rc = ib_data_add(tx->dpi, new);
+        /* Store the field */
+        rc = act_setvar_store(svdata, tx, new);
         if (rc != IB_OK) {
             ib_log_error_tx(tx,
-                         "setvar: Failed to add field %s: %s",
+                         "setvar: Failed to store field %s: %s",
                          svdata->name, ib_status_to_string(rc));
             IB_FTRACE_RET_STATUS(rc);
         }
@@ -454,39 +544,19 @@ static ib_status_t act_setvar_execute(void *cbdata,
     /* Numerical operation : Add */
     else if (svdata->op == SETVAR_NUMADD) {
         assert(svdata->type == IB_FTYPE_NUM);
-        if (cur == NULL) {
+
+        rc = ib_data_set_relative(tx->dpi, svdata->name, svdata->value.num);
+        if (rc == IB_ENOENT) {
             ib_log_error_tx(tx,
                          "setvar: field %s does not exist for NUMADD action",
                          svdata->name);
             IB_FTRACE_RET_STATUS(IB_EINVAL);
         }
-
-        /* Handle num and unum types */
-        if (cur->type == IB_FTYPE_NUM) {
-            ib_num_t num;
-            rc = ib_field_value(cur, ib_ftype_num_out(&num));
-            if (rc != IB_OK) {
-                IB_FTRACE_RET_STATUS(rc);
-            }
-
-            num += svdata->value.num;
-            ib_field_setv(cur, ib_ftype_num_in(&num));
-        }
-        else if (cur->type == IB_FTYPE_UNUM) {
-            ib_unum_t num;
-            rc = ib_field_setv(cur, ib_ftype_unum_out(&num));
-            if (rc != IB_OK) {
-                IB_FTRACE_RET_STATUS(rc);
-            }
-
-            num += (ib_unum_t)svdata->value.num;
-            ib_field_setv(cur, ib_ftype_unum_in(&num));
-        }
-        else {
+        else if (rc != IB_OK) {
             ib_log_error_tx(tx,
-                         "setvar: field %s type %d invalid for NUMADD action",
-                         svdata->name, cur->type);
-            IB_FTRACE_RET_STATUS(IB_EINVAL);
+                         "setvar: field %s invalid for NUMADD action: %s",
+                         svdata->name, ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
         }
     }
 
@@ -536,5 +606,16 @@ ib_status_t ib_core_actions_init(ib_engine_t *ib, ib_module_t *mod)
         IB_FTRACE_RET_STATUS(rc);
     }
 
+    /* Register the block action */
+    rc = ib_action_register(ib,
+                            "block",
+                            IB_ACT_FLAG_NONE,
+                            NULL, /* no create function */
+                            NULL, /* no destroy function */
+                            act_block_execute);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
     IB_FTRACE_RET_STATUS(IB_OK);
 }
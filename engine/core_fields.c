@@ -26,40 +26,58 @@
 
 #include <ironbee/debug.h>
 #include <ironbee/core.h>
+#include <ironbee/mpool.h>
+#include <ironbee/symbol.h>
 #include <ironbee_private.h>
 
 #include <assert.h>
 
+/**
+ * Interned names of the core fields.
+ *
+ * Interned once per engine so that transactions share the names rather
+ * than copying and hashing them for each request.
+ */
+typedef struct {
+    const ib_symbol_t *request_line;
+    const ib_symbol_t *request_method;
+    const ib_symbol_t *request_uri_raw;
+    const ib_symbol_t *request_protocol;
+    const ib_symbol_t *response_line;
+    const ib_symbol_t *response_protocol;
+    const ib_symbol_t *response_status;
+    const ib_symbol_t *response_message;
+} core_field_symbols_t;
+
 /* -- Field Generation Routines -- */
 
 static inline void core_gen_bytestr_alias_field(ib_tx_t *tx,
-                                                const char *name,
+                                                const ib_symbol_t *sym,
                                                 ib_bytestr_t *val)
 {
     ib_field_t *f;
 
     assert(tx != NULL);
-    assert(name != NULL);
+    assert(sym != NULL);
 
-    ib_status_t rc = ib_field_create_no_copy(&f, tx->mp,
-                                             name, strlen(name),
-                                             IB_FTYPE_BYTESTR,
-                                             val);
+    ib_status_t rc = ib_field_create_sym(&f, tx->mp, sym,
+                                         IB_FTYPE_BYTESTR,
+                                         val);
     if (rc != IB_OK) {
         ib_log_warning(tx->ib, "Failed to create \"%s\" field: %s",
-                     name, ib_status_to_string(rc));
+                     sym->name, ib_status_to_string(rc));
         return;
     }
 
     ib_log_debug(tx->ib, "FIELD: \"%s\"=\"%.*s\"",
-                 name,
+                 sym->name,
                  (int)ib_bytestr_length(val),
                  (char *)ib_bytestr_const_ptr(val));
 
     rc = ib_data_add(tx->dpi, f);
     if (rc != IB_OK) {
         ib_log_warning(tx->ib, "Failed add \"%s\" field to data store: %s",
-                       name, ib_status_to_string(rc));
+                       sym->name, ib_status_to_string(rc));
     }
 }
 
@@ -76,19 +94,22 @@ static ib_status_t core_gen_request_header_fields(ib_engine_t *ib,
     assert(ib != NULL);
     assert(tx != NULL);
     assert(event == request_headers_event);
+    assert(cbdata != NULL);
+
+    const core_field_symbols_t *syms = (const core_field_symbols_t *)cbdata;
 
     ib_log_debug(ib, "core_gen_request_header_fields");
 
-    core_gen_bytestr_alias_field(tx, "request_line",
+    core_gen_bytestr_alias_field(tx, syms->request_line,
                                  tx->request_line->raw);
 
-    core_gen_bytestr_alias_field(tx, "request_method",
+    core_gen_bytestr_alias_field(tx, syms->request_method,
                                  tx->request_line->method);
 
-    core_gen_bytestr_alias_field(tx, "request_uri_raw",
+    core_gen_bytestr_alias_field(tx, syms->request_uri_raw,
                                  tx->request_line->uri);
 
-    core_gen_bytestr_alias_field(tx, "request_protocol",
+    core_gen_bytestr_alias_field(tx, syms->request_protocol,
                                  tx->request_line->protocol);
 
     IB_FTRACE_RET_STATUS(IB_OK);
@@ -107,39 +128,92 @@ static ib_status_t core_gen_response_header_fields(ib_engine_t *ib,
     assert(ib != NULL);
     assert(tx != NULL);
     assert(event == response_headers_event);
+    assert(cbdata != NULL);
+
+    const core_field_symbols_t *syms = (const core_field_symbols_t *)cbdata;
 
     ib_log_debug(ib, "core_gen_response_header_fields");
 
-    core_gen_bytestr_alias_field(tx, "response_line",
+    core_gen_bytestr_alias_field(tx, syms->response_line,
                                  tx->response_line->raw);
 
-    core_gen_bytestr_alias_field(tx, "response_protocol",
+    core_gen_bytestr_alias_field(tx, syms->response_protocol,
                                  tx->response_line->protocol);
 
-    core_gen_bytestr_alias_field(tx, "response_status",
+    core_gen_bytestr_alias_field(tx, syms->response_status,
                                  tx->response_line->status);
 
-    core_gen_bytestr_alias_field(tx, "response_message",
+    core_gen_bytestr_alias_field(tx, syms->response_message,
                                  tx->response_line->msg);
 
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
+/**
+ * Intern a core field name.
+ *
+ * @param[in] ib Engine
+ * @param[in] name Field name
+ * @param[out] psym Address which symbol is written
+ *
+ * @returns Status code
+ */
+static ib_status_t core_field_symbol(ib_engine_t *ib,
+                                     const char *name,
+                                     const ib_symbol_t **psym)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    rc = ib_engine_symbol(ib, name, strlen(name), psym);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to intern field name \"%s\": %s",
+                     name, ib_status_to_string(rc));
+    }
+    IB_FTRACE_RET_STATUS(rc);
+}
+
 /* Initialize core field generation callbacks. */
 ib_status_t ib_core_fields_init(ib_engine_t *ib,
                                 ib_module_t *mod)
 {
     IB_FTRACE_INIT();
+    core_field_symbols_t *syms;
+    ib_status_t rc;
 
     assert(ib != NULL);
     assert(mod != NULL);
 
+    syms = (core_field_symbols_t *)ib_mpool_calloc(ib->mp, 1, sizeof(*syms));
+    if (syms == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    if (   ((rc = core_field_symbol(ib, "request_line",
+                                    &syms->request_line)) != IB_OK)
+        || ((rc = core_field_symbol(ib, "request_method",
+                                    &syms->request_method)) != IB_OK)
+        || ((rc = core_field_symbol(ib, "request_uri_raw",
+                                    &syms->request_uri_raw)) != IB_OK)
+        || ((rc = core_field_symbol(ib, "request_protocol",
+                                    &syms->request_protocol)) != IB_OK)
+        || ((rc = core_field_symbol(ib, "response_line",
+                                    &syms->response_line)) != IB_OK)
+        || ((rc = core_field_symbol(ib, "response_protocol",
+                                    &syms->response_protocol)) != IB_OK)
+        || ((rc = core_field_symbol(ib, "response_status",
+                                    &syms->response_status)) != IB_OK)
+        || ((rc = core_field_symbol(ib, "response_message",
+                                    &syms->response_message)) != IB_OK))
+    {
+        IB_FTRACE_RET_STATUS(rc);
+    }
 
     ib_hook_tx_register(ib, request_headers_event,
-                        core_gen_request_header_fields, NULL);
+                        core_gen_request_header_fields, syms);
 
     ib_hook_tx_register(ib, response_headers_event,
-                        core_gen_response_header_fields, NULL);
+                        core_gen_response_header_fields, syms);
 
     IB_FTRACE_RET_STATUS(IB_OK);
 }
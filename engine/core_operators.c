@@ -363,6 +363,9 @@ static ib_status_t op_checkflag_execute(ib_engine_t *ib,
     if (strcasecmp(cstr, "suspicious") == 0) {
         *result = ib_tx_flags_isset(tx, IB_TX_FSUSPICIOUS);
     }
+    else if (strcasecmp(cstr, "blocked") == 0) {
+        *result = ib_tx_flags_isset(tx, IB_TX_FBLOCKED);
+    }
     else {
         ib_log_error_tx(tx,  "checkflag operator: invalid flag '%s'", cstr);
         IB_FTRACE_RET_STATUS(IB_EINVAL);
@@ -1000,7 +1003,7 @@ ib_status_t ib_core_operators_init(ib_engine_t *ib, ib_module_t *mod)
     /* Register the string equal operator */
     rc = ib_operator_register(ib,
                               "streq",
-                              IB_OP_FLAG_PHASE,
+                              IB_OP_FLAG_PHASE | IB_OP_FLAG_PARALLEL,
                               strop_create,
                               NULL, /* no destroy function */
                               op_streq_execute);
@@ -1011,7 +1014,7 @@ ib_status_t ib_core_operators_init(ib_engine_t *ib, ib_module_t *mod)
     /* Register the string contains operator */
     rc = ib_operator_register(ib,
                               "contains",
-                              IB_OP_FLAG_PHASE,
+                              IB_OP_FLAG_PHASE | IB_OP_FLAG_PARALLEL,
                               strop_create,
                               NULL, /* no destroy function */
                               op_contains_execute);
@@ -1022,7 +1025,7 @@ ib_status_t ib_core_operators_init(ib_engine_t *ib, ib_module_t *mod)
     /* Register the ipmatch operator */
     rc = ib_operator_register(ib,
                               "ipmatch",
-                              IB_OP_FLAG_PHASE,
+                              IB_OP_FLAG_PHASE | IB_OP_FLAG_PARALLEL,
                               op_ipmatch_create,
                               NULL, /* no destroy function */
                               op_ipmatch_execute);
@@ -1037,7 +1040,7 @@ ib_status_t ib_core_operators_init(ib_engine_t *ib, ib_module_t *mod)
     /* Register the numeric equal operator */
     rc = ib_operator_register(ib,
                               "eq",
-                              IB_OP_FLAG_PHASE,
+                              IB_OP_FLAG_PHASE | IB_OP_FLAG_PARALLEL,
                               op_numcmp_create,
                               NULL, /* no destroy function */
                               op_eq_execute);
@@ -1048,7 +1051,7 @@ ib_status_t ib_core_operators_init(ib_engine_t *ib, ib_module_t *mod)
     /* Register the numeric not-equal operator */
     rc = ib_operator_register(ib,
                               "ne",
-                              IB_OP_FLAG_PHASE,
+                              IB_OP_FLAG_PHASE | IB_OP_FLAG_PARALLEL,
                               op_numcmp_create,
                               NULL, /* no destroy function */
                               op_ne_execute);
@@ -1059,7 +1062,7 @@ ib_status_t ib_core_operators_init(ib_engine_t *ib, ib_module_t *mod)
     /* Register the numeric greater-than operator */
     rc = ib_operator_register(ib,
                               "gt",
-                              IB_OP_FLAG_PHASE,
+                              IB_OP_FLAG_PHASE | IB_OP_FLAG_PARALLEL,
                               op_numcmp_create,
                               NULL, /* no destroy function */
                               op_gt_execute);
@@ -1070,7 +1073,7 @@ ib_status_t ib_core_operators_init(ib_engine_t *ib, ib_module_t *mod)
     /* Register the numeric less-than operator */
     rc = ib_operator_register(ib,
                               "lt",
-                              IB_OP_FLAG_PHASE,
+                              IB_OP_FLAG_PHASE | IB_OP_FLAG_PARALLEL,
                               op_numcmp_create,
                               NULL, /* no destroy function */
                               op_lt_execute);
@@ -1081,7 +1084,7 @@ ib_status_t ib_core_operators_init(ib_engine_t *ib, ib_module_t *mod)
     /* Register the numeric greater-than or equal to operator */
     rc = ib_operator_register(ib,
                               "ge",
-                              IB_OP_FLAG_PHASE,
+                              IB_OP_FLAG_PHASE | IB_OP_FLAG_PARALLEL,
                               op_numcmp_create,
                               NULL, /* no destroy function */
                               op_ge_execute);
@@ -1092,7 +1095,7 @@ ib_status_t ib_core_operators_init(ib_engine_t *ib, ib_module_t *mod)
     /* Register the numeric less-than or equal to operator */
     rc = ib_operator_register(ib,
                               "le",
-                              IB_OP_FLAG_PHASE,
+                              IB_OP_FLAG_PHASE | IB_OP_FLAG_PARALLEL,
                               op_numcmp_create,
                               NULL, /* no destroy function */
                               op_le_execute);
@@ -263,6 +263,24 @@ ib_status_t ib_data_get_ex(ib_provider_inst_t *dpi,
     IB_FTRACE_RET_STATUS(rc);
 }
 
+ib_status_t ib_data_get_sym(ib_provider_inst_t *dpi,
+                            const ib_symbol_t *sym,
+                            ib_field_t **pf)
+{
+    IB_FTRACE_INIT();
+    IB_PROVIDER_API_TYPE(data) *api =
+        (IB_PROVIDER_API_TYPE(data) *)dpi->pr->api;
+    ib_status_t rc;
+
+    assert(dpi != NULL);
+    assert(dpi->pr != NULL);
+    assert(dpi->pr->api != NULL);
+    assert(sym != NULL);
+
+    rc = api->get_sym(dpi, sym, pf);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
 ib_status_t ib_data_get_all(ib_provider_inst_t *dpi,
                             ib_list_t *list)
 {
@@ -419,6 +437,26 @@ ib_status_t ib_data_remove_ex(ib_provider_inst_t *dpi,
     IB_FTRACE_RET_STATUS(rc);
 }
 
+ib_status_t ib_data_set_relative_ex(ib_provider_inst_t *dpi,
+                                   const char *name,
+                                   size_t nlen,
+                                   intmax_t adjval)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    assert(dpi != NULL);
+    assert(dpi->pr != NULL);
+    assert(dpi->pr->api != NULL);
+
+    IB_PROVIDER_API_TYPE(data) *api =
+        (IB_PROVIDER_API_TYPE(data) *)dpi->pr->api;
+
+    rc = api->set_relative(dpi, name, nlen, adjval);
+
+    IB_FTRACE_RET_STATUS(rc);
+}
+
 ib_status_t ib_data_expand_str(ib_provider_inst_t *dpi,
                                const char *str,
                                char **result)
@@ -467,6 +505,48 @@ ib_status_t ib_data_expand_str_ex(ib_provider_inst_t *dpi,
     IB_FTRACE_RET_STATUS(rc);
 }
 
+ib_status_t DLL_PUBLIC ib_data_expand_compile(ib_mpool_t *mp,
+                                              const char *str,
+                                              size_t slen,
+                                              ib_expand_template_t **tmpl)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    rc = ib_expand_compile(mp,
+                           str,
+                           slen,
+                           IB_VARIABLE_EXPANSION_PREFIX,
+                           IB_VARIABLE_EXPANSION_POSTFIX,
+                           tmpl);
+
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+ib_status_t DLL_PUBLIC ib_data_expand_template(
+    ib_provider_inst_t *dpi,
+    const ib_expand_template_t *tmpl,
+    ib_bool_t nul,
+    char **result,
+    size_t *result_len)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    assert(dpi != NULL);
+    assert(dpi->pr != NULL);
+    assert(dpi->pr->api != NULL);
+
+    rc = ib_expand_template_exec(dpi->mp,
+                                 tmpl,
+                                 nul,
+                                 (ib_hash_t *)dpi->data,
+                                 result,
+                                 result_len);
+
+    IB_FTRACE_RET_STATUS(rc);
+}
+
 ib_status_t DLL_PUBLIC ib_data_expand_test_str(const char *str,
                                                ib_bool_t *result)
 {
@@ -38,6 +38,7 @@
 #include <ironbee/engine.h>
 #include <ironbee/mpool.h>
 #include <ironbee/hash.h>
+#include <ironbee/symbol.h>
 #include <ironbee/cfgmap.h>
 #include <ironbee/debug.h>
 #include <ironbee/module.h>
@@ -224,6 +225,7 @@ ib_status_t ib_engine_create(ib_engine_t **pib, ib_server_t *plugin)
         goto failed;
     }
     (*pib)->mp = pool;
+    (*pib)->cfg_hash = IB_SNAPSHOT_HASH_INIT;
 
     /* Create temporary memory pool */
     /// @todo Need to tune the pool size
@@ -334,6 +336,12 @@ ib_status_t ib_engine_create(ib_engine_t **pib, ib_server_t *plugin)
         goto failed;
     }
 
+    /* Create a symbol table to intern field names */
+    rc = ib_symtab_create(&((*pib)->symbols), (*pib)->mp);
+    if (rc != IB_OK) {
+        goto failed;
+    }
+
     /* Initialize the core static module. */
     /// @todo Probably want to do this in a less hard-coded manner.
     rc = ib_module_init(ib_core_module(), *pib);
@@ -435,10 +443,61 @@ void ib_engine_pool_temp_destroy(ib_engine_t *ib)
     IB_FTRACE_RET_VOID();
 }
 
+ib_status_t ib_engine_symbol(ib_engine_t *ib,
+                             const char *name,
+                             size_t nlen,
+                             const ib_symbol_t **psym)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    assert(ib != NULL);
+
+    rc = ib_symtab_intern(ib->symbols, name, nlen, psym);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+ib_status_t ib_engine_snapshot_open(ib_engine_t *ib,
+                                    const char *path)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    assert(ib != NULL);
+    assert(path != NULL);
+
+    if (ib->snapshot != NULL) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    rc = ib_snapshot_open(&ib->snapshot, ib->mp, path);
+    if (rc != IB_OK) {
+        ib->snapshot = NULL;
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    ib_log_debug(ib, "Opened compile cache \"%s\" "
+                 "(config hash %016llx)",
+                 path,
+                 (unsigned long long)ib_snapshot_config_hash(ib->snapshot));
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_snapshot_t *ib_engine_snapshot_get(const ib_engine_t *ib)
+{
+    IB_FTRACE_INIT();
+    assert(ib != NULL);
+
+    IB_FTRACE_RET_PTR(ib_snapshot_t, ib->snapshot);
+}
+
 void ib_engine_destroy(ib_engine_t *ib)
 {
     IB_FTRACE_INIT();
     if (ib) {
+        (void)ib_trace_ring_flush();
+
         size_t ne;
         size_t idx;
         ib_context_t *ctx;
@@ -467,7 +526,7 @@ void ib_engine_destroy(ib_engine_t *ib)
         ib_log_debug3(ib, "Unloading modules...");
         IB_ARRAY_LOOP_REVERSE(ib->modules, ne, idx, m) {
             if (m != cm) {
-                ib_module_unload(m);
+                ib_module_fini(ib, m);
             }
         }
 
@@ -0,0 +1,346 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; Engine Manager
+ *
+ * Engines are kept in a fixed table of slots.  Each slot counts the users
+ * of its engine; the current engine holds one extra reference on behalf of
+ * the manager, which is dropped when it is replaced.  Whoever drops the
+ * last reference destroys the engine, outside of the lock.
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include "ironbee_config_auto.h"
+
+#include <ironbee/engine_manager.h>
+#include <ironbee/array.h>
+#include <ironbee/debug.h>
+#include <ironbee/lock.h>
+#include <ironbee/module.h>
+
+#include "ironbee_private.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @internal
+ * An engine held by the manager.
+ */
+typedef struct {
+    ib_engine_t        *ib;               /**< Engine; NULL if slot free */
+    size_t              refs;             /**< Users, plus 1 if current */
+} manager_slot_t;
+
+/**
+ * @internal
+ * Engine manager.
+ */
+struct ib_manager_t {
+    ib_lock_t           lock;             /**< Protects everything below */
+    manager_slot_t     *slots;            /**< Engine slots */
+    size_t              max_engines;      /**< Number of slots */
+    manager_slot_t     *current;          /**< Current engine or NULL */
+    uint64_t            generation;       /**< Generation of current */
+};
+
+/**
+ * @internal
+ * Check that two engines have the same modules at the same indexes.
+ *
+ * @param[in] a Engine
+ * @param[in] b Engine
+ *
+ * @returns 1 if they do, 0 otherwise
+ */
+static int manager_modules_match(const ib_engine_t *a,
+                                 const ib_engine_t *b)
+{
+    size_t n = ib_array_elements(a->modules);
+    size_t idx;
+
+    if (n != ib_array_elements(b->modules)) {
+        return 0;
+    }
+    for (idx = 0; idx < n; ++idx) {
+        ib_module_t *ma = NULL;
+        ib_module_t *mb = NULL;
+
+        ib_array_get(a->modules, idx, &ma);
+        ib_array_get(b->modules, idx, &mb);
+        if ( (ma == NULL) || (mb == NULL) ) {
+            if (ma != mb) {
+                return 0;
+            }
+        }
+        else if (strcmp(ma->name, mb->name) != 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @internal
+ * Find the slot holding @a ib.
+ *
+ * Must be called with the lock held.
+ *
+ * @param[in] manager Engine manager
+ * @param[in] ib Engine
+ *
+ * @returns Slot or NULL
+ */
+static manager_slot_t *manager_slot_find(ib_manager_t *manager,
+                                         const ib_engine_t *ib)
+{
+    size_t n;
+
+    for (n = 0; n < manager->max_engines; ++n) {
+        if (manager->slots[n].ib == ib) {
+            return &(manager->slots[n]);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @internal
+ * Drop a reference to the engine in @a slot.
+ *
+ * Must be called with the lock held.
+ *
+ * @param[in] slot Slot
+ *
+ * @returns The engine if this was the last reference (the slot is freed and
+ *          the caller must destroy the engine), NULL otherwise
+ */
+static ib_engine_t *manager_slot_unref(manager_slot_t *slot)
+{
+    ib_engine_t *ib = slot->ib;
+
+    assert(slot->refs > 0);
+
+    if (--slot->refs != 0) {
+        return NULL;
+    }
+    slot->ib = NULL;
+    return ib;
+}
+
+ib_status_t ib_manager_create(ib_manager_t **pmanager,
+                              size_t max_engines)
+{
+    IB_FTRACE_INIT();
+    ib_manager_t *manager;
+    ib_status_t rc;
+
+    assert(pmanager != NULL);
+
+    if (max_engines == 0) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    manager = (ib_manager_t *)calloc(1, sizeof(*manager));
+    if (manager == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    manager->slots =
+        (manager_slot_t *)calloc(max_engines, sizeof(*manager->slots));
+    if (manager->slots == NULL) {
+        free(manager);
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    manager->max_engines = max_engines;
+
+    rc = ib_lock_init(&(manager->lock));
+    if (rc != IB_OK) {
+        free(manager->slots);
+        free(manager);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    *pmanager = manager;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+void ib_manager_destroy(ib_manager_t *manager)
+{
+    IB_FTRACE_INIT();
+    size_t n;
+
+    if (manager == NULL) {
+        IB_FTRACE_RET_VOID();
+    }
+
+    for (n = 0; n < manager->max_engines; ++n) {
+        if (manager->slots[n].ib != NULL) {
+            ib_engine_destroy(manager->slots[n].ib);
+        }
+    }
+
+    ib_lock_destroy(&(manager->lock));
+    free(manager->slots);
+    free(manager);
+
+    IB_FTRACE_RET_VOID();
+}
+
+ib_status_t ib_manager_engine_add(ib_manager_t *manager,
+                                  ib_engine_t *ib)
+{
+    IB_FTRACE_INIT();
+    manager_slot_t *slot = NULL;
+    ib_engine_t *old = NULL;
+    uint64_t generation;
+    size_t n;
+
+    assert(manager != NULL);
+    assert(ib != NULL);
+
+    ib_lock_lock(&(manager->lock));
+
+    if ( (manager->current != NULL) &&
+         ! manager_modules_match(manager->current->ib, ib) )
+    {
+        ib_lock_unlock(&(manager->lock));
+        ib_log_error(ib, "New engine does not load the same modules "
+                     "as the current engine");
+        IB_FTRACE_RET_STATUS(IB_EINCOMPAT);
+    }
+
+    for (n = 0; n < manager->max_engines; ++n) {
+        if (manager->slots[n].ib == NULL) {
+            slot = &(manager->slots[n]);
+            break;
+        }
+    }
+    /* With every slot taken, an idle current engine can be replaced in
+     * place. */
+    if ( (slot == NULL) &&
+         (manager->current != NULL) && (manager->current->refs == 1) )
+    {
+        slot = manager->current;
+    }
+    if (slot == NULL) {
+        ib_lock_unlock(&(manager->lock));
+        ib_log_error(ib, "Too many engines in use (%zu) to add another",
+                     manager->max_engines);
+        IB_FTRACE_RET_STATUS(IB_EAGAIN);
+    }
+
+    /* Publish; the replaced engine goes once its connections are done. */
+    if (manager->current != NULL) {
+        old = manager_slot_unref(manager->current);
+    }
+    generation = ++manager->generation;
+    slot->ib = ib;
+    slot->refs = 1;
+    manager->current = slot;
+
+    ib_lock_unlock(&(manager->lock));
+
+    ib_log_info(ib, "Engine generation %llu is now current",
+                (unsigned long long)generation);
+    if (old != NULL) {
+        ib_engine_destroy(old);
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_manager_engine_acquire(ib_manager_t *manager,
+                                      ib_engine_t **pib)
+{
+    IB_FTRACE_INIT();
+
+    assert(manager != NULL);
+    assert(pib != NULL);
+
+    ib_lock_lock(&(manager->lock));
+    if (manager->current == NULL) {
+        ib_lock_unlock(&(manager->lock));
+        IB_FTRACE_RET_STATUS(IB_ENOENT);
+    }
+    ++manager->current->refs;
+    *pib = manager->current->ib;
+    ib_lock_unlock(&(manager->lock));
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_manager_engine_release(ib_manager_t *manager,
+                                      ib_engine_t *ib)
+{
+    IB_FTRACE_INIT();
+    manager_slot_t *slot;
+    ib_engine_t *old;
+
+    assert(manager != NULL);
+
+    ib_lock_lock(&(manager->lock));
+    slot = manager_slot_find(manager, ib);
+    if ( (ib == NULL) || (slot == NULL) ) {
+        ib_lock_unlock(&(manager->lock));
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+    old = manager_slot_unref(slot);
+    ib_lock_unlock(&(manager->lock));
+
+    if (old != NULL) {
+        ib_engine_destroy(old);
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+size_t ib_manager_engine_count(ib_manager_t *manager)
+{
+    IB_FTRACE_INIT();
+    size_t count = 0;
+    size_t n;
+
+    assert(manager != NULL);
+
+    ib_lock_lock(&(manager->lock));
+    for (n = 0; n < manager->max_engines; ++n) {
+        if (manager->slots[n].ib != NULL) {
+            ++count;
+        }
+    }
+    ib_lock_unlock(&(manager->lock));
+
+    IB_FTRACE_RET_SIZET(count);
+}
+
+uint64_t ib_manager_generation(ib_manager_t *manager)
+{
+    uint64_t generation;
+
+    assert(manager != NULL);
+
+    ib_lock_lock(&(manager->lock));
+    generation = manager->generation;
+    ib_lock_unlock(&(manager->lock));
+
+    return generation;
+}
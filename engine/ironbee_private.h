@@ -35,10 +35,15 @@
 #include <ironbee/provider.h>
 #include <ironbee/array.h>
 #include <ironbee/logformat.h>
+#include <ironbee/rule_engine.h>
 
 /* Pull in FILE* for ib_auditlog_cfg_t. */
 #include <stdio.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * @internal
  *
@@ -101,6 +106,10 @@ struct ib_engine_t {
     ib_hash_t          *operators;        /**< Hash tracking operators */
     ib_hash_t          *actions;          /**< Hash tracking rules */
     ib_rule_engine_t   *rules;            /**< Rule engine data */
+    ib_symtab_t        *symbols;          /**< Interned field names */
+    ib_snapshot_t      *snapshot;         /**< Compile cache or NULL */
+    uint64_t            cfg_hash;         /**< Hash of configuration text */
+    ib_list_t          *op_pending;       /**< Deferred operator instances */
 
     /* Hooks */
     ib_hook_t *hook[IB_STATE_EVENT_NUM + 1]; /**< Registered hook callbacks */
@@ -189,6 +198,22 @@ struct ib_matcher_t {
 #define IB_VARIABLE_EXPANSION_PREFIX  "%{"  /**< Variable prefix */
 #define IB_VARIABLE_EXPANSION_POSTFIX "}"   /**< Variable postfix */
 
+/**
+ * @internal
+ * Finish a module for an engine being destroyed.
+ *
+ * Calls the module's fini function.  A loaded module is shared by every
+ * engine which loads it, and its @c ib is the engine which initialized it
+ * last, so the engine being destroyed is passed explicitly.
+ *
+ * @param[in] ib Engine being destroyed
+ * @param[in] m Module
+ *
+ * @returns Status code
+ */
+ib_status_t ib_module_fini(ib_engine_t *ib,
+                           ib_module_t *m);
+
 /**
  * Initialize the core fields.
  *
@@ -226,6 +251,204 @@ ib_status_t ib_rule_engine_ctx_init(ib_engine_t *ib,
                                     ib_module_t *mod,
                                     ib_context_t *ctx);
 
+/**
+ * @internal
+ * Build the rule dependency indexes of a context.
+ *
+ * Called when a context is closed, after all of its rules are registered.
+ *
+ * @param[in,out] ib IronBee object
+ * @param[in,out] ctx IronBee context
+ *
+ * @returns Status code
+ */
+ib_status_t ib_rule_engine_ctx_close(ib_engine_t *ib,
+                                     ib_context_t *ctx);
+
+/**
+ * @internal
+ * Enable rule profiling.
+ *
+ * Called when the main context is closed, after all rules are registered.
+ *
+ * @param[in,out] ib IronBee object
+ * @param[in] interval Seconds between periodic reports (0 for none)
+ *
+ * @returns Status code
+ */
+ib_status_t ib_rule_engine_profile_enable(ib_engine_t *ib,
+                                          ib_num_t interval);
+
+/**
+ * @internal
+ * Enable parallel rule evaluation.
+ *
+ * Called when the main context is closed, after all rules are registered.
+ *
+ * @param[in,out] ib IronBee object
+ * @param[in] num_threads Number of worker threads
+ *
+ * @returns Status code
+ */
+ib_status_t ib_rule_engine_workers_enable(ib_engine_t *ib,
+                                          ib_num_t num_threads);
+
+/**
+ * @internal
+ * Shut down the rule engine.
+ *
+ * Called when the main context is destroyed; writes the final rule profile
+ * report (if profiling is enabled) and stops the rule worker threads.
+ *
+ * @param[in,out] ib IronBee object
+ */
+void ib_rule_engine_fini(ib_engine_t *ib);
+
+/**
+ * @internal
+ * Create a rule profiler.
+ *
+ * @param[in] ib IronBee object
+ * @param[in] rules All registered rules, in profile index order
+ * @param[in] interval Seconds between periodic reports (0 for none)
+ * @param[out] pprofile Address which new profiler is written
+ *
+ * @returns Status code
+ */
+ib_status_t ib_rule_profile_create(ib_engine_t *ib,
+                                   ib_list_t *rules,
+                                   ib_num_t interval,
+                                   ib_rule_profile_t **pprofile);
+
+/**
+ * @internal
+ * Record a single rule execution.
+ *
+ * Lock free except for the first call on each thread and when a periodic
+ * report is due.
+ *
+ * @param[in,out] profile Rule profiler
+ * @param[in] rule Rule executed
+ * @param[in] result Rule result
+ * @param[in] start_ns Start time (ib_clock_get_time_ns())
+ * @param[in] end_ns End time (ib_clock_get_time_ns())
+ */
+void ib_rule_profile_record(ib_rule_profile_t *profile,
+                            const ib_rule_t *rule,
+                            ib_num_t result,
+                            uint64_t start_ns,
+                            uint64_t end_ns);
+
+/**
+ * @internal
+ * Log the aggregated rule profile.
+ *
+ * @param[in] profile Rule profiler
+ * @param[in] label Report label (i.e. "periodic")
+ */
+void ib_rule_profile_report(ib_rule_profile_t *profile,
+                            const char *label);
+
+/**
+ * @internal
+ * Release a rule profiler's per-thread resources.
+ *
+ * @param[in,out] profile Rule profiler
+ */
+void ib_rule_profile_destroy(ib_rule_profile_t *profile);
+
+/**
+ * @internal
+ * Rule worker function.
+ *
+ * @param[in] cbdata Callback data passed to ib_rule_workers_run()
+ * @param[in] item Item number (0 to num_items - 1)
+ * @param[in] slot Slot number (0 to ib_rule_workers_slots() - 1)
+ */
+typedef void (*ib_rule_work_fn_t)(void *cbdata,
+                                  size_t item,
+                                  size_t slot);
+
+/**
+ * @internal
+ * Create a rule worker pool and start its threads.
+ *
+ * @param[in] ib IronBee object
+ * @param[in] num_threads Number of worker threads
+ * @param[out] pworkers Address which new pool is written
+ *
+ * @returns Status code
+ */
+ib_status_t ib_rule_workers_create(ib_engine_t *ib,
+                                   size_t num_threads,
+                                   ib_rule_workers_t **pworkers);
+
+/**
+ * @internal
+ * Run @a fn for each of @a num_items items across the worker pool.
+ *
+ * Blocks until every item is complete; the calling thread runs items as
+ * well.  May be called from several threads at once.
+ *
+ * @param[in] workers Rule worker pool
+ * @param[in] num_items Number of items
+ * @param[in] fn Function to run for each item
+ * @param[in] cbdata Callback data for @a fn
+ *
+ * @returns Status code
+ */
+ib_status_t ib_rule_workers_run(ib_rule_workers_t *workers,
+                                size_t num_items,
+                                ib_rule_work_fn_t fn,
+                                void *cbdata);
+
+/**
+ * @internal
+ * Get the number of slots an item may run in.
+ *
+ * @param[in] workers Rule worker pool
+ *
+ * @returns Number of worker threads plus one
+ */
+size_t ib_rule_workers_slots(const ib_rule_workers_t *workers);
+
+/**
+ * @internal
+ * Stop a rule worker pool's threads and free it.
+ *
+ * @param[in,out] workers Rule worker pool
+ */
+void ib_rule_workers_destroy(ib_rule_workers_t *workers);
+
+/**
+ * @internal
+ * Start deferring operator instance creation (see
+ * ib_operator_inst_create_deferred()).
+ *
+ * @param[in] ib Engine
+ *
+ * @returns Status code
+ */
+ib_status_t ib_operator_defer_start(ib_engine_t *ib);
+
+/**
+ * @internal
+ * Run the deferred operator instance creations and stop deferring.
+ *
+ * The creations run on a temporary rule worker pool of @a num_threads
+ * threads plus the calling thread, each thread allocating from its own
+ * subpool of the main memory pool.  Failures are logged in the order the
+ * instances were created.
+ *
+ * @param[in] ib Engine
+ * @param[in] num_threads Number of threads; 0 to run on the calling thread
+ *            only and -1 for one less than the number of online CPUs
+ *
+ * @returns Status code of the first failed creation, or IB_OK
+ */
+ib_status_t ib_operator_defer_finish(ib_engine_t *ib,
+                                     ib_num_t num_threads);
+
 /**
  * @internal
  * Initialize the core transformations.
@@ -275,4 +498,8 @@ ib_status_t ib_check_hook(ib_engine_t* ib,
                           ib_state_event_type_t event,
                           ib_state_hook_type_t hook_type);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* IB_PRIVATE_H_ */
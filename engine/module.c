@@ -166,14 +166,28 @@ ib_status_t ib_module_load(ib_module_t **pm,
 ib_status_t ib_module_unload(ib_module_t *m)
 {
     IB_FTRACE_INIT();
-    ib_engine_t *ib;
-    ib_status_t rc;
 
     if (m == NULL) {
         IB_FTRACE_RET_STATUS(IB_EINVAL);
     }
 
-    ib = m->ib;
+    ib_module_fini(m->ib, m);
+
+    /// @todo Implement
+
+    /* Unregister directives */
+
+    IB_FTRACE_RET_STATUS(IB_ENOTIMPL);
+}
+
+ib_status_t ib_module_fini(ib_engine_t *ib, ib_module_t *m)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc = IB_OK;
+
+    if ( (ib == NULL) || (m == NULL) ) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
 
     ib_log_debug3(ib,
                  "Unloading module %s: "
@@ -191,11 +205,7 @@ ib_status_t ib_module_unload(ib_module_t *m)
         }
     }
 
-    /// @todo Implement
-
-    /* Unregister directives */
-
-    IB_FTRACE_RET_STATUS(IB_ENOTIMPL);
+    IB_FTRACE_RET_STATUS(rc);
 }
 
 ib_status_t ib_module_register_context(ib_module_t *m,
@@ -27,10 +27,35 @@
 #include <ironbee/operator.h>
 
 #include <ironbee/debug.h>
+#include <ironbee/list.h>
 #include <ironbee/mpool.h>
 
 #include "ironbee_private.h"
 
+#include <assert.h>
+#include <unistd.h>
+
+/**
+ * @internal
+ * Operator instance whose creation was deferred.
+ */
+typedef struct {
+    ib_operator_inst_t *op_inst;          /**< Instance */
+    ib_context_t       *ctx;              /**< Context it was created in */
+    const char         *parameters;       /**< Copy of the parameters */
+    ib_status_t         rc;               /**< Result of creation */
+} op_pending_t;
+
+/**
+ * @internal
+ * Callback data for op_pending_create().
+ */
+typedef struct {
+    ib_engine_t        *ib;               /**< Engine */
+    op_pending_t      **items;            /**< Deferred instances, in order */
+    ib_mpool_t        **pools;            /**< Memory pool per worker slot */
+} op_pending_batch_t;
+
 ib_status_t ib_operator_register(ib_engine_t *ib,
                                  const char *name,
                                  ib_flags_t flags,
@@ -119,6 +144,222 @@ ib_status_t ib_operator_inst_create(ib_engine_t *ib,
     IB_FTRACE_RET_STATUS(rc);
 }
 
+ib_status_t ib_operator_inst_create_deferred(ib_engine_t *ib,
+                                             ib_context_t *ctx,
+                                             ib_flags_t required_op_flags,
+                                             const char *name,
+                                             const char *parameters,
+                                             ib_flags_t flags,
+                                             ib_operator_inst_t **op_inst)
+{
+    IB_FTRACE_INIT();
+    ib_mpool_t *pool = ib_engine_pool_main_get(ib);
+    ib_mpool_t *tmp = ib_engine_pool_temp_get(ib);
+    ib_operator_t *op;
+    op_pending_t *pending;
+    ib_status_t rc;
+
+    rc = ib_hash_get(ib->operators, &op, name);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    if ( (ib->op_pending == NULL) ||
+         (op->fn_create == NULL) ||
+         ((op->flags & IB_OP_FLAG_DEFER) == 0) )
+    {
+        rc = ib_operator_inst_create(ib, ctx, required_op_flags,
+                                     name, parameters, flags, op_inst);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    /* Verify that this operator is valid for this rule type */
+    if ( (op->flags & required_op_flags) != required_op_flags) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    *op_inst = (ib_operator_inst_t *)
+        ib_mpool_calloc(pool, 1, sizeof(ib_operator_inst_t));
+    if (*op_inst == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    (*op_inst)->op = op;
+    (*op_inst)->flags = flags;
+
+    /* The parameters may not outlive the configuration parser. */
+    pending = (op_pending_t *)ib_mpool_alloc(tmp, sizeof(*pending));
+    if (pending == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    pending->op_inst = *op_inst;
+    pending->ctx = ctx;
+    pending->rc = IB_OK;
+    if (parameters == NULL) {
+        pending->parameters = NULL;
+    }
+    else {
+        pending->parameters = ib_mpool_strdup(tmp, parameters);
+        if (pending->parameters == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+    }
+
+    rc = ib_list_push(ib->op_pending, pending);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+ib_status_t ib_operator_defer_start(ib_engine_t *ib)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    assert(ib != NULL);
+
+    rc = ib_list_create(&(ib->op_pending), ib_engine_pool_temp_get(ib));
+    if (rc != IB_OK) {
+        ib->op_pending = NULL;
+    }
+
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+/**
+ * @internal
+ * Rule worker function: run one deferred creation.
+ *
+ * @param[in] cbdata Batch (op_pending_batch_t)
+ * @param[in] item Item number
+ * @param[in] slot Slot number
+ */
+static void op_pending_create(void *cbdata, size_t item, size_t slot)
+{
+    IB_FTRACE_INIT();
+    const op_pending_batch_t *batch = (const op_pending_batch_t *)cbdata;
+    op_pending_t *pending = batch->items[item];
+    ib_operator_inst_t *op_inst = pending->op_inst;
+
+    pending->rc = op_inst->op->fn_create(batch->ib,
+                                         pending->ctx,
+                                         batch->pools[slot],
+                                         pending->parameters,
+                                         op_inst);
+
+    IB_FTRACE_RET_VOID();
+}
+
+ib_status_t ib_operator_defer_finish(ib_engine_t *ib,
+                                     ib_num_t num_threads)
+{
+    IB_FTRACE_INIT();
+    ib_mpool_t *tmp = ib_engine_pool_temp_get(ib);
+    ib_list_t *list = ib->op_pending;
+    ib_list_node_t *node;
+    ib_rule_workers_t *workers = NULL;
+    op_pending_batch_t batch;
+    size_t num_items;
+    size_t num_slots;
+    size_t n;
+    ib_status_t rc;
+    ib_status_t first_rc = IB_OK;
+
+    assert(ib != NULL);
+
+    /* Everything from here on is created immediately. */
+    ib->op_pending = NULL;
+    if (list == NULL) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    num_items = ib_list_elements(list);
+    if (num_items == 0) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    batch.ib = ib;
+    batch.items = (op_pending_t **)
+        ib_mpool_alloc(tmp, num_items * sizeof(*batch.items));
+    if (batch.items == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    n = 0;
+    IB_LIST_LOOP(list, node) {
+        batch.items[n++] = (op_pending_t *)ib_list_node_data(node);
+    }
+
+    if (num_threads < 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = (cpus > 1) ? (ib_num_t)(cpus - 1) : 0;
+    }
+    if ((size_t)num_threads >= num_items) {
+        num_threads = (ib_num_t)(num_items - 1);
+    }
+    if (num_threads > 0) {
+        rc = ib_rule_workers_create(ib, (size_t)num_threads, &workers);
+        if (rc != IB_OK) {
+            ib_log_warning(ib, "Failed to start operator compile threads: %s",
+                           ib_status_to_string(rc));
+            workers = NULL;
+        }
+    }
+
+    /* The main memory pool is not thread safe, so each slot gets its own
+     * subpool (which lives as long as the main pool). */
+    num_slots = (workers == NULL) ? 1 : ib_rule_workers_slots(workers);
+    batch.pools = (ib_mpool_t **)
+        ib_mpool_alloc(tmp, num_slots * sizeof(*batch.pools));
+    if (batch.pools == NULL) {
+        ib_rule_workers_destroy(workers);
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    if (workers == NULL) {
+        batch.pools[0] = ib_engine_pool_main_get(ib);
+    }
+    else {
+        for (n = 0; n < num_slots; ++n) {
+            rc = ib_mpool_create(&(batch.pools[n]), "operators",
+                                 ib_engine_pool_main_get(ib));
+            if (rc != IB_OK) {
+                ib_rule_workers_destroy(workers);
+                IB_FTRACE_RET_STATUS(rc);
+            }
+        }
+    }
+
+    ib_log_debug(ib, "Creating %zd deferred operator instances on %zd threads",
+                 num_items, num_slots);
+    if (workers == NULL) {
+        for (n = 0; n < num_items; ++n) {
+            op_pending_create(&batch, n, 0);
+        }
+    }
+    else {
+        rc = ib_rule_workers_run(workers, num_items,
+                                 op_pending_create, &batch);
+        ib_rule_workers_destroy(workers);
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+
+    /* Report failures in configuration order, whatever order they ran in. */
+    for (n = 0; n < num_items; ++n) {
+        const op_pending_t *pending = batch.items[n];
+
+        if (pending->rc != IB_OK) {
+            ib_log_error(ib, "Failed to create operator instance '%s' "
+                         "with parameters \"%s\": %s",
+                         pending->op_inst->op->name,
+                         (pending->parameters == NULL) ?
+                             "" : pending->parameters,
+                         ib_status_to_string(pending->rc));
+            if (first_rc == IB_OK) {
+                first_rc = pending->rc;
+            }
+        }
+    }
+
+    IB_FTRACE_RET_STATUS(first_rc);
+}
+
 ib_status_t ib_operator_inst_destroy(ib_operator_inst_t *op_inst)
 {
     IB_FTRACE_INIT();
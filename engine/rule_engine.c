@@ -25,8 +25,10 @@
 #include "ironbee_config_auto.h"
 
 #include <assert.h>
+#include <string.h>
 
 #include <ironbee/bytestr.h>
+#include <ironbee/hash.h>
 #include <ironbee/rule_engine.h>
 #include <ironbee/util.h>
 #include <ironbee/field.h>
@@ -35,6 +37,7 @@
 #include <ironbee/transformation.h>
 #include <ironbee/operator.h>
 #include <ironbee/action.h>
+#include <ironbee/clock.h>
 #include <ironbee/rule_engine.h>
 
 #include <ironbee/debug.h>
@@ -204,6 +207,12 @@ static const ib_rule_phase_meta_t rule_phase_meta[] =
 #define MAX_LIST_RECURSION   (5)       /**< Max list recursion limit */
 #define MAX_CHAIN_RECURSION  (10)      /**< Max chain recursion limit */
 
+/**
+ * Name of the transaction field which accumulates rule execution time (ns)
+ * when rule profiling is enabled.
+ */
+#define PROFILE_TX_FIELD     "rule_engine_time"
+
 
 /**
  * Test the validity of a phase number
@@ -288,6 +297,31 @@ static ib_status_t find_phase_stream_meta(
     IB_FTRACE_RET_STATUS(IB_ENOENT);
 }
 
+/**
+ * Get a target field from the transaction's data provider.
+ * @internal
+ *
+ * Looks the field up by symbol when the name was interned, avoiding
+ * hashing it on every transaction.
+ *
+ * @param[in] tx Transaction
+ * @param[in] sym Interned name or NULL
+ * @param[in] name Field name
+ * @param[out] pf Address which field is written
+ *
+ * @returns Status code
+ */
+static ib_status_t get_data_field(ib_tx_t *tx,
+                                  const ib_symbol_t *sym,
+                                  const char *name,
+                                  ib_field_t **pf)
+{
+    if (sym != NULL) {
+        return ib_data_get_sym(tx->dpi, sym, pf);
+    }
+    return ib_data_get(tx->dpi, name, pf);
+}
+
 /**
  * Log a field's value
  * @internal
@@ -326,6 +360,342 @@ static void log_field(ib_engine_t *ib,
     }
 }
 
+/**
+ * Cursors into the arrays of an execution plan, used while filling it.
+ */
+typedef struct {
+    size_t                 rules;     /**< Next chained rule */
+    size_t                 targets;   /**< Next target */
+    size_t                 tfns;      /**< Next transformation */
+    size_t                 actions;   /**< Next action */
+} plan_cursor_t;
+
+/**
+ * Count the execution plan entries of a phase rule and its chain.
+ * @internal
+ *
+ * @param[in] rule Phase rule
+ * @param[in,out] plan Execution plan whose counts to update
+ */
+static void count_plan_rule(const ib_rule_t *rule,
+                            ib_rule_phase_plan_t *plan)
+{
+    IB_FTRACE_INIT();
+    const ib_list_node_t *node;
+
+    for ( ; rule != NULL; rule = rule->chained_rule) {
+        IB_LIST_LOOP_CONST(rule->target_fields, node) {
+            const ib_rule_target_t *target =
+                (const ib_rule_target_t *)node->data;
+
+            ++plan->num_targets;
+            if (target->tfn_list != NULL) {
+                plan->num_tfns += IB_LIST_ELEMENTS(target->tfn_list);
+            }
+        }
+        plan->num_actions += IB_LIST_ELEMENTS(rule->true_actions);
+        plan->num_actions += IB_LIST_ELEMENTS(rule->false_actions);
+        if (rule->chained_rule != NULL) {
+            ++plan->num_chained;
+        }
+    }
+
+    IB_FTRACE_RET_VOID();
+}
+
+/**
+ * Copy a list of actions into an execution plan's action array.
+ * @internal
+ *
+ * @param[in] actions List of actions
+ * @param[in,out] plan Execution plan
+ * @param[in,out] cursor Plan cursors
+ * @param[out] pactions Address which the slice of the action array is
+ *             written, or NULL if there are no actions
+ * @param[out] pnum Address which number of actions is written
+ */
+static void fill_plan_actions(const ib_list_t *actions,
+                              ib_rule_phase_plan_t *plan,
+                              plan_cursor_t *cursor,
+                              ib_action_inst_t ***pactions,
+                              size_t *pnum)
+{
+    IB_FTRACE_INIT();
+    const ib_list_node_t *node;
+
+    *pnum = IB_LIST_ELEMENTS(actions);
+    if (*pnum == 0) {
+        *pactions = NULL;
+        IB_FTRACE_RET_VOID();
+    }
+    *pactions = &(plan->actions[cursor->actions]);
+    IB_LIST_LOOP_CONST(actions, node) {
+        plan->actions[cursor->actions++] = (ib_action_inst_t *)node->data;
+    }
+
+    IB_FTRACE_RET_VOID();
+}
+
+/**
+ * Compile a phase rule and its chain into an execution plan.
+ * @internal
+ *
+ * The rule's targets, transformations and actions are appended to the
+ * plan's arrays; rules chained from it take the next chained rule entries.
+ *
+ * @param[in] rule Phase rule
+ * @param[in,out] plan Execution plan
+ * @param[in,out] cursor Plan cursors
+ * @param[out] exec Compiled rule to fill in
+ */
+static void fill_plan_rule(ib_rule_t *rule,
+                           ib_rule_phase_plan_t *plan,
+                           plan_cursor_t *cursor,
+                           ib_rule_exec_t *exec)
+{
+    IB_FTRACE_INIT();
+    const ib_list_node_t *node;
+    const ib_list_node_t *tnode;
+
+    for (;;) {
+        exec->rule = rule;
+        exec->opinst = rule->opinst;
+        exec->flags = rule->flags;
+        exec->num_targets = IB_LIST_ELEMENTS(rule->target_fields);
+        exec->targets = NULL;
+        if (exec->num_targets != 0) {
+            exec->targets = &(plan->targets[cursor->targets]);
+        }
+        IB_LIST_LOOP_CONST(rule->target_fields, node) {
+            const ib_rule_target_t *target =
+                (const ib_rule_target_t *)node->data;
+            ib_rule_exec_target_t  *etarget =
+                &(plan->targets[cursor->targets++]);
+
+            etarget->field_name = target->field_name;
+            etarget->symbol = target->symbol;
+            etarget->tfns = NULL;
+            etarget->num_tfns = 0;
+            if ( (target->tfn_list == NULL) ||
+                 (IB_LIST_ELEMENTS(target->tfn_list) == 0) )
+            {
+                continue;
+            }
+            etarget->tfns = &(plan->tfns[cursor->tfns]);
+            IB_LIST_LOOP_CONST(target->tfn_list, tnode) {
+                plan->tfns[cursor->tfns++] = (ib_tfn_t *)tnode->data;
+                ++etarget->num_tfns;
+            }
+        }
+        fill_plan_actions(rule->true_actions, plan, cursor,
+                          &(exec->true_actions), &(exec->num_true_actions));
+        fill_plan_actions(rule->false_actions, plan, cursor,
+                          &(exec->false_actions), &(exec->num_false_actions));
+
+        if (rule->chained_rule == NULL) {
+            exec->chained_rule = NULL;
+            break;
+        }
+        exec->chained_rule = &(plan->rules[cursor->rules]);
+        exec = &(plan->rules[cursor->rules++]);
+        rule = rule->chained_rule;
+    }
+
+    IB_FTRACE_RET_VOID();
+}
+
+/**
+ * Build the execution plan for a phase's rules.
+ * @internal
+ *
+ * @param[in] mp Memory pool to use for allocations
+ * @param[in] rule_list Phase rule list
+ * @param[out] pplan Address which the plan is written
+ *
+ * @returns Status code
+ */
+static ib_status_t build_phase_plan(ib_mpool_t *mp,
+                                    const ib_list_t *rule_list,
+                                    ib_rule_phase_plan_t **pplan)
+{
+    IB_FTRACE_INIT();
+    ib_rule_phase_plan_t *plan;
+    plan_cursor_t         cursor;
+    const ib_list_node_t *node;
+    size_t                rule_num;
+
+    plan = (ib_rule_phase_plan_t *)ib_mpool_calloc(mp, 1, sizeof(*plan));
+    if (plan == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    /* Size the arrays */
+    plan->num_rules = IB_LIST_ELEMENTS(rule_list);
+    IB_LIST_LOOP_CONST(rule_list, node) {
+        count_plan_rule((const ib_rule_t *)node->data, plan);
+    }
+
+    if ( (plan->num_rules + plan->num_chained) != 0) {
+        plan->rules = (ib_rule_exec_t *)
+            ib_mpool_alloc(mp, (plan->num_rules + plan->num_chained) *
+                           sizeof(*plan->rules));
+        if (plan->rules == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+    }
+    if (plan->num_targets != 0) {
+        plan->targets = (ib_rule_exec_target_t *)
+            ib_mpool_alloc(mp, plan->num_targets * sizeof(*plan->targets));
+        if (plan->targets == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+    }
+    if (plan->num_tfns != 0) {
+        plan->tfns = (ib_tfn_t **)
+            ib_mpool_alloc(mp, plan->num_tfns * sizeof(*plan->tfns));
+        if (plan->tfns == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+    }
+    if (plan->num_actions != 0) {
+        plan->actions = (ib_action_inst_t **)
+            ib_mpool_alloc(mp, plan->num_actions * sizeof(*plan->actions));
+        if (plan->actions == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+    }
+
+    /* Fill them in, in execution order */
+    cursor.rules = plan->num_rules;
+    cursor.targets = 0;
+    cursor.tfns = 0;
+    cursor.actions = 0;
+    rule_num = 0;
+    IB_LIST_LOOP_CONST(rule_list, node) {
+        fill_plan_rule((ib_rule_t *)node->data, plan, &cursor,
+                       &(plan->rules[rule_num++]));
+    }
+    assert(cursor.rules == plan->num_rules + plan->num_chained);
+    assert(cursor.targets == plan->num_targets);
+    assert(cursor.tfns == plan->num_tfns);
+    assert(cursor.actions == plan->num_actions);
+
+    *pplan = plan;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/* Defined with the other index building code, below. */
+static ib_status_t build_phase_index(ib_engine_t *ib,
+                                     ib_mpool_t *mp,
+                                     const ib_ruleset_phase_t *ruleset_phase,
+                                     const ib_rule_phase_plan_t *plan,
+                                     ib_rule_phase_index_t **pindex);
+
+/**
+ * Determine if a phase's plan and index cover all of its rules.
+ * @internal
+ *
+ * Stream phases and phases without rules have no index.
+ *
+ * @param[in] ruleset_phase Phase ruleset
+ * @param[in] plan Execution plan or NULL
+ * @param[in] index Dependency index or NULL
+ *
+ * @returns IB_TRUE if @a plan and @a index are current
+ */
+static ib_bool_t phase_plan_current(const ib_ruleset_phase_t *ruleset_phase,
+                                    const ib_rule_phase_plan_t *plan,
+                                    const ib_rule_phase_index_t *index)
+{
+    size_t num_rules = IB_LIST_ELEMENTS(ruleset_phase->rule_list);
+
+    if ( (plan == NULL) || (plan->num_rules != num_rules) ) {
+        return IB_FALSE;
+    }
+    if ( (ruleset_phase->phase_meta->is_stream == IB_TRUE) ||
+         (num_rules == 0) )
+    {
+        return IB_TRUE;
+    }
+    return ( (index != NULL) && (index->num_rules == num_rules) ) ?
+        IB_TRUE : IB_FALSE;
+}
+
+/**
+ * Get the execution plan and dependency index for a phase's rules.
+ * @internal
+ *
+ * Both are built when the context is closed.  If rules are registered
+ * after that, they are rebuilt once, from the context's memory pool, and
+ * the phase keeps the new ones; a warning is logged, as the operator
+ * should register the rules before the context is closed.
+ *
+ * @param[in] ib Engine
+ * @param[in] tx Transaction
+ * @param[in,out] ruleset_phase Phase ruleset
+ * @param[out] pplan Address which the plan is written
+ * @param[out] pindex Address which the index (or NULL) is written
+ *
+ * @returns Status code
+ */
+static ib_status_t get_phase_plan(ib_engine_t *ib,
+                                  ib_tx_t *tx,
+                                  ib_ruleset_phase_t *ruleset_phase,
+                                  const ib_rule_phase_plan_t **pplan,
+                                  const ib_rule_phase_index_t **pindex)
+{
+    IB_FTRACE_INIT();
+    ib_rule_phase_plan_t  *plan = ruleset_phase->plan;
+    ib_rule_phase_index_t *index = ruleset_phase->index;
+    ib_status_t            rc;
+
+    if (phase_plan_current(ruleset_phase, plan, index) == IB_TRUE) {
+        *pplan = plan;
+        *pindex = index;
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    rc = ib_lock_lock(&(ib->rules->plan_lock));
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    /* Another transaction may have rebuilt them while we waited */
+    plan = ruleset_phase->plan;
+    index = ruleset_phase->index;
+    if (phase_plan_current(ruleset_phase, plan, index) == IB_FALSE) {
+        ib_log_warning_tx(tx,
+                          "Rules were added to phase %d/%s in context %s "
+                          "after it was closed; rebuilding its execution "
+                          "plan and index",
+                          ruleset_phase->phase_num,
+                          ruleset_phase->phase_meta->name,
+                          ib_context_full_get(tx->ctx));
+
+        rc = build_phase_plan(tx->ctx->mp, ruleset_phase->rule_list, &plan);
+        index = NULL;
+        if ( (rc == IB_OK) &&
+             (ruleset_phase->phase_meta->is_stream != IB_TRUE) )
+        {
+            rc = build_phase_index(ib, tx->ctx->mp, ruleset_phase,
+                                   plan, &index);
+        }
+        if (rc == IB_OK) {
+            ruleset_phase->plan = plan;
+            ruleset_phase->index = index;
+        }
+    }
+
+    ib_lock_unlock(&(ib->rules->plan_lock));
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    *pplan = plan;
+    *pindex = index;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
 /**
  * Execute a field's transformations.
  * @internal
@@ -340,14 +710,13 @@ static void log_field(ib_engine_t *ib,
  */
 static ib_status_t execute_field_tfns(ib_engine_t *ib,
                                       ib_tx_t *tx,
-                                      ib_rule_target_t *target,
+                                      const ib_rule_exec_target_t *target,
                                       ib_field_t *value,
                                       ib_field_t **result)
 {
     IB_FTRACE_INIT();
     ib_status_t     rc;
-    ib_num_t        n = 0;
-    ib_list_node_t *node = NULL;
+    size_t          n;
     ib_field_t     *in_field;
     ib_field_t     *out = NULL;
 
@@ -357,7 +726,7 @@ static ib_status_t execute_field_tfns(ib_engine_t *ib,
     assert(result != NULL);
 
     /* No transformations?  Do nothing. */
-    if (IB_LIST_ELEMENTS(target->tfn_list) == 0) {
+    if (target->num_tfns == 0) {
         *result = value;
         ib_log_debug3_tx(tx,
                      "No transformations for field %s", target->field_name);
@@ -368,27 +737,26 @@ static ib_status_t execute_field_tfns(ib_engine_t *ib,
     }
 
     ib_log_debug3_tx(tx,
-                 "Executing %d transformations on field %s",
-                 IB_LIST_ELEMENTS(target->tfn_list), target->field_name);
+                 "Executing %zd transformations on field %s",
+                 target->num_tfns, target->field_name);
 
     /*
      * Loop through all of the field operators.
      */
     in_field = value;
-    IB_LIST_LOOP(target->tfn_list, node) {
-        ib_tfn_t  *tfn = (ib_tfn_t *)node->data;
+    for (n = 1; n <= target->num_tfns; ++n) {
+        ib_tfn_t  *tfn = target->tfns[n - 1];
         ib_flags_t flags = 0;
 
         /* Run it */
-        ++n;
         ib_log_debug3_tx(tx,
-                     "Executing field transformation #%d '%s' on '%s'",
+                     "Executing field transformation #%zd '%s' on '%s'",
                      n, tfn->name, target->field_name);
         log_field(ib, "before tfn", in_field);
         rc = ib_tfn_transform(ib, tx->mp, tfn, in_field, &out, &flags);
         if (rc != IB_OK) {
             ib_log_error_tx(tx,
-                         "Error executing field operator #%d field %s: %s",
+                         "Error executing field operator #%zd field %s: %s",
                          n, target->field_name, ib_status_to_string(rc));
             IB_FTRACE_RET_STATUS(rc);
         }
@@ -397,7 +765,7 @@ static ib_status_t execute_field_tfns(ib_engine_t *ib,
         /* Verify that out isn't NULL */
         if (out == NULL) {
             ib_log_error_tx(tx,
-                         "Field operator #%d field %s returned NULL",
+                         "Field operator #%zd field %s returned NULL",
                          n, target->field_name);
             IB_FTRACE_RET_STATUS(IB_EINVAL);
         }
@@ -468,6 +836,11 @@ static ib_status_t execute_rule_operator(ib_engine_t *ib,
                              "Error executing %s on list element #%d: %s",
                              opinst->op->name, n, ib_status_to_string(rc));
             }
+
+            /* First match wins */
+            if (*rule_result != 0) {
+                break;
+            }
         }
         ib_log_debug3_tx(tx, "Operator %s, field %s (list %zd) => %d",
                      opinst->op->name, fname, vlist->nelts, *rule_result);
@@ -497,30 +870,31 @@ static ib_status_t execute_rule_operator(ib_engine_t *ib,
  * @internal
  *
  * @param[in] ib Engine
- * @param[in] rule Rule to execute
+ * @param[in] exec Compiled rule to execute
  * @param[in,out] tx Transaction
  * @param[out] rule_result Pointer to number in which to store the result
  *
  * @returns Status code
  */
 static ib_status_t execute_phase_rule_targets(ib_engine_t *ib,
-                                              ib_rule_t *rule,
+                                              const ib_rule_exec_t *exec,
                                               ib_tx_t *tx,
                                               ib_num_t *rule_result)
 {
     IB_FTRACE_INIT();
     assert(ib != NULL);
-    assert(rule != NULL);
+    assert(exec != NULL);
     assert(tx != NULL);
     assert(rule_result != NULL);
-    ib_list_node_t      *node = NULL;
-    ib_operator_inst_t  *opinst = rule->opinst;
+    const ib_rule_t     *rule = exec->rule;
+    ib_operator_inst_t  *opinst = exec->opinst;
+    size_t               n;
 
     /* Log what we're going to do */
     ib_log_debug3_tx(tx, "Executing rule %s", rule->meta.id);
 
     /* Special case: External rules */
-    if ( (rule->flags & IB_RULE_FLAG_EXTERNAL) != 0) {
+    if ( (exec->flags & IB_RULE_FLAG_EXTERNAL) != 0) {
         ib_status_t rc;
 
         /* Execute the operator */
@@ -541,9 +915,8 @@ static ib_status_t execute_phase_rule_targets(ib_engine_t *ib,
      * returns an error.  This needs further discussion to determine what the
      * correct behavior should be.
      */
-    IB_LIST_LOOP(rule->target_fields, node) {
-        ib_rule_target_t *target = (ib_rule_target_t *)node->data;
-        assert(target != NULL);
+    for (n = 0; n < exec->num_targets; ++n) {
+        const ib_rule_exec_target_t *target = &(exec->targets[n]);
         const char       *fname = target->field_name;
         assert(fname != NULL);
         ib_field_t       *value = NULL;     /* Value from the DPI */
@@ -552,7 +925,7 @@ static ib_status_t execute_phase_rule_targets(ib_engine_t *ib,
         ib_status_t       rc = IB_OK;
 
         /* Get the field value */
-        rc = ib_data_get(tx->dpi, fname, &value);
+        rc = get_data_field(tx, target->symbol, fname, &value);
         if (rc == IB_ENOENT) {
             if ( (opinst->op->flags & IB_OP_FLAG_ALLOW_NULL) == 0) {
                 continue;
@@ -590,9 +963,10 @@ static ib_status_t execute_phase_rule_targets(ib_engine_t *ib,
         ib_log_debug3_tx(tx, "Operator %s, field %s => %d",
                      opinst->op->name, fname, result);
 
-        /* Store the result */
+        /* Store the result; first match wins */
         if (result != 0) {
             *rule_result = result;
+            break;
         }
     }
 
@@ -653,7 +1027,8 @@ static ib_status_t execute_action(ib_engine_t *ib,
  * @param[in] rule Rule to execute
  * @param[in,out] tx Transaction
  * @param[in] result Rule execution result
- * @param[in] actions List of actions to execute
+ * @param[in] actions Actions to execute
+ * @param[in] num_actions Number of entries in @a actions
  *
  * @returns Status code
  */
@@ -661,10 +1036,11 @@ static ib_status_t execute_actions(ib_engine_t *ib,
                                    ib_rule_t *rule,
                                    ib_tx_t *tx,
                                    ib_num_t result,
-                                   ib_list_t *actions)
+                                   ib_action_inst_t *const *actions,
+                                   size_t num_actions)
 {
     IB_FTRACE_INIT();
-    ib_list_node_t   *node = NULL;
+    size_t            n;
     ib_status_t       rc = IB_OK;
     const char       *name = (result != 0) ? "True" : "False";
 
@@ -677,9 +1053,9 @@ static ib_status_t execute_actions(ib_engine_t *ib,
      * returns an error.  This needs further discussion to determine what the
      * correct behavior should be.
      */
-    IB_LIST_LOOP(actions, node) {
+    for (n = 0; n < num_actions; ++n) {
         ib_status_t       arc;     /* Action's return code */
-        ib_action_inst_t *action = (ib_action_inst_t *)node->data;
+        ib_action_inst_t *action = actions[n];
 
         /* Execute the action */
         arc = execute_action(ib, rule, tx, result, action);
@@ -699,31 +1075,71 @@ static ib_status_t execute_actions(ib_engine_t *ib,
     IB_FTRACE_RET_STATUS(rc);
 }
 
+/**
+ * Add rule execution time to the transaction's profile field.
+ * @internal
+ *
+ * @param[in,out] tx Transaction
+ * @param[in] ns Time spent executing rules (ns)
+ */
+static void profile_tx_time(ib_tx_t *tx,
+                            uint64_t ns)
+{
+    IB_FTRACE_INIT();
+    ib_field_t  *f = NULL;
+    ib_num_t     total;
+    ib_status_t  rc;
+
+    rc = ib_data_get(tx->dpi, PROFILE_TX_FIELD, &f);
+    if ( (rc == IB_OK) && (f != NULL) ) {
+        rc = ib_field_value(f, ib_ftype_num_out(&total));
+        if (rc == IB_OK) {
+            total += (ib_num_t)ns;
+            rc = ib_field_setv(f, ib_ftype_num_in(&total));
+        }
+    }
+    else {
+        rc = ib_data_add_num(tx->dpi, PROFILE_TX_FIELD, (ib_num_t)ns, NULL);
+    }
+    if (rc != IB_OK) {
+        ib_log_debug2_tx(tx, "Failed to update field %s: %s",
+                         PROFILE_TX_FIELD, ib_status_to_string(rc));
+    }
+    IB_FTRACE_RET_VOID();
+}
+
 /**
  * Execute a single phase rule, it's actions, and it's chained rules.
  * @internal
  *
  * @param[in] ib Engine
- * @param[in] event Event type
+ * @param[in] exec Compiled rule to execute
  * @param[in,out] tx Transaction
  * @param[in] recursion Recursion limit
  * @param[in,out] rule_result Result of rule execution
+ * @param[in] result_known If IB_TRUE, @a rule_result already holds the
+ *            operator result (from a literal group or the rule workers) and
+ *            the rule's targets aren't evaluated
  *
  * @returns Status code
  */
 static ib_status_t execute_phase_rule(ib_engine_t *ib,
-                                      ib_rule_t *rule,
+                                      const ib_rule_exec_t *exec,
                                       ib_tx_t *tx,
                                       ib_num_t recursion,
-                                      ib_num_t *rule_result)
+                                      ib_num_t *rule_result,
+                                      ib_bool_t result_known)
 {
     IB_FTRACE_INIT();
-    ib_list_t   *actions;
-    ib_status_t  rc = IB_OK;
-    ib_status_t  trc;         /* Temporary status code */
+    ib_rule_t         *rule;
+    ib_status_t        rc = IB_OK;
+    ib_status_t        trc;         /* Temporary status code */
+    ib_rule_profile_t *profile = ib->rules->profile;
+    uint64_t           start_ns = 0;
 
     assert(ib != NULL);
-    assert(rule != NULL);
+    assert(exec != NULL);
+    rule = exec->rule;
     assert(rule->phase_meta->is_stream == IB_FALSE);
     assert(tx != NULL);
     assert(rule_result != NULL);
@@ -735,8 +1151,9 @@ static ib_status_t execute_phase_rule(ib_engine_t *ib,
         IB_FTRACE_RET_STATUS(IB_EOTHER);
     }
 
-    /* Initialize the rule result */
-    *rule_result = 0;
+    if (profile != NULL) {
+        start_ns = ib_clock_get_time_ns();
+    }
 
     /*
      * Execute the rule operator on the target fields.
@@ -745,11 +1162,19 @@ static ib_status_t execute_phase_rule(ib_engine_t *ib,
      * returns an error.  This needs further discussion to determine what the
      * correct behavior should be.
      */
-    trc = execute_phase_rule_targets(ib, rule, tx, rule_result);
-    if (trc != IB_OK) {
-        ib_log_error_tx(tx, "Error executing rule %s: %s",
-                     rule->meta.id, ib_status_to_string(trc));
-        rc = trc;
+    if (result_known == IB_TRUE) {
+        ib_log_debug3_tx(tx, "Rule %s Operator %s => %d (precomputed)",
+                         rule->meta.id, exec->opinst->op->name,
+                         *rule_result);
+    }
+    else {
+        *rule_result = 0;
+        trc = execute_phase_rule_targets(ib, exec, tx, rule_result);
+        if (trc != IB_OK) {
+            ib_log_error_tx(tx, "Error executing rule %s: %s",
+                         rule->meta.id, ib_status_to_string(trc));
+            rc = trc;
+        }
     }
 
     /*
@@ -760,18 +1185,25 @@ static ib_status_t execute_phase_rule(ib_engine_t *ib,
      * correct behavior should be.
      */
     if (*rule_result != 0) {
-        actions = rule->true_actions;
+        trc = execute_actions(ib, rule, tx, *rule_result,
+                              exec->true_actions, exec->num_true_actions);
     }
     else {
-        actions = rule->false_actions;
+        trc = execute_actions(ib, rule, tx, *rule_result,
+                              exec->false_actions, exec->num_false_actions);
     }
-    trc = execute_actions(ib, rule, tx, *rule_result, actions);
     if (trc != IB_OK) {
         ib_log_error_tx(tx,
                      "Error executing action for rule %s", rule->meta.id);
         rc = trc;
     }
 
+    /* Chained rules are recorded separately, under their own IDs. */
+    if (profile != NULL) {
+        ib_rule_profile_record(profile, rule, *rule_result,
+                               start_ns, ib_clock_get_time_ns());
+    }
+
     /*
      * Execute chained rule
      *
@@ -781,18 +1213,19 @@ static ib_status_t execute_phase_rule(ib_engine_t *ib,
      *
      * @note Chaining is currently done via recursion.
      */
-    if ( (*rule_result != 0) && (rule->chained_rule != NULL) ) {
+    if ( (*rule_result != 0) && (exec->chained_rule != NULL) ) {
         ib_log_debug3_tx(tx,
                      "Chaining to rule %s",
-                     rule->chained_rule->meta.id);
+                     exec->chained_rule->rule->meta.id);
         trc = execute_phase_rule(ib,
-                                 rule->chained_rule,
+                                 exec->chained_rule,
                                  tx,
                                  recursion,
-                                 rule_result);
+                                 rule_result,
+                                 IB_FALSE);
         if (trc != IB_OK) {
             ib_log_error_tx(tx, "Error executing chained rule %s",
-                         rule->chained_rule->meta.id);
+                         exec->chained_rule->rule->meta.id);
             rc = trc;
         }
     }
@@ -801,377 +1234,705 @@ static ib_status_t execute_phase_rule(ib_engine_t *ib,
 }
 
 /**
- * Run a set of phase rules.
+ * Mark the rules of a literal group which match a field value.
  * @internal
  *
- * @param[in] ib Engine.
- * @param[in,out] tx Transaction.
- * @param[in] event Event type.
- * @param[in] cbdata Callback data (actually phase_rule_cbdata_t).
+ * Matches the same way as the streq and contains operators; list fields
+ * are handled by matching each of their elements.
  *
- * @returns Status code.
+ * @param[in] tx Transaction
+ * @param[in] group Literal group
+ * @param[in] value Field value (after transformations)
+ * @param[in] recursion Recursion limit -- won't recurse if recursion is zero
+ * @param[in,out] matched Per rule: rule's operator is true
+ *
+ * @returns Status code
  */
-static ib_status_t run_phase_rules(ib_engine_t *ib,
-                                   ib_tx_t *tx,
-                                   ib_state_event_type_t event,
-                                   void *cbdata)
+static ib_status_t match_literal_group(ib_tx_t *tx,
+                                       const ib_rule_literal_group_t *group,
+                                       const ib_field_t *value,
+                                       ib_num_t recursion,
+                                       uint8_t *matched)
 {
     IB_FTRACE_INIT();
-    assert(ib != NULL);
-    assert(tx != NULL);
-    assert(tx->ctx != NULL);
-    assert(cbdata != NULL);
+    const char     *str;
+    size_t          len;
+    ib_list_t      *rules;
+    ib_list_node_t *node;
+    ib_status_t     rc;
 
-    const ib_rule_phase_meta_t *meta = (const ib_rule_phase_meta_t *) cbdata;
-    ib_context_t               *ctx = tx->ctx;
-    ib_ruleset_phase_t         *ruleset_phase;
-    ib_list_t                  *rules;
-    ib_list_node_t             *node = NULL;
+    /* Limit recursion */
+    --recursion;
+    if (recursion <= 0) {
+        ib_log_error_tx(tx, "Rule engine: List recursion limit reached");
+        IB_FTRACE_RET_STATUS(IB_EOTHER);
+    }
 
-    ruleset_phase = &(ctx->rules->ruleset.phases[meta->phase_num]);
-    assert(ruleset_phase != NULL);
-    rules = ruleset_phase->rule_list;
-    assert(rules != NULL);
+    if (value->type == IB_FTYPE_LIST) {
+        ib_list_t *vlist;
 
-    /* Sanity check */
-    if (ruleset_phase->phase_num != meta->phase_num) {
-        ib_log_error_tx(tx, "Rule engine: Phase %d (%s) is %d",
-                     meta->phase_num, meta->name, ruleset_phase->phase_num );
+        rc = ib_field_value(value, ib_ftype_list_mutable_out(&vlist));
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        IB_LIST_LOOP(vlist, node) {
+            rc = match_literal_group(tx, group,
+                                     (const ib_field_t *)node->data,
+                                     recursion, matched);
+            if (rc != IB_OK) {
+                ib_log_debug_tx(tx, "Error matching literal group on "
+                                "list element of %s: %s",
+                                group->target->field_name,
+                                ib_status_to_string(rc));
+            }
+        }
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    else if (value->type == IB_FTYPE_NULSTR) {
+        rc = ib_field_value(value, ib_ftype_nulstr_out(&str));
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        if (str == NULL) {
+            IB_FTRACE_RET_STATUS(IB_OK);
+        }
+        len = strlen(str);
+    }
+    else if (value->type == IB_FTYPE_BYTESTR) {
+        const ib_bytestr_t *bs;
+
+        rc = ib_field_value(value, ib_ftype_bytestr_out(&bs));
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        str = (const char *)ib_bytestr_const_ptr(bs);
+        len = ib_bytestr_length(bs);
+        if (str == NULL) {
+            str = "";
+        }
+    }
+    else {
         IB_FTRACE_RET_STATUS(IB_EINVAL);
     }
 
-    /* Walk through the rules & execute them */
-    if (IB_LIST_ELEMENTS(rules) == 0) {
-        ib_log_debug3_tx(tx,
-                     "No rules for phase %d/%s in context %s",
-                      meta->phase_num, meta->name, ib_context_full_get(ctx));
+    /* streq: a single hash lookup finds every rule with this literal */
+    if (group->literals != NULL) {
+        rc = ib_hash_get_ex(group->literals, &rules, str, len);
+        if (rc == IB_OK) {
+            IB_LIST_LOOP(rules, node) {
+                matched[*(const size_t *)node->data] = 1;
+            }
+        }
         IB_FTRACE_RET_STATUS(IB_OK);
     }
-    ib_log_debug3_tx(tx,
-                  "Executing %d rules for phase %d/%s in context %s",
-                  IB_LIST_ELEMENTS(rules),
-                  meta->phase_num, meta->name, ib_context_full_get(ctx));
 
-    /*
-     * Loop through all of the rules for this phase, execute them.
-     *
-     * @todo The current behavior is to keep running even after rule execution
-     * returns an error.  This needs further discussion to determine what the
-     * correct behavior should be.
-     */
-    IB_LIST_LOOP(rules, node) {
-        ib_rule_t   *rule = (ib_rule_t *)node->data;
-        ib_num_t     rule_result = 0;
-        ib_status_t  rule_rc;
+    /* contains: a single scan finds every literal in the value */
+    if (len != 0) {
+        ib_ac_context_t  ac_ctx;
+        ib_list_node_t  *mnode;
 
-        /* Skip invalid / disabled rules */
-        if ( (rule->flags & IB_RULE_FLAGS_RUNABLE) != IB_RULE_FLAGS_RUNABLE) {
-            ib_log_debug2_tx(tx,
-                         "Not executing invalid/disabled phase rule %s",
-                         rule->meta.id);
-            continue;
+        ib_ac_init_ctx(&ac_ctx, group->ac);
+        rc = ib_ac_consume(&ac_ctx, str, len,
+                           IB_AC_FLAG_CONSUME_MATCHALL |
+                           IB_AC_FLAG_CONSUME_DOLIST,
+                           tx->mp);
+        if (rc == IB_ENOENT) {
+            IB_FTRACE_RET_STATUS(IB_OK);
+        }
+        else if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
         }
+        IB_LIST_LOOP(ac_ctx.match_list, mnode) {
+            const ib_ac_match_t *mt = (const ib_ac_match_t *)mnode->data;
 
-        /* Execute the rule, it's actions and chains */
-        rule_rc = execute_phase_rule(ib,
-                                     rule,
-                                     tx,
-                                     MAX_CHAIN_RECURSION,
-                                     &rule_result);
-        if (rule_rc != IB_OK) {
-            ib_log_error_tx(tx,
-                         "Error executing rule %s: %s",
-                         rule->meta.id, ib_status_to_string(rule_rc));
+            rules = (ib_list_t *)mt->data;
+            IB_LIST_LOOP(rules, node) {
+                matched[*(const size_t *)node->data] = 1;
+            }
         }
     }
 
-    /*
-     * @todo Eat errors for now.  Unless something Really Bad(TM) has
-     * occurred, return IB_OK to the engine.  A bigger discussion of if / how
-     * such errors should be propagated needs to occur.
-     */
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
 /**
- * Execute a single stream txdata rule, and it's actions
+ * Evaluate the operators of all rules in a literal group.
  * @internal
  *
  * @param[in] ib Engine
- * @param[in] event Event type
  * @param[in] tx Transaction
- * @param[in,out] txdata Transaction data
- * @param[in,out] rule_result Result of rule execution
- *
- * @returns Status code
+ * @param[in] group Literal group
+ * @param[in,out] matched Per rule: rule's operator is true
  */
-static ib_status_t execute_stream_txdata_rule(ib_engine_t *ib,
-                                              ib_rule_t *rule,
-                                              ib_tx_t *tx,
-                                              ib_txdata_t *txdata,
-                                              ib_num_t *result)
+static void execute_literal_group(ib_engine_t *ib,
+                                  ib_tx_t *tx,
+                                  const ib_rule_literal_group_t *group,
+                                  uint8_t *matched)
 {
     IB_FTRACE_INIT();
-    ib_status_t          rc = IB_OK;
-    ib_operator_inst_t  *opinst = rule->opinst;
-    ib_field_t          *value = NULL;
-
-    assert(ib != NULL);
-    assert(rule != NULL);
-    assert(txdata != NULL);
-    assert(result != NULL);
-    assert(rule->phase_meta->is_stream == IB_TRUE);
-
+    ib_field_t  *value = NULL;
+    ib_field_t  *tfnvalue = NULL;
+    const char  *fname = group->target->field_name;
+    ib_status_t  rc;
+    size_t       n;
+
+    for (n = 0; n < group->num_rules; ++n) {
+        matched[group->rules[n]] = 0;
+    }
 
-    /*
-     * Execute the rule operator.
-     *
-     * @todo The current behavior is to keep running even after action(s)
-     * returns an error.  This needs further discussion to determine what the
-     * correct behavior should be.
-     */
+    rc = get_data_field(tx, group->target->symbol, fname, &value);
+    if (rc == IB_ENOENT) {
+        IB_FTRACE_RET_VOID();
+    }
+    else if (rc != IB_OK) {
+        ib_log_error_tx(tx, "Error getting field %s: %s",
+                        fname, ib_status_to_string(rc));
+        IB_FTRACE_RET_VOID();
+    }
 
-    /* Create a field to hold the data */
-    rc = ib_field_create_bytestr_alias(&value,
-                                       tx->mp,
-                                       "tmp", 3,
-                                       txdata->data, txdata->dlen);
+    rc = execute_field_tfns(ib, tx, group->target, value, &tfnvalue);
     if (rc != IB_OK) {
-        ib_log_error_tx(tx,
-                        "Error creating field for stream txdata rule data: %s",
-                        ib_status_to_string(rc));
-        IB_FTRACE_RET_STATUS(rc);
+        ib_log_error_tx(tx, "Error executing transformation on %s: %s",
+                        fname, ib_status_to_string(rc));
+        IB_FTRACE_RET_VOID();
+    }
+    if (tfnvalue == NULL) {
+        IB_FTRACE_RET_VOID();
     }
 
-    /* Execute the rule operator */
-    rc = ib_operator_execute(ib, tx, opinst, value, result);
+    rc = match_literal_group(tx, group, tfnvalue, MAX_LIST_RECURSION,
+                             matched);
     if (rc != IB_OK) {
-        ib_log_error_tx(tx,
-                     "Operator %s returned an error: %s",
-                     opinst->op->name, ib_status_to_string(rc));
-        IB_FTRACE_RET_STATUS(rc);
+        ib_log_error_tx(tx, "Error matching %zd literal rules on %s: %s",
+                        group->num_rules, fname, ib_status_to_string(rc));
     }
-    ib_log_debug3_tx(tx, "Operator %s => %d", opinst->op->name, *result);
 
-    IB_FTRACE_RET_STATUS(rc);
+    IB_FTRACE_RET_VOID();
 }
 
 /**
- * Execute a single stream header rule, and it's actions
+ * Look up the target fields of a phase which are not yet known to exist.
  * @internal
  *
- * @param[in] ib Engine
- * @param[in] event Event type
+ * A field counts as present if the lookup returns anything other than
+ * IB_ENOENT; for "collection:key" targets, the collection existing is
+ * enough.  Rules targeting a present field are marked to run.
+ *
  * @param[in] tx Transaction
- * @param[in] headers Parsed headers
- * @param[in,out] rule_result Result of rule execution
+ * @param[in] index Phase dependency index
+ * @param[in,out] present Per field: field is known to exist
+ * @param[in,out] run Per rule: rule should be executed
+ */
+static void probe_phase_fields(ib_tx_t *tx,
+                               const ib_rule_phase_index_t *index,
+                               uint8_t *present,
+                               uint8_t *run)
+{
+    IB_FTRACE_INIT();
+    size_t fnum;
+
+    for (fnum = 0; fnum < index->num_fields; ++fnum) {
+        const ib_rule_dep_field_t *field = &(index->fields[fnum]);
+        ib_field_t                *value = NULL;
+        ib_status_t                rc = IB_ENOENT;
+        size_t                     n;
+
+        if (present[fnum] != 0) {
+            continue;
+        }
+
+        if (field->base != NULL) {
+            rc = get_data_field(tx, field->base_symbol, field->base, &value);
+        }
+        if (rc == IB_ENOENT) {
+            rc = get_data_field(tx, field->symbol, field->name, &value);
+        }
+        if (rc == IB_ENOENT) {
+            continue;
+        }
+
+        present[fnum] = 1;
+        for (n = 0; n < field->num_rules; ++n) {
+            run[field->rules[n]] = 1;
+        }
+    }
+
+    IB_FTRACE_RET_VOID();
+}
+
+/**
+ * Determine if a transaction's block decision ends a phase.
+ * @internal
  *
- * @returns Status code
+ * Once a transaction is blocked the rules of every remaining phase are
+ * skipped, except those of post-processing, which always run.
+ *
+ * @param[in] tx Transaction
+ * @param[in] meta Phase meta data
+ *
+ * @returns IB_TRUE if the phase's remaining rules should be skipped
  */
-static ib_status_t execute_stream_header_rule(ib_engine_t *ib,
-                                              ib_rule_t *rule,
-                                              ib_tx_t *tx,
-                                              ib_parsed_header_t *headers,
-                                              ib_num_t *rule_result)
+static ib_bool_t phase_blocked(const ib_tx_t *tx,
+                               const ib_rule_phase_meta_t *meta)
 {
     IB_FTRACE_INIT();
-    ib_status_t          rc = IB_OK;
-    ib_operator_inst_t  *opinst = rule->opinst;
-    ib_field_t          *value;
-    ib_parsed_name_value_pair_list_t *nvpair;
 
-    assert(ib != NULL);
-    assert(rule != NULL);
-    assert(headers != NULL);
-    assert(rule_result != NULL);
-    assert(rule->phase_meta->is_stream == IB_TRUE);
+    if ( (ib_tx_flags_isset(tx, IB_TX_FBLOCKED) != 0) &&
+         (meta->phase_num != PHASE_POSTPROCESS) )
+    {
+        IB_FTRACE_RET_INT(IB_TRUE);
+    }
+    IB_FTRACE_RET_INT(IB_FALSE);
+}
+
+/**
+ * Per slot state of a parallel rule batch.
+ */
+typedef struct {
+    ib_mpool_t            *mp;        /**< Slot memory pool or NULL */
+    ib_provider_inst_t     dpi;       /**< Slot private data provider */
+    ib_tx_t                tx;        /**< Slot copy of the transaction */
+} parallel_slot_t;
 
+/**
+ * A rule evaluated by the rule worker pool.
+ */
+typedef struct {
+    size_t                 num;        /**< Rule number within phase */
+    const ib_rule_exec_t  *rule;       /**< Compiled rule */
+    ib_field_t           **values;     /**< Target field values */
+    const char           **fnames;     /**< Target field names */
+    size_t                 num_values; /**< Number of target values */
+    uint8_t                is_false;   /**< Operator proven false */
+} parallel_rule_t;
 
-    /*
-     * Execute the rule operator.
-     *
-     * @todo The current behavior is to keep running even after action(s)
-     * returns an error.  This needs further discussion to determine what the
-     * correct behavior should be.
-     */
-    *rule_result = 0;
-    for (nvpair = headers;  nvpair != NULL;  nvpair = nvpair->next) {
-        ib_num_t result;
+/**
+ * Parallel rule batch; callback data for evaluate_parallel_rule().
+ */
+typedef struct {
+    ib_engine_t           *ib;         /**< Engine */
+    ib_tx_t               *tx;         /**< Transaction */
+    parallel_rule_t       *items;      /**< Rules to evaluate */
+    parallel_slot_t       *slots;      /**< Per slot state */
+} parallel_batch_t;
 
-        /* Create a field to hold the data */
-        ib_log_debug_tx(tx, "nvpair: '%.*s'='%.*s'\n",
-                        (int)ib_bytestr_length(nvpair->name),
-                        (const char *)ib_bytestr_const_ptr(nvpair->name),
-                        (int)ib_bytestr_length(nvpair->value),
-                        (const char *)ib_bytestr_const_ptr(nvpair->value));
-        rc = ib_field_create(&value,
-                             tx->mp,
-                             (const char *)ib_bytestr_const_ptr(nvpair->name),
-                             ib_bytestr_length(nvpair->name),
-                             IB_FTYPE_BYTESTR,
-                             ib_ftype_bytestr_in(nvpair->value));
+/**
+ * Evaluate a rule's operator on a rule worker.
+ * @internal
+ *
+ * The operator sees a private copy of the transaction with its own memory
+ * pool and data, so that anything it stores (i.e. pcre captures) is thrown
+ * away.  Only a false result is recorded: a rule which matches, or which
+ * fails, is run again by the request thread.
+ *
+ * @param[in] cbdata Parallel batch
+ * @param[in] item Rule to evaluate
+ * @param[in] slot Slot number
+ */
+static void evaluate_parallel_rule(void *cbdata,
+                                   size_t item,
+                                   size_t slot)
+{
+    IB_FTRACE_INIT();
+    parallel_batch_t *batch = (parallel_batch_t *)cbdata;
+    parallel_rule_t  *prule = &(batch->items[item]);
+    parallel_slot_t  *pslot = &(batch->slots[slot]);
+    ib_num_t          result = 0;
+    ib_status_t       rc;
+    size_t            n;
+
+    if (pslot->mp == NULL) {
+        ib_hash_t *data;
+
+        rc = ib_mpool_create(&(pslot->mp), "rule worker", NULL);
         if (rc != IB_OK) {
-            ib_log_error_tx(tx,
-                            "Error creating field for header stream rule data: %s",
-                            ib_status_to_string(rc));
-            IB_FTRACE_RET_STATUS(rc);
+            pslot->mp = NULL;
+            IB_FTRACE_RET_VOID();
         }
-
-        /* Execute the rule operator */
-        rc = ib_operator_execute(ib, tx, opinst, value, &result);
+        rc = ib_hash_create_nocase(&data, pslot->mp);
         if (rc != IB_OK) {
-            ib_log_error_tx(tx,
-                            "Operator %s returned an error: %s",
-                            opinst->op->name, ib_status_to_string(rc));
-            IB_FTRACE_RET_STATUS(rc);
+            IB_FTRACE_RET_VOID();
         }
+        pslot->dpi = *(batch->tx->dpi);
+        pslot->dpi.mp = pslot->mp;
+        pslot->dpi.data = data;
+        pslot->tx = *(batch->tx);
+        pslot->tx.mp = pslot->mp;
+        pslot->tx.dpi = &(pslot->dpi);
+    }
+    else if (pslot->tx.dpi == NULL) {
+        IB_FTRACE_RET_VOID();
+    }
 
-        /* Store the result */
-        if (result != 0) {
-            *rule_result = result;
+    for (n = 0; n < prule->num_values; ++n) {
+        rc = execute_rule_operator(batch->ib,
+                                   &(pslot->tx),
+                                   prule->rule->opinst,
+                                   prule->fnames[n],
+                                   prule->values[n],
+                                   MAX_LIST_RECURSION,
+                                   &result);
+        if ( (rc != IB_OK) || (result != 0) ) {
+            IB_FTRACE_RET_VOID();
         }
     }
-    ib_log_debug3_tx(tx, "Operator %s => %d", opinst->op->name, *rule_result);
+    prule->is_false = 1;
 
-    IB_FTRACE_RET_STATUS(rc);
+    IB_FTRACE_RET_VOID();
 }
 
 /**
- * Run a set of stream rules.
+ * Evaluate a phase's parallel rules across the rule worker pool.
  * @internal
  *
- * @param[in] ib Engine.
- * @param[in] tx Transaction.
- * @param[in] event Event type.
- * @param[in] txdata Transaction data (or NULL)
- * @param[in] headers Parsed headers (or NULL)
- * @param[in] meta Phase meta data
+ * Target values are looked up by the calling thread, so workers only run
+ * operators.  Rules with dynamic target fields, whose values are computed
+ * on lookup, are left to the request thread.
+ *
+ * @param[in] ib Engine
+ * @param[in] tx Transaction
+ * @param[in] plan Phase execution plan
+ * @param[in] index Phase dependency index
+ * @param[in] run Per rule: rule should be executed
+ * @param[out] proven Per rule: operator is known to be false
  *
  * @returns Status code
  */
-static ib_status_t run_stream_rules(ib_engine_t *ib,
-                                    ib_tx_t *tx,
-                                    ib_state_event_type_t event,
-                                    ib_txdata_t *txdata,
-                                    ib_parsed_header_t *headers,
-                                    const ib_rule_phase_meta_t *meta)
+static ib_status_t evaluate_parallel_rules(ib_engine_t *ib,
+                                           ib_tx_t *tx,
+                                           const ib_rule_phase_plan_t *plan,
+                                           const ib_rule_phase_index_t *index,
+                                           const uint8_t *run,
+                                           uint8_t *proven)
 {
     IB_FTRACE_INIT();
+    ib_rule_workers_t    *workers = ib->rules->workers;
+    parallel_batch_t      batch;
+    size_t                num_items = 0;
+    size_t                num_slots;
+    size_t                num;
+    size_t                n;
+    ib_status_t           rc;
+
+    batch.ib = ib;
+    batch.tx = tx;
+    batch.items = (parallel_rule_t *)
+        ib_mpool_alloc(tx->mp, index->num_parallel * sizeof(*batch.items));
+    if (batch.items == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
 
-    assert(ib != NULL);
-    assert( (txdata != NULL) || (headers != NULL) );
-    assert(meta != NULL);
-    assert( (meta->hook_type != IB_STATE_HOOK_TXDATA) || (txdata != NULL) );
-    assert( (meta->hook_type != IB_STATE_HOOK_HEADER) || (headers != NULL) );
+    for (num = 0; num < plan->num_rules; ++num) {
+        const ib_rule_exec_t *exec = &(plan->rules[num]);
+        parallel_rule_t      *prule = &(batch.items[num_items]);
+        ib_bool_t             usable = IB_TRUE;
 
-    ib_context_t            *ctx = tx->ctx;
-    ib_ruleset_phase_t      *ruleset_phase =
-        &(ctx->rules->ruleset.phases[meta->phase_num]);
-    ib_list_t               *rules = ruleset_phase->rule_list;
-    ib_list_node_t          *node = NULL;
+        if ( (index->parallel[num] == 0) || (run[num] == 0) ||
+             ((exec->flags & IB_RULE_FLAGS_RUNABLE) != IB_RULE_FLAGS_RUNABLE) )
+        {
+            continue;
+        }
 
-    /* Sanity check */
-    if (ruleset_phase->phase_num != meta->phase_num) {
-        ib_log_error_tx(tx, "Rule engine: Stream %d (%s) is %d",
-                     meta->phase_num, meta->name, ruleset_phase->phase_num);
-        IB_FTRACE_RET_STATUS(IB_EINVAL);
+        prule->num = num;
+        prule->rule = exec;
+        prule->num_values = 0;
+        prule->is_false = 0;
+        prule->values = (ib_field_t **)
+            ib_mpool_alloc(tx->mp, exec->num_targets * sizeof(*prule->values));
+        prule->fnames = (const char **)
+            ib_mpool_alloc(tx->mp, exec->num_targets * sizeof(*prule->fnames));
+        if ( (prule->values == NULL) || (prule->fnames == NULL) ) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+
+        for (n = 0; n < exec->num_targets; ++n) {
+            const ib_rule_exec_target_t *target = &(exec->targets[n]);
+            ib_field_t                  *value = NULL;
+
+            rc = get_data_field(tx, target->symbol, target->field_name,
+                                &value);
+            if (rc == IB_ENOENT) {
+                continue;
+            }
+            if ( (rc != IB_OK) || (value == NULL) ||
+                 (ib_field_is_dynamic(value) != 0) )
+            {
+                usable = IB_FALSE;
+                break;
+            }
+            prule->values[prule->num_values] = value;
+            prule->fnames[prule->num_values] = target->field_name;
+            ++prule->num_values;
+        }
+        if (usable == IB_TRUE) {
+            ++num_items;
+        }
     }
 
-    /* Are there any rules?  If not, do a quick exit */
-    if (IB_LIST_ELEMENTS(rules) == 0) {
-        ib_log_debug3_tx(tx,
-                      "No rules for stream %d/%s in context %s",
-                      meta->phase_num, meta->name, ib_context_full_get(ctx));
+    if (num_items < 2) {
         IB_FTRACE_RET_STATUS(IB_OK);
     }
-    ib_log_debug3_tx(tx,
-                  "Executing %d rules for stream %d/%s in context %s",
-                  IB_LIST_ELEMENTS(rules),
-                  meta->phase_num, meta->name, ib_context_full_get(ctx));
 
-    /*
-     * Loop through all of the rules for this phase, execute them.
-     *
-     * @todo The current behavior is to keep running even after rule execution
-     * returns an error.  This needs further discussion to determine what the
-     * correct behavior should be.
-     */
-    IB_LIST_LOOP(rules, node) {
-        ib_rule_t   *rule = (ib_rule_t *)node->data;
-        ib_list_t   *actions;
-        ib_num_t     result = 0;
-        ib_num_t     dtype_num;
-        ib_bool_t    dtype_found = IB_FALSE;
-        ib_status_t  rc = IB_OK;
+    num_slots = ib_rule_workers_slots(workers);
+    batch.slots = (parallel_slot_t *)
+        ib_mpool_calloc(tx->mp, num_slots, sizeof(*batch.slots));
+    if (batch.slots == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
 
-        /*
-         * Determine if this event applies to this rule (txdata only)
+    rc = ib_rule_workers_run(workers, num_items,
+                             evaluate_parallel_rule, &batch);
+
+    for (n = 0; n < num_slots; ++n) {
+        if (batch.slots[n].mp != NULL) {
+            ib_mpool_destroy(batch.slots[n].mp);
+        }
+    }
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    for (n = 0; n < num_items; ++n) {
+        if (batch.items[n].is_false != 0) {
+            proven[batch.items[n].num] = 1;
+        }
+    }
+    ib_log_debug3_tx(tx, "Evaluated %zd rules on rule workers", num_items);
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * Run a set of phase rules.
+ * @internal
+ *
+ * @param[in] ib Engine.
+ * @param[in,out] tx Transaction.
+ * @param[in] event Event type.
+ * @param[in] cbdata Callback data (actually phase_rule_cbdata_t).
+ *
+ * @returns Status code.
+ */
+static ib_status_t run_phase_rules(ib_engine_t *ib,
+                                   ib_tx_t *tx,
+                                   ib_state_event_type_t event,
+                                   void *cbdata)
+{
+    IB_FTRACE_INIT();
+    assert(ib != NULL);
+    assert(tx != NULL);
+    assert(tx->ctx != NULL);
+    assert(cbdata != NULL);
+
+    const ib_rule_phase_meta_t *meta = (const ib_rule_phase_meta_t *) cbdata;
+    ib_context_t               *ctx = tx->ctx;
+    ib_ruleset_phase_t         *ruleset_phase;
+    ib_list_t                  *rules;
+    const ib_rule_phase_plan_t *plan;
+    uint64_t                    start_ns = 0;
+    const ib_rule_phase_index_t *index;
+    uint8_t                    *present = NULL;
+    uint8_t                    *run = NULL;
+    uint8_t                    *matched = NULL;
+    uint8_t                    *proven = NULL;
+    size_t                     *group_epoch = NULL;
+    size_t                      epoch = 1;
+    size_t                      data_size = 0;
+    size_t                      num;
+    ib_status_t                 rc;
+
+    ruleset_phase = &(ctx->rules->ruleset.phases[meta->phase_num]);
+    assert(ruleset_phase != NULL);
+    rules = ruleset_phase->rule_list;
+    assert(rules != NULL);
+
+    /* Sanity check */
+    if (ruleset_phase->phase_num != meta->phase_num) {
+        ib_log_error_tx(tx, "Rule engine: Phase %d (%s) is %d",
+                     meta->phase_num, meta->name, ruleset_phase->phase_num );
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    /* Walk through the rules & execute them */
+    if (IB_LIST_ELEMENTS(rules) == 0) {
+        ib_log_debug3_tx(tx,
+                     "No rules for phase %d/%s in context %s",
+                      meta->phase_num, meta->name, ib_context_full_get(ctx));
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    if (phase_blocked(tx, meta) == IB_TRUE) {
+        ib_log_debug3_tx(tx,
+                         "Transaction blocked: not executing phase %d/%s",
+                         meta->phase_num, meta->name);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    ib_log_debug3_tx(tx,
+                  "Executing %d rules for phase %d/%s in context %s",
+                  IB_LIST_ELEMENTS(rules),
+                  meta->phase_num, meta->name, ib_context_full_get(ctx));
+
+    if (ib->rules->profile != NULL) {
+        start_ns = ib_clock_get_time_ns();
+    }
+
+    rc = get_phase_plan(ib, tx, ruleset_phase, &plan, &index);
+    if (rc != IB_OK) {
+        ib_log_error_tx(tx,
+                        "Rule engine: No execution plan for phase %d/%s: %s",
+                        meta->phase_num, meta->name, ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    /*
+     * Find which of the phase's target fields exist; only rules which
+     * target one of them (or which run without data) are executed.
+     */
+    if (index != NULL) {
+        run = (uint8_t *)ib_mpool_alloc(tx->mp, index->num_rules);
+        present = (uint8_t *)ib_mpool_calloc(tx->mp, 1, index->num_fields);
+        if ( (run == NULL) || (present == NULL) ) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+        memcpy(run, index->always, index->num_rules);
+        probe_phase_fields(tx, index, present, run);
+        data_size = ib_hash_size((ib_hash_t *)tx->dpi->data);
+
+        if (index->num_groups != 0) {
+            matched = (uint8_t *)ib_mpool_calloc(tx->mp, 1, index->num_rules);
+            group_epoch = (size_t *)
+                ib_mpool_calloc(tx->mp, index->num_groups, sizeof(size_t));
+            if ( (matched == NULL) || (group_epoch == NULL) ) {
+                IB_FTRACE_RET_STATUS(IB_EALLOC);
+            }
+        }
+
+        /*
+         * Rule workers evaluate the operators of independent rules up
+         * front.  A rule proven false can skip its operator as long as no
+         * rule before it changed the data (the epoch is still 1).
          */
-        assert(meta->event == event);
-        if (txdata != NULL) {
-            for (dtype_num = 0;  dtype_num < meta->num_dtypes;  ++dtype_num) {
-                if (txdata->dtype == meta->dtypes[dtype_num]) {
-                    dtype_found = IB_TRUE;
-                    break;
-                }
+        if ( (ib->rules->workers != NULL) && (index->num_parallel >= 2) ) {
+            proven = (uint8_t *)ib_mpool_calloc(tx->mp, 1, index->num_rules);
+            if (proven == NULL) {
+                IB_FTRACE_RET_STATUS(IB_EALLOC);
             }
-            if (dtype_found == IB_FALSE) {
-                continue;
+            rc = evaluate_parallel_rules(ib, tx, plan, index, run, proven);
+            if (rc != IB_OK) {
+                ib_log_error_tx(tx, "Error evaluating parallel rules: %s",
+                                ib_status_to_string(rc));
+                memset(proven, 0, index->num_rules);
             }
         }
+    }
+
+    /*
+     * Loop through all of the rules for this phase, execute them.
+     *
+     * @todo The current behavior is to keep running even after rule execution
+     * returns an error.  This needs further discussion to determine what the
+     * correct behavior should be.
+     */
+    for (num = 0; num < plan->num_rules; ++num) {
+        const ib_rule_exec_t *exec = &(plan->rules[num]);
+        const ib_rule_t      *rule = exec->rule;
+        ib_num_t              rule_result = 0;
+        ib_status_t           rule_rc;
 
         /* Skip invalid / disabled rules */
-        if ( (rule->flags & IB_RULE_FLAGS_RUNABLE) != IB_RULE_FLAGS_RUNABLE) {
+        if ( (exec->flags & IB_RULE_FLAGS_RUNABLE) != IB_RULE_FLAGS_RUNABLE) {
             ib_log_debug2_tx(tx,
-                         "Not executing invalid/disabled stream rule %s",
+                         "Not executing invalid/disabled phase rule %s",
                          rule->meta.id);
             continue;
         }
 
         /*
-         * Execute the rule
-         *
-         * @todo The current behavior is to keep running even after an
-         * operator returns an error.  This needs further discussion to
-         * determine what the correct behavior should be.
+         * Skip rules whose targets don't exist.  Earlier rules may have
+         * added fields (i.e. setvar), so look again if the data changed.
          */
-        if (txdata != NULL) {
-            rc = execute_stream_txdata_rule(ib, rule, tx, txdata, &result);
-        }
-        else if (headers != NULL) {
-            rc = execute_stream_header_rule(ib, rule, tx, headers, &result);
-        }
-        if (rc != IB_OK) {
-            ib_log_error_tx(tx, "Error executing rule %s: %s",
-                            rule->meta.id, ib_status_to_string(rc));
+        if ( (run != NULL) && (run[num] == 0) ) {
+            size_t size = ib_hash_size((ib_hash_t *)tx->dpi->data);
+            if (size != data_size) {
+                probe_phase_fields(tx, index, present, run);
+                data_size = size;
+            }
+            if (run[num] == 0) {
+                ib_log_debug3_tx(tx,
+                                 "Not executing phase rule %s: "
+                                 "no target fields present",
+                                 rule->meta.id);
+                continue;
+            }
         }
 
-        /* Invert? */
-        if ( (rule->opinst->flags & IB_OPINST_FLAG_INVERT) != 0) {
-            result = ( (result) == 0);
+        /* Rules proven false by the rule workers only run their actions */
+        if ( (proven != NULL) && (proven[num] != 0) && (epoch == 1) ) {
+            rule_result = 0;
+            rule_rc = execute_phase_rule(ib,
+                                         exec,
+                                         tx,
+                                         MAX_CHAIN_RECURSION,
+                                         &rule_result,
+                                         IB_TRUE);
         }
 
         /*
-         * Execute the actions.
-         *
-         * @todo The current behavior is to keep running even after action(s)
-         * returns an error.  This needs further discussion to determine what
-         * the correct behavior should be.
+         * Rules in a literal group share one evaluation of their operators.
+         * The group is evaluated again if a rule which may have changed
+         * the data (one that ran actions, transformations or external code)
+         * ran since.
          */
-        if (result != 0) {
-            actions = rule->true_actions;
+        else if ( (matched != NULL) && (index->group[num] != NULL) ) {
+            const ib_rule_literal_group_t *group = index->group[num];
+
+            if (group_epoch[group->num] != epoch) {
+                execute_literal_group(ib, tx, group, matched);
+                group_epoch[group->num] = epoch;
+            }
+            rule_result = matched[num];
+            rule_rc = execute_phase_rule(ib,
+                                         exec,
+                                         tx,
+                                         MAX_CHAIN_RECURSION,
+                                         &rule_result,
+                                         IB_TRUE);
         }
+
+        /* Execute the rule, it's actions and chains */
         else {
-            actions = rule->false_actions;
+            rule_rc = execute_phase_rule(ib,
+                                         exec,
+                                         tx,
+                                         MAX_CHAIN_RECURSION,
+                                         &rule_result,
+                                         IB_FALSE);
         }
-        rc = execute_actions(ib, rule, tx, result, actions);
-        if (rc != IB_OK) {
+        if (rule_rc != IB_OK) {
             ib_log_error_tx(tx,
-                         "Error executing action for rule %s: %s",
-                         rule->meta.id, ib_status_to_string(rc));
+                         "Error executing rule %s: %s",
+                         rule->meta.id, ib_status_to_string(rule_rc));
+        }
+
+        if ( (run != NULL) &&
+             ( (index->modifies[num] != 0) || (rule_result != 0) ) )
+        {
+            ++epoch;
+        }
+
+        /* A block decision is final; skip the rest of the phase */
+        if (phase_blocked(tx, meta) == IB_TRUE) {
+            ib_log_debug3_tx(tx,
+                             "Rule %s blocked transaction: not executing "
+                             "the remaining phase %d/%s rules",
+                             rule->meta.id, meta->phase_num, meta->name);
+            break;
         }
     }
 
+    if (ib->rules->profile != NULL) {
+        profile_tx_time(tx, ib_clock_get_time_ns() - start_ns);
+    }
+
     /*
      * @todo Eat errors for now.  Unless something Really Bad(TM) has
      * occurred, return IB_OK to the engine.  A bigger discussion of if / how
@@ -1181,306 +1942,1394 @@ static ib_status_t run_stream_rules(ib_engine_t *ib,
 }
 
 /**
- * Run stream header rules
+ * Execute a single stream txdata rule, and it's actions
  * @internal
  *
- * @param[in] ib Engine.
- * @param[in] tx Transaction.
- * @param[in] event Event type.
- * @param[in] headers Parsed headers
- * @param[in] cbdata Callback data (actually phase_rule_cbdata_t)
+ * @param[in] ib Engine
+ * @param[in] event Event type
+ * @param[in] tx Transaction
+ * @param[in,out] txdata Transaction data
+ * @param[in,out] rule_result Result of rule execution
  *
  * @returns Status code
  */
-static ib_status_t run_stream_header_rules(ib_engine_t *ib,
-                                           ib_tx_t *tx,
-                                           ib_state_event_type_t event,
-                                           ib_parsed_header_t *headers,
-                                           void *cbdata)
+static ib_status_t execute_stream_txdata_rule(ib_engine_t *ib,
+                                              ib_rule_t *rule,
+                                              ib_tx_t *tx,
+                                              ib_txdata_t *txdata,
+                                              ib_num_t *result)
 {
     IB_FTRACE_INIT();
+    ib_status_t          rc = IB_OK;
+    ib_operator_inst_t  *opinst = rule->opinst;
+    ib_field_t          *value = NULL;
 
     assert(ib != NULL);
-    assert(headers != NULL);
-    assert(cbdata != NULL);
+    assert(rule != NULL);
+    assert(txdata != NULL);
+    assert(result != NULL);
+    assert(rule->phase_meta->is_stream == IB_TRUE);
 
-    const ib_rule_phase_meta_t *meta = (const ib_rule_phase_meta_t *) cbdata;
-    ib_status_t rc;
-    rc = run_stream_rules(ib, tx, event, NULL, headers, meta);
-    IB_FTRACE_RET_STATUS(rc);
-}
 
-/**
- * Run stream TXDATA rules
- * @internal
- *
- * @param[in] ib Engine.
- * @param[in] tx Transaction.
- * @param[in] event Event type.
- * @param[in] txdata Transaction data.
- * @param[in] cbdata Callback data (actually phase_rule_cbdata_t)
- *
- * @returns Status code
- */
-static ib_status_t run_stream_txdata_rules(ib_engine_t *ib,
-                                           ib_tx_t *tx,
-                                           ib_state_event_type_t event,
-                                           ib_txdata_t *txdata,
-                                           void *cbdata)
-{
-    IB_FTRACE_INIT();
+    /*
+     * Execute the rule operator.
+     *
+     * @todo The current behavior is to keep running even after action(s)
+     * returns an error.  This needs further discussion to determine what the
+     * correct behavior should be.
+     */
 
-    assert(ib != NULL);
-    assert(cbdata != NULL);
+    /* Create a field to hold the data */
+    rc = ib_field_create_bytestr_alias(&value,
+                                       tx->mp,
+                                       "tmp", 3,
+                                       txdata->data, txdata->dlen);
+    if (rc != IB_OK) {
+        ib_log_error_tx(tx,
+                        "Error creating field for stream txdata rule data: %s",
+                        ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
 
-    if (txdata == NULL) {
-        IB_FTRACE_RET_STATUS(IB_OK);
+    /* Execute the rule operator */
+    rc = ib_operator_execute(ib, tx, opinst, value, result);
+    if (rc != IB_OK) {
+        ib_log_error_tx(tx,
+                     "Operator %s returned an error: %s",
+                     opinst->op->name, ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
     }
-    const ib_rule_phase_meta_t *meta = (const ib_rule_phase_meta_t *) cbdata;
-    ib_status_t rc;
-    rc = run_stream_rules(ib, tx, event, txdata, NULL, meta);
+    ib_log_debug3_tx(tx, "Operator %s => %d", opinst->op->name, *result);
+
     IB_FTRACE_RET_STATUS(rc);
 }
 
 /**
- * Run stream TX rules (aka request header)
+ * Execute a single stream header rule, and it's actions
  * @internal
  *
- * @param[in] ib Engine.
- * @param[in] tx Transaction.
- * @param[in] event Event type.
- * @param[in] cbdata Callback data (actually phase_rule_cbdata_t)
+ * @param[in] ib Engine
+ * @param[in] event Event type
+ * @param[in] tx Transaction
+ * @param[in] headers Parsed headers
+ * @param[in,out] rule_result Result of rule execution
  *
  * @returns Status code
  */
-static ib_status_t run_stream_tx_rules(ib_engine_t *ib,
-                                       ib_tx_t *tx,
-                                       ib_state_event_type_t event,
-                                       void *cbdata)
+static ib_status_t execute_stream_header_rule(ib_engine_t *ib,
+                                              ib_rule_t *rule,
+                                              ib_tx_t *tx,
+                                              ib_parsed_header_t *headers,
+                                              ib_num_t *rule_result)
+{
+    IB_FTRACE_INIT();
+    ib_status_t          rc = IB_OK;
+    ib_operator_inst_t  *opinst = rule->opinst;
+    ib_field_t          *value;
+    ib_parsed_name_value_pair_list_t *nvpair;
+
+    assert(ib != NULL);
+    assert(rule != NULL);
+    assert(headers != NULL);
+    assert(rule_result != NULL);
+    assert(rule->phase_meta->is_stream == IB_TRUE);
+
+
+    /*
+     * Execute the rule operator.
+     *
+     * @todo The current behavior is to keep running even after action(s)
+     * returns an error.  This needs further discussion to determine what the
+     * correct behavior should be.
+     */
+    *rule_result = 0;
+    for (nvpair = headers;  nvpair != NULL;  nvpair = nvpair->next) {
+        ib_num_t result;
+
+        /* Create a field to hold the data */
+        ib_log_debug_tx(tx, "nvpair: '%.*s'='%.*s'\n",
+                        (int)ib_bytestr_length(nvpair->name),
+                        (const char *)ib_bytestr_const_ptr(nvpair->name),
+                        (int)ib_bytestr_length(nvpair->value),
+                        (const char *)ib_bytestr_const_ptr(nvpair->value));
+        rc = ib_field_create(&value,
+                             tx->mp,
+                             (const char *)ib_bytestr_const_ptr(nvpair->name),
+                             ib_bytestr_length(nvpair->name),
+                             IB_FTYPE_BYTESTR,
+                             ib_ftype_bytestr_in(nvpair->value));
+        if (rc != IB_OK) {
+            ib_log_error_tx(tx,
+                            "Error creating field for header stream rule data: %s",
+                            ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+
+        /* Execute the rule operator */
+        rc = ib_operator_execute(ib, tx, opinst, value, &result);
+        if (rc != IB_OK) {
+            ib_log_error_tx(tx,
+                            "Operator %s returned an error: %s",
+                            opinst->op->name, ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+
+        /* Store the result; first match wins */
+        if (result != 0) {
+            *rule_result = result;
+            break;
+        }
+    }
+    ib_log_debug3_tx(tx, "Operator %s => %d", opinst->op->name, *rule_result);
+
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+/**
+ * Run a set of stream rules.
+ * @internal
+ *
+ * @param[in] ib Engine.
+ * @param[in] tx Transaction.
+ * @param[in] event Event type.
+ * @param[in] txdata Transaction data (or NULL)
+ * @param[in] headers Parsed headers (or NULL)
+ * @param[in] meta Phase meta data
+ *
+ * @returns Status code
+ */
+static ib_status_t run_stream_rules(ib_engine_t *ib,
+                                    ib_tx_t *tx,
+                                    ib_state_event_type_t event,
+                                    ib_txdata_t *txdata,
+                                    ib_parsed_header_t *headers,
+                                    const ib_rule_phase_meta_t *meta)
+{
+    IB_FTRACE_INIT();
+
+    assert(ib != NULL);
+    assert( (txdata != NULL) || (headers != NULL) );
+    assert(meta != NULL);
+    assert( (meta->hook_type != IB_STATE_HOOK_TXDATA) || (txdata != NULL) );
+    assert( (meta->hook_type != IB_STATE_HOOK_HEADER) || (headers != NULL) );
+
+    ib_context_t            *ctx = tx->ctx;
+    ib_ruleset_phase_t      *ruleset_phase =
+        &(ctx->rules->ruleset.phases[meta->phase_num]);
+    ib_list_t               *rules = ruleset_phase->rule_list;
+    const ib_rule_phase_plan_t *plan;
+    const ib_rule_phase_index_t *index;
+    size_t                   num;
+    ib_status_t              prc;
+
+    /* Sanity check */
+    if (ruleset_phase->phase_num != meta->phase_num) {
+        ib_log_error_tx(tx, "Rule engine: Stream %d (%s) is %d",
+                     meta->phase_num, meta->name, ruleset_phase->phase_num);
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    /* Are there any rules?  If not, do a quick exit */
+    if (IB_LIST_ELEMENTS(rules) == 0) {
+        ib_log_debug3_tx(tx,
+                      "No rules for stream %d/%s in context %s",
+                      meta->phase_num, meta->name, ib_context_full_get(ctx));
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    if (phase_blocked(tx, meta) == IB_TRUE) {
+        ib_log_debug3_tx(tx,
+                         "Transaction blocked: not executing stream %d/%s",
+                         meta->phase_num, meta->name);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    ib_log_debug3_tx(tx,
+                  "Executing %d rules for stream %d/%s in context %s",
+                  IB_LIST_ELEMENTS(rules),
+                  meta->phase_num, meta->name, ib_context_full_get(ctx));
+
+    prc = get_phase_plan(ib, tx, ruleset_phase, &plan, &index);
+    if (prc != IB_OK) {
+        ib_log_error_tx(tx,
+                        "Rule engine: No execution plan for stream %d/%s: %s",
+                        meta->phase_num, meta->name, ib_status_to_string(prc));
+        IB_FTRACE_RET_STATUS(prc);
+    }
+
+    /*
+     * Loop through all of the rules for this phase, execute them.
+     *
+     * @todo The current behavior is to keep running even after rule execution
+     * returns an error.  This needs further discussion to determine what the
+     * correct behavior should be.
+     */
+    for (num = 0; num < plan->num_rules; ++num) {
+        const ib_rule_exec_t *exec = &(plan->rules[num]);
+        ib_rule_t   *rule = exec->rule;
+        ib_num_t     result = 0;
+        ib_num_t     dtype_num;
+        ib_bool_t    dtype_found = IB_FALSE;
+        ib_status_t  rc = IB_OK;
+
+        /*
+         * Determine if this event applies to this rule (txdata only)
+         */
+        assert(meta->event == event);
+        if (txdata != NULL) {
+            for (dtype_num = 0;  dtype_num < meta->num_dtypes;  ++dtype_num) {
+                if (txdata->dtype == meta->dtypes[dtype_num]) {
+                    dtype_found = IB_TRUE;
+                    break;
+                }
+            }
+            if (dtype_found == IB_FALSE) {
+                continue;
+            }
+        }
+
+        /* Skip invalid / disabled rules */
+        if ( (exec->flags & IB_RULE_FLAGS_RUNABLE) != IB_RULE_FLAGS_RUNABLE) {
+            ib_log_debug2_tx(tx,
+                         "Not executing invalid/disabled stream rule %s",
+                         rule->meta.id);
+            continue;
+        }
+
+        /*
+         * Execute the rule
+         *
+         * @todo The current behavior is to keep running even after an
+         * operator returns an error.  This needs further discussion to
+         * determine what the correct behavior should be.
+         */
+        if (txdata != NULL) {
+            rc = execute_stream_txdata_rule(ib, rule, tx, txdata, &result);
+        }
+        else if (headers != NULL) {
+            rc = execute_stream_header_rule(ib, rule, tx, headers, &result);
+        }
+        if (rc != IB_OK) {
+            ib_log_error_tx(tx, "Error executing rule %s: %s",
+                            rule->meta.id, ib_status_to_string(rc));
+        }
+
+        /* Invert? */
+        if ( (exec->opinst->flags & IB_OPINST_FLAG_INVERT) != 0) {
+            result = ( (result) == 0);
+        }
+
+        /*
+         * Execute the actions.
+         *
+         * @todo The current behavior is to keep running even after action(s)
+         * returns an error.  This needs further discussion to determine what
+         * the correct behavior should be.
+         */
+        if (result != 0) {
+            rc = execute_actions(ib, rule, tx, result,
+                                 exec->true_actions, exec->num_true_actions);
+        }
+        else {
+            rc = execute_actions(ib, rule, tx, result,
+                                 exec->false_actions, exec->num_false_actions);
+        }
+        if (rc != IB_OK) {
+            ib_log_error_tx(tx,
+                         "Error executing action for rule %s: %s",
+                         rule->meta.id, ib_status_to_string(rc));
+        }
+
+        /* A block decision is final; skip the rest of the stream */
+        if (phase_blocked(tx, meta) == IB_TRUE) {
+            ib_log_debug3_tx(tx,
+                             "Rule %s blocked transaction: not executing "
+                             "the remaining stream %d/%s rules",
+                             rule->meta.id, meta->phase_num, meta->name);
+            break;
+        }
+    }
+
+    /*
+     * @todo Eat errors for now.  Unless something Really Bad(TM) has
+     * occurred, return IB_OK to the engine.  A bigger discussion of if / how
+     * such errors should be propagated needs to occur.
+     */
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * Run stream header rules
+ * @internal
+ *
+ * @param[in] ib Engine.
+ * @param[in] tx Transaction.
+ * @param[in] event Event type.
+ * @param[in] headers Parsed headers
+ * @param[in] cbdata Callback data (actually phase_rule_cbdata_t)
+ *
+ * @returns Status code
+ */
+static ib_status_t run_stream_header_rules(ib_engine_t *ib,
+                                           ib_tx_t *tx,
+                                           ib_state_event_type_t event,
+                                           ib_parsed_header_t *headers,
+                                           void *cbdata)
+{
+    IB_FTRACE_INIT();
+
+    assert(ib != NULL);
+    assert(headers != NULL);
+    assert(cbdata != NULL);
+
+    const ib_rule_phase_meta_t *meta = (const ib_rule_phase_meta_t *) cbdata;
+    ib_status_t rc;
+    rc = run_stream_rules(ib, tx, event, NULL, headers, meta);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+/**
+ * Run stream TXDATA rules
+ * @internal
+ *
+ * @param[in] ib Engine.
+ * @param[in] tx Transaction.
+ * @param[in] event Event type.
+ * @param[in] txdata Transaction data.
+ * @param[in] cbdata Callback data (actually phase_rule_cbdata_t)
+ *
+ * @returns Status code
+ */
+static ib_status_t run_stream_txdata_rules(ib_engine_t *ib,
+                                           ib_tx_t *tx,
+                                           ib_state_event_type_t event,
+                                           ib_txdata_t *txdata,
+                                           void *cbdata)
+{
+    IB_FTRACE_INIT();
+
+    assert(ib != NULL);
+    assert(cbdata != NULL);
+
+    if (txdata == NULL) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    const ib_rule_phase_meta_t *meta = (const ib_rule_phase_meta_t *) cbdata;
+    ib_status_t rc;
+    rc = run_stream_rules(ib, tx, event, txdata, NULL, meta);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+/**
+ * Run stream TX rules (aka request header)
+ * @internal
+ *
+ * @param[in] ib Engine.
+ * @param[in] tx Transaction.
+ * @param[in] event Event type.
+ * @param[in] cbdata Callback data (actually phase_rule_cbdata_t)
+ *
+ * @returns Status code
+ */
+static ib_status_t run_stream_tx_rules(ib_engine_t *ib,
+                                       ib_tx_t *tx,
+                                       ib_state_event_type_t event,
+                                       void *cbdata)
+{
+    IB_FTRACE_INIT();
+    ib_parsed_header_wrapper_t *hdrs;
+    ib_status_t rc;
+
+    assert(ib != NULL);
+    assert(tx != NULL);
+    assert(cbdata != NULL);
+
+    /* Wrap up the request line */
+    rc = ib_parsed_name_value_pair_list_wrapper_create(&hdrs, tx);
+    if (rc != IB_OK) {
+        ib_log_error_tx(tx, "Error creating name/value pair list: %s",
+                        ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    if (
+        tx->request_line->method != NULL &&
+        ib_bytestr_const_ptr(tx->request_line->method) != NULL
+    ) {
+        rc = ib_parsed_name_value_pair_list_add(
+            hdrs,
+            "method", 6,
+            (const char *)ib_bytestr_const_ptr(tx->request_line->method),
+            ib_bytestr_length(tx->request_line->method));
+        if (rc != IB_OK) {
+            ib_log_error_tx(tx, "Error adding method to name/value pair list: %s",
+                            ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+    if (
+        tx->request_line->uri != NULL &&
+        ib_bytestr_const_ptr(tx->request_line->uri) != NULL
+    ) {
+        rc = ib_parsed_name_value_pair_list_add(
+            hdrs,
+            "uri", 4,
+            (const char *)ib_bytestr_const_ptr(tx->request_line->uri),
+            ib_bytestr_length(tx->request_line->uri));
+        if (rc != IB_OK) {
+            ib_log_error_tx(tx, "Error adding uri to name/value pair list: %s",
+                            ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+    if (
+        tx->request_line->protocol != NULL &&
+        ib_bytestr_const_ptr(tx->request_line->protocol) != NULL
+    ) {
+        rc = ib_parsed_name_value_pair_list_add(
+            hdrs,
+            "protocol", 7,
+            (const char *)ib_bytestr_const_ptr(tx->request_line->protocol),
+            ib_bytestr_length(tx->request_line->protocol));
+        if (rc != IB_OK) {
+            ib_log_error_tx(tx, "Error adding protocol to name/value pair list: %s",
+                            ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+
+    /* Now, process the request line */
+    ib_log_debug_tx(tx, "Running header line through stream headers");
+    rc = run_stream_header_rules(ib, tx, event,
+                                 hdrs->head, cbdata);
+    if (rc != IB_OK) {
+        ib_log_error_tx(tx, "Error processing tx request line: %s",
+                        ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    /* Process the request headers */
+    if (tx->request_headers != NULL && tx->request_headers->head != NULL) {
+        ib_log_debug_tx(tx, "Running headers through stream headers");
+        rc = run_stream_header_rules(ib, tx, event,
+                                     tx->request_headers->head,
+                                     cbdata);
+        if (rc != IB_OK) {
+            ib_log_error_tx(tx, "Error processing tx request line: %s",
+                            ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * Initialize rule set objects.
+ * @internal
+ *
+ * @param[in] ib Engine
+ * @param[in] mp Memory pool to use for allocations
+ * @param[in,out] rule_engine Rule engine
+ *
+ * @returns Status code
+ */
+static ib_status_t init_ruleset(ib_engine_t *ib,
+                                ib_mpool_t *mp,
+                                ib_rule_engine_t *rule_engine)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+    ib_num_t    phase_num;
+
+    /* Initialize the phase rules */
+    for (phase_num = (ib_num_t)PHASE_NONE;
+         phase_num < (ib_num_t)IB_RULE_PHASE_COUNT;
+         ++phase_num)
+    {
+        ib_ruleset_phase_t *ruleset_phase =
+            &(rule_engine->ruleset.phases[phase_num]);
+        ruleset_phase->phase_num = (ib_rule_phase_t)phase_num;
+        rc = find_phase_meta(phase_num, &(ruleset_phase->phase_meta));
+        if (rc != IB_OK) {
+            ib_log_error(ib,
+                         "Rule set initialization: "
+                         "failed to find phase meta data: %s",
+                         rc);
+            IB_FTRACE_RET_STATUS(rc);
+        }
+
+        rc = ib_list_create(&(ruleset_phase->rule_list), mp);
+        if (rc != IB_OK) {
+            ib_log_error(ib,
+                         "Rule set initialization: "
+                         "failed to create phase ruleset list: %s",
+                         rc);
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * Register rules callbacks
+ * @internal
+ *
+ * @param[in] ib Engine
+ * @param[in] mp Memory pool to use for allocations
+ * @param[in,out] rule_engine Rule engine
+ *
+ * @returns Status code
+ */
+static ib_status_t register_callbacks(ib_engine_t *ib,
+                                      ib_mpool_t *mp,
+                                      ib_rule_engine_t *rule_engine)
+{
+    IB_FTRACE_INIT();
+    const ib_rule_phase_meta_t *meta;
+    const char                 *hook_type = NULL;
+    ib_status_t                 rc = IB_OK;
+
+    /* Register specific handlers for specific events, and a
+     * generic handler for the rest */
+    for (meta = rule_phase_meta; meta->phase_num != PHASE_INVALID; ++meta) {
+        if (meta->event == (ib_state_event_type_t) -1) {
+            continue;
+        }
+
+        /* Non-phase rules all use the same callback */
+        switch (meta->is_stream) {
+
+        case IB_FALSE :
+            rc = ib_hook_tx_register(
+                ib,
+                meta->event,
+                run_phase_rules,
+                (void *)meta);
+            hook_type = "tx";
+            break;
+
+        case IB_TRUE :
+            switch (meta->hook_type) {
+
+            case IB_STATE_HOOK_TX:
+                rc = ib_hook_tx_register(
+                    ib,
+                    meta->event,
+                    run_stream_tx_rules,
+                    (void *)meta);
+                hook_type = "stream-tx";
+                break;
+
+            case IB_STATE_HOOK_TXDATA:
+                rc = ib_hook_txdata_register(
+                    ib,
+                    meta->event,
+                    run_stream_txdata_rules,
+                    (void *)meta);
+                hook_type = "txdata";
+                break;
+
+            case IB_STATE_HOOK_HEADER:
+                rc = ib_hook_parsed_header_data_register(
+                    ib,
+                    meta->event,
+                    run_stream_header_rules,
+                    (void *)meta);
+                hook_type = "header";
+                break;
+
+            default:
+                ib_log_error(ib,
+                             "Unknown hook registration type %d for "
+                             "phase %d/%d/%s",
+                             meta->phase_num, meta->event, meta->name);
+                IB_FTRACE_RET_STATUS(IB_EINVAL);
+            }
+            break;
+
+        default:
+            assert(0 && "Invalid bool for is_stream");
+            break;
+
+        }
+
+        /* OK */
+        if (rc != IB_OK) {
+            ib_log_error(ib,
+                         "Hook %s registration for phase %d/%d/%s returned %s",
+                         hook_type, meta->phase_num, meta->event, meta->name,
+                         ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * Initialize a rule engine object.
+ * @internal
+ *
+ * @param[in] ib Engine
+ * @param[in,out] mp Memory pool to use for allocations
+ * @param[out] p_rule_engine Pointer to new rule engine object
+ *
+ * @returns Status code
+ */
+static ib_status_t create_rule_engine(ib_engine_t *ib,
+                                      ib_mpool_t *mp,
+                                      ib_rule_engine_t **p_rule_engine)
+{
+    IB_FTRACE_INIT();
+    ib_rule_engine_t *rule_engine;
+    ib_status_t       rc;
+
+    /* Create the rule object */
+    rule_engine =
+        (ib_rule_engine_t *)ib_mpool_calloc(mp, 1, sizeof(*rule_engine));
+    if (rule_engine == NULL) {
+        ib_log_error(ib,
+                     "Rule engine failed to allocate rule engine object");
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    /* Create the rule list */
+    rc = ib_list_create(&(rule_engine->rule_list), mp);
+    if (rc != IB_OK) {
+        ib_log_error(ib,
+                     "Rule engine failed to initialize rule list: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    *p_rule_engine = rule_engine;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_rule_engine_init(ib_engine_t *ib,
+                                ib_module_t *mod)
 {
     IB_FTRACE_INIT();
-    ib_parsed_header_wrapper_t *hdrs;
     ib_status_t rc;
 
-    assert(ib != NULL);
-    assert(tx != NULL);
-    assert(cbdata != NULL);
+    /* Create the rule engine object */
+    rc = create_rule_engine(ib, ib->mp, &(ib->rules));
+    if (rc != IB_OK) {
+        ib_log_error(ib,
+                     "Rule engine failed to create rule engine: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
 
-    /* Wrap up the request line */
-    rc = ib_parsed_name_value_pair_list_wrapper_create(&hdrs, tx);
+    rc = ib_lock_init(&(ib->rules->plan_lock));
     if (rc != IB_OK) {
-        ib_log_error_tx(tx, "Error creating name/value pair list: %s",
-                        ib_status_to_string(rc));
+        ib_log_error(ib,
+                     "Rule engine failed to initialize plan lock: %s",
+                     ib_status_to_string(rc));
         IB_FTRACE_RET_STATUS(rc);
     }
-    if (
-        tx->request_line->method != NULL &&
-        ib_bytestr_const_ptr(tx->request_line->method) != NULL
-    ) {
-        rc = ib_parsed_name_value_pair_list_add(
-            hdrs,
-            "method", 6,
-            (const char *)ib_bytestr_const_ptr(tx->request_line->method),
-            ib_bytestr_length(tx->request_line->method));
+
+    /* Register the rule callbacks */
+    rc = register_callbacks(ib, ib->mp, ib->rules);
+    if (rc != IB_OK) {
+        ib_log_error(ib,
+                     "Rule engine failed to register phase callbacks: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_rule_engine_ctx_init(ib_engine_t *ib,
+                                    ib_module_t *mod,
+                                    ib_context_t *ctx)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    /* If the rules are already initialized, do nothing */
+    if (ctx->rules != NULL) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    /* Create the rule engine object */
+    rc = create_rule_engine(ib, ctx->mp, &(ctx->rules));
+    if (rc != IB_OK) {
+        ib_log_error(ib,
+                     "Rule engine failed to initialize context rules: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    /* Initialize the rule sets */
+    rc = init_ruleset(ib, ctx->mp, ctx->rules);
+    if (rc != IB_OK) {
+        ib_log_error(ib,
+                     "Rule engine failed to initialize phase ruleset: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * Determine if a phase rule has to run whether or not its targets exist.
+ * @internal
+ *
+ * With no target fields present, a rule's result is false; its false
+ * actions run and an inverted operator makes it true.
+ *
+ * @param[in] rule The rule
+ *
+ * @returns IB_TRUE if the rule can't be skipped
+ */
+static ib_bool_t rule_runs_without_data(const ib_rule_t *rule)
+{
+    IB_FTRACE_INIT();
+    const ib_operator_inst_t *opinst = rule->opinst;
+
+    if ( ((rule->flags & IB_RULE_FLAG_EXTERNAL) != 0) ||
+         ((opinst->op->flags & IB_OP_FLAG_ALLOW_NULL) != 0) ||
+         ((opinst->flags & IB_OPINST_FLAG_INVERT) != 0) ||
+         ( (rule->false_actions != NULL) &&
+           (IB_LIST_ELEMENTS(rule->false_actions) != 0) ) )
+    {
+        IB_FTRACE_RET_INT(IB_TRUE);
+    }
+    IB_FTRACE_RET_INT(IB_FALSE);
+}
+
+/**
+ * Literal string operators which can be evaluated for a group of rules.
+ */
+typedef enum {
+    LITERAL_OP_NONE,                /**< Not a groupable literal rule */
+    LITERAL_OP_STREQ,               /**< streq: one hash lookup */
+    LITERAL_OP_CONTAINS,            /**< contains: one Aho-Corasick scan */
+} literal_op_t;
+
+/**
+ * Member of a candidate literal group
+ */
+typedef struct {
+    size_t                 num;           /**< Rule index within phase */
+    const char            *literal;       /**< Rule's literal */
+} literal_member_t;
+
+/**
+ * Candidate literal group, used while building the groups
+ */
+typedef struct {
+    literal_op_t           op;            /**< Group operator */
+    const ib_rule_exec_target_t *target;  /**< Target of the first rule */
+    ib_list_t             *members;       /**< Rules (literal_member_t *) */
+} literal_candidate_t;
+
+/**
+ * Determine how a phase rule can be grouped with other literal rules.
+ * @internal
+ *
+ * Rules with a single target and a non-expanding streq or contains operator
+ * qualify, unless they have to run without data (see
+ * rule_runs_without_data()).  Empty contains literals always match and are
+ * left alone.
+ *
+ * @param[in] rule The rule
+ *
+ * @returns Literal operator or LITERAL_OP_NONE
+ */
+static literal_op_t rule_literal_op(const ib_rule_t *rule)
+{
+    IB_FTRACE_INIT();
+    const ib_operator_inst_t *opinst = rule->opinst;
+    const char               *literal = (const char *)opinst->data;
+
+    if ( (IB_LIST_ELEMENTS(rule->target_fields) != 1) ||
+         ((opinst->flags & IB_OPINST_FLAG_EXPAND) != 0) ||
+         (literal == NULL) )
+    {
+        IB_FTRACE_RET_INT(LITERAL_OP_NONE);
+    }
+    if (strcmp(opinst->op->name, "streq") == 0) {
+        IB_FTRACE_RET_INT(LITERAL_OP_STREQ);
+    }
+    if ( (strcmp(opinst->op->name, "contains") == 0) && (*literal != '\0') ) {
+        IB_FTRACE_RET_INT(LITERAL_OP_CONTAINS);
+    }
+    IB_FTRACE_RET_INT(LITERAL_OP_NONE);
+}
+
+/**
+ * Build the key identifying the group of a literal rule.
+ * @internal
+ *
+ * Rules share a group if they have the same operator, target field and
+ * transformations.
+ *
+ * @param[in] mp Memory pool to use for allocations
+ * @param[in] op Literal operator
+ * @param[in] target Rule's target
+ *
+ * @returns Group key or NULL on allocation failure
+ */
+static const char *literal_group_key(ib_mpool_t *mp,
+                                     literal_op_t op,
+                                     const ib_rule_exec_target_t *target)
+{
+    IB_FTRACE_INIT();
+    size_t                len = strlen(target->field_name) + 2;
+    size_t                n;
+    char                 *key;
+
+    for (n = 0; n < target->num_tfns; ++n) {
+        len += strlen(target->tfns[n]->name) + 1;
+    }
+    key = (char *)ib_mpool_alloc(mp, len);
+    if (key == NULL) {
+        IB_FTRACE_RET_CONSTSTR(NULL);
+    }
+
+    key[0] = (op == LITERAL_OP_STREQ) ? 's' : 'c';
+    strcpy(key + 1, target->field_name);
+    for (n = 0; n < target->num_tfns; ++n) {
+        strcat(key, "\x1f");
+        strcat(key, target->tfns[n]->name);
+    }
+    IB_FTRACE_RET_CONSTSTR(key);
+}
+
+/**
+ * Create a literal group from a candidate with two or more rules.
+ * @internal
+ *
+ * @param[in] ib Engine
+ * @param[in] mp Memory pool to use for allocations
+ * @param[in] tmp Memory pool for temporary allocations
+ * @param[in] candidate Group candidate
+ * @param[in] num Group number
+ * @param[out] pgroup The new group
+ *
+ * @returns Status code
+ */
+static ib_status_t create_literal_group(ib_engine_t *ib,
+                                        ib_mpool_t *mp,
+                                        ib_mpool_t *tmp,
+                                        const literal_candidate_t *candidate,
+                                        size_t num,
+                                        ib_rule_literal_group_t **pgroup)
+{
+    IB_FTRACE_INIT();
+    ib_rule_literal_group_t *group;
+    ib_hash_t               *literals;
+    ib_list_t               *distinct;
+    const ib_list_node_t    *node;
+    size_t                   n = 0;
+    ib_status_t              rc;
+
+    group = (ib_rule_literal_group_t *)ib_mpool_calloc(mp, 1, sizeof(*group));
+    if (group == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    group->num = num;
+    group->target = candidate->target;
+    group->num_rules = IB_LIST_ELEMENTS(candidate->members);
+    group->rules = (size_t *)
+        ib_mpool_alloc(mp, group->num_rules * sizeof(*group->rules));
+    if (group->rules == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    /* Map each distinct literal to the rules using it */
+    rc = ib_hash_create(&literals, mp);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    rc = ib_list_create(&distinct, tmp);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    IB_LIST_LOOP_CONST(candidate->members, node) {
+        const literal_member_t *member = (const literal_member_t *)node->data;
+        ib_list_t              *rules;
+
+        group->rules[n] = member->num;
+        rc = ib_hash_get(literals, &rules, member->literal);
+        if (rc == IB_ENOENT) {
+            rc = ib_list_create(&rules, mp);
+            if (rc == IB_OK) {
+                rc = ib_hash_set(literals, member->literal, rules);
+            }
+            if (rc == IB_OK) {
+                rc = ib_list_push(distinct, (void *)member->literal);
+            }
+        }
+        if (rc == IB_OK) {
+            rc = ib_list_push(rules, &(group->rules[n]));
+        }
         if (rc != IB_OK) {
-            ib_log_error_tx(tx, "Error adding method to name/value pair list: %s",
-                            ib_status_to_string(rc));
             IB_FTRACE_RET_STATUS(rc);
         }
+        ++n;
     }
-    if (
-        tx->request_line->uri != NULL &&
-        ib_bytestr_const_ptr(tx->request_line->uri) != NULL
-    ) {
-        rc = ib_parsed_name_value_pair_list_add(
-            hdrs,
-            "uri", 4,
-            (const char *)ib_bytestr_const_ptr(tx->request_line->uri),
-            ib_bytestr_length(tx->request_line->uri));
+
+    if (candidate->op == LITERAL_OP_STREQ) {
+        group->literals = literals;
+    }
+    else {
+        rc = ib_ac_create(&(group->ac), 0, mp);
         if (rc != IB_OK) {
-            ib_log_error_tx(tx, "Error adding uri to name/value pair list: %s",
-                            ib_status_to_string(rc));
             IB_FTRACE_RET_STATUS(rc);
         }
-    }
-    if (
-        tx->request_line->protocol != NULL &&
-        ib_bytestr_const_ptr(tx->request_line->protocol) != NULL
-    ) {
-        rc = ib_parsed_name_value_pair_list_add(
-            hdrs,
-            "protocol", 7,
-            (const char *)ib_bytestr_const_ptr(tx->request_line->protocol),
-            ib_bytestr_length(tx->request_line->protocol));
+        IB_LIST_LOOP_CONST(distinct, node) {
+            const char *literal = (const char *)node->data;
+            ib_list_t  *rules;
+
+            rc = ib_hash_get(literals, &rules, literal);
+            if (rc != IB_OK) {
+                IB_FTRACE_RET_STATUS(rc);
+            }
+            rc = ib_ac_add_pattern(group->ac, literal, NULL, rules, 0);
+            if (rc != IB_OK) {
+                IB_FTRACE_RET_STATUS(rc);
+            }
+        }
+        rc = ib_ac_build_links(group->ac);
         if (rc != IB_OK) {
-            ib_log_error_tx(tx, "Error adding protocol to name/value pair list: %s",
-                            ib_status_to_string(rc));
             IB_FTRACE_RET_STATUS(rc);
         }
     }
 
-    /* Now, process the request line */
-    ib_log_debug_tx(tx, "Running header line through stream headers");
-    rc = run_stream_header_rules(ib, tx, event,
-                                 hdrs->head, cbdata);
+    ib_log_debug(ib, "Grouped %zd %s rules on %s",
+                 group->num_rules,
+                 (candidate->op == LITERAL_OP_STREQ) ? "streq" : "contains",
+                 group->target->field_name);
+    *pgroup = group;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * Group a phase's literal streq / contains rules by target.
+ * @internal
+ *
+ * @param[in] ib Engine
+ * @param[in] mp Memory pool to use for allocations
+ * @param[in] rule_list Phase rule list
+ * @param[in] plan Phase execution plan; groups share its targets
+ * @param[in,out] index Phase dependency index
+ *
+ * @returns Status code
+ */
+static ib_status_t build_literal_groups(ib_engine_t *ib,
+                                       ib_mpool_t *mp,
+                                       const ib_list_t *rule_list,
+                                       const ib_rule_phase_plan_t *plan,
+                                       ib_rule_phase_index_t *index)
+{
+    IB_FTRACE_INIT();
+    ib_mpool_t           *tmp;
+    ib_hash_t            *by_key;
+    ib_list_t            *candidates;
+    const ib_list_node_t *node;
+    literal_candidate_t  *candidate;
+    size_t                rule_num = 0;
+    ib_status_t           rc;
+
+    index->group = (ib_rule_literal_group_t **)
+        ib_mpool_calloc(mp, index->num_rules, sizeof(*index->group));
+    if (index->group == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    rc = ib_mpool_create(&tmp, "rule literal groups", mp);
     if (rc != IB_OK) {
-        ib_log_error_tx(tx, "Error processing tx request line: %s",
-                        ib_status_to_string(rc));
         IB_FTRACE_RET_STATUS(rc);
     }
+    rc = ib_hash_create(&by_key, tmp);
+    if (rc != IB_OK) {
+        goto done;
+    }
+    rc = ib_list_create(&candidates, tmp);
+    if (rc != IB_OK) {
+        goto done;
+    }
 
-    /* Process the request headers */
-    if (tx->request_headers != NULL && tx->request_headers->head != NULL) {
-        ib_log_debug_tx(tx, "Running headers through stream headers");
-        rc = run_stream_header_rules(ib, tx, event,
-                                     tx->request_headers->head,
-                                     cbdata);
+    /* Collect the literal rules by group key */
+    IB_LIST_LOOP_CONST(rule_list, node) {
+        ib_rule_t        *rule = (ib_rule_t *)node->data;
+        const ib_rule_exec_target_t *target;
+        literal_op_t      op;
+        const char       *key;
+        literal_member_t *member;
+
+        if ( (index->always[rule_num] != 0) ||
+             ((op = rule_literal_op(rule)) == LITERAL_OP_NONE) )
+        {
+            ++rule_num;
+            continue;
+        }
+        target = &(plan->rules[rule_num].targets[0]);
+
+        key = literal_group_key(tmp, op, target);
+        member = (literal_member_t *)ib_mpool_alloc(tmp, sizeof(*member));
+        if ( (key == NULL) || (member == NULL) ) {
+            rc = IB_EALLOC;
+            goto done;
+        }
+        member->num = rule_num++;
+        member->literal = (const char *)rule->opinst->data;
+
+        rc = ib_hash_get(by_key, &candidate, key);
+        if (rc == IB_ENOENT) {
+            candidate = (literal_candidate_t *)
+                ib_mpool_alloc(tmp, sizeof(*candidate));
+            if (candidate == NULL) {
+                rc = IB_EALLOC;
+                goto done;
+            }
+            candidate->op = op;
+            candidate->target = target;
+            rc = ib_list_create(&(candidate->members), tmp);
+            if (rc == IB_OK) {
+                rc = ib_hash_set(by_key, key, candidate);
+            }
+            if (rc == IB_OK) {
+                rc = ib_list_push(candidates, candidate);
+            }
+        }
+        if (rc == IB_OK) {
+            rc = ib_list_push(candidate->members, member);
+        }
+        if (rc != IB_OK) {
+            goto done;
+        }
+    }
+
+    /* Only groups of two or more rules are worth evaluating together */
+    IB_LIST_LOOP_CONST(candidates, node) {
+        ib_rule_literal_group_t *group;
+        size_t                   n;
+
+        candidate = (literal_candidate_t *)node->data;
+        if (IB_LIST_ELEMENTS(candidate->members) < 2) {
+            continue;
+        }
+
+        rc = create_literal_group(ib, mp, tmp, candidate,
+                                  index->num_groups, &group);
         if (rc != IB_OK) {
-            ib_log_error_tx(tx, "Error processing tx request line: %s",
-                            ib_status_to_string(rc));
-            IB_FTRACE_RET_STATUS(rc);
+            goto done;
         }
+        for (n = 0; n < group->num_rules; ++n) {
+            index->group[group->rules[n]] = group;
+        }
+        ++index->num_groups;
     }
+    rc = IB_OK;
 
-    IB_FTRACE_RET_STATUS(IB_OK);
+done:
+    ib_mpool_destroy(tmp);
+    IB_FTRACE_RET_STATUS(rc);
 }
 
 /**
- * Initialize rule set objects.
+ * Find the rules of a phase which may change data, and those which may be
+ * evaluated by the rule worker pool.
  * @internal
  *
- * @param[in] ib Engine
+ * A rule may change data if it runs without data, starts a chain, or
+ * applies (in place) transformations outside of a literal group.  Rules
+ * which match change data as well, but that is only known at run time.
+ *
  * @param[in] mp Memory pool to use for allocations
- * @param[in,out] rule_engine Rule engine
+ * @param[in] rule_list Phase rule list
+ * @param[in,out] index Phase dependency index
  *
  * @returns Status code
  */
-static ib_status_t init_ruleset(ib_engine_t *ib,
-                                ib_mpool_t *mp,
-                                ib_rule_engine_t *rule_engine)
+static ib_status_t classify_phase_rules(ib_mpool_t *mp,
+                                        const ib_list_t *rule_list,
+                                        ib_rule_phase_index_t *index)
 {
     IB_FTRACE_INIT();
-    ib_status_t rc;
-    ib_num_t    phase_num;
+    const ib_list_node_t *node;
+    const ib_list_node_t *tnode;
+    size_t                rule_num = 0;
 
-    /* Initialize the phase rules */
-    for (phase_num = (ib_num_t)PHASE_NONE;
-         phase_num < (ib_num_t)IB_RULE_PHASE_COUNT;
-         ++phase_num)
-    {
-        ib_ruleset_phase_t *ruleset_phase =
-            &(rule_engine->ruleset.phases[phase_num]);
-        ruleset_phase->phase_num = (ib_rule_phase_t)phase_num;
-        rc = find_phase_meta(phase_num, &(ruleset_phase->phase_meta));
-        if (rc != IB_OK) {
-            ib_log_error(ib,
-                         "Rule set initialization: "
-                         "failed to find phase meta data: %s",
-                         rc);
-            IB_FTRACE_RET_STATUS(rc);
+    index->modifies = (uint8_t *)ib_mpool_calloc(mp, 1, index->num_rules);
+    index->parallel = (uint8_t *)ib_mpool_calloc(mp, 1, index->num_rules);
+    if ( (index->modifies == NULL) || (index->parallel == NULL) ) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    IB_LIST_LOOP_CONST(rule_list, node) {
+        const ib_rule_t          *rule = (const ib_rule_t *)node->data;
+        const ib_operator_inst_t *opinst = rule->opinst;
+        ib_bool_t                 has_tfns = IB_FALSE;
+        size_t                    num = rule_num++;
+
+        IB_LIST_LOOP_CONST(rule->target_fields, tnode) {
+            const ib_rule_target_t *target =
+                (const ib_rule_target_t *)tnode->data;
+
+            if ( (target->tfn_list != NULL) &&
+                 (IB_LIST_ELEMENTS(target->tfn_list) != 0) )
+            {
+                has_tfns = IB_TRUE;
+            }
         }
 
-        rc = ib_list_create(&(ruleset_phase->rule_list), mp);
-        if (rc != IB_OK) {
-            ib_log_error(ib,
-                         "Rule set initialization: "
-                         "failed to create phase ruleset list: %s",
-                         rc);
-            IB_FTRACE_RET_STATUS(rc);
+        if ( (index->always[num] != 0) ||
+             (rule->chained_rule != NULL) ||
+             ( (has_tfns == IB_TRUE) && (index->group[num] == NULL) ) )
+        {
+            index->modifies[num] = 1;
+            continue;
+        }
+
+        /* Workers see a snapshot of the data; they can't expand or
+         * transform it. */
+        if ( (index->group[num] == NULL) &&
+             (has_tfns == IB_FALSE) &&
+             ((opinst->op->flags & IB_OP_FLAG_PARALLEL) != 0) &&
+             ((opinst->flags & IB_OPINST_FLAG_EXPAND) == 0) )
+        {
+            index->parallel[num] = 1;
+            ++index->num_parallel;
         }
     }
+
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
 /**
- * Register rules callbacks
+ * Build the dependency index for a phase's rules.
  * @internal
  *
  * @param[in] ib Engine
  * @param[in] mp Memory pool to use for allocations
- * @param[in,out] rule_engine Rule engine
+ * @param[in] ruleset_phase Phase ruleset to index
+ * @param[in] plan Execution plan of @a ruleset_phase
+ * @param[out] pindex Address which the index (NULL if there are no
+ *             rules) is written
  *
  * @returns Status code
  */
-static ib_status_t register_callbacks(ib_engine_t *ib,
-                                      ib_mpool_t *mp,
-                                      ib_rule_engine_t *rule_engine)
+static ib_status_t build_phase_index(ib_engine_t *ib,
+                                     ib_mpool_t *mp,
+                                     const ib_ruleset_phase_t *ruleset_phase,
+                                     const ib_rule_phase_plan_t *plan,
+                                     ib_rule_phase_index_t **pindex)
 {
     IB_FTRACE_INIT();
-    const ib_rule_phase_meta_t *meta;
-    const char                 *hook_type = NULL;
-    ib_status_t                 rc = IB_OK;
+    ib_rule_phase_index_t *index;
+    ib_hash_t             *by_name;
+    ib_list_t             *names;
+    const ib_list_node_t  *node;
+    const ib_list_node_t  *tnode;
+    ib_rule_dep_field_t   *field;
+    size_t                 num_rules;
+    size_t                 rule_num;
+    size_t                 fnum;
+    ib_status_t            rc;
+
+    *pindex = NULL;
+    num_rules = IB_LIST_ELEMENTS(ruleset_phase->rule_list);
+    if (num_rules == 0) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
 
-    /* Register specific handlers for specific events, and a
-     * generic handler for the rest */
-    for (meta = rule_phase_meta; meta->phase_num != PHASE_INVALID; ++meta) {
-        if (meta->event == (ib_state_event_type_t) -1) {
+    index = (ib_rule_phase_index_t *)ib_mpool_calloc(mp, 1, sizeof(*index));
+    if (index == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    index->num_rules = num_rules;
+    index->always = (uint8_t *)ib_mpool_calloc(mp, 1, num_rules);
+    if (index->always == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    rc = ib_hash_create(&by_name, mp);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    rc = ib_list_create(&names, mp);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    /* First pass: find the distinct fields and count their rules */
+    rule_num = 0;
+    IB_LIST_LOOP_CONST(ruleset_phase->rule_list, node) {
+        const ib_rule_t *rule = (const ib_rule_t *)node->data;
+
+        if (rule_runs_without_data(rule) == IB_TRUE) {
+            index->always[rule_num++] = 1;
             continue;
         }
 
-        /* Non-phase rules all use the same callback */
-        switch (meta->is_stream) {
+        IB_LIST_LOOP_CONST(rule->target_fields, tnode) {
+            const ib_rule_target_t *target =
+                (const ib_rule_target_t *)tnode->data;
 
-        case IB_FALSE :
-            rc = ib_hook_tx_register(
-                ib,
-                meta->event,
-                run_phase_rules,
-                (void *)meta);
-            hook_type = "tx";
-            break;
+            rc = ib_hash_get(by_name, &field, target->field_name);
+            if (rc == IB_ENOENT) {
+                const char *colon = strchr(target->field_name, ':');
 
-        case IB_TRUE :
-            switch (meta->hook_type) {
+                field = (ib_rule_dep_field_t *)
+                    ib_mpool_calloc(mp, 1, sizeof(*field));
+                if (field == NULL) {
+                    IB_FTRACE_RET_STATUS(IB_EALLOC);
+                }
+                field->name = target->field_name;
+                field->symbol = target->symbol;
+                if (colon != NULL) {
+                    size_t  blen = colon - target->field_name;
+                    char   *base = (char *)ib_mpool_alloc(mp, blen + 1);
+
+                    if (base == NULL) {
+                        IB_FTRACE_RET_STATUS(IB_EALLOC);
+                    }
+                    memcpy(base, target->field_name, blen);
+                    base[blen] = '\0';
+                    field->base = base;
+
+                    /* Only an optimization; NULL once config is done */
+                    if (ib_engine_symbol(ib, base, blen,
+                                         &(field->base_symbol)) != IB_OK)
+                    {
+                        field->base_symbol = NULL;
+                    }
+                }
+                rc = ib_hash_set(by_name, target->field_name, field);
+                if (rc == IB_OK) {
+                    rc = ib_list_push(names, field);
+                }
+            }
+            if (rc != IB_OK) {
+                IB_FTRACE_RET_STATUS(rc);
+            }
 
-            case IB_STATE_HOOK_TX:
-                rc = ib_hook_tx_register(
-                    ib,
-                    meta->event,
-                    run_stream_tx_rules,
-                    (void *)meta);
-                hook_type = "stream-tx";
-                break;
+            /* The rule list is filled in below; num_rules is a bound */
+            ++field->num_rules;
+        }
+        ++rule_num;
+    }
 
-            case IB_STATE_HOOK_TXDATA:
-                rc = ib_hook_txdata_register(
-                    ib,
-                    meta->event,
-                    run_stream_txdata_rules,
-                    (void *)meta);
-                hook_type = "txdata";
-                break;
+    /* Lay the fields out in an array */
+    index->num_fields = IB_LIST_ELEMENTS(names);
+    if (index->num_fields != 0) {
+        index->fields = (ib_rule_dep_field_t *)
+            ib_mpool_alloc(mp, index->num_fields * sizeof(*index->fields));
+        if (index->fields == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+    }
+    fnum = 0;
+    IB_LIST_LOOP_CONST(names, node) {
+        field = &(index->fields[fnum]);
+        *field = *(const ib_rule_dep_field_t *)node->data;
+        field->rules = (size_t *)
+            ib_mpool_alloc(mp, field->num_rules * sizeof(*field->rules));
+        if (field->rules == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+        field->num_rules = 0;
+        rc = ib_hash_set(by_name, field->name, field);
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        ++fnum;
+    }
 
-            case IB_STATE_HOOK_HEADER:
-                rc = ib_hook_parsed_header_data_register(
-                    ib,
-                    meta->event,
-                    run_stream_header_rules,
-                    (void *)meta);
-                hook_type = "header";
-                break;
+    /* Second pass: record which rules use each field */
+    rule_num = 0;
+    IB_LIST_LOOP_CONST(ruleset_phase->rule_list, node) {
+        const ib_rule_t *rule = (const ib_rule_t *)node->data;
 
-            default:
-                ib_log_error(ib,
-                             "Unknown hook registration type %d for "
-                             "phase %d/%d/%s",
-                             meta->phase_num, meta->event, meta->name);
-                IB_FTRACE_RET_STATUS(IB_EINVAL);
+        if (index->always[rule_num] == 0) {
+            IB_LIST_LOOP_CONST(rule->target_fields, tnode) {
+                const ib_rule_target_t *target =
+                    (const ib_rule_target_t *)tnode->data;
+
+                rc = ib_hash_get(by_name, &field, target->field_name);
+                if (rc != IB_OK) {
+                    IB_FTRACE_RET_STATUS(rc);
+                }
+
+                /* A rule may name the same field more than once */
+                if ( (field->num_rules == 0) ||
+                     (field->rules[field->num_rules - 1] != rule_num) )
+                {
+                    field->rules[field->num_rules++] = rule_num;
+                }
             }
-            break;
+        }
+        ++rule_num;
+    }
 
-        default:
-            assert(0 && "Invalid bool for is_stream");
-            break;
+    /* Group the literal rules which share a target */
+    rc = build_literal_groups(ib, mp, ruleset_phase->rule_list,
+                              plan, index);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    rc = classify_phase_rules(mp, ruleset_phase->rule_list, index);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    ib_log_debug(ib, "Indexed %zd phase %d/%s rules by %zd target fields, "
+                 "%zd literal groups, %zd parallel rules",
+                 num_rules, ruleset_phase->phase_num,
+                 ruleset_phase->phase_meta->name, index->num_fields,
+                 index->num_groups, index->num_parallel);
+    *pindex = index;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_rule_engine_ctx_close(ib_engine_t *ib,
+                                     ib_context_t *ctx)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+    ib_num_t    phase_num;
+
+    assert(ib != NULL);
+    assert(ctx != NULL);
+    assert(ctx->rules != NULL);
+
+    for (phase_num = (ib_num_t)PHASE_NONE;
+         phase_num < (ib_num_t)IB_RULE_PHASE_COUNT;
+         ++phase_num)
+    {
+        ib_ruleset_phase_t *ruleset_phase =
+            &(ctx->rules->ruleset.phases[phase_num]);
 
+        if (ruleset_phase->phase_meta == NULL) {
+            continue;
         }
 
-        /* OK */
+        rc = build_phase_plan(ctx->mp, ruleset_phase->rule_list,
+                              &(ruleset_phase->plan));
         if (rc != IB_OK) {
             ib_log_error(ib,
-                         "Hook %s registration for phase %d/%d/%s returned %s",
-                         hook_type, meta->phase_num, meta->event, meta->name,
-                         ib_status_to_string(rc));
+                         "Rule engine failed to compile phase %d rules: %s",
+                         (int)phase_num, ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+
+        /* Stream rules inspect data, not fields */
+        if (ruleset_phase->phase_meta->is_stream == IB_TRUE) {
+            continue;
+        }
+
+        rc = build_phase_index(ib, ctx->mp, ruleset_phase,
+                               ruleset_phase->plan, &(ruleset_phase->index));
+        if (rc != IB_OK) {
+            ib_log_error(ib,
+                         "Rule engine failed to index phase %d rules: %s",
+                         (int)phase_num, ib_status_to_string(rc));
             IB_FTRACE_RET_STATUS(rc);
         }
     }
@@ -1488,66 +3337,43 @@ static ib_status_t register_callbacks(ib_engine_t *ib,
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
-/**
- * Initialize a rule engine object.
- * @internal
- *
- * @param[in] ib Engine
- * @param[in,out] mp Memory pool to use for allocations
- * @param[out] p_rule_engine Pointer to new rule engine object
- *
- * @returns Status code
- */
-static ib_status_t create_rule_engine(ib_engine_t *ib,
-                                      ib_mpool_t *mp,
-                                      ib_rule_engine_t **p_rule_engine)
+ib_status_t ib_rule_engine_profile_enable(ib_engine_t *ib,
+                                          ib_num_t interval)
 {
     IB_FTRACE_INIT();
-    ib_rule_engine_t *rule_engine;
-    ib_status_t       rc;
+    ib_status_t rc;
 
-    /* Create the rule object */
-    rule_engine =
-        (ib_rule_engine_t *)ib_mpool_calloc(mp, 1, sizeof(*rule_engine));
-    if (rule_engine == NULL) {
-        ib_log_error(ib,
-                     "Rule engine failed to allocate rule engine object");
-        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    if (ib->rules->profile != NULL) {
+        IB_FTRACE_RET_STATUS(IB_OK);
     }
 
-    /* Create the rule list */
-    rc = ib_list_create(&(rule_engine->rule_list), mp);
+    rc = ib_rule_profile_create(ib, ib->rules->rule_list, interval,
+                                &(ib->rules->profile));
     if (rc != IB_OK) {
         ib_log_error(ib,
-                     "Rule engine failed to initialize rule list: %s",
+                     "Rule engine failed to create rule profiler: %s",
                      ib_status_to_string(rc));
         IB_FTRACE_RET_STATUS(rc);
     }
 
-    *p_rule_engine = rule_engine;
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
-ib_status_t ib_rule_engine_init(ib_engine_t *ib,
-                                ib_module_t *mod)
+ib_status_t ib_rule_engine_workers_enable(ib_engine_t *ib,
+                                          ib_num_t num_threads)
 {
     IB_FTRACE_INIT();
     ib_status_t rc;
 
-    /* Create the rule engine object */
-    rc = create_rule_engine(ib, ib->mp, &(ib->rules));
-    if (rc != IB_OK) {
-        ib_log_error(ib,
-                     "Rule engine failed to create rule engine: %s",
-                     ib_status_to_string(rc));
-        IB_FTRACE_RET_STATUS(rc);
+    if ( (ib->rules->workers != NULL) || (num_threads <= 0) ) {
+        IB_FTRACE_RET_STATUS(IB_OK);
     }
 
-    /* Register the rule callbacks */
-    rc = register_callbacks(ib, ib->mp, ib->rules);
+    rc = ib_rule_workers_create(ib, (size_t)num_threads,
+                                &(ib->rules->workers));
     if (rc != IB_OK) {
         ib_log_error(ib,
-                     "Rule engine failed to register phase callbacks: %s",
+                     "Rule engine failed to create rule workers: %s",
                      ib_status_to_string(rc));
         IB_FTRACE_RET_STATUS(rc);
     }
@@ -1555,37 +3381,32 @@ ib_status_t ib_rule_engine_init(ib_engine_t *ib,
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
-ib_status_t ib_rule_engine_ctx_init(ib_engine_t *ib,
-                                    ib_module_t *mod,
-                                    ib_context_t *ctx)
+void ib_rule_engine_fini(ib_engine_t *ib)
 {
     IB_FTRACE_INIT();
-    ib_status_t rc;
+    ib_rule_profile_t *profile;
+    ib_rule_workers_t *workers;
 
-    /* If the rules are already initialized, do nothing */
-    if (ctx->rules != NULL) {
-        IB_FTRACE_RET_STATUS(IB_OK);
+    if (ib->rules == NULL) {
+        IB_FTRACE_RET_VOID();
     }
 
-    /* Create the rule engine object */
-    rc = create_rule_engine(ib, ctx->mp, &(ctx->rules));
-    if (rc != IB_OK) {
-        ib_log_error(ib,
-                     "Rule engine failed to initialize context rules: %s",
-                     ib_status_to_string(rc));
-        IB_FTRACE_RET_STATUS(rc);
+    workers = ib->rules->workers;
+    if (workers != NULL) {
+        ib->rules->workers = NULL;
+        ib_rule_workers_destroy(workers);
     }
 
-    /* Initialize the rule sets */
-    rc = init_ruleset(ib, ctx->mp, ctx->rules);
-    if (rc != IB_OK) {
-        ib_log_error(ib,
-                     "Rule engine failed to initialize phase ruleset: %s",
-                     ib_status_to_string(rc));
-        IB_FTRACE_RET_STATUS(rc);
+    profile = ib->rules->profile;
+    if (profile != NULL) {
+        ib->rules->profile = NULL;
+        ib_rule_profile_report(profile, "shutdown");
+        ib_rule_profile_destroy(profile);
     }
 
-    IB_FTRACE_RET_STATUS(IB_OK);
+    ib_lock_destroy(&(ib->rules->plan_lock));
+
+    IB_FTRACE_RET_VOID();
 }
 
 ib_mpool_t *ib_rule_mpool(ib_engine_t *ib)
@@ -1978,6 +3799,15 @@ ib_status_t ib_rule_register(ib_engine_t *ib,
                      ib_context_full_get(ctx));
     }
 
+    /* Add it to the engine-wide list; the position is its profile index */
+    rule->profile_index = IB_LIST_ELEMENTS(ib->rules->rule_list);
+    rc = ib_list_push(ib->rules->rule_list, (void *)rule);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to add rule %s to engine rule list: %s",
+                     rule->meta.id, ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
     /* Enable & validate this rule */
     rule->flags |= IB_RULE_FLAGS_RUNABLE;
 
@@ -2074,6 +3904,17 @@ ib_status_t DLL_PUBLIC ib_rule_create_target(ib_engine_t *ib,
         IB_FTRACE_RET_STATUS(IB_EALLOC);
     }
 
+    /* Intern the name; targets created after configuration look their
+     * field up by name. */
+    rc = ib_engine_symbol(ib, name, strlen(name), &((*target)->symbol));
+    if (rc == IB_EALLOC) {
+        ib_log_error(ib, "Error interning target field name '%s'", name);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    else if (rc != IB_OK) {
+        (*target)->symbol = NULL;
+    }
+
     /* Create the field transformation list */
     rc = ib_list_create(&((*target)->tfn_list), ib_rule_mpool(ib));
     if (rc != IB_OK) {
@@ -0,0 +1,367 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; Rule Profiler
+ *
+ * Collects per-rule execution statistics.  Each thread that executes rules
+ * gets its own block of counters from a per-thread statistics registry
+ * (see ironbee/tstats.h), so the hot path does no locking and no shared
+ * writes; the blocks are summed when a report is generated.
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include "ironbee_config_auto.h"
+
+#include <ironbee/rule_engine.h>
+#include <ironbee/operator.h>
+#include <ironbee/clock.h>
+#include <ironbee/lock.h>
+#include <ironbee/debug.h>
+#include <ironbee/mpool.h>
+#include <ironbee/tstats.h>
+
+#include "ironbee_private.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Number of rules listed in a report */
+#define PROFILE_REPORT_RULES   20
+
+/** Size of the buffer used to format a histogram */
+#define PROFILE_HIST_BUF_LEN   (IB_TSTATS_BUCKETS * 24)
+
+/**
+ * Counters for a single rule.
+ *
+ * A thread's counter block is an array of these, by profile index.
+ */
+typedef struct {
+    uint64_t          matches;            /**< Number of true results */
+    ib_tstats_hist_t  time;               /**< Executions and latency */
+} profile_counters_t;
+
+/**
+ * Aggregated counters for a report.
+ */
+typedef struct {
+    const char         *name;             /**< Rule ID or operator name */
+    const char         *op_name;          /**< Operator name */
+    const ib_operator_t *op;              /**< Operator */
+    profile_counters_t  c;                /**< Aggregated counters */
+} profile_agg_t;
+
+/**
+ * Rule profiler; typedef in ironbee/rule_engine.h
+ */
+struct ib_rule_profile_t {
+    ib_engine_t        *ib;               /**< Engine */
+    const ib_rule_t   **rules;            /**< Rules, by profile index */
+    size_t              num_rules;        /**< Number of rules */
+    uint64_t            interval_ns;      /**< Report interval (0: never) */
+    uint64_t            started_ns;       /**< Time profiler was created */
+    volatile uint64_t   next_report_ns;   /**< Time of next report */
+    ib_lock_t           lock;             /**< Protects next_report_ns */
+    ib_tstats_t        *stats;            /**< Per-thread counter blocks */
+};
+
+/**
+ * Add one set of counters to another.
+ * @internal
+ *
+ * @param[in,out] dst Destination counters
+ * @param[in] src Source counters
+ */
+static void profile_counters_add(profile_counters_t *dst,
+                                 const profile_counters_t *src)
+{
+    dst->matches += src->matches;
+    ib_tstats_hist_add(&dst->time, &src->time);
+}
+
+/**
+ * Report aggregation state; callback data for profile_sum_thread().
+ */
+typedef struct {
+    const ib_rule_profile_t *profile;     /**< Rule profiler */
+    profile_agg_t           *rule_agg;    /**< Aggregates, by profile index */
+} profile_sum_t;
+
+/**
+ * Add a thread's counters to the report aggregates.
+ * @internal
+ *
+ * @param[in] block Thread's counter block
+ * @param[in] cbdata Report aggregation state (profile_sum_t)
+ */
+static void profile_sum_thread(const void *block, void *cbdata)
+{
+    const profile_counters_t *counters = (const profile_counters_t *)block;
+    profile_sum_t            *sum = (profile_sum_t *)cbdata;
+    size_t                    n;
+
+    for (n = 0; n < sum->profile->num_rules; ++n) {
+        profile_counters_add(&sum->rule_agg[n].c, &counters[n]);
+    }
+}
+
+/**
+ * qsort() comparison: order by cumulative time, largest first.
+ * @internal
+ */
+static int profile_agg_cmp(const void *a, const void *b)
+{
+    const profile_agg_t *pa = (const profile_agg_t *)a;
+    const profile_agg_t *pb = (const profile_agg_t *)b;
+
+    if (pa->c.time.total_ns == pb->c.time.total_ns) {
+        return 0;
+    }
+    return (pa->c.time.total_ns > pb->c.time.total_ns) ? -1 : 1;
+}
+
+/**
+ * Log one line of a report.
+ * @internal
+ *
+ * @param[in] ib Engine
+ * @param[in] kind "rule" or "operator"
+ * @param[in] agg Aggregated counters
+ */
+static void profile_log_agg(ib_engine_t *ib,
+                            const char *kind,
+                            const profile_agg_t *agg)
+{
+    char hist[PROFILE_HIST_BUF_LEN];
+    const profile_counters_t *c = &agg->c;
+    const ib_tstats_hist_t   *t = &c->time;
+
+    ib_tstats_hist_format(t, hist, sizeof(hist));
+    ib_log_info(ib,
+                "Rule profile: %s %s op=%s execs=%" PRIu64
+                " matches=%" PRIu64 " total=%" PRIu64 "us"
+                " avg=%" PRIu64 "ns max=%" PRIu64 "ns"
+                " p50<=%" PRIu64 "ns p99<=%" PRIu64 "ns hist=[%s]",
+                kind, agg->name, agg->op_name,
+                t->count, c->matches, t->total_ns / 1000,
+                t->total_ns / t->count, t->max_ns,
+                ib_tstats_hist_percentile(t, 50),
+                ib_tstats_hist_percentile(t, 99),
+                hist);
+}
+
+ib_status_t ib_rule_profile_create(ib_engine_t *ib,
+                                   ib_list_t *rules,
+                                   ib_num_t interval,
+                                   ib_rule_profile_t **pprofile)
+{
+    IB_FTRACE_INIT();
+    assert(ib != NULL);
+    assert(rules != NULL);
+    assert(pprofile != NULL);
+
+    ib_mpool_t        *mp = ib_engine_pool_main_get(ib);
+    ib_rule_profile_t *profile;
+    ib_list_node_t    *node;
+    ib_status_t        rc;
+    size_t             n = 0;
+
+    profile = (ib_rule_profile_t *)ib_mpool_calloc(mp, 1, sizeof(*profile));
+    if (profile == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    profile->ib = ib;
+    profile->num_rules = IB_LIST_ELEMENTS(rules);
+    profile->rules = (const ib_rule_t **)
+        ib_mpool_calloc(mp, profile->num_rules + 1, sizeof(ib_rule_t *));
+    if (profile->rules == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    IB_LIST_LOOP(rules, node) {
+        const ib_rule_t *rule = (const ib_rule_t *)node->data;
+        assert(rule->profile_index == n);
+        profile->rules[n++] = rule;
+    }
+
+    rc = ib_lock_init(&profile->lock);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    /* One spare entry, as there may be no rules. */
+    rc = ib_tstats_create(&profile->stats,
+                          (profile->num_rules + 1) *
+                          sizeof(profile_counters_t));
+    if (rc != IB_OK) {
+        ib_lock_destroy(&profile->lock);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    profile->started_ns = ib_clock_get_time_ns();
+    profile->interval_ns = (uint64_t)interval * 1000000000;
+    profile->next_report_ns = profile->started_ns + profile->interval_ns;
+
+    ib_log_debug(ib, "Rule profiling enabled for %zu rules, interval %ds",
+                 profile->num_rules, (int)interval);
+
+    *pprofile = profile;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+void ib_rule_profile_record(ib_rule_profile_t *profile,
+                            const ib_rule_t *rule,
+                            ib_num_t result,
+                            uint64_t start_ns,
+                            uint64_t end_ns)
+{
+    profile_counters_t *counters;
+    profile_counters_t *c;
+
+    /* Rules registered after the profiler was created aren't tracked. */
+    if (rule->profile_index >= profile->num_rules) {
+        return;
+    }
+    counters = (profile_counters_t *)ib_tstats_block(profile->stats);
+    if (counters == NULL) {
+        return;
+    }
+
+    c = &counters[rule->profile_index];
+    if (result != 0) {
+        ++c->matches;
+    }
+    ib_tstats_hist_record(&c->time, end_ns - start_ns);
+
+    /* Periodic report; only one thread wins the race for it. */
+    if ( (profile->interval_ns != 0) && (end_ns >= profile->next_report_ns) ) {
+        ib_bool_t report = IB_FALSE;
+
+        ib_lock_lock(&profile->lock);
+        if (end_ns >= profile->next_report_ns) {
+            profile->next_report_ns = end_ns + profile->interval_ns;
+            report = IB_TRUE;
+        }
+        ib_lock_unlock(&profile->lock);
+
+        if (report == IB_TRUE) {
+            ib_rule_profile_report(profile, "periodic");
+        }
+    }
+}
+
+void ib_rule_profile_report(ib_rule_profile_t *profile,
+                            const char *label)
+{
+    IB_FTRACE_INIT();
+    assert(profile != NULL);
+    assert(label != NULL);
+
+    ib_engine_t      *ib = profile->ib;
+    profile_agg_t    *rule_agg;
+    profile_agg_t    *op_agg;
+    profile_sum_t     sum;
+    size_t            num_ops = 0;
+    size_t            num_active = 0;
+    uint64_t          execs = 0;
+    uint64_t          total_ns = 0;
+    size_t            n;
+
+    rule_agg = (profile_agg_t *)calloc(profile->num_rules + 1,
+                                       sizeof(*rule_agg));
+    op_agg = (profile_agg_t *)calloc(profile->num_rules + 1,
+                                     sizeof(*op_agg));
+    if ( (rule_agg == NULL) || (op_agg == NULL) ) {
+        ib_log_error(ib, "Rule profile: failed to allocate report buffers");
+        free(rule_agg);
+        free(op_agg);
+        IB_FTRACE_RET_VOID();
+    }
+
+    /* Sum the per-thread counters for each rule. */
+    sum.profile = profile;
+    sum.rule_agg = rule_agg;
+    ib_tstats_foreach(profile->stats, profile_sum_thread, &sum);
+
+    /* Fill in names and sum by operator. */
+    for (n = 0; n < profile->num_rules; ++n) {
+        const ib_rule_t     *rule = profile->rules[n];
+        const ib_operator_t *op = rule->opinst->op;
+        profile_agg_t       *agg = &rule_agg[n];
+        size_t               o;
+
+        agg->name = (rule->meta.id != NULL) ? rule->meta.id : "-";
+        agg->op_name = op->name;
+        agg->op = op;
+        if (agg->c.time.count == 0) {
+            continue;
+        }
+        ++num_active;
+        execs += agg->c.time.count;
+        total_ns += agg->c.time.total_ns;
+
+        for (o = 0; o < num_ops; ++o) {
+            if (op_agg[o].op == op) {
+                break;
+            }
+        }
+        if (o == num_ops) {
+            op_agg[o].name = op->name;
+            op_agg[o].op_name = op->name;
+            op_agg[o].op = op;
+            ++num_ops;
+        }
+        profile_counters_add(&op_agg[o].c, &agg->c);
+    }
+
+    ib_log_info(ib,
+                "Rule profile (%s): %zu of %zu rules executed, "
+                "%" PRIu64 " executions, %" PRIu64 "us in %" PRIu64 "s",
+                label, num_active, profile->num_rules, execs,
+                total_ns / 1000,
+                (ib_clock_get_time_ns() - profile->started_ns) / 1000000000);
+
+    /* Most expensive rules first. */
+    qsort(rule_agg, profile->num_rules, sizeof(*rule_agg), profile_agg_cmp);
+    for (n = 0; (n < num_active) && (n < PROFILE_REPORT_RULES); ++n) {
+        profile_log_agg(ib, "rule", &rule_agg[n]);
+    }
+
+    qsort(op_agg, num_ops, sizeof(*op_agg), profile_agg_cmp);
+    for (n = 0; n < num_ops; ++n) {
+        profile_log_agg(ib, "operator", &op_agg[n]);
+    }
+
+    free(rule_agg);
+    free(op_agg);
+    IB_FTRACE_RET_VOID();
+}
+
+void ib_rule_profile_destroy(ib_rule_profile_t *profile)
+{
+    IB_FTRACE_INIT();
+    assert(profile != NULL);
+
+    ib_tstats_destroy(profile->stats);
+    profile->stats = NULL;
+    ib_lock_destroy(&profile->lock);
+
+    IB_FTRACE_RET_VOID();
+}
@@ -0,0 +1,322 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; Rule Worker Pool
+ *
+ * A fixed set of threads which evaluate batches of rules on behalf of
+ * request threads.  Any number of request threads may submit batches at
+ * once; batches are queued and their items are handed out one at a time to
+ * whichever thread is free.  The submitting thread works on its own batch
+ * too, so a batch completes even if every worker is busy with others.
+ *
+ * Each item is run with a slot number: worker threads use their index and
+ * the submitting thread uses the number of workers.  Within one batch no
+ * two items run concurrently in the same slot, so callers may keep per-slot
+ * scratch state in the batch's callback data.
+ *
+ * Items are expected to be expensive (a rule operator over its targets),
+ * so a single mutex guards the queue and the item counters.
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include "ironbee_config_auto.h"
+
+#include <ironbee/rule_engine.h>
+#include <ironbee/debug.h>
+
+#include "ironbee_private.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+/**
+ * A batch of work submitted by ib_rule_workers_run().
+ *
+ * Lives on the submitting thread's stack.
+ */
+typedef struct rule_batch_t rule_batch_t;
+struct rule_batch_t {
+    ib_rule_work_fn_t   fn;               /**< Function to run per item */
+    void               *cbdata;           /**< Callback data for fn */
+    size_t              num_items;        /**< Number of items */
+    size_t              next_item;        /**< Next item to hand out */
+    size_t              done_items;       /**< Number of items completed */
+    pthread_cond_t      done_cond;        /**< Signaled when batch is done */
+    rule_batch_t       *next;             /**< Next batch in queue */
+};
+
+/**
+ * Worker thread start data.
+ */
+typedef struct {
+    ib_rule_workers_t  *workers;          /**< Worker pool */
+    size_t              slot;             /**< Thread's slot number */
+} rule_worker_t;
+
+/**
+ * Rule worker pool.
+ */
+struct ib_rule_workers_t {
+    ib_engine_t        *ib;               /**< Engine */
+    pthread_mutex_t     lock;             /**< Protects everything below */
+    pthread_cond_t      work_cond;        /**< Signaled when work queued */
+    rule_batch_t       *head;             /**< First batch with items left */
+    rule_batch_t       *tail;             /**< Last batch in queue */
+    int                 shutdown;         /**< Set to stop the threads */
+    pthread_t          *threads;          /**< Worker threads */
+    rule_worker_t      *worker;           /**< Per thread start data */
+    size_t              num_threads;      /**< Number of started threads */
+};
+
+/**
+ * Hand out the next item of the batch at the head of the queue.
+ * @internal
+ *
+ * Must be called with the pool lock held.  The batch is dequeued when its
+ * last item is handed out.
+ *
+ * @param[in,out] workers Worker pool
+ * @param[in] batch Batch to take from
+ *
+ * @returns Item number
+ */
+static size_t take_item(ib_rule_workers_t *workers,
+                        rule_batch_t *batch)
+{
+    size_t item = batch->next_item++;
+
+    if (batch->next_item == batch->num_items) {
+        rule_batch_t **pb = &(workers->head);
+        rule_batch_t  *prev = NULL;
+
+        while (*pb != batch) {
+            prev = *pb;
+            pb = &((*pb)->next);
+        }
+        *pb = batch->next;
+        if (workers->tail == batch) {
+            workers->tail = prev;
+        }
+    }
+    return item;
+}
+
+/**
+ * Mark an item of a batch complete.
+ * @internal
+ *
+ * Must be called with the pool lock held.
+ *
+ * @param[in,out] batch Batch
+ */
+static void finish_item(rule_batch_t *batch)
+{
+    ++batch->done_items;
+    if (batch->done_items == batch->num_items) {
+        pthread_cond_signal(&(batch->done_cond));
+    }
+}
+
+/**
+ * Worker thread main loop.
+ * @internal
+ *
+ * @param[in] arg Worker thread start data
+ *
+ * @returns NULL
+ */
+static void *worker_main(void *arg)
+{
+    const rule_worker_t *worker = (const rule_worker_t *)arg;
+    ib_rule_workers_t *workers = worker->workers;
+
+    pthread_mutex_lock(&(workers->lock));
+    for (;;) {
+        rule_batch_t *batch;
+        size_t        item;
+
+        while ( (workers->shutdown == 0) && (workers->head == NULL) ) {
+            pthread_cond_wait(&(workers->work_cond), &(workers->lock));
+        }
+        if (workers->shutdown != 0) {
+            break;
+        }
+
+        batch = workers->head;
+        item = take_item(workers, batch);
+        pthread_mutex_unlock(&(workers->lock));
+
+        batch->fn(batch->cbdata, item, worker->slot);
+
+        pthread_mutex_lock(&(workers->lock));
+        finish_item(batch);
+    }
+    pthread_mutex_unlock(&(workers->lock));
+
+    return NULL;
+}
+
+ib_status_t ib_rule_workers_create(ib_engine_t *ib,
+                                   size_t num_threads,
+                                   ib_rule_workers_t **pworkers)
+{
+    IB_FTRACE_INIT();
+    ib_rule_workers_t *workers;
+    size_t             n;
+
+    assert(ib != NULL);
+    assert(pworkers != NULL);
+
+    workers = (ib_rule_workers_t *)calloc(1, sizeof(*workers));
+    if (workers == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    workers->ib = ib;
+    workers->threads = (pthread_t *)calloc(num_threads, sizeof(pthread_t));
+    workers->worker =
+        (rule_worker_t *)calloc(num_threads, sizeof(rule_worker_t));
+    if ( (workers->threads == NULL) || (workers->worker == NULL) ) {
+        free(workers->threads);
+        free(workers->worker);
+        free(workers);
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    if (pthread_mutex_init(&(workers->lock), NULL) != 0) {
+        free(workers->threads);
+        free(workers->worker);
+        free(workers);
+        IB_FTRACE_RET_STATUS(IB_EUNKNOWN);
+    }
+    if (pthread_cond_init(&(workers->work_cond), NULL) != 0) {
+        pthread_mutex_destroy(&(workers->lock));
+        free(workers->threads);
+        free(workers->worker);
+        free(workers);
+        IB_FTRACE_RET_STATUS(IB_EUNKNOWN);
+    }
+
+    for (n = 0; n < num_threads; ++n) {
+        workers->worker[n].workers = workers;
+        workers->worker[n].slot = n;
+        if (pthread_create(&(workers->threads[n]), NULL,
+                           worker_main, &(workers->worker[n])) != 0)
+        {
+            ib_log_error(ib, "Failed to start rule worker thread %zd", n);
+            ib_rule_workers_destroy(workers);
+            IB_FTRACE_RET_STATUS(IB_EUNKNOWN);
+        }
+        workers->num_threads = n + 1;
+    }
+
+    ib_log_debug(ib, "Started %zd rule worker threads", num_threads);
+    *pworkers = workers;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_rule_workers_run(ib_rule_workers_t *workers,
+                                size_t num_items,
+                                ib_rule_work_fn_t fn,
+                                void *cbdata)
+{
+    IB_FTRACE_INIT();
+    rule_batch_t batch;
+
+    assert(workers != NULL);
+    assert(fn != NULL);
+
+    if (num_items == 0) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    batch.fn = fn;
+    batch.cbdata = cbdata;
+    batch.num_items = num_items;
+    batch.next_item = 0;
+    batch.done_items = 0;
+    batch.next = NULL;
+    if (pthread_cond_init(&(batch.done_cond), NULL) != 0) {
+        IB_FTRACE_RET_STATUS(IB_EUNKNOWN);
+    }
+
+    /* Queue the batch */
+    pthread_mutex_lock(&(workers->lock));
+    if (workers->tail == NULL) {
+        workers->head = &batch;
+    }
+    else {
+        workers->tail->next = &batch;
+    }
+    workers->tail = &batch;
+    pthread_cond_broadcast(&(workers->work_cond));
+
+    /* Work on it from this thread too */
+    while (batch.next_item < batch.num_items) {
+        size_t item = take_item(workers, &batch);
+
+        pthread_mutex_unlock(&(workers->lock));
+        fn(cbdata, item, workers->num_threads);
+        pthread_mutex_lock(&(workers->lock));
+        finish_item(&batch);
+    }
+
+    /* Wait for the items other threads took */
+    while (batch.done_items < batch.num_items) {
+        pthread_cond_wait(&(batch.done_cond), &(workers->lock));
+    }
+    pthread_mutex_unlock(&(workers->lock));
+
+    pthread_cond_destroy(&(batch.done_cond));
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+size_t ib_rule_workers_slots(const ib_rule_workers_t *workers)
+{
+    assert(workers != NULL);
+
+    return workers->num_threads + 1;
+}
+
+void ib_rule_workers_destroy(ib_rule_workers_t *workers)
+{
+    IB_FTRACE_INIT();
+    size_t n;
+
+    if (workers == NULL) {
+        IB_FTRACE_RET_VOID();
+    }
+
+    pthread_mutex_lock(&(workers->lock));
+    workers->shutdown = 1;
+    pthread_cond_broadcast(&(workers->work_cond));
+    pthread_mutex_unlock(&(workers->lock));
+
+    for (n = 0; n < workers->num_threads; ++n) {
+        pthread_join(workers->threads[n], NULL);
+    }
+
+    pthread_cond_destroy(&(workers->work_cond));
+    pthread_mutex_destroy(&(workers->lock));
+    free(workers->threads);
+    free(workers->worker);
+    free(workers);
+
+    IB_FTRACE_RET_VOID();
+}
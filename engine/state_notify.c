@@ -20,6 +20,8 @@
 #include <ironbee/state_notify.h>
 
 #include <ironbee/engine.h>
+#include <ironbee/core.h>
+#include <ironbee/debug.h>
 #include <ironbee/field.h>
 
 #include "ironbee_private.h"
@@ -266,6 +268,20 @@ static ib_status_t ib_state_notify_tx(ib_engine_t *ib,
     /* This transaction is now the current (for pipelined). */
     tx->conn->tx = tx;
 
+#ifdef IB_DEBUG
+    /* Ring trace this thread's work on the transaction if its context
+     * asks for it. */
+    if (tx->ctx != NULL) {
+        ib_core_cfg_t *corecfg;
+
+        rc = ib_context_module_config(tx->ctx, ib_core_module(),
+                                      (void *)&corecfg);
+        if (rc == IB_OK) {
+            ib_trace_ring_enable(corecfg->ftrace != 0);
+        }
+    }
+#endif
+
     CALL_TX_HOOKS(&rc, ib->hook[event], event, tx, ib, tx);
 
     if ((rc != IB_OK) || (tx->ctx == NULL)) {
@@ -317,6 +333,12 @@ ib_status_t ib_state_notify_cfg_started(ib_engine_t *ib)
         IB_FTRACE_RET_STATUS(rc);
     }
 
+    /* Expensive operator instances are created when configuration ends. */
+    rc = ib_operator_defer_start(ib);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
     /// @todo Create a temp mem pool???
     CALL_NULL_HOOKS(&rc, ib->hook[cfg_started_event], cfg_started_event, ib);
 
@@ -327,6 +349,18 @@ ib_status_t ib_state_notify_cfg_finished(ib_engine_t *ib)
 {
     IB_FTRACE_INIT();
     ib_status_t rc;
+    ib_core_cfg_t *corecfg;
+
+    /* Create the operator instances deferred while configuring. */
+    rc = ib_context_module_config(ib->ctx, ib_core_module(),
+                                  (void *)&corecfg);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    rc = ib_operator_defer_finish(ib, corecfg->rule_compile_workers);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
 
     /* Initialize (and close) the main configuration context. */
     rc = ib_context_close(ib->ctx);
@@ -337,6 +371,25 @@ ib_status_t ib_state_notify_cfg_finished(ib_engine_t *ib)
     /* Run the hooks. */
     CALL_NULL_HOOKS(&rc, ib->hook[cfg_finished_event], cfg_finished_event, ib);
 
+    /* Field names are shared read-only by transactions from here on. */
+    ib_symtab_freeze(ib->symbols);
+
+    /* Save what was compiled for the next start. */
+    if (ib->snapshot != NULL) {
+        size_t hits;
+        size_t misses;
+        ib_status_t snap_rc;
+
+        ib_snapshot_stats(ib->snapshot, &hits, &misses);
+        ib_log_debug(ib, "Compile cache: %zd hits, %zd misses",
+                     hits, misses);
+        snap_rc = ib_snapshot_commit(ib->snapshot, ib->cfg_hash);
+        if (snap_rc != IB_OK) {
+            ib_log_warning(ib, "Could not save compile cache: %s",
+                           ib_status_to_string(snap_rc));
+        }
+    }
+
     /* Destroy the temporary memory pool. */
     ib_engine_pool_temp_destroy(ib);
 
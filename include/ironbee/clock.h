@@ -94,6 +94,29 @@ ib_clock_type_t DLL_PUBLIC ib_clock_type(void);
  */
 ib_time_t DLL_PUBLIC ib_clock_get_time(void);
 
+/**
+ * Get a high resolution timestamp in nanoseconds.
+ *
+ * This is intended for measuring short intervals (i.e. profiling) and
+ * is not related to wall clock time.
+ *
+ * @note This is not monotonic on all platforms.
+ *
+ * @returns Timestamp in nanoseconds
+ */
+uint64_t DLL_PUBLIC ib_clock_get_time_ns(void);
+
+/**
+ * Get a low cost, low resolution timestamp in nanoseconds.
+ *
+ * Uses a coarse clock (i.e. CLOCK_MONOTONIC_COARSE) where available, which
+ * is cheaper to read but only as precise as the kernel tick.  Falls back to
+ * ib_clock_get_time_ns().
+ *
+ * @returns Timestamp in nanoseconds
+ */
+uint64_t DLL_PUBLIC ib_clock_get_time_ns_coarse(void);
+
 /** @} IronBeeUtilClock */
 
 #ifdef __cplusplus
@@ -90,6 +90,11 @@ struct ib_core_cfg_t {
     const char      *data;              /**< Active data provider key */
     const char      *module_base_path;  /**< Module base path. */
     const char      *rule_base_path;    /**< Rule base path. */
+    ib_num_t         rule_profile;      /**< Rule profiling enabled */
+    ib_num_t         rule_profile_interval; /**< Rule profile report secs */
+    ib_num_t         rule_workers;      /**< Rule worker threads (0=off) */
+    ib_num_t         rule_compile_workers; /**< Compile threads (-1=auto) */
+    ib_num_t         ftrace;            /**< Ring trace transactions */
 };
 
 
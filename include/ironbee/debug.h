@@ -28,6 +28,7 @@
 #include <ironbee/build.h>
 #include <ironbee/types.h>
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -41,10 +42,96 @@ extern "C" {
  *
  * Debugging support; e.g., tracing all function calls.
  *
+ * Function tracing has two backends.  By default every traced call and
+ * return is written as a line of text to the file given to
+ * ib_trace_init().  After ib_trace_ring_init(), calls and returns are
+ * instead recorded as fixed size binary events in a ring buffer per
+ * thread, only on threads which have enabled it with
+ * ib_trace_ring_enable(), and written out by ib_trace_ring_flush() for
+ * offline decoding (see ibtrace).
+ *
  * @{
  */
 
+/** Binary trace file magic. */
+#define IB_TRACE_RING_MAGIC       "IBFTRACE"
+
+/** Binary trace file version. */
+#define IB_TRACE_RING_VERSION     1
+
+/** Default number of events per thread ring. */
+#define IB_TRACE_RING_EVENTS      65536
+
+/** Set in ib_trace_event_t::site for a return event. */
+#define IB_TRACE_EVENT_RETURN     (UINT32_C(1) << 31)
+
+/**
+ * Binary trace event.
+ */
+typedef struct ib_trace_event_t ib_trace_event_t;
+struct ib_trace_event_t {
+    uint64_t           ns;            /**< Time (ib_clock_get_time_ns()) */
+    uint32_t           site;          /**< Site ID; IB_TRACE_EVENT_RETURN */
+    int32_t            value;         /**< Return value (truncated) */
+};
+
+/**
+ * Binary trace file header.
+ *
+ * A binary trace file is, in host byte order:
+ * - An ib_trace_file_header_t.
+ * - @c nsites site records: an ib_trace_file_site_t followed by
+ *   @c flen bytes of file name and @c nlen bytes of function name.
+ * - @c nthreads thread records: an ib_trace_file_thread_t followed by
+ *   @c nevents ib_trace_event_t, oldest first.
+ */
+typedef struct ib_trace_file_header_t ib_trace_file_header_t;
+struct ib_trace_file_header_t {
+    char               magic[8];      /**< IB_TRACE_RING_MAGIC */
+    uint32_t           version;       /**< IB_TRACE_RING_VERSION */
+    uint32_t           nsites;        /**< Number of site records */
+    uint32_t           nthreads;      /**< Number of thread records */
+    uint32_t           reserved;      /**< Zero */
+};
+
+/** Binary trace file site record. */
+typedef struct ib_trace_file_site_t ib_trace_file_site_t;
+struct ib_trace_file_site_t {
+    uint32_t           id;            /**< Site ID */
+    uint32_t           line;          /**< Source line */
+    uint32_t           flen;          /**< Length of file name */
+    uint32_t           nlen;          /**< Length of function name */
+};
+
+/** Binary trace file thread record. */
+typedef struct ib_trace_file_thread_t ib_trace_file_thread_t;
+struct ib_trace_file_thread_t {
+    uint64_t           thread;        /**< Thread number */
+    uint64_t           nevents;       /**< Number of events that follow */
+    uint64_t           dropped;       /**< Events overwritten in the ring */
+};
+
 #ifdef IB_DEBUG
+/**
+ * @internal
+ * Trace site; one per traced function, created by IB_FTRACE_INIT().
+ *
+ * The ID is assigned the first time the site is recorded to a ring.
+ */
+typedef struct ib_trace_site_t ib_trace_site_t;
+struct ib_trace_site_t {
+    const char        *file;          /**< Source file */
+    int                line;          /**< Source line */
+    const char        *func;          /**< Function name */
+    volatile uint32_t  id;            /**< Site ID (0 until recorded) */
+};
+
+/**
+ * @internal
+ * Non-zero once ib_trace_ring_init() has selected the ring backend.
+ */
+extern DLL_PUBLIC int ib_trace_ring_mode;
+
 /**
  * Initialize tracing system.
  *
@@ -148,6 +235,55 @@ void DLL_PUBLIC ib_trace_str(const char *file,
                              const char *msg,
                              const char *str);
 
+/**
+ * Switch function tracing to per-thread binary rings.
+ *
+ * Tracing stays off on each thread until it calls ib_trace_ring_enable().
+ * Calling this again only changes the output file.
+ *
+ * @param fn File ib_trace_ring_flush() writes to
+ * @param nevents Events per thread ring (rounded up to a power of 2)
+ */
+void DLL_PUBLIC ib_trace_ring_init(const char *fn, size_t nevents);
+
+/**
+ * Turn ring tracing on or off for the calling thread.
+ *
+ * Does nothing unless ib_trace_ring_init() has been called.
+ *
+ * @param on Non-zero to record calls made by this thread
+ */
+void DLL_PUBLIC ib_trace_ring_enable(int on);
+
+/**
+ * Write all thread rings and the site table to the trace file.
+ *
+ * Rings being written to while this runs may show a few torn events at
+ * their newest end.
+ *
+ * @returns
+ * - IB_OK on success (or if ring tracing is not in use).
+ * - IB_EOTHER if the file could not be written.
+ */
+ib_status_t DLL_PUBLIC ib_trace_ring_flush(void);
+
+/**
+ * @internal
+ * Record a call to a ring.
+ *
+ * @param site Trace site
+ */
+void DLL_PUBLIC ib_trace_enter(ib_trace_site_t *site);
+
+/**
+ * @internal
+ * Record a return to a ring.
+ *
+ * @param site Trace site
+ * @param value Returned value (truncated to 32 bits)
+ */
+void DLL_PUBLIC ib_trace_leave(ib_trace_site_t *site, int64_t value);
+
 /**
  * @internal
  * Current function name.
@@ -187,22 +323,44 @@ void DLL_PUBLIC ib_trace_str(const char *file,
  *
  */
 #define IB_FTRACE_INIT() \
+    static ib_trace_site_t __ib_ft_site__ = \
+        { __FILE__, __LINE__, IB_CURRENT_FUNCTION, 0 }; \
     const char *__ib_fname__ = IB_CURRENT_FUNCTION; \
-    ib_trace_msg(__FILE__, __LINE__, __ib_fname__, "called")
+    (ib_trace_ring_mode ? \
+        ib_trace_enter(&__ib_ft_site__) : \
+        ib_trace_msg(__FILE__, __LINE__, __ib_fname__, "called"))
+
+/**
+ * @internal
+ * Record a return to the ring if ring tracing is in use.
+ *
+ * Evaluates to non-zero if it was, in which case no text is traced.
+ *
+ * @param rv Return value
+ */
+#define IB_FTRACE_RING_LEAVE(rv) \
+    (ib_trace_ring_mode ? \
+        (ib_trace_leave(&__ib_ft_site__, (int64_t)(rv)), 1) : 0)
 
 /**
  * Logs a string message to the ftrace log.
  *
+ * Messages are not recorded by ring tracing.
+ *
  * @param msg String message
  */
 #define IB_FTRACE_MSG(msg) \
-    ib_trace_msg(__FILE__, __LINE__, __ib_fname__, (msg))
+    (ib_trace_ring_mode ? \
+        (void)0 : \
+        ib_trace_msg(__FILE__, __LINE__, __ib_fname__, (msg)))
 
 /**
  * Return wrapper for functions which do not return a value.
  */
 #define IB_FTRACE_RET_VOID() \
-    ib_trace_msg(__FILE__, __LINE__, __ib_fname__, "returned"); \
+    (IB_FTRACE_RING_LEAVE(0) ? \
+        (void)0 : \
+        ib_trace_msg(__FILE__, __LINE__, __ib_fname__, "returned")); \
     return
 
 /**
@@ -213,7 +371,9 @@ void DLL_PUBLIC ib_trace_str(const char *file,
 #define IB_FTRACE_RET_STATUS(rv) \
     do { \
         ib_status_t __ib_ft_rv = rv; \
-        if (__ib_ft_rv != IB_OK) { \
+        if (IB_FTRACE_RING_LEAVE(__ib_ft_rv)) { \
+        } \
+        else if (__ib_ft_rv != IB_OK) { \
             ib_trace_status(__FILE__, __LINE__, __ib_fname__, "returned error", __ib_ft_rv); \
         } \
         else { \
@@ -230,7 +390,9 @@ void DLL_PUBLIC ib_trace_str(const char *file,
 #define IB_FTRACE_RET_INT(rv) \
     do { \
         int __ib_ft_rv = rv; \
-        ib_trace_num(__FILE__, __LINE__, __ib_fname__, "returned", (intmax_t)__ib_ft_rv); \
+        if (!IB_FTRACE_RING_LEAVE(__ib_ft_rv)) { \
+            ib_trace_num(__FILE__, __LINE__, __ib_fname__, "returned", (intmax_t)__ib_ft_rv); \
+        } \
         return __ib_ft_rv; \
     } while(0)
 
@@ -242,7 +404,9 @@ void DLL_PUBLIC ib_trace_str(const char *file,
 #define IB_FTRACE_RET_UINT(rv) \
     do { \
         unsigned int __ib_ft_rv = rv; \
-        ib_trace_num(__FILE__, __LINE__, __ib_fname__, "returned", (uintmax_t)__ib_ft_rv); \
+        if (!IB_FTRACE_RING_LEAVE(__ib_ft_rv)) { \
+            ib_trace_num(__FILE__, __LINE__, __ib_fname__, "returned", (uintmax_t)__ib_ft_rv); \
+        } \
         return __ib_ft_rv; \
     } while(0)
 
@@ -254,7 +418,9 @@ void DLL_PUBLIC ib_trace_str(const char *file,
 #define IB_FTRACE_RET_SIZET(rv) \
     do { \
         size_t __ib_ft_rv = rv; \
-        ib_trace_num(__FILE__, __LINE__, __ib_fname__, "returned", (intmax_t)__ib_ft_rv); \
+        if (!IB_FTRACE_RING_LEAVE(__ib_ft_rv)) { \
+            ib_trace_num(__FILE__, __LINE__, __ib_fname__, "returned", (intmax_t)__ib_ft_rv); \
+        } \
         return __ib_ft_rv; \
     } while(0)
 
@@ -267,7 +433,9 @@ void DLL_PUBLIC ib_trace_str(const char *file,
 #define IB_FTRACE_RET_PTR(type,rv) \
     do { \
         type *__ib_ft_rv = rv; \
-        ib_trace_ptr(__FILE__, __LINE__, __ib_fname__, "returned", (void *)__ib_ft_rv); \
+        if (!IB_FTRACE_RING_LEAVE(0)) { \
+            ib_trace_ptr(__FILE__, __LINE__, __ib_fname__, "returned", (void *)__ib_ft_rv); \
+        } \
         return __ib_ft_rv; \
     } while(0)
 
@@ -279,7 +447,9 @@ void DLL_PUBLIC ib_trace_str(const char *file,
 #define IB_FTRACE_RET_STR(rv) \
     do { \
         char *__ib_ft_rv = rv; \
-        ib_trace_str(__FILE__, __LINE__, __ib_fname__, "returned", (const char *)__ib_ft_rv); \
+        if (!IB_FTRACE_RING_LEAVE(0)) { \
+            ib_trace_str(__FILE__, __LINE__, __ib_fname__, "returned", (const char *)__ib_ft_rv); \
+        } \
         return __ib_ft_rv; \
     } while(0)
 
@@ -291,7 +461,9 @@ void DLL_PUBLIC ib_trace_str(const char *file,
 #define IB_FTRACE_RET_CONSTSTR(rv) \
     do { \
         const char *__ib_ft_rv = rv; \
-        ib_trace_str(__FILE__, __LINE__, __ib_fname__, "returned", __ib_ft_rv); \
+        if (!IB_FTRACE_RING_LEAVE(0)) { \
+            ib_trace_str(__FILE__, __LINE__, __ib_fname__, "returned", __ib_ft_rv); \
+        } \
         return __ib_ft_rv; \
     } while(0)
 
@@ -303,6 +475,9 @@ void DLL_PUBLIC ib_trace_str(const char *file,
 #define ib_trace_unum(file,line,func,msg,unum)
 #define ib_trace_ptr(file,line,func,msg,ptr)
 #define ib_trace_str(file,line,func,msg,str)
+#define ib_trace_ring_init(fn,nevents)
+#define ib_trace_ring_enable(on)
+#define ib_trace_ring_flush() (IB_OK)
 
 #define IB_FTRACE_INIT(name)
 #define IB_FTRACE_MSG(msg)
@@ -32,9 +32,11 @@
 #include <ironbee/field.h>
 #include <ironbee/stream.h>
 #include <ironbee/clock.h>
+#include <ironbee/expand.h>
 #include <ironbee/parsed_content.h>
 #include <ironbee/engine_types.h>
 #include <ironbee/server.h>
+#include <ironbee/snapshot.h>
 
 #include <stdarg.h>
 
@@ -217,6 +219,59 @@ ib_mpool_t DLL_PUBLIC *ib_engine_pool_temp_get(ib_engine_t *ib);
  */
 void DLL_PUBLIC ib_engine_pool_temp_destroy(ib_engine_t *ib);
 
+/**
+ * Intern a field name in the engine symbol table.
+ *
+ * Names interned while configuring can be used to create and look up
+ * fields without copying or hashing the name (see ib_field_create_sym()
+ * and ib_data_get_sym()).  The table is frozen when configuration is
+ * finished; after that only names already in it are found.
+ *
+ * @param ib Engine handle
+ * @param name Name (need not be NUL terminated)
+ * @param nlen Length of @a name
+ * @param psym Address which symbol is written
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if configuration is finished and @a name is not interned.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_engine_symbol(ib_engine_t *ib,
+                                        const char *name,
+                                        size_t nlen,
+                                        const ib_symbol_t **psym);
+
+/**
+ * Open the engine's compile cache (the PcreCompileCache directive).
+ *
+ * Once open, modules can look up the results of expensive configuration
+ * work in the cache and add the results they compute (see
+ * ib_engine_snapshot_get()).  Only the pcre module uses it, for compiled
+ * patterns; the configuration itself is not cached.  The cache is
+ * written back when configuration is finished.  Only one snapshot may be
+ * opened per engine; it should be opened before the rules are configured.
+ *
+ * @param ib Engine handle
+ * @param path Snapshot file
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if a snapshot is already open.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_engine_snapshot_open(ib_engine_t *ib,
+                                               const char *path);
+
+/**
+ * Get the engine's compile cache.
+ *
+ * @param ib Engine handle
+ *
+ * @returns Snapshot, or NULL if none is open.
+ */
+ib_snapshot_t DLL_PUBLIC *ib_engine_snapshot_get(const ib_engine_t *ib);
+
 /**
  * Destroy an engine.
  *
@@ -585,6 +640,15 @@ ib_status_t DLL_PUBLIC ib_tx_create(ib_tx_t **ptx,
  */
 #define ib_tx_mark_nobody(tx) ib_tx_flags_set(tx, IB_TX_FREQ_NOBODY)
 
+/**
+ * Mark transaction as blocked.
+ *
+ * Rules of the remaining phases, except post-processing, are not run.
+ *
+ * @param tx Transaction structure
+ */
+#define ib_tx_mark_blocked(tx) ib_tx_flags_set(tx, IB_TX_FBLOCKED)
+
 /**
  * Destroy a transaction structure.
  *
@@ -1483,6 +1547,21 @@ ib_status_t DLL_PUBLIC ib_data_get_ex(ib_provider_inst_t *dpi,
                                       size_t nlen,
                                       ib_field_t **pf);
 
+/**
+ * Get a data field by interned name.
+ *
+ * Same as ib_data_get_ex() on the symbol's name, but without hashing it.
+ *
+ * @param dpi Data provider instance
+ * @param sym Name symbol (see ib_engine_symbol())
+ * @param pf Pointer where field is written if non-NULL
+ *
+ * @returns IB_OK on success or IB_ENOENT if the element is not found.
+ */
+ib_status_t DLL_PUBLIC ib_data_get_sym(ib_provider_inst_t *dpi,
+                                       const ib_symbol_t *sym,
+                                       ib_field_t **pf);
+
 /**
  * Get all data fields from a data provider instance.
  *
@@ -1645,6 +1724,25 @@ ib_status_t ib_data_remove_ex(ib_provider_inst_t *dpi,
                                size_t nlen,
                                ib_field_t **pf);
 
+/**
+ * Add to a numeric data field.
+ *
+ * For a "key:subkey" name where @a key is a dynamic field (e.g., a
+ * persistent collection) the field adjusts @a subkey itself, atomically
+ * if it supports that (see ib_field_adjust_ex()).
+ *
+ * @param dpi Data provider instance
+ * @param name Name
+ * @param nlen Length of @a name.
+ * @param adjval Value to add (may be negative)
+ *
+ * @returns Status code (IB_ENOENT if there is no such field)
+ */
+ib_status_t DLL_PUBLIC ib_data_set_relative_ex(ib_provider_inst_t *dpi,
+                                               const char *name,
+                                               size_t nlen,
+                                               intmax_t adjval);
+
 /**
  * Expand a string using fields from the data store.
  *
@@ -1687,6 +1785,46 @@ ib_status_t ib_data_expand_str_ex(ib_provider_inst_t *dpi,
                                   char **result,
                                   size_t *result_len);
 
+/**
+ * Compile a string into an expansion template for the data store.
+ *
+ * Templates are intended to be compiled once at configuration time and
+ * expanded with ib_data_expand_template() for each transaction.
+ *
+ * @sa ib_expand_compile()
+ *
+ * @param[in] mp Memory pool to allocate the template from
+ * @param[in] str String to compile (must outlive the template)
+ * @param[in] slen Length of string @a str
+ * @param[out] tmpl Compiled template
+ *
+ * @returns Status code
+ */
+ib_status_t DLL_PUBLIC ib_data_expand_compile(ib_mpool_t *mp,
+                                              const char *str,
+                                              size_t slen,
+                                              ib_expand_template_t **tmpl);
+
+/**
+ * Expand a compiled template using fields from the data store.
+ *
+ * @sa ib_data_expand_str_ex(), ib_expand_template_exec()
+ *
+ * @param[in] dpi Data provider instance
+ * @param[in] tmpl Template created by ib_data_expand_compile()
+ * @param[in] nul Append NUL byte to @a result?
+ * @param[out] result Pointer to the expanded string.
+ * @param[out] result_len Length of @a result.
+ *
+ * @returns Status code
+ */
+ib_status_t DLL_PUBLIC ib_data_expand_template(
+    ib_provider_inst_t *dpi,
+    const ib_expand_template_t *tmpl,
+    ib_bool_t nul,
+    char **result,
+    size_t *result_len);
+
 /**
  * Determine if a string would be expanded by ib_data_expand_str().
  *
@@ -1728,6 +1866,22 @@ ib_status_t ib_data_remove(ib_provider_inst_t *dpi,
 #define ib_data_remove(dpi,name,pf) \
     ib_data_remove_ex(dpi,name,strlen(name),pf)
 
+/**
+ * Add to a numeric data field.
+ *
+ * @param dpi Data provider instance
+ * @param name Name as NUL terminated string
+ * @param adjval Value to add (may be negative)
+ *
+ * @returns Status code
+ */
+ib_status_t DLL_PUBLIC ib_data_set_relative(ib_provider_inst_t *dpi,
+                                            const char *name,
+                                            intmax_t adjval);
+
+#define ib_data_set_relative(dpi,name,adjval) \
+    ib_data_set_relative_ex(dpi,name,strlen(name),adjval)
+
 /**
  * @} IronBeeEngineData
  */
@@ -0,0 +1,175 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef _IB_ENGINE_MANAGER_H_
+#define _IB_ENGINE_MANAGER_H_
+
+/**
+ * @file
+ * @brief IronBee &mdash; Engine Manager
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include <ironbee/build.h>
+#include <ironbee/engine.h>
+#include <ironbee/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup IronBeeEngineManager Engine Manager
+ * @ingroup IronBeeEngine
+ *
+ * Configuration reload for servers.
+ *
+ * An engine's configuration cannot be changed once
+ * ib_state_notify_cfg_finished() has been called.  To reload, a server
+ * builds and configures a complete new engine (on any thread, while the
+ * current one keeps serving) and hands it to ib_manager_engine_add(), which
+ * publishes it as the current engine.
+ *
+ * Servers acquire the current engine when a connection is opened and
+ * release it once the connection is destroyed.  New connections use the
+ * newest engine while existing connections finish on the engine they
+ * started with.  An engine that has been replaced is destroyed when its
+ * last connection releases it.
+ *
+ * Every engine managed by one manager must load the same modules in the
+ * same order: module structures are shared by all engines in the process
+ * and identify their configuration by index.  ib_manager_engine_add()
+ * refuses an engine whose modules differ from the current engine's.
+ *
+ * All functions are thread safe.
+ *
+ * @{
+ */
+
+/**
+ * Engine manager.
+ */
+typedef struct ib_manager_t ib_manager_t;
+
+/**
+ * Create an engine manager.
+ *
+ * @param[out] pmanager Address which new manager is written
+ * @param[in] max_engines Maximum number of engines (current and replaced
+ *            engines still in use) that may exist at once; at least 1
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if @a max_engines is 0.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_manager_create(ib_manager_t **pmanager,
+                                         size_t max_engines);
+
+/**
+ * Destroy an engine manager and every engine it holds.
+ *
+ * No engine may be in use.
+ *
+ * @param[in] manager Engine manager
+ */
+void DLL_PUBLIC ib_manager_destroy(ib_manager_t *manager);
+
+/**
+ * Make @a ib the current engine.
+ *
+ * @a ib must be fully configured.  On success the manager owns @a ib; the
+ * engine it replaces is destroyed as soon as it is no longer in use.  On
+ * failure the caller still owns @a ib.
+ *
+ * @param[in] manager Engine manager
+ * @param[in] ib Engine
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINCOMPAT if @a ib does not load the same modules as the current
+ *   engine.
+ * - IB_EAGAIN if @a max_engines engines are still in use.
+ */
+ib_status_t DLL_PUBLIC ib_manager_engine_add(ib_manager_t *manager,
+                                             ib_engine_t *ib);
+
+/**
+ * Acquire the current engine.
+ *
+ * Each successful call must be matched by a call to
+ * ib_manager_engine_release().
+ *
+ * @param[in] manager Engine manager
+ * @param[out] pib Address which engine is written
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_ENOENT if no engine has been added.
+ */
+ib_status_t DLL_PUBLIC ib_manager_engine_acquire(ib_manager_t *manager,
+                                                 ib_engine_t **pib);
+
+/**
+ * Release an engine acquired with ib_manager_engine_acquire().
+ *
+ * If @a ib has been replaced and this was its last user, it is destroyed
+ * (on the calling thread).
+ *
+ * @param[in] manager Engine manager
+ * @param[in] ib Engine
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if @a ib is not held by @a manager.
+ */
+ib_status_t DLL_PUBLIC ib_manager_engine_release(ib_manager_t *manager,
+                                                 ib_engine_t *ib);
+
+/**
+ * Number of engines held, i.e., the current engine plus replaced engines
+ * still in use.
+ *
+ * @param[in] manager Engine manager
+ *
+ * @returns Number of engines
+ */
+size_t DLL_PUBLIC ib_manager_engine_count(ib_manager_t *manager);
+
+/**
+ * Generation of the current engine.
+ *
+ * Incremented by each successful ib_manager_engine_add(); 0 if no engine
+ * has been added.
+ *
+ * @param[in] manager Engine manager
+ *
+ * @returns Generation
+ */
+uint64_t DLL_PUBLIC ib_manager_generation(ib_manager_t *manager);
+
+/** @} IronBeeEngineManager */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IB_ENGINE_MANAGER_H_ */
@@ -125,6 +125,7 @@ typedef enum {
 #define IB_TX_FRES_SEENBODY     (1 <<11) /**< Response body seen */
 #define IB_TX_FRES_FINISHED     (1 <<12) /**< Response finished  */
 #define IB_TX_FSUSPICIOUS       (1 <<13) /**< Transaction is suspicious */
+#define IB_TX_FBLOCKED          (1 <<14) /**< Transaction blocked by rule */
 
 /** Configuration Context Type */
 /// @todo Perhaps "context scope" is better (CSCOPE)???
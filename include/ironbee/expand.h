@@ -144,6 +144,73 @@ ib_status_t DLL_PUBLIC ib_expand_test_str_ex(const char *str,
                                              ib_bool_t *result);
 
 
+/**
+ * Compiled expansion template.
+ *
+ * A template is the result of scanning a string for
+ * @a prefix + _name_ + @a suffix references once, up front.  It holds the
+ * literal segments and the names to look up, so expanding it does no
+ * pattern scanning and a single allocation for the result.
+ */
+typedef struct ib_expand_template_t ib_expand_template_t;
+
+/**
+ * Compile a string into an expansion template.
+ *
+ * The references in @a str are located using the same rules as
+ * ib_expand_str_ex().  The template refers to @a str directly, so @a str
+ * must live at least as long as the template does.
+ *
+ * @param[in] mp Memory pool to allocate the template from
+ * @param[in] str String to compile
+ * @param[in] str_len Length of @a str
+ * @param[in] prefix Prefix string (e.g. "%{")
+ * @param[in] suffix Suffix string (e.g. "}")
+ * @param[out] tmpl Compiled template
+ *
+ * @returns Status code
+ */
+ib_status_t DLL_PUBLIC ib_expand_compile(ib_mpool_t *mp,
+                                         const char *str,
+                                         size_t str_len,
+                                         const char *prefix,
+                                         const char *suffix,
+                                         ib_expand_template_t **tmpl);
+
+/**
+ * Expand a compiled template using the given hash.
+ *
+ * Names are looked up in @a hash and replaced exactly as in
+ * ib_expand_str_ex(), except that the replacement values themselves are
+ * never re-scanned for references.
+ *
+ * @param[in] mp Memory pool to allocate @a result from
+ * @param[in] tmpl Template created by ib_expand_compile()
+ * @param[in] nul Append a NUL byte to the end of @a result?
+ * @param[in] hash Hash from which to lookup names in @a tmpl
+ * @param[out] result Resulting string
+ * @param[out] result_len Length of @a result, not including any NUL byte
+ *
+ * @returns Status code
+ */
+ib_status_t DLL_PUBLIC ib_expand_template_exec(
+    ib_mpool_t *mp,
+    const ib_expand_template_t *tmpl,
+    ib_bool_t nul,
+    ib_hash_t *hash,
+    char **result,
+    size_t *result_len);
+
+/**
+ * Determine if a compiled template contains any names to expand.
+ *
+ * @param[in] tmpl Template created by ib_expand_compile()
+ *
+ * @returns IB_TRUE if @a tmpl references at least one name.
+ */
+ib_bool_t DLL_PUBLIC ib_expand_template_expands(
+    const ib_expand_template_t *tmpl);
+
 /** @} IronBeeUtilExpand */
 
 
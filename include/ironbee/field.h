@@ -29,6 +29,7 @@
 #include <ironbee/build.h>
 #include <ironbee/types.h>
 #include <ironbee/list.h>
+#include <ironbee/symbol.h>
 
 #include <string.h>
 
@@ -516,6 +517,47 @@ typedef ib_status_t (*ib_field_set_fn_t)(
     void       *data
 );
 
+/**
+ * Dynamic field adjust function.
+ *
+ * Adds @a adjval to the numeric value selected by @a arg.  Unlike a get
+ * followed by a set, this is a single operation, so an implementation can
+ * make it atomic.
+ *
+ * @param[in] field   Field in question.
+ * @param[in] arg     Optional argument.
+ * @param[in] alen    Length of @a arg.
+ * @param[in] adjval  Value to add.
+ * @param[in] data    Callback data.
+ *
+ * @returns Status code
+ */
+typedef ib_status_t (*ib_field_adjust_fn_t)(
+    ib_field_t *field,
+    const void *arg,
+    size_t      alen,
+    ib_num_t    adjval,
+    void       *data
+);
+
+/**
+ * Lazy field generator function.
+ *
+ * Called the first time the value of a lazy field is needed.  Writes the
+ * value, as it would be passed to ib_field_setv_no_copy(), to @a pval.
+ *
+ * @param[in]  field  Field in question.
+ * @param[out] pval   Where to write value.
+ * @param[in]  data   Callback data.
+ *
+ * @returns Status code
+ */
+typedef ib_status_t (*ib_field_gen_fn_t)(
+    const ib_field_t  *field,
+    void             **pval,
+    void              *data
+);
+
 /** Field Structure */
 struct ib_field_t {
     ib_mpool_t     *mp;        /**< Memory pool */
@@ -524,6 +566,7 @@ struct ib_field_t {
     size_t          nlen;      /**< Field name length */
     const char     *tfn;       /**< Transformations performed */
     ib_field_val_t *val;       /**< Private value store */
+    const ib_symbol_t *sym;    /**< Interned name or NULL */
 };
 
 /**
@@ -577,6 +620,30 @@ ib_status_t DLL_PUBLIC ib_field_create_no_copy(
     void        *mutable_in_pval
 );
 
+/**
+ * Create a field named by an interned symbol, without copying data.
+ *
+ * As ib_field_create_no_copy(), but the field's name is the symbol's name,
+ * which outlives the field, so it is not copied.  The field remembers
+ * @a sym so that it can be added to and found in the data provider
+ * without hashing its name.
+ *
+ * @param[out] pf              Address to write new field to.
+ * @param[in]  mp              Memory pool.
+ * @param[in]  sym             Field name symbol.
+ * @param[in]  type            Field type.
+ * @param[in]  mutable_in_pval Value to store in field.
+ *
+ * @returns Status code
+ */
+ib_status_t DLL_PUBLIC ib_field_create_sym(
+    ib_field_t        **pf,
+    ib_mpool_t         *mp,
+    const ib_symbol_t  *sym,
+    ib_ftype_t          type,
+    void               *mutable_in_pval
+);
+
 /**
  * Create a field but use @a *mutable_out_pval as the storage.
  *
@@ -630,6 +697,63 @@ ib_status_t DLL_PUBLIC ib_field_create_dynamic(
     void               *cbdata_set
 );
 
+/**
+ * Create a lazy field.
+ *
+ * A lazy field's value is produced by @a fn_gen the first time it is
+ * needed, either by ib_field_resolve_lazy() or by reading the value.  From
+ * then on the field is an ordinary static field holding that value.
+ * Until then it is dynamic, so code which holds the field rather than
+ * reading it through the data provider should resolve it first.
+ *
+ * @param[out] pf         Address to write new field to.
+ * @param[in]  mp         Memory pool.
+ * @param[in]  name       Field name.
+ * @param[in]  nlen       Field name length.
+ * @param[in]  type       Field type.
+ * @param[in]  fn_gen     Generator.
+ * @param[in]  cbdata_gen Generator data.
+ *
+ * @returns Status code
+ */
+ib_status_t DLL_PUBLIC ib_field_create_lazy(
+    ib_field_t        **pf,
+    ib_mpool_t         *mp,
+    const char         *name,
+    size_t              nlen,
+    ib_ftype_t          type,
+    ib_field_gen_fn_t   fn_gen,
+    void               *cbdata_gen
+);
+
+/**
+ * Generate the value of a lazy field, if it has not been already.
+ *
+ * Does nothing for fields which are not lazy.
+ *
+ * @param[in,out] f Field.
+ *
+ * @returns Status code of the generator, or IB_OK.
+ */
+ib_status_t DLL_PUBLIC ib_field_resolve_lazy(
+    ib_field_t *f
+);
+
+/**
+ * Give a dynamic field an adjust function, for ib_field_adjust_ex().
+ *
+ * @param[in,out] f             Dynamic field.
+ * @param[in]     fn_adjust     Adjust function.
+ * @param[in]     cbdata_adjust Adjust function data.
+ *
+ * @returns IB_OK, or IB_EINVAL if @a f is not dynamic.
+ */
+ib_status_t DLL_PUBLIC ib_field_dynamic_adjust(
+    ib_field_t           *f,
+    ib_field_adjust_fn_t  fn_adjust,
+    void                 *cbdata_adjust
+);
+
 /**
  * Make a copy of a field, aliasing data.
  *
@@ -802,6 +926,26 @@ ib_status_t DLL_PUBLIC ib_field_setv_ex(
     size_t      alen
 );
 
+/**
+ * Add to a numeric field, passing the argument on to dynamic fields.
+ *
+ * Static fields must be of type IB_FTYPE_NUM or IB_FTYPE_UNUM.  Dynamic
+ * fields must have an adjust function (see ib_field_dynamic_adjust()).
+ *
+ * @param[in] f       Field.
+ * @param[in] adjval  Value to add.
+ * @param[in] arg     Arbitrary argument.  Use NULL for non-dynamic fields.
+ * @param[in] alen    Argument length.
+ *
+ * @returns Status code
+ */
+ib_status_t DLL_PUBLIC ib_field_adjust_ex(
+    ib_field_t *f,
+    ib_num_t    adjval,
+    const void *arg,
+    size_t      alen
+);
+
 /**
  * Get the value stored in the field, passing the argument on to dynamic
  * fields.
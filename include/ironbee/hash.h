@@ -29,6 +29,7 @@
 #include <ironbee/build.h>
 #include <ironbee/types.h>
 #include <ironbee/list.h>
+#include <ironbee/symbol.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -355,6 +356,29 @@ ib_status_t DLL_PUBLIC ib_hash_get(
     const char        *key
 );
 
+/**
+ * Fetch value from @a hash for the interned name @a sym.
+ *
+ * Equivalent to ib_hash_get_ex() on the symbol's name, but for hashes
+ * using ib_hashfunc_djb2_nocase() the name is not hashed, and entries
+ * which were set with the same symbol match by pointer.
+ *
+ * @sa ib_hash_set_sym()
+ *
+ * @param[in]  hash  Hash table.
+ * @param[out] value Address which value is written.
+ * @param[in]  sym   Symbol to lookup.
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_ENOENT if @a sym is not in hash table.
+ */
+ib_status_t DLL_PUBLIC ib_hash_get_sym(
+    const ib_hash_t   *hash,
+    void              *value,
+    const ib_symbol_t *sym
+);
+
 /**
  * Push every entry from @a hash onto @a list.
  *
@@ -405,6 +429,31 @@ ib_status_t DLL_PUBLIC ib_hash_set_ex(
     void       *value
 );
 
+/**
+ * Set value of the interned name @a sym in @a hash to @a value.
+ *
+ * Equivalent to ib_hash_set_ex() on the symbol's name, without hashing it
+ * for hashes using ib_hashfunc_djb2_nocase().  The symbol's name is used
+ * as the key, so it is not copied.
+ *
+ * @sa ib_hash_get_sym()
+ *
+ * @param[in,out] hash  Hash table.
+ * @param[in]     sym   Symbol.
+ * @param[in]     value Value.
+ *
+ * If @a value is NULL, removes element.
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EALLOC if @a hash attempted to grow and failed.
+ */
+ib_status_t DLL_PUBLIC ib_hash_set_sym(
+    ib_hash_t         *hash,
+    const ib_symbol_t *sym,
+    void              *value
+);
+
 /**
  * Set value of @a key (NULL terminated char string) in @a hash to @a value.
  *
@@ -0,0 +1,297 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef _IB_LRU_H_
+#define _IB_LRU_H_
+
+/**
+ * @file
+ * @brief IronBee &mdash; LRU Hash Utility Functions
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include <ironbee/build.h>
+#include <ironbee/mpool.h>
+#include <ironbee/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup IronBeeLRU LRU Hash
+ * @ingroup IronBeeUtil
+ *
+ * Bounded hash tables which evict the least recently used entry when full.
+ *
+ * There are two levels:
+ *
+ * - An LRU index (ib_lru_t) links a fixed array of nodes into hash chains,
+ *   an LRU list and a free list.  The links are node indexes rather than
+ *   pointers and the caller provides all of the memory, so an index can
+ *   live in shared memory (see ib_shmtable_t).  The caller keeps its data
+ *   in an array parallel to the nodes, and does its own locking.
+ * - An LRU cache (ib_lrucache_t) is a thread safe, heap allocated cache of
+ *   byte string keys to byte string values built on LRU indexes, split
+ *   into independently locked stripes.
+ *
+ * @{
+ */
+
+/** Null node index. */
+#define IB_LRU_NIL UINT32_MAX
+
+/**
+ * LRU index node.
+ */
+typedef struct {
+    uint32_t     hnext;        /**< Next node in hash bucket or free list */
+    uint32_t     prev;         /**< Previous (more recent) node */
+    uint32_t     next;         /**< Next (less recent) node */
+    uint32_t     hash;         /**< Hash of key */
+} ib_lru_node_t;
+
+/**
+ * LRU index.
+ *
+ * Holds no pointers, so it may be placed in shared memory.
+ */
+typedef struct {
+    uint32_t     bmask;        /**< Number of buckets - 1 */
+    uint32_t     nnodes;       /**< Number of nodes */
+    uint32_t     head;         /**< Most recently used node */
+    uint32_t     tail;         /**< Least recently used node */
+    uint32_t     free;         /**< Free nodes, linked by hnext */
+    uint32_t     count;        /**< Nodes in use */
+} ib_lru_t;
+
+/**
+ * Key comparison callback for ib_lru_find().
+ *
+ * @param[in] idx Index of a node whose hash matches
+ * @param[in] key Key being looked for
+ * @param[in] klen Length of @a key
+ * @param[in] cbdata Callback data
+ *
+ * @returns Non-zero if the key of node @a idx is @a key
+ */
+typedef int (*ib_lru_match_fn_t)(uint32_t idx,
+                                 const void *key,
+                                 size_t klen,
+                                 void *cbdata);
+
+/**
+ * LRU cache.
+ */
+typedef struct ib_lrucache_t ib_lrucache_t;
+
+/**
+ * Hash a key (32 bit FNV-1a).
+ *
+ * The bucket of a key is chosen from bits 8 and up of its hash, so the low
+ * bits are free to choose a stripe.
+ *
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ *
+ * @returns Hash
+ */
+uint32_t DLL_PUBLIC ib_lru_hash(const void *key, size_t klen);
+
+/**
+ * Empty an LRU index.
+ *
+ * @param[out] lru LRU index
+ * @param[out] buckets Hash buckets
+ * @param[in] nbuckets Number of @a buckets; a power of 2
+ * @param[out] nodes Nodes
+ * @param[in] nnodes Number of @a nodes; at least 1 and less than IB_LRU_NIL
+ */
+void DLL_PUBLIC ib_lru_reset(ib_lru_t *lru,
+                             uint32_t *buckets,
+                             size_t nbuckets,
+                             ib_lru_node_t *nodes,
+                             size_t nnodes);
+
+/**
+ * Find the node of a key.
+ *
+ * The node is not moved to the front of the LRU list; see ib_lru_touch().
+ *
+ * @param[in] lru LRU index
+ * @param[in] buckets Hash buckets
+ * @param[in] nodes Nodes
+ * @param[in] hash Hash of @a key
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[in] match Key comparison function
+ * @param[in] cbdata Callback data for @a match
+ *
+ * @returns Node index or IB_LRU_NIL
+ */
+uint32_t DLL_PUBLIC ib_lru_find(const ib_lru_t *lru,
+                                const uint32_t *buckets,
+                                const ib_lru_node_t *nodes,
+                                uint32_t hash,
+                                const void *key,
+                                size_t klen,
+                                ib_lru_match_fn_t match,
+                                void *cbdata);
+
+/**
+ * Move a node to the front of the LRU list.
+ *
+ * @param[in,out] lru LRU index
+ * @param[in,out] nodes Nodes
+ * @param[in] idx Node index
+ */
+void DLL_PUBLIC ib_lru_touch(ib_lru_t *lru,
+                             ib_lru_node_t *nodes,
+                             uint32_t idx);
+
+/**
+ * Allocate a node for a new key and link it at the front of the LRU list.
+ *
+ * If there is no free node the least recently used node is removed and
+ * reused; the caller's data for it is left alone, so the caller may still
+ * look at it.
+ *
+ * @param[in,out] lru LRU index
+ * @param[in,out] buckets Hash buckets
+ * @param[in,out] nodes Nodes
+ * @param[in] hash Hash of the new key
+ * @param[out] pevicted Address which IB_TRUE is written if a node was
+ *             evicted (IB_FALSE otherwise), or NULL
+ *
+ * @returns Node index
+ */
+uint32_t DLL_PUBLIC ib_lru_insert(ib_lru_t *lru,
+                                  uint32_t *buckets,
+                                  ib_lru_node_t *nodes,
+                                  uint32_t hash,
+                                  ib_bool_t *pevicted);
+
+/**
+ * Remove a node and free it.
+ *
+ * @param[in,out] lru LRU index
+ * @param[in,out] buckets Hash buckets
+ * @param[in,out] nodes Nodes
+ * @param[in] idx Node index
+ */
+void DLL_PUBLIC ib_lru_remove(ib_lru_t *lru,
+                              uint32_t *buckets,
+                              ib_lru_node_t *nodes,
+                              uint32_t idx);
+
+/**
+ * Create an LRU cache.
+ *
+ * The cache is on the heap, as it is used from threads which can't share
+ * a memory pool.  Release it with ib_lrucache_destroy().
+ *
+ * @param[out] pcache Address which new cache is written
+ * @param[in] max_entries Maximum number of entries; at least 1
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if @a max_entries is 0 or too large.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_lrucache_create(ib_lrucache_t **pcache,
+                                          size_t max_entries);
+
+/**
+ * Get a copy of a value.
+ *
+ * The entry becomes the most recently used of its stripe.
+ *
+ * @param[in] cache Cache
+ * @param[in] mp Memory pool to copy the value into
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[out] pvalue Address which copy of value is written
+ * @param[out] pvlen Address which length of value is written, or NULL
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_ENOENT if there is no such entry.
+ * - IB_EALLOC if the copy could not be allocated.
+ */
+ib_status_t DLL_PUBLIC ib_lrucache_get(ib_lrucache_t *cache,
+                                       ib_mpool_t *mp,
+                                       const void *key,
+                                       size_t klen,
+                                       void **pvalue,
+                                       size_t *pvlen);
+
+/**
+ * Set a value.
+ *
+ * The key and value are copied.  An existing value for @a key is replaced;
+ * if the stripe of @a key is full, its least recently used entry is
+ * evicted.
+ *
+ * @param[in] cache Cache
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[in] value Value
+ * @param[in] vlen Length of @a value
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EALLOC on allocation failure; the cache is unchanged.
+ */
+ib_status_t DLL_PUBLIC ib_lrucache_set(ib_lrucache_t *cache,
+                                       const void *key,
+                                       size_t klen,
+                                       const void *value,
+                                       size_t vlen);
+
+/**
+ * Cache statistics.
+ *
+ * @param[in] cache Cache
+ * @param[out] phits Address which number of successful gets is written,
+ *             or NULL
+ * @param[out] pmisses Address which number of failed gets is written,
+ *             or NULL
+ */
+void DLL_PUBLIC ib_lrucache_stats(ib_lrucache_t *cache,
+                                  uint64_t *phits,
+                                  uint64_t *pmisses);
+
+/**
+ * Destroy an LRU cache and every entry in it.
+ *
+ * No thread may use the cache afterwards.
+ *
+ * @param[in] cache Cache; may be NULL
+ */
+void DLL_PUBLIC ib_lrucache_destroy(ib_lrucache_t *cache);
+
+/** @} IronBeeLRU */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IB_LRU_H_ */
@@ -172,7 +172,11 @@ typedef ib_status_t (*ib_module_fn_init_t)(
 /**
  * Function to finish a module.
  *
- * This is called when the module is unloaded.
+ * This is called when the module is unloaded, once for each engine which
+ * loaded it, while other engines may still be using the module.  Anything
+ * shared between engines must not be torn down here; keep per-engine
+ * state in the main context configuration and release it when the main
+ * context is destroyed.
  *
  * @param[in] ib     Engine handle
  * @param[in] m      Module
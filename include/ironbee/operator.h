@@ -110,6 +110,8 @@ struct ib_operator_t {
 #define IB_OP_FLAG_ALLOW_NULL  (1 << 0)   /**< Op. accepts NULL fields */
 #define IB_OP_FLAG_PHASE       (1 << 1)   /**< Op works with phase rules */
 #define IB_OP_FLAG_STREAM      (1 << 2)   /**< Op works with stream rules */
+#define IB_OP_FLAG_PARALLEL    (1 << 3)   /**< Op may run on rule worker */
+#define IB_OP_FLAG_DEFER       (1 << 4)   /**< Create may run on a thread */
 
 struct ib_operator_inst_t {
     struct ib_operator_t *op;    /**< Pointer to the operator type */
@@ -175,6 +177,44 @@ ib_status_t DLL_PUBLIC ib_operator_inst_create(ib_engine_t *ib,
                                                ib_flags_t flags,
                                                ib_operator_inst_t **op_inst);
 
+/**
+ * Create an operator instance, deferring expensive work while configuring.
+ *
+ * Identical to ib_operator_inst_create() except that, while the engine is
+ * being configured, instances of operators registered with
+ * IB_OP_FLAG_DEFER are only allocated here.  Their creation callbacks (e.g.
+ * compiling a regular expression) are run when configuration finishes,
+ * spread over a temporary pool of threads (see the RuleCompileWorkers
+ * directive).  Until then @c (*op_inst)->data is NULL.
+ *
+ * Errors from deferred creation are logged, in the order the instances
+ * were created, and returned by ib_state_notify_cfg_finished().
+ *
+ * The creation callback of an operator registered with IB_OP_FLAG_DEFER
+ * must be thread safe and must allocate only from the pool it is given.
+ *
+ * @param[in] ib Ironbee engine
+ * @param[in] ctx Current IronBee context
+ * @param[in] required_op_flags Required operator flags
+ *            (IB_OP_FLAG_{PHASE,STREAM})
+ * @param[in] name The name of the operator to create.
+ * @param[in] parameters Parameters used to create the instance.
+ * @param[in] flags Operator instance flags (i.e. IB_OPINST_FLAG_INVERT)
+ * @param[out] op_inst The resulting instance.
+ *
+ * @returns IB_OK on success,
+ *          IB_EINVAL if the required operator flags do not match,
+ *          IB_ENOENT if the named operator does not exist
+ */
+ib_status_t DLL_PUBLIC ib_operator_inst_create_deferred(
+    ib_engine_t *ib,
+    ib_context_t *ctx,
+    ib_flags_t required_op_flags,
+    const char *name,
+    const char *parameters,
+    ib_flags_t flags,
+    ib_operator_inst_t **op_inst);
+
 /**
  * Destroy an operator instance.
  *
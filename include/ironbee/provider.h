@@ -451,6 +451,12 @@ IB_PROVIDER_DECLARE_IFACE(data) {
         clear,
         (ib_provider_inst_t *pi)
     );
+    /* Optional: get by interned name (falls back to get by name). */
+    IB_PROVIDER_FUNC(
+        ib_status_t,
+        get_sym,
+        (ib_provider_inst_t *pi, const ib_symbol_t *sym, ib_field_t **pf)
+    );
     /// @todo init(table) add fields in bulk
 };
 
@@ -491,6 +497,11 @@ IB_PROVIDER_DECLARE_API(data) {
         clear,
         (ib_provider_inst_t *pi)
     );
+    IB_PROVIDER_FUNC(
+        ib_status_t,
+        get_sym,
+        (ib_provider_inst_t *pi, const ib_symbol_t *sym, ib_field_t **pf)
+    );
     /// @todo init
 };
 
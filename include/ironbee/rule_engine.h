@@ -30,6 +30,9 @@
 #include <ironbee/rule_defs.h>
 #include <ironbee/operator.h>
 #include <ironbee/action.h>
+#include <ironbee/expand.h>
+#include <ironbee/ahocorasick.h>
+#include <ironbee/lock.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -70,6 +73,8 @@ typedef struct {
     const char            *chain_id;        /**< Rule's chain ID */
     const char            *msg;             /**< Rule message */
     const char            *data;            /**< Rule logdata */
+    ib_expand_template_t  *msg_tmpl;        /**< Compiled msg expansion */
+    ib_expand_template_t  *data_tmpl;       /**< Compiled logdata expansion */
     ib_list_t             *tags;            /**< Rule tags */
     ib_rule_phase_t        phase;           /**< Phase number */
     uint8_t                severity;        /**< Rule severity */
@@ -82,6 +87,7 @@ typedef struct {
  */
 typedef struct {
     const char            *field_name;    /**< The field name */
+    const ib_symbol_t     *symbol;        /**< Interned field name or NULL */
     ib_list_t             *tfn_list;      /**< List of transformations */
 } ib_rule_target_t;
 
@@ -90,6 +96,109 @@ typedef struct {
  */
 typedef struct ib_rule_phase_meta_t ib_rule_phase_meta_t;
 
+/**
+ * Rule engine: Dependency index entry for a single target field
+ */
+typedef struct {
+    const char            *name;          /**< Target field name */
+    const char            *base;          /**< Name before ':' or NULL */
+    const ib_symbol_t     *symbol;        /**< Interned name or NULL */
+    const ib_symbol_t     *base_symbol;   /**< Interned base or NULL */
+    size_t                *rules;         /**< Indexes of rules using it */
+    size_t                 num_rules;     /**< Number of entries in rules */
+} ib_rule_dep_field_t;
+
+/**
+ * Rule engine: Compiled target
+ *
+ * Execution plan copy of an ib_rule_target_t, with its transformations
+ * in an array rather than a list.
+ */
+typedef struct {
+    const char            *field_name;    /**< The field name */
+    const ib_symbol_t     *symbol;        /**< Interned field name or NULL */
+    ib_tfn_t             **tfns;          /**< Transformations, in order */
+    size_t                 num_tfns;      /**< Number of entries in tfns */
+} ib_rule_exec_target_t;
+
+/**
+ * Rule engine: Compiled rule
+ *
+ * Execution plan copy of the parts of an ib_rule_t used to execute it.
+ */
+typedef struct ib_rule_exec_t ib_rule_exec_t;
+struct ib_rule_exec_t {
+    ib_rule_t             *rule;          /**< Rule compiled */
+    ib_operator_inst_t    *opinst;        /**< Rule operator */
+    ib_flags_t             flags;         /**< Rule flags */
+    ib_rule_exec_target_t *targets;       /**< Target fields */
+    size_t                 num_targets;   /**< Number of entries in targets */
+    ib_action_inst_t     **true_actions;  /**< Actions if condition True */
+    size_t                 num_true_actions;  /**< Entries in true_actions */
+    ib_action_inst_t     **false_actions; /**< Actions if condition False */
+    size_t                 num_false_actions; /**< Entries in false_actions */
+    const ib_rule_exec_t  *chained_rule;  /**< Next rule in the chain */
+};
+
+/**
+ * Rule engine: Phase execution plan
+ *
+ * Built when the owning context is closed, and read-only afterwards.  The
+ * phase's rules and everything needed to execute them are laid out in a
+ * few arrays, in execution order, rather than in linked lists spread over
+ * the configuration memory pool: the first @a num_rules entries of
+ * @a rules are the phase's rules, in the order of the rule list, and are
+ * followed by the rules chained from them.  The targets, transformations
+ * and actions of each rule are slices of the shared arrays.
+ */
+typedef struct {
+    size_t                 num_rules;     /**< Number of phase rules */
+    size_t                 num_chained;   /**< Number of chained rules */
+    ib_rule_exec_t        *rules;         /**< Phase, then chained rules */
+    ib_rule_exec_target_t *targets;       /**< All targets */
+    size_t                 num_targets;   /**< Number of entries in targets */
+    ib_tfn_t             **tfns;          /**< All transformations */
+    size_t                 num_tfns;      /**< Number of entries in tfns */
+    ib_action_inst_t     **actions;       /**< All actions */
+    size_t                 num_actions;   /**< Number of entries in actions */
+} ib_rule_phase_plan_t;
+
+/**
+ * Rule engine: Literal rule group
+ *
+ * Phase rules applying the same literal string operator (streq or
+ * contains) to the same target with the same transformations.  A group is
+ * evaluated once, with a single hash lookup or Aho-Corasick scan, for all
+ * of its rules.
+ */
+typedef struct {
+    size_t                 num;           /**< Group number within phase */
+    const ib_rule_exec_target_t *target;  /**< Target shared by the rules */
+    ib_hash_t             *literals;      /**< streq: literal to rule list */
+    ib_ac_t               *ac;            /**< contains: literal patterns */
+    size_t                *rules;         /**< Indexes of rules in group */
+    size_t                 num_rules;     /**< Number of entries in rules */
+} ib_rule_literal_group_t;
+
+/**
+ * Rule engine: Phase dependency index
+ *
+ * Built when the owning context is closed.  Maps each distinct target field
+ * of the phase's rules to the rules which target it, so that rules whose
+ * targets are all absent can be skipped without looking up every target.
+ */
+typedef struct {
+    size_t                 num_rules;     /**< Number of indexed rules */
+    ib_rule_dep_field_t   *fields;        /**< Distinct target fields */
+    size_t                 num_fields;    /**< Number of entries in fields */
+    uint8_t               *always;        /**< Per rule: run unconditionally */
+    ib_rule_literal_group_t **group;      /**< Per rule: literal group/NULL */
+    size_t                 num_groups;    /**< Number of literal groups */
+    uint8_t               *modifies;      /**< Per rule: may change data */
+    uint8_t               *parallel;      /**< Per rule: worker evaluable */
+    size_t                 num_parallel;  /**< Number of parallel rules */
+} ib_rule_phase_index_t;
+
 /**
  * Ruleset for a single phase
  */
@@ -97,6 +206,8 @@ typedef struct {
     ib_rule_phase_t             phase_num;   /**< Phase number */
     const ib_rule_phase_meta_t *phase_meta;  /**< Rule phase meta-data */
     ib_list_t                  *rule_list;   /**< Rules to execute in phase */
+    ib_rule_phase_plan_t       *plan;        /**< Execution plan or NULL */
+    ib_rule_phase_index_t      *index;       /**< Dependency index or NULL */
 } ib_ruleset_phase_t;
 
 /**
@@ -122,6 +233,7 @@ struct ib_rule_t {
     ib_rule_t             *chained_rule;    /**< Next rule in the chain */
     ib_rule_t             *chained_from;    /**< Ptr to rule chained from */
     ib_flags_t             flags;           /**< External, etc. */
+    size_t                 profile_index;   /**< Index for rule profiler */
 };
 
 /**
@@ -131,6 +243,16 @@ typedef struct {
     ib_rule_t             *previous;     /**< Previous rule parsed */
 } ib_rule_parser_data_t;
 
+/**
+ * Rule profiler (opaque)
+ */
+typedef struct ib_rule_profile_t ib_rule_profile_t;
+
+/**
+ * Rule worker pool (opaque)
+ */
+typedef struct ib_rule_workers_t ib_rule_workers_t;
+
 /**
  * Rule engine data; typedef in ironbee_private.h
  */
@@ -138,6 +260,11 @@ struct ib_rule_engine_t {
     ib_ruleset_t           ruleset;     /**< Rules to exec */
     ib_list_t             *rule_list;   /**< All rules owned by this context */
     ib_rule_parser_data_t  parser_data; /**< Rule parser specific data */
+    ib_rule_profile_t     *profile;     /**< Rule profiler or NULL */
+    ib_rule_workers_t     *workers;     /**< Rule worker pool or NULL */
+    ib_lock_t              plan_lock;   /**< Serializes rebuilding plans of
+                                         *   rules added late (engine's
+                                         *   only) */
 };
 
 /**
@@ -0,0 +1,185 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef _IB_SHMTABLE_H_
+#define _IB_SHMTABLE_H_
+
+/**
+ * @file
+ * @brief IronBee &mdash; Shared Memory Counter Table Utility Functions
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include <ironbee/build.h>
+#include <ironbee/mpool.h>
+#include <ironbee/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup IronBeeShmTable Shared Memory Counter Table
+ * @ingroup IronBeeUtil
+ *
+ * Bounded table of numeric values shared between processes.
+ *
+ * The table lives in an anonymous shared mapping, so it is shared by the
+ * process that creates it and every process forked from it afterwards
+ * (i.e., create it while configuring, before a server forks its workers).
+ * It has room for a fixed number of entries, set at creation, and never
+ * grows; when it is full the least recently used entry is evicted.
+ * Entries may be given a time to live, after which they read as missing.
+ *
+ * The table is split into stripes, each with its own process shared lock,
+ * so operations on different keys rarely contend.  Each operation,
+ * including ib_shmtable_add(), is atomic with respect to every process and
+ * thread using the table.
+ *
+ * @{
+ */
+
+/** Maximum key length. */
+#define IB_SHMTABLE_KEY_MAX 120
+
+/**
+ * Shared memory counter table.
+ */
+typedef struct ib_shmtable_t ib_shmtable_t;
+
+/**
+ * Create a table.
+ *
+ * The mapping is released when @a mp is destroyed.
+ *
+ * @param[out] ptable Address which new table is written
+ * @param[in] mp Memory pool
+ * @param[in] max_entries Maximum number of entries; at least 1
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if @a max_entries is 0 or too large.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_shmtable_create(ib_shmtable_t **ptable,
+                                          ib_mpool_t *mp,
+                                          size_t max_entries);
+
+/**
+ * Get a value.
+ *
+ * @param[in] table Table
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[out] pval Address which value is written
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_ENOENT if there is no such entry or it has expired.
+ * - IB_EINVAL if @a klen is greater than IB_SHMTABLE_KEY_MAX.
+ */
+ib_status_t DLL_PUBLIC ib_shmtable_get(ib_shmtable_t *table,
+                                       const void *key,
+                                       size_t klen,
+                                       ib_num_t *pval);
+
+/**
+ * Set a value.
+ *
+ * The entry's time to live starts over.
+ *
+ * @param[in] table Table
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[in] val Value
+ * @param[in] ttl Time to live in seconds; 0 for none
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if @a klen is greater than IB_SHMTABLE_KEY_MAX.
+ */
+ib_status_t DLL_PUBLIC ib_shmtable_set(ib_shmtable_t *table,
+                                       const void *key,
+                                       size_t klen,
+                                       ib_num_t val,
+                                       uint32_t ttl);
+
+/**
+ * Add to a value.
+ *
+ * A missing or expired entry is created with value @a adjval and time to
+ * live @a ttl.  Adding to an existing entry does not extend its time to
+ * live, so a counter with a time to live counts over a fixed window.
+ *
+ * @param[in] table Table
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[in] adjval Value to add
+ * @param[in] ttl Time to live in seconds of a new entry; 0 for none
+ * @param[out] presult Address which new value is written, or NULL
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if @a klen is greater than IB_SHMTABLE_KEY_MAX.
+ */
+ib_status_t DLL_PUBLIC ib_shmtable_add(ib_shmtable_t *table,
+                                       const void *key,
+                                       size_t klen,
+                                       ib_num_t adjval,
+                                       uint32_t ttl,
+                                       ib_num_t *presult);
+
+/**
+ * Remove an entry.
+ *
+ * @param[in] table Table
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_ENOENT if there is no such entry or it has expired.
+ * - IB_EINVAL if @a klen is greater than IB_SHMTABLE_KEY_MAX.
+ */
+ib_status_t DLL_PUBLIC ib_shmtable_remove(ib_shmtable_t *table,
+                                          const void *key,
+                                          size_t klen);
+
+/**
+ * Table statistics.
+ *
+ * @param[in] table Table
+ * @param[out] pcount Address which number of entries (including expired
+ *             entries not yet reclaimed) is written, or NULL
+ * @param[out] pevictions Address which number of unexpired entries evicted
+ *             to make room is written, or NULL
+ */
+void DLL_PUBLIC ib_shmtable_stats(ib_shmtable_t *table,
+                                  size_t *pcount,
+                                  uint64_t *pevictions);
+
+/** @} IronBeeShmTable */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IB_SHMTABLE_H_ */
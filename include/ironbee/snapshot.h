@@ -0,0 +1,211 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef _IB_SNAPSHOT_H_
+#define _IB_SNAPSHOT_H_
+
+/**
+ * @file
+ * @brief IronBee &mdash; Compile Cache Snapshot Utility Functions
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include <ironbee/build.h>
+#include <ironbee/mpool.h>
+#include <ironbee/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup IronBeeSnapshot Compile Cache Snapshot
+ * @ingroup IronBeeUtil
+ *
+ * On-disk cache of the results of expensive configuration time work.
+ *
+ * Only blobs without pointers can be cached.  At present that is compiled
+ * (and studied) PCRE patterns; the configuration is still parsed and rules,
+ * Aho-Corasick automata and radix trees are still built on every start.
+ *
+ * A snapshot is a file of binary blobs, each filed under a namespace
+ * (usually the name of the module that produced it) and a binary key that
+ * identifies the input it was computed from, e.g., a regular expression and
+ * its compile flags.  The file is mapped read-only when the snapshot is
+ * opened; blobs found in it are used in place instead of being recomputed.
+ * Blobs computed during this run are added with ib_snapshot_put() and the
+ * file is rewritten by ib_snapshot_commit() once configuration is done.
+ *
+ * Because keys describe their inputs completely, a stale entry is never
+ * found by a lookup; it is simply dropped the next time the snapshot is
+ * committed.  The file also records a hash of the configuration text it was
+ * built from, so an unchanged configuration is recognised and the file is
+ * not rewritten.
+ *
+ * Snapshots are native byte order and are versioned; a file with another
+ * version or byte order is ignored (and replaced on commit).
+ *
+ * Gets and puts are serialised with a lock and may be made from several
+ * threads while configuring.
+ *
+ * @{
+ */
+
+/** Initial value for ib_snapshot_hash(). */
+#define IB_SNAPSHOT_HASH_INIT 0xcbf29ce484222325ULL
+
+/** Snapshot file format version. */
+#define IB_SNAPSHOT_VERSION 1
+
+/**
+ * Snapshot.
+ */
+typedef struct ib_snapshot_t ib_snapshot_t;
+
+/**
+ * Open a snapshot.
+ *
+ * If @a path exists and is a valid snapshot it is mapped and its entries
+ * become available to ib_snapshot_get().  A missing or invalid file results
+ * in an empty snapshot; this is not an error.  The mapping is released when
+ * @a mp is destroyed.
+ *
+ * @param[out] psnap Address which new snapshot is written
+ * @param[in] mp Memory pool
+ * @param[in] path Snapshot file
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_snapshot_open(ib_snapshot_t **psnap,
+                                        ib_mpool_t *mp,
+                                        const char *path);
+
+/**
+ * Look up a blob.
+ *
+ * The blob is read-only and is valid as long as the snapshot is; it is
+ * aligned to 8 bytes.
+ *
+ * @param[in] snap Snapshot
+ * @param[in] ns Namespace
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[out] pdata Address which blob is written
+ * @param[out] pdlen Address which length of blob is written
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_ENOENT if there is no such blob.
+ */
+ib_status_t DLL_PUBLIC ib_snapshot_get(ib_snapshot_t *snap,
+                                       const char *ns,
+                                       const void *key,
+                                       size_t klen,
+                                       const void **pdata,
+                                       size_t *pdlen);
+
+/**
+ * Add a blob.
+ *
+ * @a key and @a data are copied.  The blob replaces any existing blob with
+ * the same namespace and key.
+ *
+ * @param[in] snap Snapshot
+ * @param[in] ns Namespace
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[in] data Blob
+ * @param[in] dlen Length of @a data
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_snapshot_put(ib_snapshot_t *snap,
+                                       const char *ns,
+                                       const void *key,
+                                       size_t klen,
+                                       const void *data,
+                                       size_t dlen);
+
+/**
+ * Write the snapshot back to its file.
+ *
+ * The new file contains the blobs that were looked up or added since the
+ * snapshot was opened.  It is written to a temporary file which is then
+ * renamed over the old one, so readers never see a partial snapshot.
+ * Nothing is written if @a config_hash matches the file, nothing was added
+ * and every blob in the file was used.
+ *
+ * @param[in] snap Snapshot
+ * @param[in] config_hash Hash of the configuration, from ib_snapshot_hash()
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EOTHER if the file could not be written.
+ */
+ib_status_t DLL_PUBLIC ib_snapshot_commit(ib_snapshot_t *snap,
+                                          uint64_t config_hash);
+
+/**
+ * Lookup statistics.
+ *
+ * @param[in] snap Snapshot
+ * @param[out] phits Address which number of successful gets is written
+ * @param[out] pmisses Address which number of failed gets is written
+ */
+void DLL_PUBLIC ib_snapshot_stats(const ib_snapshot_t *snap,
+                                  size_t *phits,
+                                  size_t *pmisses);
+
+/**
+ * Hash of the configuration recorded in the snapshot file.
+ *
+ * @param[in] snap Snapshot
+ *
+ * @returns Hash, or 0 if the snapshot was not loaded from a file.
+ */
+uint64_t DLL_PUBLIC ib_snapshot_config_hash(const ib_snapshot_t *snap);
+
+/**
+ * Fold @a data into a running 64 bit FNV-1a hash.
+ *
+ * Start from IB_SNAPSHOT_HASH_INIT.
+ *
+ * @param[in] hash Hash so far
+ * @param[in] data Data
+ * @param[in] len Length of @a data
+ *
+ * @returns Updated hash
+ */
+uint64_t DLL_PUBLIC ib_snapshot_hash(uint64_t hash,
+                                     const void *data,
+                                     size_t len);
+
+/** @} IronBeeSnapshot */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IB_SNAPSHOT_H_ */
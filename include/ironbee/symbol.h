@@ -0,0 +1,161 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef _IB_SYMBOL_H_
+#define _IB_SYMBOL_H_
+
+/**
+ * @file
+ * @brief IronBee &mdash; Symbol Table Utility Functions
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include <ironbee/build.h>
+#include <ironbee/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup IronBeeSymbol Symbol Table
+ * @ingroup IronBeeUtil
+ *
+ * Interned, case-insensitive names.
+ *
+ * A symbol table maps each distinct name (ignoring case) to a single
+ * symbol.  Symbols live as long as the table's memory pool, so their names
+ * can be used without copying, two symbols are the same name exactly when
+ * they are the same pointer, and the hash of a name is computed once, when
+ * it is interned.
+ *
+ * Names are interned while configuring.  Once the table is frozen it is
+ * immutable and may be read from any number of threads.
+ *
+ * @{
+ */
+
+/**
+ * Symbol table.
+ */
+typedef struct ib_symtab_t ib_symtab_t;
+
+/**
+ * Interned name.
+ *
+ * The hash values allow hash tables using ib_hashfunc_djb2_nocase() to
+ * find a symbol without hashing its name: for a table randomizer @c r the
+ * hash is <tt>r * hash_mul + hash</tt> (see ib_symbol_hash()).
+ */
+typedef struct ib_symbol_t ib_symbol_t;
+struct ib_symbol_t {
+    const char            *name;      /**< Name ('\\0' terminated) */
+    size_t                 nlen;      /**< Name length */
+    uint32_t               hash;      /**< Case-insensitive djb2, seed 0 */
+    uint32_t               hash_mul;  /**< 33 ^ nlen */
+};
+
+/**
+ * Create a symbol table.
+ *
+ * @param[out] psymtab Address which new table is written
+ * @param[in] mp Memory pool for the table and its symbols
+ *
+ * @returns Status code
+ */
+ib_status_t DLL_PUBLIC ib_symtab_create(ib_symtab_t **psymtab,
+                                        ib_mpool_t *mp);
+
+/**
+ * Intern a name.
+ *
+ * If the name (ignoring case) is already in the table, its symbol is
+ * returned; otherwise one is created, keeping the case of @a name.
+ *
+ * @param[in,out] symtab Symbol table
+ * @param[in] name Name (need not be '\\0' terminated)
+ * @param[in] nlen Length of @a name
+ * @param[out] psym Address which symbol is written
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if the table is frozen and @a name is not in it.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_symtab_intern(ib_symtab_t *symtab,
+                                        const char *name,
+                                        size_t nlen,
+                                        const ib_symbol_t **psym);
+
+/**
+ * Look up an interned name.
+ *
+ * @param[in] symtab Symbol table
+ * @param[in] name Name (need not be '\\0' terminated)
+ * @param[in] nlen Length of @a name
+ * @param[out] psym Address which symbol is written
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_ENOENT if @a name has not been interned.
+ */
+ib_status_t DLL_PUBLIC ib_symtab_lookup(const ib_symtab_t *symtab,
+                                        const char *name,
+                                        size_t nlen,
+                                        const ib_symbol_t **psym);
+
+/**
+ * Freeze a symbol table.
+ *
+ * No names are interned after this; the table may then be shared between
+ * threads without locking.
+ *
+ * @param[in,out] symtab Symbol table
+ */
+void DLL_PUBLIC ib_symtab_freeze(ib_symtab_t *symtab);
+
+/**
+ * Number of symbols in a table.
+ *
+ * @param[in] symtab Symbol table
+ *
+ * @returns Number of symbols
+ */
+size_t DLL_PUBLIC ib_symtab_size(const ib_symtab_t *symtab);
+
+/**
+ * Hash a symbol as ib_hashfunc_djb2_nocase() would.
+ *
+ * @param[in] sym Symbol
+ * @param[in] randomizer Hash table randomizer
+ *
+ * @returns ib_hashfunc_djb2_nocase(sym->name, sym->nlen, randomizer)
+ */
+uint32_t DLL_PUBLIC ib_symbol_hash(const ib_symbol_t *sym,
+                                   uint32_t randomizer);
+
+/** @} IronBeeSymbol */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IB_SYMBOL_H_ */
@@ -0,0 +1,190 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef _IB_TSTATS_H_
+#define _IB_TSTATS_H_
+
+/**
+ * @file
+ * @brief IronBee &mdash; Per-Thread Statistics Utility Functions
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include <ironbee/build.h>
+#include <ironbee/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup IronBeeTStats Per-Thread Statistics
+ * @ingroup IronBeeUtil
+ *
+ * Latency histograms, and a registry of per-thread counter blocks.
+ *
+ * Each thread that records statistics gets its own block of counters
+ * (found via thread specific data), so recording does no locking and no
+ * shared writes.  The blocks are linked into the registry, under a lock,
+ * once per thread, so that they can be summed for a report.  Reads of
+ * another thread's counters during a report are not synchronized; a report
+ * may miss the handful of events in flight at the time.
+ *
+ * @{
+ */
+
+/**
+ * Number of latency histogram buckets.
+ *
+ * Bucket N counts durations of [2^N, 2^(N+1)) ns; the last bucket also
+ * counts everything longer (~268ms).  With 29 buckets an ib_tstats_hist_t
+ * is exactly four 64 byte cache lines.
+ */
+#define IB_TSTATS_BUCKETS 29
+
+/** Size of the cache line blocks are aligned to. */
+#define IB_TSTATS_CACHE_LINE 64
+
+/**
+ * Latency histogram.
+ */
+typedef struct {
+    uint64_t     count;                       /**< Number of durations */
+    uint64_t     total_ns;                    /**< Sum of durations */
+    uint64_t     max_ns;                      /**< Longest duration */
+    uint64_t     hist[IB_TSTATS_BUCKETS];     /**< log2 histogram */
+} ib_tstats_hist_t;
+
+/**
+ * Registry of per-thread counter blocks.
+ */
+typedef struct ib_tstats_t ib_tstats_t;
+
+/**
+ * Per-thread block callback for ib_tstats_foreach().
+ *
+ * @param[in] block Counter block of one thread
+ * @param[in] cbdata Callback data
+ */
+typedef void (*ib_tstats_block_fn_t)(const void *block, void *cbdata);
+
+/**
+ * Record a duration in a histogram.
+ *
+ * @param[in,out] h Histogram
+ * @param[in] ns Duration in nanoseconds
+ */
+void DLL_PUBLIC ib_tstats_hist_record(ib_tstats_hist_t *h, uint64_t ns);
+
+/**
+ * Add one histogram to another.
+ *
+ * @param[in,out] dst Destination histogram
+ * @param[in] src Source histogram
+ */
+void DLL_PUBLIC ib_tstats_hist_add(ib_tstats_hist_t *dst,
+                                   const ib_tstats_hist_t *src);
+
+/**
+ * Estimate a percentile from a histogram.
+ *
+ * @param[in] h Histogram
+ * @param[in] pct Percentile (0-100)
+ *
+ * @returns Upper bound of the bucket containing the percentile (ns); the
+ *          longest duration if that is the last bucket.
+ */
+uint64_t DLL_PUBLIC ib_tstats_hist_percentile(const ib_tstats_hist_t *h,
+                                              unsigned int pct);
+
+/**
+ * Format the non-empty buckets of a histogram as "bucket:count ...".
+ *
+ * @param[in] h Histogram
+ * @param[out] buf Buffer; always NUL terminated
+ * @param[in] len Length of @a buf; at least 1
+ */
+void DLL_PUBLIC ib_tstats_hist_format(const ib_tstats_hist_t *h,
+                                      char *buf,
+                                      size_t len);
+
+/**
+ * Create a registry.
+ *
+ * The registry and its blocks are on the heap, as they are used from
+ * threads which can't share a memory pool.  Release them with
+ * ib_tstats_destroy().
+ *
+ * @param[out] pts Address which new registry is written
+ * @param[in] block_size Size of each thread's counter block
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if @a block_size is 0.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_tstats_create(ib_tstats_t **pts,
+                                        size_t block_size);
+
+/**
+ * Get the calling thread's counter block, creating it if required.
+ *
+ * A new block is zeroed and cache line aligned.  Only the calling thread
+ * may write to it.
+ *
+ * @param[in] ts Registry
+ *
+ * @returns Counter block or NULL on allocation failure
+ */
+void DLL_PUBLIC *ib_tstats_block(ib_tstats_t *ts);
+
+/**
+ * Call a function for every thread's counter block.
+ *
+ * The registry is locked during the calls; @a fn must not call other
+ * registry functions.
+ *
+ * @param[in] ts Registry
+ * @param[in] fn Function to call
+ * @param[in] cbdata Callback data for @a fn
+ *
+ * @returns Number of blocks
+ */
+size_t DLL_PUBLIC ib_tstats_foreach(ib_tstats_t *ts,
+                                    ib_tstats_block_fn_t fn,
+                                    void *cbdata);
+
+/**
+ * Destroy a registry and every thread's counter block.
+ *
+ * No thread may use the registry afterwards.
+ *
+ * @param[in] ts Registry
+ */
+void DLL_PUBLIC ib_tstats_destroy(ib_tstats_t *ts);
+
+/** @} IronBeeTStats */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IB_TSTATS_H_ */
@@ -26,6 +26,7 @@
 #define __IBPP__ALL__
 
 #include <include/ironbeepp/byte_string.hpp>
+#include <include/ironbeepp/byte_string_view.hpp>
 #include <include/ironbeepp/clock.hpp>
 #include <include/ironbeepp/common_semantics.hpp>
 #include <include/ironbeepp/configuration_directives.hpp>
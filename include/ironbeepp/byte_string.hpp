@@ -30,6 +30,7 @@
 #ifndef __IBPP__BYTE_STRING__
 #define __IBPP__BYTE_STRING__
 
+#include <ironbeepp/byte_string_view.hpp>
 #include <ironbeepp/common_semantics.hpp>
 #include <ironbeepp/exception.hpp>
 #include <ironbeepp/memory_pool.hpp>
@@ -125,6 +126,17 @@ public:
      **/
     std::string to_s() const;
 
+    /**
+     * Create view.
+     *
+     * Unlike to_s(), this does not copy: the view aliases the byte string's
+     * data and is valid until that data changes or its memory pool is
+     * destroyed.  A singular byte string results in an empty view.
+     *
+     * @returns view of same content as @c this.
+     **/
+    ByteStringView view() const;
+
     /**
      * Memory pool.
      *
@@ -351,6 +363,19 @@ public:
      **/
     static ByteString create(MemoryPool pool, const std::string& s);
 
+    /**
+     * Create copy of @a view using @a pool.
+     *
+     * Creates a new byte string using @a pool to allocate memory and set
+     * contents to a copy of @a view.
+     *
+     * @param[in] pool Memory pool to allocate memory from.
+     * @param[in] view Data to copy into byte string.
+     * @returns New byte string with copy of @a view.
+     * @throws IronBee++ exception on any error.
+     **/
+    static ByteString create(MemoryPool pool, ByteStringView view);
+
     /**
      * Create a byte string pointing to @a data.
      *
@@ -405,6 +430,25 @@ public:
         const std::string& s
     );
 
+    /**
+     * Create a read only byte string pointing to @a view.
+     *
+     * Creates a new byte string that uses the data of @a view as the
+     * underlying data.  Nothing is copied; the lifetime of that data must
+     * exceed the lifetime of the byte string.  This is the usual way to
+     * hand a view of engine data, e.g., from ConstField::value_as_view(),
+     * back to the engine.
+     *
+     * @param[in] pool Memory pool to allocate memory from.
+     * @param[in] view Data of byte string.
+     * @returns New byte string with alias of @a view.
+     * @throws IronBee++ exception on any error.
+     **/
+    static ByteString create_alias(
+        MemoryPool     pool,
+        ByteStringView view
+    );
+
     /// @}
 
     /**
@@ -0,0 +1,251 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee++ &mdash; ByteStringView
+ *
+ * This file defines ByteStringView, a non-owning view of a sequence of
+ * bytes.
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#ifndef __IBPP__BYTE_STRING_VIEW__
+#define __IBPP__BYTE_STRING_VIEW__
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace IronBee {
+
+/**
+ * Non-owning view of a sequence of bytes: a pointer and a length.
+ *
+ * Unlike ByteString, a ByteStringView is a plain value: it does not refer to
+ * an ib_bytestr_t, is never singular and never allocates.  It is returned by
+ * the @c *_view() accessors of ConstByteString, ConstField,
+ * ConstParsedNameValue, ConstParsedRequestLine and ConstParsedResponseLine
+ * so that inspection code can look at engine data without copying it into
+ * a @c std::string.
+ *
+ * The view does not extend the lifetime of the data.  Views of engine data
+ * are valid as long as the memory pool holding that data is, e.g., for the
+ * life of the transaction.  Use to_s() to make a copy that outlives it.
+ *
+ * ByteStringView provides the read-only part of the standard container
+ * interface (begin(), end(), size(), operator[], ...) and so can be used
+ * with standard algorithms and @c boost::algorithm::string.
+ *
+ * @sa ConstByteString::view()
+ * @nosubgrouping
+ **/
+class ByteStringView
+{
+public:
+    //! Value type.
+    typedef char value_type;
+    //! Size type.
+    typedef size_t size_type;
+    //! Difference type.
+    typedef ptrdiff_t difference_type;
+    //! Reference type.
+    typedef const char& reference;
+    //! Const reference type.
+    typedef const char& const_reference;
+    //! Pointer type.
+    typedef const char* pointer;
+    //! Const pointer type.
+    typedef const char* const_pointer;
+    //! Iterator type.
+    typedef const char* iterator;
+    //! Const iterator type.
+    typedef const char* const_iterator;
+
+    //! Construct empty view.
+    ByteStringView() :
+        m_data(NULL),
+        m_length(0)
+    {
+        // nop
+    }
+
+    /**
+     * Construct view of @a length bytes at @a data.
+     *
+     * @param[in] data   Data to view; may be NULL if @a length is 0.
+     * @param[in] length Length of @a data.
+     **/
+    ByteStringView(const char* data, size_t length) :
+        m_data(data),
+        m_length(length)
+    {
+        // nop
+    }
+
+    /**
+     * Construct view of null terminated @a cstring.
+     *
+     * @param[in] cstring String to view.
+     **/
+    ByteStringView(const char* cstring) :
+        m_data(cstring),
+        m_length(cstring ? ::strlen(cstring) : 0)
+    {
+        // nop
+    }
+
+    /**
+     * Construct view of @a s.
+     *
+     * The view is invalidated by any change to @a s.
+     *
+     * @param[in] s String to view.
+     **/
+    ByteStringView(const std::string& s) :
+        m_data(s.data()),
+        m_length(s.length())
+    {
+        // nop
+    }
+
+    /**
+     * @name Queries
+     * Query aspects of the view.
+     **/
+    ///@{
+
+    //! Pointer to data.  May be NULL if empty().
+    const char* data() const
+    {
+        return m_data;
+    }
+
+    //! Length of data.
+    size_t length() const
+    {
+        return m_length;
+    }
+
+    //! Length of data.
+    size_t size() const
+    {
+        return m_length;
+    }
+
+    //! True iff length is zero.
+    bool empty() const
+    {
+        return m_length == 0;
+    }
+
+    //! Beginning of data.
+    const_iterator begin() const
+    {
+        return m_data;
+    }
+
+    //! End of data.
+    const_iterator end() const
+    {
+        return m_data + m_length;
+    }
+
+    //! Byte at @a i.  Behavior is undefined if @a i >= length().
+    const char& operator[](size_t i) const
+    {
+        return m_data[i];
+    }
+
+    ///@}
+
+    /**
+     * @name Algorithms
+     * Algorithms involving the view.
+     **/
+    ///@{
+
+    /**
+     * View of @a length bytes starting at @a offset.
+     *
+     * The result is clamped to the end of the view.
+     *
+     * @param[in] offset Offset of first byte.
+     * @param[in] length Maximum length of result.
+     * @returns View of the requested range.
+     **/
+    ByteStringView substr(
+        size_t offset,
+        size_t length = std::string::npos
+    ) const;
+
+    /**
+     * Returns index of @a other in view.
+     *
+     * @param[in] other View to search for.
+     * @returns index of @a other or -1 if not a substring.
+     **/
+    int index_of(ByteStringView other) const;
+
+    /**
+     * Compare to @a other.
+     *
+     * @param[in] other View to compare to.
+     * @returns <0, 0, >0 as @c this is less than, equal to, or greater
+     *          than @a other.
+     **/
+    int compare(ByteStringView other) const;
+
+    /**
+     * Create string version.
+     *
+     * This will copy the data, and so allocates.
+     *
+     * @returns string with same content as @c this.
+     **/
+    std::string to_s() const;
+
+    ///@}
+
+private:
+    const char* m_data;
+    size_t      m_length;
+};
+
+//! Equality.
+bool operator==(ByteStringView a, ByteStringView b);
+//! Inequality.
+bool operator!=(ByteStringView a, ByteStringView b);
+//! Less than; lexicographic by byte.
+bool operator<(ByteStringView a, ByteStringView b);
+
+/**
+ * Output operator for ByteStringView.
+ *
+ * Outputs the bytes of @a view to @a o, unadorned.
+ *
+ * @param[in] o    Ostream to output to.
+ * @param[in] view View to output.
+ * @return @a o
+ **/
+std::ostream& operator<<(std::ostream& o, ByteStringView view);
+
+} // IronBee
+
+#endif
@@ -199,6 +199,9 @@ public:
     //! Name as string.
     std::string name_as_s() const;
 
+    //! Name as view; does not copy.
+    ByteStringView name_as_view() const;
+
     //! Type of field.
     type_e type() const;
 
@@ -271,6 +274,14 @@ public:
         size_t      arg_length
     ) const;
 
+    //! ByteString value as view; does not copy.
+    ByteStringView value_as_view() const;
+    //! ByteString value as view -- dynamic.
+    ByteStringView value_as_view(
+        const char* arg,
+        size_t      arg_length
+    ) const;
+
     //! List value accessor.
     template <typename T>
     ConstList<T> value_as_list() const;
@@ -26,22 +26,30 @@
  */
 
 #include <ironbeepp/engine.hpp>
+#include <ironbeepp/connection.hpp>
+#include <ironbeepp/connection_data.hpp>
+#include <ironbeepp/transaction.hpp>
+#include <ironbeepp/transaction_data.hpp>
+#include <ironbeepp/parsed_name_value.hpp>
+#include <ironbeepp/parsed_request_line.hpp>
+#include <ironbeepp/parsed_response_line.hpp>
+#include <ironbeepp/internal/catch.hpp>
+#include <ironbeepp/internal/throw.hpp>
+
+#include <ironbee/debug.h>
+#include <ironbee/engine.h>
+#include <ironbee/mpool.h>
 
 #include <boost/function.hpp>
 
+#include <cassert>
+#include <new>
+
 #ifndef __IBPP__HOOKS__
 #define __IBPP__HOOKS__
 
 namespace IronBee {
 
-class Transaction;
-class TransactionData;
-class Connection;
-class ConnectionData;
-class ParsedNameValue;
-class ParsedRequestLine;
-class ParsedResponseLine;
-
 /**
  * Helper class for Engine::register_hooks().
  *
@@ -56,6 +64,24 @@ class ParsedResponseLine;
  *       ;
  * @endcode
  *
+ * Each registration stores the callback as a @c boost::function boxed in a
+ * @c boost::any and every event unboxes it before calling it.  Hot hooks can
+ * avoid that cost by using the Direct Registration methods instead, which
+ * take the functor type as a template parameter:
+ *
+ * @code
+ * struct on_request_headers
+ * {
+ *     void operator()(
+ *         Engine engine, Transaction tx, Engine::state_event_e event
+ *     ) const;
+ * };
+ *
+ * engine.register_hooks()
+ *       .transaction_direct(Engine::request_headers, on_request_headers())
+ *       ;
+ * @endcode
+ *
  * @sa Engine::register_hooks()
  * @sa Engine::state_event_e
  * @nosubgrouping
@@ -707,10 +733,621 @@ public:
 
     ///@}
 
+    /**
+     * @name Direct Registration
+     * Register by functor type.
+     *
+     * These are equivalent to the Generic Registration methods except that
+     * the functor type is a template parameter.  A copy of @a f is
+     * constructed in the engine main memory pool and a C trampoline
+     * specific to @a F is registered with the engine.  The trampoline calls
+     * @a f directly: there is no @c boost::function or @c boost::any
+     * between the engine and the functor and the call can be inlined.
+     * Exceptions are translated to status codes as for the other methods.
+     *
+     * @a F must be copy constructible and callable with the same arguments
+     * as the corresponding callback type above.  The copy is destroyed
+     * when the engine main memory pool is.
+     *
+     * All methods return @c *this to allow for call chaining.
+     **/
+    ///@{
+
+    /**
+     * Register null functor.
+     *
+     * @tparam F Functor type; see null_t.
+     * @param[in] event Event to register for.
+     * @param[in] f     Functor to register.
+     * @returns @c *this for call chaining.
+     * @throw einval if callback type is not appropriate for @a event.
+     **/
+    template <typename F>
+    HooksRegistrar& null_direct(
+        Engine::state_event_e event,
+        const F&              f = F()
+    );
+
+    /**
+     * Register headers data functor.
+     *
+     * @tparam F Functor type; see headers_data_t.
+     * @param[in] event Event to register for.
+     * @param[in] f     Functor to register.
+     * @returns @c *this for call chaining.
+     * @throw einval if callback type is not appropriate for @a event.
+     **/
+    template <typename F>
+    HooksRegistrar& headers_data_direct(
+        Engine::state_event_e event,
+        const F&              f = F()
+    );
+
+    /**
+     * Register request line functor.
+     *
+     * @tparam F Functor type; see request_line_t.
+     * @param[in] event Event to register for.
+     * @param[in] f     Functor to register.
+     * @returns @c *this for call chaining.
+     * @throw einval if callback type is not appropriate for @a event.
+     **/
+    template <typename F>
+    HooksRegistrar& request_line_direct(
+        Engine::state_event_e event,
+        const F&              f = F()
+    );
+
+    /**
+     * Register response line functor.
+     *
+     * @tparam F Functor type; see response_line_t.
+     * @param[in] event Event to register for.
+     * @param[in] f     Functor to register.
+     * @returns @c *this for call chaining.
+     * @throw einval if callback type is not appropriate for @a event.
+     **/
+    template <typename F>
+    HooksRegistrar& response_line_direct(
+        Engine::state_event_e event,
+        const F&              f = F()
+    );
+
+    /**
+     * Register connection functor.
+     *
+     * @tparam F Functor type; see connection_t.
+     * @param[in] event Event to register for.
+     * @param[in] f     Functor to register.
+     * @returns @c *this for call chaining.
+     * @throw einval if callback type is not appropriate for @a event.
+     **/
+    template <typename F>
+    HooksRegistrar& connection_direct(
+        Engine::state_event_e event,
+        const F&              f = F()
+    );
+
+    /**
+     * Register connection data functor.
+     *
+     * @tparam F Functor type; see connection_data_t.
+     * @param[in] event Event to register for.
+     * @param[in] f     Functor to register.
+     * @returns @c *this for call chaining.
+     * @throw einval if callback type is not appropriate for @a event.
+     **/
+    template <typename F>
+    HooksRegistrar& connection_data_direct(
+        Engine::state_event_e event,
+        const F&              f = F()
+    );
+
+    /**
+     * Register transaction functor.
+     *
+     * @tparam F Functor type; see transaction_t.
+     * @param[in] event Event to register for.
+     * @param[in] f     Functor to register.
+     * @returns @c *this for call chaining.
+     * @throw einval if callback type is not appropriate for @a event.
+     **/
+    template <typename F>
+    HooksRegistrar& transaction_direct(
+        Engine::state_event_e event,
+        const F&              f = F()
+    );
+
+    /**
+     * Register transaction data functor.
+     *
+     * @tparam F Functor type; see transaction_data_t.
+     * @param[in] event Event to register for.
+     * @param[in] f     Functor to register.
+     * @returns @c *this for call chaining.
+     * @throw einval if callback type is not appropriate for @a event.
+     **/
+    template <typename F>
+    HooksRegistrar& transaction_data_direct(
+        Engine::state_event_e event,
+        const F&              f = F()
+    );
+
+    ///@}
+
 private:
+    /**
+     * Copy @a f into the engine main memory pool.
+     *
+     * The copy is destroyed when the pool is.
+     *
+     * @tparam F Functor type.
+     * @param[in] f Functor to copy.
+     * @returns Pointer to copy, suitable as hook callback data.
+     * @throw ealloc on allocation failure.
+     **/
+    template <typename F>
+    void* direct_data(const F& f);
+
     Engine m_engine;
 };
 
+namespace Internal {
+/// @cond Internal
+namespace DirectHooks {
+
+/**
+ * Memory pool cleanup: destroy a functor constructed by direct_data().
+ *
+ * @param[in] cbdata Functor to destroy.
+ * @returns IB_OK
+ **/
+template <typename F>
+ib_status_t destroy(void* cbdata)
+{
+    static_cast<F*>(cbdata)->~F();
+    return IB_OK;
+}
+
+/**
+ * Direct hooks handler for null callbacks.
+ *
+ * @param[in] ib_engine The IronBee engine.
+ * @param[in] event     Which event happened.
+ * @param[in] cbdata    Callback data: functor of type @a F.
+ * @returns Status code reflecting any exceptions thrown.
+ **/
+template <typename F>
+ib_status_t null(
+    ib_engine_t*          ib_engine,
+    ib_state_event_type_t event,
+    void*                 cbdata
+)
+{
+    IB_FTRACE_INIT();
+
+    assert(ib_engine != NULL);
+    assert(cbdata != NULL);
+
+    IB_FTRACE_RET_STATUS(IBPP_TRY_CATCH(ib_engine,
+        (*static_cast<F*>(cbdata))(
+            Engine(ib_engine),
+            static_cast<Engine::state_event_e>(event)
+        )
+    ));
+}
+
+/**
+ * Direct hooks handler for headers_data callbacks.
+ *
+ * @param[in] ib_engine  The IronBee engine.
+ * @param[in] ib_tx      Transaction.
+ * @param[in] event      Which event happened.
+ * @param[in] ib_headers Data of event.
+ * @param[in] cbdata     Callback data: functor of type @a F.
+ * @returns Status code reflecting any exceptions thrown.
+ **/
+template <typename F>
+ib_status_t headers_data(
+    ib_engine_t*          ib_engine,
+    ib_tx_t*              ib_tx,
+    ib_state_event_type_t event,
+    ib_parsed_header_t*   ib_headers,
+    void*                 cbdata
+)
+{
+    IB_FTRACE_INIT();
+
+    assert(ib_engine != NULL);
+    /* ib_tx may be NULL */
+    assert(ib_headers != NULL);
+    assert(cbdata != NULL);
+
+    IB_FTRACE_RET_STATUS(IBPP_TRY_CATCH(ib_engine,
+        (*static_cast<F*>(cbdata))(
+            Engine(ib_engine),
+            Transaction(ib_tx),
+            static_cast<Engine::state_event_e>(event),
+            ParsedNameValue(ib_headers)
+        )
+    ));
+}
+
+/**
+ * Direct hooks handler for request_line callbacks.
+ *
+ * @param[in] ib_engine       The IronBee engine.
+ * @param[in] ib_tx           Transaction.
+ * @param[in] event           Which event happened.
+ * @param[in] ib_request_line Data of event.
+ * @param[in] cbdata          Callback data: functor of type @a F.
+ * @returns Status code reflecting any exceptions thrown.
+ **/
+template <typename F>
+ib_status_t request_line(
+    ib_engine_t*          ib_engine,
+    ib_tx_t*              ib_tx,
+    ib_state_event_type_t event,
+    ib_parsed_req_line_t* ib_request_line,
+    void*                 cbdata
+)
+{
+    IB_FTRACE_INIT();
+
+    assert(ib_engine != NULL);
+    /* ib_tx may be NULL */
+    assert(ib_request_line != NULL);
+    assert(cbdata != NULL);
+
+    IB_FTRACE_RET_STATUS(IBPP_TRY_CATCH(ib_engine,
+        (*static_cast<F*>(cbdata))(
+            Engine(ib_engine),
+            Transaction(ib_tx),
+            static_cast<Engine::state_event_e>(event),
+            ParsedRequestLine(ib_request_line)
+        )
+    ));
+}
+
+/**
+ * Direct hooks handler for response_line callbacks.
+ *
+ * @param[in] ib_engine        The IronBee engine.
+ * @param[in] ib_tx            Transaction.
+ * @param[in] event            Which event happened.
+ * @param[in] ib_response_line Data of event.
+ * @param[in] cbdata           Callback data: functor of type @a F.
+ * @returns Status code reflecting any exceptions thrown.
+ **/
+template <typename F>
+ib_status_t response_line(
+    ib_engine_t*           ib_engine,
+    ib_tx_t*               ib_tx,
+    ib_state_event_type_t  event,
+    ib_parsed_resp_line_t* ib_response_line,
+    void*                  cbdata
+)
+{
+    IB_FTRACE_INIT();
+
+    assert(ib_engine != NULL);
+    /* ib_tx may be NULL */
+    assert(ib_response_line != NULL);
+    assert(cbdata != NULL);
+
+    IB_FTRACE_RET_STATUS(IBPP_TRY_CATCH(ib_engine,
+        (*static_cast<F*>(cbdata))(
+            Engine(ib_engine),
+            Transaction(ib_tx),
+            static_cast<Engine::state_event_e>(event),
+            ParsedResponseLine(ib_response_line)
+        )
+    ));
+}
+
+/**
+ * Direct hooks handler for connection callbacks.
+ *
+ * @param[in] ib_engine     The IronBee engine.
+ * @param[in] event         Which event happened.
+ * @param[in] ib_connection Data of event.
+ * @param[in] cbdata        Callback data: functor of type @a F.
+ * @returns Status code reflecting any exceptions thrown.
+ **/
+template <typename F>
+ib_status_t connection(
+    ib_engine_t*          ib_engine,
+    ib_state_event_type_t event,
+    ib_conn_t*            ib_connection,
+    void*                 cbdata
+)
+{
+    IB_FTRACE_INIT();
+
+    assert(ib_engine != NULL);
+    assert(ib_connection != NULL);
+    assert(cbdata != NULL);
+
+    IB_FTRACE_RET_STATUS(IBPP_TRY_CATCH(ib_engine,
+        (*static_cast<F*>(cbdata))(
+            Engine(ib_engine),
+            static_cast<Engine::state_event_e>(event),
+            Connection(ib_connection)
+        )
+    ));
+}
+
+/**
+ * Direct hooks handler for connection_data callbacks.
+ *
+ * @param[in] ib_engine          The IronBee engine.
+ * @param[in] event              Which event happened.
+ * @param[in] ib_connection_data Data of event.
+ * @param[in] cbdata             Callback data: functor of type @a F.
+ * @returns Status code reflecting any exceptions thrown.
+ **/
+template <typename F>
+ib_status_t connection_data(
+    ib_engine_t*          ib_engine,
+    ib_state_event_type_t event,
+    ib_conndata_t*        ib_connection_data,
+    void*                 cbdata
+)
+{
+    IB_FTRACE_INIT();
+
+    assert(ib_engine != NULL);
+    assert(ib_connection_data != NULL);
+    assert(cbdata != NULL);
+
+    IB_FTRACE_RET_STATUS(IBPP_TRY_CATCH(ib_engine,
+        (*static_cast<F*>(cbdata))(
+            Engine(ib_engine),
+            static_cast<Engine::state_event_e>(event),
+            ConnectionData(ib_connection_data)
+        )
+    ));
+}
+
+/**
+ * Direct hooks handler for transaction callbacks.
+ *
+ * @param[in] ib_engine The IronBee engine.
+ * @param[in] ib_tx     Transaction.
+ * @param[in] event     Which event happened.
+ * @param[in] cbdata    Callback data: functor of type @a F.
+ * @returns Status code reflecting any exceptions thrown.
+ **/
+template <typename F>
+ib_status_t transaction(
+    ib_engine_t*          ib_engine,
+    ib_tx_t*              ib_tx,
+    ib_state_event_type_t event,
+    void*                 cbdata
+)
+{
+    IB_FTRACE_INIT();
+
+    assert(ib_engine != NULL);
+    assert(ib_tx != NULL);
+    assert(cbdata != NULL);
+
+    IB_FTRACE_RET_STATUS(IBPP_TRY_CATCH(ib_engine,
+        (*static_cast<F*>(cbdata))(
+            Engine(ib_engine),
+            Transaction(ib_tx),
+            static_cast<Engine::state_event_e>(event)
+        )
+    ));
+}
+
+/**
+ * Direct hooks handler for transaction_data callbacks.
+ *
+ * @param[in] ib_engine           The IronBee engine.
+ * @param[in] ib_tx               Transaction.
+ * @param[in] event               Which event happened.
+ * @param[in] ib_transaction_data Data of event.
+ * @param[in] cbdata              Callback data: functor of type @a F.
+ * @returns Status code reflecting any exceptions thrown.
+ **/
+template <typename F>
+ib_status_t transaction_data(
+    ib_engine_t*          ib_engine,
+    ib_tx_t*              ib_tx,
+    ib_state_event_type_t event,
+    ib_txdata_t*          ib_transaction_data,
+    void*                 cbdata
+)
+{
+    IB_FTRACE_INIT();
+
+    assert(ib_engine != NULL);
+    assert(ib_tx != NULL);
+    assert(ib_transaction_data != NULL);
+    assert(cbdata != NULL);
+
+    IB_FTRACE_RET_STATUS(IBPP_TRY_CATCH(ib_engine,
+        (*static_cast<F*>(cbdata))(
+            Engine(ib_engine),
+            Transaction(ib_tx),
+            static_cast<Engine::state_event_e>(event),
+            TransactionData(ib_transaction_data)
+        )
+    ));
+}
+
+} // DirectHooks
+/// @endcond
+} // Internal
+
+template <typename F>
+void* HooksRegistrar::direct_data(const F& f)
+{
+    ib_mpool_t* mp = m_engine.main_memory_pool().ib();
+    void* mem = ib_mpool_alloc(mp, sizeof(F));
+    if (mem == NULL) {
+        BOOST_THROW_EXCEPTION(ealloc() << errinfo_what(
+            "Could not allocate direct hook functor."
+        ));
+    }
+
+    F* copy = new (mem) F(f);
+    Internal::throw_if_error(
+        ib_mpool_cleanup_register(
+            mp,
+            &Internal::DirectHooks::destroy<F>,
+            copy
+        )
+    );
+
+    return copy;
+}
+
+template <typename F>
+HooksRegistrar& HooksRegistrar::null_direct(
+    Engine::state_event_e event,
+    const F&              f
+)
+{
+    Internal::throw_if_error(
+        ib_hook_null_register(
+            m_engine.ib(),
+            static_cast<ib_state_event_type_t>(event),
+            &Internal::DirectHooks::null<F>,
+            direct_data(f)
+        )
+    );
+
+    return *this;
+}
+
+template <typename F>
+HooksRegistrar& HooksRegistrar::headers_data_direct(
+    Engine::state_event_e event,
+    const F&              f
+)
+{
+    Internal::throw_if_error(
+        ib_hook_parsed_header_data_register(
+            m_engine.ib(),
+            static_cast<ib_state_event_type_t>(event),
+            &Internal::DirectHooks::headers_data<F>,
+            direct_data(f)
+        )
+    );
+
+    return *this;
+}
+
+template <typename F>
+HooksRegistrar& HooksRegistrar::request_line_direct(
+    Engine::state_event_e event,
+    const F&              f
+)
+{
+    Internal::throw_if_error(
+        ib_hook_parsed_req_line_register(
+            m_engine.ib(),
+            static_cast<ib_state_event_type_t>(event),
+            &Internal::DirectHooks::request_line<F>,
+            direct_data(f)
+        )
+    );
+
+    return *this;
+}
+
+template <typename F>
+HooksRegistrar& HooksRegistrar::response_line_direct(
+    Engine::state_event_e event,
+    const F&              f
+)
+{
+    Internal::throw_if_error(
+        ib_hook_parsed_resp_line_register(
+            m_engine.ib(),
+            static_cast<ib_state_event_type_t>(event),
+            &Internal::DirectHooks::response_line<F>,
+            direct_data(f)
+        )
+    );
+
+    return *this;
+}
+
+template <typename F>
+HooksRegistrar& HooksRegistrar::connection_direct(
+    Engine::state_event_e event,
+    const F&              f
+)
+{
+    Internal::throw_if_error(
+        ib_hook_conn_register(
+            m_engine.ib(),
+            static_cast<ib_state_event_type_t>(event),
+            &Internal::DirectHooks::connection<F>,
+            direct_data(f)
+        )
+    );
+
+    return *this;
+}
+
+template <typename F>
+HooksRegistrar& HooksRegistrar::connection_data_direct(
+    Engine::state_event_e event,
+    const F&              f
+)
+{
+    Internal::throw_if_error(
+        ib_hook_conndata_register(
+            m_engine.ib(),
+            static_cast<ib_state_event_type_t>(event),
+            &Internal::DirectHooks::connection_data<F>,
+            direct_data(f)
+        )
+    );
+
+    return *this;
+}
+
+template <typename F>
+HooksRegistrar& HooksRegistrar::transaction_direct(
+    Engine::state_event_e event,
+    const F&              f
+)
+{
+    Internal::throw_if_error(
+        ib_hook_tx_register(
+            m_engine.ib(),
+            static_cast<ib_state_event_type_t>(event),
+            &Internal::DirectHooks::transaction<F>,
+            direct_data(f)
+        )
+    );
+
+    return *this;
+}
+
+template <typename F>
+HooksRegistrar& HooksRegistrar::transaction_data_direct(
+    Engine::state_event_e event,
+    const F&              f
+)
+{
+    Internal::throw_if_error(
+        ib_hook_txdata_register(
+            m_engine.ib(),
+            static_cast<ib_state_event_type_t>(event),
+            &Internal::DirectHooks::transaction_data<F>,
+            direct_data(f)
+        )
+    );
+
+    return *this;
+}
+
 } // IronBee
 
 #endif
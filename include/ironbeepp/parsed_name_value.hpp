@@ -105,6 +105,12 @@ public:
     //! Value.
     ByteString value() const;
 
+    //! Name as view; does not copy.
+    ByteStringView name_view() const;
+
+    //! Value as view; does not copy.
+    ByteStringView value_view() const;
+
     //! Next name/value.
     ParsedNameValue next() const;
 
@@ -31,6 +31,7 @@
 #ifndef __IBPP__PARSED_REQUEST_LINE__
 #define __IBPP__PARSED_REQUEST_LINE__
 
+#include <ironbeepp/byte_string_view.hpp>
 #include <ironbeepp/common_semantics.hpp>
 
 #include <ostream>
@@ -103,6 +104,18 @@ public:
     //! HTTP Protocol.
     ByteString protocol() const;
 
+    //! Raw request line as view; does not copy.
+    ByteStringView raw_view() const;
+
+    //! HTTP Method as view; does not copy.
+    ByteStringView method_view() const;
+
+    //! HTTP URI as view; does not copy.
+    ByteStringView uri_view() const;
+
+    //! HTTP Protocol as view; does not copy.
+    ByteStringView protocol_view() const;
+
     /**
      * Create a ConstParsedRequestLine, aliasing memory.
      *
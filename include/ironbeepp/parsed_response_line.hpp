@@ -31,6 +31,7 @@
 #ifndef __IBPP__PARSED_RESPONSE_LINE__
 #define __IBPP__PARSED_RESPONSE_LINE__
 
+#include <ironbeepp/byte_string_view.hpp>
 #include <ironbeepp/common_semantics.hpp>
 
 #include <ostream>
@@ -103,6 +104,18 @@ public:
     //! HTTP Message.
     ByteString message() const;
 
+    //! Raw response line as view; does not copy.
+    ByteStringView raw_view() const;
+
+    //! HTTP Protocol as view; does not copy.
+    ByteStringView protocol_view() const;
+
+    //! HTTP Status as view; does not copy.
+    ByteStringView status_view() const;
+
+    //! HTTP Message as view; does not copy.
+    ByteStringView message_view() const;
+
 
    /**
     * Create a ConstParsedResponseLine, aliasing memory.
@@ -85,6 +85,14 @@ std::string ConstByteString::to_s() const
     return std::string(const_data(), length());
 }
 
+ByteStringView ConstByteString::view() const
+{
+    if (! ib()) {
+        return ByteStringView();
+    }
+    return ByteStringView(const_data(), length());
+}
+
 MemoryPool ConstByteString::memory_pool() const
 {
     return MemoryPool(ib_bytestr_mpool(ib()));
@@ -185,6 +193,11 @@ ByteString ByteString::create(MemoryPool pool, const std::string& s)
     return ByteString::create(pool, s.data(), s.length());
 }
 
+ByteString ByteString::create(MemoryPool pool, ByteStringView view)
+{
+    return ByteString::create(pool, view.data(), view.length());
+}
+
 ByteString ByteString::create_alias(
     MemoryPool  pool,
     const char* data,
@@ -225,6 +238,14 @@ ByteString ByteString::create_alias(
     return create_alias(pool, s.data(), s.length());
 }
 
+ByteString ByteString::create_alias(
+    MemoryPool     pool,
+    ByteStringView view
+)
+{
+    return create_alias(pool, view.data(), view.length());
+}
+
 char* ByteString::data() const
 {
     return reinterpret_cast<char*>(ib_bytestr_ptr(ib()));
@@ -311,7 +332,7 @@ std::ostream& operator<<(std::ostream& o, const ConstByteString& bytestr)
         o << "IronBee::ByteString[!singular!]";
     }
     else {
-        o << "IronBee::ByteString[" << bytestr.to_s() << "]";
+        o << "IronBee::ByteString[" << bytestr.view() << "]";
     }
 
     return o;
@@ -0,0 +1,98 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee++ Byte String View Implementation
+ * @internal
+ *
+ * @sa byte_string_view.hpp
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include <ironbeepp/byte_string_view.hpp>
+
+#include <algorithm>
+
+namespace IronBee {
+
+ByteStringView ByteStringView::substr(size_t offset, size_t length) const
+{
+    if (offset >= m_length) {
+        return ByteStringView();
+    }
+    return ByteStringView(
+        m_data + offset,
+        std::min(length, m_length - offset)
+    );
+}
+
+int ByteStringView::index_of(ByteStringView other) const
+{
+    if (other.empty()) {
+        return 0;
+    }
+    const_iterator i = std::search(begin(), end(), other.begin(), other.end());
+    if (i == end()) {
+        return -1;
+    }
+    return i - begin();
+}
+
+int ByteStringView::compare(ByteStringView other) const
+{
+    size_t n = std::min(m_length, other.m_length);
+    int rc = (n == 0) ? 0 : ::memcmp(m_data, other.m_data, n);
+    if (rc != 0) {
+        return rc;
+    }
+    if (m_length < other.m_length) {
+        return -1;
+    }
+    return m_length > other.m_length ? 1 : 0;
+}
+
+std::string ByteStringView::to_s() const
+{
+    return m_length == 0 ? std::string() : std::string(m_data, m_length);
+}
+
+bool operator==(ByteStringView a, ByteStringView b)
+{
+    return a.length() == b.length() && a.compare(b) == 0;
+}
+
+bool operator!=(ByteStringView a, ByteStringView b)
+{
+    return ! (a == b);
+}
+
+bool operator<(ByteStringView a, ByteStringView b)
+{
+    return a.compare(b) < 0;
+}
+
+std::ostream& operator<<(std::ostream& o, ByteStringView view)
+{
+    if (! view.empty()) {
+        o.write(view.data(), view.length());
+    }
+    return o;
+}
+
+} // IronBee
@@ -417,6 +417,11 @@ std::string ConstField::name_as_s() const
     return std::string(name(), name_length());
 }
 
+ByteStringView ConstField::name_as_view() const
+{
+    return ByteStringView(name(), name_length());
+}
+
 ConstField::type_e ConstField::type() const
 {
     return static_cast<ConstField::type_e>(ib()->type);
@@ -566,6 +571,19 @@ ConstByteString ConstField::value_as_byte_string(
     return ConstByteString(v);
 }
 
+ByteStringView ConstField::value_as_view() const
+{
+    return value_as_byte_string().view();
+}
+
+ByteStringView ConstField::value_as_view(
+    const char* arg,
+    size_t      arg_length
+) const
+{
+    return value_as_byte_string(arg, arg_length).view();
+}
+
 /* Field */
 
 // See api documentation for discussion of const_cast.
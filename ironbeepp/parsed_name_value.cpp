@@ -29,6 +29,16 @@ ByteString ConstParsedNameValue::value() const
     return ByteString(ib()->value);
 }
 
+ByteStringView ConstParsedNameValue::name_view() const
+{
+    return ConstByteString(ib()->name).view();
+}
+
+ByteStringView ConstParsedNameValue::value_view() const
+{
+    return ConstByteString(ib()->value).view();
+}
+
 ParsedNameValue ConstParsedNameValue::next() const
 {
     return ParsedNameValue(ib()->next);
@@ -80,8 +90,8 @@ std::ostream& operator<<(
         o << "IronBee::ParsedNameValue[!singular!]";
     } else {
         o << "IronBee::ParsedNameValue["
-          << parsed_name_value.name().to_s() << ":"
-          << parsed_name_value.value().to_s() << "]";
+          << parsed_name_value.name_view() << ":"
+          << parsed_name_value.value_view() << "]";
     }
     return o;
 }
@@ -43,6 +43,26 @@ ByteString ConstParsedRequestLine::protocol() const
     return ByteString(ib()->protocol);
 }
 
+ByteStringView ConstParsedRequestLine::raw_view() const
+{
+    return ConstByteString(ib()->raw).view();
+}
+
+ByteStringView ConstParsedRequestLine::method_view() const
+{
+    return ConstByteString(ib()->method).view();
+}
+
+ByteStringView ConstParsedRequestLine::uri_view() const
+{
+    return ConstByteString(ib()->uri).view();
+}
+
+ByteStringView ConstParsedRequestLine::protocol_view() const
+{
+    return ConstByteString(ib()->protocol).view();
+}
+
 ConstParsedRequestLine ConstParsedRequestLine::create_alias(
     Transaction transaction,
     const char* raw,
@@ -101,9 +121,9 @@ std::ostream& operator<<(std::ostream& o, const ConstParsedRequestLine& parsed_r
         o << "IronBee::ParsedRequestLine[!singular!]";
     } else {
         o << "IronBee::ParsedRequestLine["
-          << parsed_request_line.method().to_s() << " "
-          << parsed_request_line.uri().to_s() << " "
-          << parsed_request_line.protocol().to_s() << "]";
+          << parsed_request_line.method_view() << " "
+          << parsed_request_line.uri_view() << " "
+          << parsed_request_line.protocol_view() << "]";
     }
     return o;
 }
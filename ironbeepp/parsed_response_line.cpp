@@ -43,6 +43,26 @@ ByteString ConstParsedResponseLine::message() const
     return ByteString(ib()->msg);
 }
 
+ByteStringView ConstParsedResponseLine::raw_view() const
+{
+    return ConstByteString(ib()->raw).view();
+}
+
+ByteStringView ConstParsedResponseLine::protocol_view() const
+{
+    return ConstByteString(ib()->protocol).view();
+}
+
+ByteStringView ConstParsedResponseLine::status_view() const
+{
+    return ConstByteString(ib()->status).view();
+}
+
+ByteStringView ConstParsedResponseLine::message_view() const
+{
+    return ConstByteString(ib()->msg).view();
+}
+
 ConstParsedResponseLine ConstParsedResponseLine::create_alias(
     Transaction transaction,
     const char* raw,
@@ -101,8 +121,8 @@ std::ostream& operator<<(std::ostream& o, const ConstParsedResponseLine& parsed_
         o << "IronBee::ParsedResponseLine[!singular!]";
     } else {
         o << "IronBee::ParsedResponseLine["
-          << parsed_response_line.status().to_s() << " "
-          << parsed_response_line.message().to_s() << "]";
+          << parsed_response_line.status_view() << " "
+          << parsed_response_line.message_view() << "]";
     }
     return o;
 }
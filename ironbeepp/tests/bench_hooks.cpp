@@ -0,0 +1,148 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee++ &mdash; Hook Dispatch Micro-Benchmark
+ * @internal
+ *
+ * Registers the same transaction functor once through
+ * HooksRegistrar::transaction() and once through
+ * HooksRegistrar::transaction_direct() and calls each hook directly, the
+ * way the engine does, reporting the time per call.
+ *
+ * This is not run by "make check"; build and run it with "make bench".
+ * The number of calls can be passed via BENCH_FLAGS, e.g.:
+ *
+ * @code
+ * make bench BENCH_FLAGS="10000000"
+ * @endcode
+ *
+ * @author Christopher Alfeld <calfeld@qualys.com>
+ **/
+
+#include <ironbeepp/hooks.hpp>
+
+#include "fixture.hpp"
+
+#include <ironbee/engine.h>
+
+#include "ironbee_private.h"
+
+#include <cstdlib>
+#include <stdint.h>
+#include <iostream>
+
+#include <time.h>
+
+using namespace std;
+using namespace IronBee;
+
+namespace {
+
+uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+struct counter
+{
+    explicit counter(size_t& n) : m_n(n) {}
+
+    void operator()(Engine, Transaction, Engine::state_event_e) const
+    {
+        ++m_n;
+    }
+
+    size_t& m_n;
+};
+
+class HookBench : public IBPPTestFixture
+{
+public:
+    /**
+     * Time @a calls invocations of the last hook registered for @a event.
+     *
+     * @param[in] event Event to call hook for.
+     * @param[in] calls Number of calls.
+     * @returns Nanoseconds per call.
+     **/
+    double run(Engine::state_event_e event, size_t calls)
+    {
+        ib_hook_t* hook = m_engine.ib()->hook[event];
+        while (hook->next != NULL) {
+            hook = hook->next;
+        }
+
+        ib_state_event_type_t ib_event =
+            static_cast<ib_state_event_type_t>(event);
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < calls; ++i) {
+            hook->callback.tx(
+                m_engine.ib(), m_transaction.ib(), ib_event, hook->cdata
+            );
+        }
+
+        return double(now_ns() - start) / calls;
+    }
+
+    void register_boxed(Engine::state_event_e event, const counter& c)
+    {
+        HooksRegistrar(m_engine).transaction(event, c);
+    }
+
+    void register_direct(Engine::state_event_e event, const counter& c)
+    {
+        HooksRegistrar(m_engine).transaction_direct(event, c);
+    }
+};
+
+} // Anonymous
+
+int main(int argc, char** argv)
+{
+    size_t calls = 1000000;
+    if (argc > 1) {
+        calls = strtoul(argv[1], NULL, 10);
+    }
+    if (calls == 0) {
+        cerr << "Usage: " << argv[0] << " [calls]" << endl;
+        return 1;
+    }
+
+    size_t n = 0;
+    HookBench bench;
+
+    bench.register_boxed(Engine::request_headers, counter(n));
+    bench.register_direct(Engine::response_headers, counter(n));
+
+    /* Warm up both paths before measuring. */
+    bench.run(Engine::request_headers, calls / 10 + 1);
+    bench.run(Engine::response_headers, calls / 10 + 1);
+
+    double boxed  = bench.run(Engine::request_headers, calls);
+    double direct = bench.run(Engine::response_headers, calls);
+
+    cout << "calls:  " << calls << endl
+         << "boxed:  " << boxed << " ns/call" << endl
+         << "direct: " << direct << " ns/call" << endl
+         << "ratio:  " << boxed / direct << endl;
+
+    return n > 0 ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee++ Internals &mdash; Byte String View Tests
+ * @internal
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ **/
+
+#include <ironbeepp/byte_string_view.hpp>
+#include <ironbeepp/byte_string.hpp>
+#include <ironbeepp/memory_pool.hpp>
+
+#include "gtest/gtest.h"
+
+#include <ironbee/debug.h>
+
+#include <algorithm>
+#include <string>
+#include <sstream>
+
+using namespace std;
+using IronBee::ByteString;
+using IronBee::ByteStringView;
+using IronBee::ConstByteString;
+using IronBee::MemoryPool;
+
+TEST(TestByteStringView, Basic)
+{
+    ByteStringView v;
+    EXPECT_TRUE(v.empty());
+    EXPECT_EQ(0UL, v.length());
+    EXPECT_EQ(v.begin(), v.end());
+    EXPECT_EQ("", v.to_s());
+
+    const char* s = "foo\0bar";
+    v = ByteStringView(s, 7);
+    EXPECT_FALSE(v.empty());
+    EXPECT_EQ(7UL, v.size());
+    EXPECT_EQ(s, v.data());
+    EXPECT_EQ('b', v[4]);
+    EXPECT_EQ(string(s, 7), v.to_s());
+    EXPECT_EQ(7, distance(v.begin(), v.end()));
+    EXPECT_EQ(1, count(v.begin(), v.end(), '\0'));
+
+    v = ByteStringView("hello");
+    EXPECT_EQ(5UL, v.length());
+
+    string str("world");
+    v = str;
+    EXPECT_EQ(str.data(), v.data());
+    EXPECT_EQ(str.length(), v.length());
+}
+
+TEST(TestByteStringView, Algorithms)
+{
+    ByteStringView v("hello world");
+
+    EXPECT_EQ(ByteStringView("world"), v.substr(6));
+    EXPECT_EQ(ByteStringView("lo"), v.substr(3, 2));
+    EXPECT_TRUE(v.substr(11).empty());
+    EXPECT_TRUE(v.substr(100).empty());
+
+    EXPECT_EQ(6, v.index_of("world"));
+    EXPECT_EQ(0, v.index_of(""));
+    EXPECT_EQ(-1, v.index_of("planet"));
+
+    EXPECT_TRUE(ByteStringView("abc") == string("abc"));
+    EXPECT_TRUE(ByteStringView("abc") != ByteStringView("abd"));
+    EXPECT_TRUE(ByteStringView("ab") < ByteStringView("abc"));
+    EXPECT_TRUE(ByteStringView("abc") < ByteStringView("abd"));
+    EXPECT_FALSE(ByteStringView("abd") < ByteStringView("abc"));
+    EXPECT_EQ(0, ByteStringView().compare(ByteStringView("", 0)));
+
+    stringstream out;
+    out << v;
+    EXPECT_EQ("hello world", out.str());
+}
+
+TEST(TestByteStringView, ByteString)
+{
+    MemoryPool pool = MemoryPool::create();
+
+    EXPECT_TRUE(ConstByteString().view().empty());
+
+    ByteString bs = ByteString::create(pool, "foobar");
+    ByteStringView v = bs.view();
+    EXPECT_EQ(bs.const_data(), v.data());
+    EXPECT_EQ(bs.length(), v.length());
+    EXPECT_EQ("foobar", v.to_s());
+
+    ByteString alias = ByteString::create_alias(pool, v.substr(3));
+    EXPECT_TRUE(alias.read_only());
+    EXPECT_EQ(bs.const_data() + 3, alias.const_data());
+    EXPECT_EQ("bar", alias.to_s());
+
+    ByteString copy = ByteString::create(pool, v.substr(0, 3));
+    EXPECT_NE(bs.const_data(), copy.const_data());
+    EXPECT_EQ("foo", copy.to_s());
+
+    stringstream out;
+    out << bs;
+    EXPECT_EQ("IronBee::ByteString[foobar]", out.str());
+}
@@ -88,7 +88,11 @@ TEST_F(TestField, Construction)
     EXPECT_TRUE(f);
     EXPECT_EQ(Field::BYTE_STRING, f.type());
     EXPECT_EQ(bs.to_s(), f.value_as_byte_string().to_s());
+    EXPECT_EQ(bs.to_s(), f.value_as_view().to_s());
+    EXPECT_EQ(bs.length(), f.value_as_view().length());
     EXPECT_EQ("test", f.name_as_s());
+    EXPECT_EQ(f.name(), f.name_as_view().data());
+    EXPECT_EQ(4UL, f.name_as_view().length());
     EXPECT_EQ(m_pool, f.memory_pool());
     EXPECT_FALSE(f.is_dynamic());
 
@@ -151,6 +155,7 @@ TEST_F(TestField, SetAndGet)
     EXPECT_THROW(f.value_as_list<int*>(),      IronBee::einval);
     EXPECT_NO_THROW(f.set_byte_string(bs2));
     EXPECT_EQ("value2", f.value_as_byte_string().to_s());
+    EXPECT_EQ("value2", f.value_as_view().to_s());
 
     List<int*> l = List<int*>::create(m_pool);
     f = Field::create_no_copy_list(m_pool, "test", 4, l);
@@ -518,6 +523,7 @@ TEST_F(TestField, CreateNoCopy)
     Field f2 = Field::create_no_copy_byte_string(m_pool, "foo", 3, b);
     b.set("Test4");
     EXPECT_EQ(b.to_s(), f2.value_as_byte_string().to_s());
+    EXPECT_EQ(b.const_data(), f2.value_as_view().data());
 
     List<int*> l = List<int*>::create(m_pool);
     Field f3 = Field::create_no_copy_list(m_pool, "foo", 3, l);
@@ -472,3 +472,32 @@ TEST_F(TestHooks, Basic)
     test_transaction_data(Engine::response_body_data, info);
 }
 
+
+TEST_F(TestHooks, Direct)
+{
+    HooksRegistrar H(m_engine);
+    handler_info_t info;
+    Handler handler(info);
+
+    H.null_direct(Engine::configuration_started, handler);
+    test_null(Engine::configuration_started, info);
+    H.headers_data_direct(Engine::request_headers_data, handler);
+    test_headers_data(Engine::request_headers_data, info);
+    H.request_line_direct(Engine::request_started, handler);
+    test_request_line(Engine::request_started, info);
+    H.response_line_direct(Engine::response_started, handler);
+    test_response_line(Engine::response_started, info);
+    H.connection_direct(Engine::connection_opened, handler);
+    test_connection(Engine::connection_opened, info);
+    H.connection_data_direct(Engine::connection_data_in, handler);
+    test_connection_data(Engine::connection_data_in, info);
+    H.transaction_direct(Engine::request_headers, handler);
+    test_transaction(Engine::request_headers, info);
+    H.transaction_data_direct(Engine::request_body_data, handler);
+    test_transaction_data(Engine::request_body_data, info);
+
+    EXPECT_THROW(
+        H.transaction_direct(Engine::connection_opened, handler),
+        einval
+    );
+}
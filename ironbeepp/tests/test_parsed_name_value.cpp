@@ -66,4 +66,6 @@ TEST(TestParsedNameValue, create)
     ASSERT_TRUE(pnv);
     EXPECT_EQ("foo", pnv.name().to_s());
     EXPECT_EQ("bar", pnv.value().to_s());
+    EXPECT_EQ(pnv.name().const_data(), pnv.name_view().data());
+    EXPECT_EQ("bar", pnv.value_view().to_s());
 }
@@ -24,6 +24,8 @@
  * @author Pablo Rincon <pablo.rincon.crespo@gmail.com>
  */
 
+#include "ironbee_config_auto.h"
+
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -347,6 +349,7 @@ static ib_status_t pmf_operator_create(ib_engine_t *ib,
 
     char* file = NULL;
     char* line = NULL;
+    char* saveptr = NULL;
     size_t pattern_file_len = strlen(pattern_file);
 
     /* Escaped directive and length. */
@@ -397,7 +400,10 @@ static ib_status_t pmf_operator_create(ib_engine_t *ib,
     /* Iterate through the file contents, one line at a time.
      * Each line is unescaped (allowing null characters) into line_unescaped
      * and added to the ahocorasic object as a pattern. */
-    for (line=strtok(file, "\n"); line != NULL; line=strtok(NULL, "\n")) {
+    for (line = strtok_r(file, "\n", &saveptr);
+         line != NULL;
+         line = strtok_r(NULL, "\n", &saveptr))
+    {
         size_t line_len = strlen(line);
 
         if ( line_len > 0 ) {
@@ -457,6 +463,7 @@ static ib_status_t pm_operator_create(ib_engine_t *ib,
     size_t tok_buffer_sz = pattern_len+1;
     char* tok_buffer = malloc(tok_buffer_sz);
     char* tok;
+    char* saveptr = NULL;
 
     if (tok_buffer == NULL ) {
         IB_FTRACE_RET_STATUS(IB_EALLOC);
@@ -478,7 +485,9 @@ static ib_status_t pm_operator_create(ib_engine_t *ib,
         IB_FTRACE_RET_STATUS(rc);
     }
 
-    for (tok = strtok(tok_buffer, " "); tok != NULL; tok = strtok(NULL, " "))
+    for (tok = strtok_r(tok_buffer, " ", &saveptr);
+         tok != NULL;
+         tok = strtok_r(NULL, " ", &saveptr))
     {
         if (strlen(tok) > 0) {
             rc = ib_ac_add_pattern(ac, tok, &nop_ac_match, NULL, 0);
@@ -592,13 +601,13 @@ static ib_status_t modac_init(ib_engine_t *ib,
 
     ib_operator_register(ib,
                          "pm",
-                         IB_OP_FLAG_PHASE|IB_OP_FLAG_STREAM,
+                         IB_OP_FLAG_PHASE|IB_OP_FLAG_STREAM|IB_OP_FLAG_DEFER,
                          &pm_operator_create,
                          &pm_operator_destroy,
                          &pm_operator_execute);
     ib_operator_register(ib,
                          "pmf",
-                         IB_OP_FLAG_PHASE|IB_OP_FLAG_STREAM,
+                         IB_OP_FLAG_PHASE|IB_OP_FLAG_STREAM|IB_OP_FLAG_DEFER,
                          &pmf_operator_create,
                          &pm_operator_destroy,
                          &pm_operator_execute);
@@ -16,8 +16,13 @@
  *****************************************************************************/
 
 #include <assert.h>
+#include <inttypes.h>
 #include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <strings.h>
+#include <sys/types.h>
 
 #include <GeoIPCity.h>
 
@@ -29,6 +34,10 @@
 #include <ironbee/util.h>
 #include <ironbee/config.h>
 #include <ironbee/field.h>
+#include <ironbee/hash.h>
+#include <ironbee/lru.h>
+#include <ironbee/mpool.h>
+#include <ironbee/string.h>
 
 /* Define the module name as well as a string version of it. */
 #define MODULE_NAME        geoip
@@ -40,9 +49,306 @@ IB_MODULE_DECLARE();
 
 /**
  * @internal
- * The GeoIP database.
+ * Module configuration.
+ *
+ * The database and the lookup cache belong to the engine: they are only
+ * set on the main context, and are released when it is destroyed.
+ */
+typedef struct {
+    ib_num_t       cache_size;  /**< Max cached addresses (0=disabled) */
+    GeoIP         *db;          /**< The GeoIP database */
+    ib_lrucache_t *cache;       /**< Lookup cache or NULL */
+} geoip_cfg_t;
+
+/* Instantiate a module global configuration. */
+static geoip_cfg_t geoip_global_cfg = {
+    16384,                      /* cache_size */
+    NULL,                       /* db */
+    NULL                        /* cache */
+};
+
+/* Key of the per-connection lookup memo in the connection data hash. */
+#define GEOIP_CONN_KEY "GEOIP_CONN_MEMO"
+
+/**
+ * @internal
+ * String items of a GeoIP record, in the order they are added to the
+ * GEOIP list.
+ */
+static const char *geoip_str_names[] = {
+    "country_code",
+    "country_code3",
+    "country_name",
+    "region",
+    "city",
+    "postal_code",
+    "continent_code",
+};
+#define GEOIP_NUM_STRS \
+    (sizeof(geoip_str_names) / sizeof(geoip_str_names[0]))
+
+#ifdef GEOIP_HAVE_VERSION
+/**
+ * @internal
+ * Single character confidence items of a GeoIP record.
+ */
+static const char *geoip_conf_names[] = {
+    "country_conf",
+    "region_conf",
+    "city_conf",
+    "postal_conf",
+};
+#define GEOIP_NUM_CONFS \
+    (sizeof(geoip_conf_names) / sizeof(geoip_conf_names[0]))
+#endif /* GEOIP_HAVE_VERSION */
+
+/**
+ * @internal
+ * Result of looking up a single address, copied out of the GeoIPRecord.
+ *
+ * The string items are stored in the data block that follows the entry;
+ * string items are offsets into that block.  An entry is cached as a
+ * single value, keyed by the address.
+ */
+typedef struct {
+    ib_bool_t      found;                 /**< Was a record found? */
+    ib_num_t       latitude;              /**< Rounded latitude */
+    ib_num_t       longitude;             /**< Rounded longitude */
+    ib_num_t       area_code;             /**< Area code */
+    ib_num_t       charset;               /**< Character set */
+    ssize_t        str[GEOIP_NUM_STRS];   /**< String offsets or -1 */
+#ifdef GEOIP_HAVE_VERSION
+    ib_num_t       accuracy_radius;       /**< Accuracy radius */
+    ib_num_t       metro_code;            /**< Metro code */
+    char           conf[GEOIP_NUM_CONFS]; /**< Confidence items */
+#endif /* GEOIP_HAVE_VERSION */
+    size_t         data_len;              /**< Length of data block */
+    char           data[];                /**< String items */
+} geoip_entry_t;
+
+/**
+ * @internal
+ * Per-connection lookup memo.
  */
-static GeoIP *geoip_db = NULL;
+typedef struct {
+    const char *ip;             /**< Address that was looked up */
+    ib_field_t *list;           /**< The resulting GEOIP list */
+} geoip_memo_t;
+
+/**
+ * @internal
+ * Create an entry from a GeoIP record.
+ *
+ * @param[in] mp Memory pool to allocate the entry from
+ * @param[in] rec GeoIP record, or NULL if none was found
+ *
+ * @returns The new entry, or NULL on allocation failure
+ */
+static geoip_entry_t *geoip_entry_create(ib_mpool_t *mp,
+                                         const GeoIPRecord *rec)
+{
+    const char *strs[GEOIP_NUM_STRS] = { NULL };
+    size_t data_len = 0;
+    geoip_entry_t *entry;
+    char *p;
+    size_t n;
+
+    if (rec != NULL) {
+        strs[0] = rec->country_code;
+        strs[1] = rec->country_code3;
+        strs[2] = rec->country_name;
+        strs[3] = rec->region;
+        strs[4] = rec->city;
+        strs[5] = rec->postal_code;
+        strs[6] = rec->continent_code;
+    }
+    for (n = 0; n < GEOIP_NUM_STRS; ++n) {
+        if (strs[n] != NULL) {
+            data_len += strlen(strs[n]) + 1;
+        }
+    }
+
+    entry = (geoip_entry_t *)
+        ib_mpool_calloc(mp, 1, sizeof(*entry) + data_len);
+    if (entry == NULL) {
+        return NULL;
+    }
+    entry->data_len = data_len;
+    p = entry->data;
+    for (n = 0; n < GEOIP_NUM_STRS; ++n) {
+        if (strs[n] == NULL) {
+            entry->str[n] = -1;
+        }
+        else {
+            size_t len = strlen(strs[n]) + 1;
+            memcpy(p, strs[n], len);
+            entry->str[n] = p - entry->data;
+            p += len;
+        }
+    }
+
+    if (rec != NULL) {
+        entry->found = IB_TRUE;
+        entry->latitude = lround(rec->latitude);
+        entry->longitude = lround(rec->longitude);
+        entry->area_code = rec->area_code;
+        entry->charset = rec->charset;
+#ifdef GEOIP_HAVE_VERSION
+        entry->accuracy_radius = rec->accuracy_radius;
+        entry->metro_code = rec->metro_code;
+        entry->conf[0] = rec->country_conf;
+        entry->conf[1] = rec->region_conf;
+        entry->conf[2] = rec->city_conf;
+        entry->conf[3] = rec->postal_conf;
+#endif /* GEOIP_HAVE_VERSION */
+    }
+    else {
+        entry->found = IB_FALSE;
+    }
+
+    return entry;
+}
+
+/**
+ * @internal
+ * Destroy an engine's lookup cache, logging its hit rate.
+ *
+ * @param[in] ib IronBee engine
+ * @param[in,out] cfg Main context configuration
+ */
+static void geoip_cache_destroy(ib_engine_t *ib, geoip_cfg_t *cfg)
+{
+    IB_FTRACE_INIT();
+    uint64_t hits;
+    uint64_t misses;
+
+    if (cfg->cache == NULL) {
+        IB_FTRACE_RET_VOID();
+    }
+
+    ib_lrucache_stats(cfg->cache, &hits, &misses);
+    ib_lrucache_destroy(cfg->cache);
+    cfg->cache = NULL;
+
+    ib_log_info(ib, "GeoIP cache: %" PRIu64 " hits, %" PRIu64 " misses "
+                "(%.1f%% hit rate)",
+                hits, misses,
+                ((hits + misses) == 0) ? 0.0 :
+                (100.0 * (double)hits) / (double)(hits + misses));
+    IB_FTRACE_RET_VOID();
+}
+
+/**
+ * @internal
+ * Create a field and add it to the GEOIP list.
+ *
+ * @param[in] mp Memory pool
+ * @param[in] list GEOIP list
+ * @param[in] name Field name
+ * @param[in] type Field type
+ * @param[in] in_pval Field value
+ *
+ * @returns Status code
+ */
+static ib_status_t geoip_list_add(ib_mpool_t *mp,
+                                  ib_field_t *list,
+                                  const char *name,
+                                  ib_ftype_t type,
+                                  void *in_pval)
+{
+    IB_FTRACE_INIT();
+    ib_field_t *tmp_field;
+    ib_status_t rc;
+
+    rc = ib_field_create(&tmp_field, mp, IB_FIELD_NAME(name), type, in_pval);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    rc = ib_field_list_add(list, tmp_field);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+/**
+ * @internal
+ * Fill in the GEOIP list from a lookup result.
+ *
+ * @param[in] mp Memory pool
+ * @param[in] list GEOIP list
+ * @param[in] entry Lookup result
+ *
+ * @returns Status code
+ */
+static ib_status_t geoip_list_fill(ib_mpool_t *mp,
+                                   ib_field_t *list,
+                                   const geoip_entry_t *entry)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+    size_t n;
+
+    /* Append the floats latitude and longitude.
+     * NOTE: Future work may add a float type to the Ironbee DPI. */
+    rc = geoip_list_add(mp, list, "latitude", IB_FTYPE_NUM,
+                        ib_ftype_num_in(&entry->latitude));
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    rc = geoip_list_add(mp, list, "longitude", IB_FTYPE_NUM,
+                        ib_ftype_num_in(&entry->longitude));
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    /* Add integers. */
+    rc = geoip_list_add(mp, list, "area_code", IB_FTYPE_NUM,
+                        ib_ftype_num_in(&entry->area_code));
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    rc = geoip_list_add(mp, list, "charset", IB_FTYPE_NUM,
+                        ib_ftype_num_in(&entry->charset));
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    /* Add strings. */
+    for (n = 0; n < GEOIP_NUM_STRS; ++n) {
+        if (entry->str[n] < 0) {
+            continue;
+        }
+        rc = geoip_list_add(mp, list, geoip_str_names[n], IB_FTYPE_NULSTR,
+                            ib_ftype_nulstr_in(entry->data + entry->str[n]));
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+
+    /* If we have GeoIP_lib_version() we are using GeoIP > 1.4.6 which means we also support confidence items */
+#ifdef GEOIP_HAVE_VERSION
+    rc = geoip_list_add(mp, list, "accuracy_radius", IB_FTYPE_NUM,
+                        ib_ftype_num_in(&entry->accuracy_radius));
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    rc = geoip_list_add(mp, list, "metro_code", IB_FTYPE_NUM,
+                        ib_ftype_num_in(&entry->metro_code));
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    /* Wrap single character arguments into a 2-character string and add. */
+    for (n = 0; n < GEOIP_NUM_CONFS; ++n) {
+        char one_char_str[2] = { entry->conf[n], '\0' };
+        rc = geoip_list_add(mp, list, geoip_conf_names[n], IB_FTYPE_NULSTR,
+                            ib_ftype_nulstr_in(one_char_str));
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+#endif /* GEOIP_HAVE_VERSION */
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
 
 static ib_status_t geoip_lookup(
     ib_engine_t *ib,
@@ -54,22 +360,13 @@ static ib_status_t geoip_lookup(
     IB_FTRACE_INIT();
 
     const char *ip = tx->er_ipstr;
+    ib_conn_t *conn = tx->conn;
 
     if (ip == NULL) {
         ib_log_alert_tx(tx, "Trying to lookup NULL IP in GEOIP");
         IB_FTRACE_RET_STATUS(IB_EINVAL);
     }
 
-#ifdef GEOIP_HAVE_VERSION
-    /**
-     * Some configurations exist as single characters and must be converted to
-     * a string. This is simply a place to assemble that string before
-     * it is passed into ip_data_add_nulstr.
-     * This is only needed if we have support confidence items. WAM
-     */
-    char one_char_str[2] = { '\0', '\0' };
-#endif /* GEOIP_HAVE_VERSION */
-
     ib_status_t rc;
 
     /* Declare and initialize the GeoIP property list.
@@ -78,27 +375,53 @@ static ib_status_t geoip_lookup(
      * record. */
     ib_field_t *geoip_lst = NULL;
 
-    ib_field_t *tmp_field = NULL;
-
-    ib_num_t longitude;
-    ib_num_t latitude;
-
-    GeoIPRecord *geoip_rec;
+    geoip_memo_t *memo = NULL;
+    geoip_entry_t *entry = NULL;
+    ib_bool_t cached = IB_FALSE;
+    const char *ip_copy;
+    geoip_cfg_t *cfg;
+
+    /* Requests on a keep-alive connection normally share an address, so
+     * reuse the list built for the previous request when possible. */
+    ib_hash_get(conn->data, &memo, GEOIP_CONN_KEY);
+    if ( (memo != NULL) && (strcmp(memo->ip, ip) == 0) ) {
+        ib_log_debug_tx(tx, "GeoIP Lookup '%s' (connection cached)", ip);
+        rc = ib_data_add(tx->dpi, memo->list);
+        if (rc != IB_OK) {
+            ib_log_alert_tx(tx, "Unable to add GEOIP list to DPI.");
+            IB_FTRACE_RET_STATUS(IB_EINVAL);
+        }
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
 
     ib_log_debug_tx(tx, "GeoIP Lookup '%s'", ip);
 
-    /* Build a new list. */
-    rc = ib_data_add_list(tx->dpi, "GEOIP", &geoip_lst);
-
-    /* NOTICE: Called before GeoIP_record_by_addr allocates a
-     * GeoIPRecord. */
+    /* Build a new list.  It is allocated from the connection so that
+     * later transactions on the connection can share it. */
+    rc = ib_field_create(&geoip_lst,
+                         conn->mp,
+                         IB_FIELD_NAME("GEOIP"),
+                         IB_FTYPE_LIST,
+                         NULL);
+    if (rc == IB_OK) {
+        rc = ib_data_add(tx->dpi, geoip_lst);
+    }
     if (rc != IB_OK)
     {
         ib_log_alert_tx(tx, "Unable to add GEOIP list to DPI.");
         IB_FTRACE_RET_STATUS(IB_EINVAL);
     }
 
-    if (geoip_db == NULL) {
+    /* The database and cache are on the main context */
+    rc = ib_context_module_config(ib_context_main(ib),
+                                  IB_MODULE_STRUCT_PTR, (void *)&cfg);
+    if (rc != IB_OK) {
+        ib_log_error_tx(tx, "Failed to fetch GeoIP config: %s",
+                        ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    if (cfg->db == NULL) {
         ib_log_alert_tx(tx,
                      "GeoIP database was never opened. Perhaps the "
                      "configuration file needs a GeoIPDatabaseFile "
@@ -106,176 +429,65 @@ static ib_status_t geoip_lookup(
         IB_FTRACE_RET_STATUS(IB_EINVAL);
     }
 
-    geoip_rec = GeoIP_record_by_addr(geoip_db, ip);
-
-    if (geoip_rec != NULL)
-    {
-        ib_log_debug_tx(tx, "GeoIP record found.");
-
-        /* Append the floats latitude and longitude.
-         * NOTE: Future work may add a float type to the Ironbee DPI. */
-
-        latitude = lround(geoip_rec->latitude);
-        ib_field_create(&tmp_field,
-                        tx->mp,
-                        IB_FIELD_NAME("latitude"),
-                        IB_FTYPE_NUM,
-                        ib_ftype_num_in(&latitude));
-        ib_field_list_add(geoip_lst, tmp_field);
-
-        longitude = lround(geoip_rec->longitude);
-        ib_field_create(&tmp_field,
-                        tx->mp,
-                        IB_FIELD_NAME("longitude"),
-                        IB_FTYPE_NUM,
-                        ib_ftype_num_in(&longitude));
-        ib_field_list_add(geoip_lst, tmp_field);
-
-        /* Add integers. */
-        tmp_field = NULL;
-
-        /* Avoids type-punning errors on gcc 4.2.4 with holder values. */
-        const ib_num_t charset = geoip_rec->charset;
-        const ib_num_t area_code = geoip_rec->area_code;;
-
-        ib_field_create(&tmp_field,
-                        tx->mp,
-                        IB_FIELD_NAME("area_code"),
-                        IB_FTYPE_NUM,
-                        ib_ftype_num_in(&area_code));
-        ib_field_list_add(geoip_lst, tmp_field);
-        ib_field_create(&tmp_field,
-                        tx->mp,
-                        IB_FIELD_NAME("charset"),
-                        IB_FTYPE_NUM,
-                        ib_ftype_num_in(&charset));
-        ib_field_list_add(geoip_lst, tmp_field);
-
-        /* Add strings. */
-        if (geoip_rec->country_code!=NULL)
-        {
-            ib_field_create(&tmp_field,
-                            tx->mp,
-                            IB_FIELD_NAME("country_code"),
-                            IB_FTYPE_NULSTR,
-                            ib_ftype_nulstr_in(geoip_rec->country_code));
-            ib_field_list_add(geoip_lst, tmp_field);
+    /* Try the engine's cache before searching the database. */
+    if (cfg->cache != NULL) {
+        rc = ib_lrucache_get(cfg->cache, conn->mp, ip, strlen(ip),
+                             (void **)&entry, NULL);
+        if (rc == IB_EALLOC) {
+            IB_FTRACE_RET_STATUS(rc);
         }
+        cached = (rc == IB_OK) ? IB_TRUE : IB_FALSE;
+    }
+    if (cached == IB_FALSE) {
+        GeoIPRecord *geoip_rec = GeoIP_record_by_addr(cfg->db, ip);
 
-        if (geoip_rec->country_code3!=NULL)
-        {
-            ib_field_create(&tmp_field,
-                            tx->mp,
-                            IB_FIELD_NAME("country_code3"),
-                            IB_FTYPE_NULSTR,
-                            ib_ftype_nulstr_in(geoip_rec->country_code3));
-            ib_field_list_add(geoip_lst, tmp_field);
+        entry = geoip_entry_create(conn->mp, geoip_rec);
+        if (geoip_rec != NULL) {
+            GeoIPRecord_delete(geoip_rec);
         }
-
-        if (geoip_rec->country_name!=NULL)
-        {
-            ib_field_create(&tmp_field,
-                            tx->mp,
-                            IB_FIELD_NAME("country_name"),
-                            IB_FTYPE_NULSTR,
-                            ib_ftype_nulstr_in(geoip_rec->country_name));
-            ib_field_list_add(geoip_lst, tmp_field);
+        if (entry == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
         }
 
-        if (geoip_rec->region!=NULL)
-        {
-            ib_field_create(&tmp_field,
-                            tx->mp,
-                            IB_FIELD_NAME("region"),
-                            IB_FTYPE_NULSTR,
-                            ib_ftype_nulstr_in(geoip_rec->region));
-            ib_field_list_add(geoip_lst, tmp_field);
+        /* Failing to cache the entry only costs a later lookup. */
+        if (cfg->cache != NULL) {
+            ib_lrucache_set(cfg->cache, ip, strlen(ip),
+                            entry, sizeof(*entry) + entry->data_len);
         }
+    }
 
-        if (geoip_rec->city!=NULL)
-        {
-            ib_field_create(&tmp_field,
-                            tx->mp,
-                            IB_FIELD_NAME("city"),
-                            IB_FTYPE_NULSTR,
-                            ib_ftype_nulstr_in(geoip_rec->city));
-            ib_field_list_add(geoip_lst, tmp_field);
-        }
+    if (entry->found == IB_TRUE) {
+        ib_log_debug_tx(tx, "GeoIP record found.");
+        rc = geoip_list_fill(conn->mp, geoip_lst, entry);
+    }
+    else {
+        ib_log_debug_tx(tx, "No GeoIP record found.");
+        rc = IB_OK;
+    }
 
-        if (geoip_rec->postal_code!=NULL)
-        {
-            ib_field_create(&tmp_field,
-                            tx->mp,
-                            IB_FIELD_NAME("postal_code"),
-                            IB_FTYPE_NULSTR,
-                            ib_ftype_nulstr_in(geoip_rec->postal_code));
-            ib_field_list_add(geoip_lst, tmp_field);
-        }
+    if (rc != IB_OK) {
+        ib_log_error_tx(tx, "Failed to build GEOIP list: %s",
+                        ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
 
-        if (geoip_rec->continent_code!=NULL)
-        {
-            ib_field_create(&tmp_field,
-                            tx->mp,
-                            IB_FIELD_NAME("continent_code"),
-                            IB_FTYPE_NULSTR,
-                            ib_ftype_nulstr_in(geoip_rec->continent_code));
-            ib_field_list_add(geoip_lst, tmp_field);
+    /* Remember the result for the rest of the connection. */
+    ip_copy = ib_mpool_strdup(conn->mp, ip);
+    if (ip_copy == NULL) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    if (memo == NULL) {
+        memo = (geoip_memo_t *)ib_mpool_alloc(conn->mp, sizeof(*memo));
+        if (memo == NULL) {
+            IB_FTRACE_RET_STATUS(IB_OK);
         }
-        /* If we have GeoIP_lib_version() we are using GeoIP > 1.4.6 which means we also support confidence items */
-#ifdef GEOIP_HAVE_VERSION
-        ib_field_create(&tmp_field,
-                        tx->mp,
-                        IB_FIELD_NAME("accuracy_radius"),
-                        IB_FTYPE_NUM,
-                        ib_ftype_num_in(&geoip_rec->accuracy_radius));
-        ib_field_list_add(geoip_lst, tmp_field);
-
-        ib_field_create(&tmp_field,
-                        tx->mp,
-                        IB_FIELD_NAME("metro_code"),
-                        IB_FTYPE_NUM,
-                        ib_ftype_num_in(&geoip_rec->metro_code));
-        ib_field_list_add(geoip_lst, tmp_field);
-
-        /* Wrap single character arguments into a 2-character string and add. */
-        one_char_str[0] = geoip_rec->country_conf;
-        ib_field_create(&tmp_field,
-                        tx->mp,
-                        IB_FIELD_NAME("country_conf"),
-                        IB_FTYPE_NULSTR,
-                        ib_ftype_nulstr_in(one_char_str));
-        ib_field_list_add(geoip_lst, tmp_field);
-
-        one_char_str[0] = geoip_rec->region_conf;
-        ib_field_create(&tmp_field,
-                        tx->mp,
-                        IB_FIELD_NAME("region_conf"),
-                        IB_FTYPE_NULSTR,
-                        ib_ftype_nulstr_in(one_char_str));
-        ib_field_list_add(geoip_lst, tmp_field);
-
-        one_char_str[0] = geoip_rec->city_conf;
-        ib_field_create(&tmp_field,
-                        tx->mp,
-                        IB_FIELD_NAME("city_conf"),
-                        IB_FTYPE_NULSTR,
-                        ib_ftype_nulstr_in(one_char_str));
-        ib_field_list_add(geoip_lst, tmp_field);
-
-        one_char_str[0] = geoip_rec->postal_conf;
-        ib_field_create(&tmp_field,
-                        tx->mp,
-                        IB_FIELD_NAME("postal_conf"),
-                        IB_FTYPE_NULSTR,
-                        ib_ftype_nulstr_in(one_char_str));
-        ib_field_list_add(geoip_lst, tmp_field);
-#endif /* GEOIP_HAVE_VERSION */
-
-        GeoIPRecord_delete(geoip_rec);
+        memo->ip = ip_copy;
+        memo->list = geoip_lst;
+        ib_hash_set(conn->data, GEOIP_CONN_KEY, memo);
     }
-    else
-    {
-        ib_log_debug_tx(tx, "No GeoIP record found.");
+    else {
+        memo->ip = ip_copy;
+        memo->list = geoip_lst;
     }
 
     IB_FTRACE_RET_STATUS(IB_OK);
@@ -295,8 +507,17 @@ static ib_status_t geoip_database_file_dir_param1(ib_cfgparser_t *cp,
     ib_status_t rc;
     size_t p1_len = strlen(p1);
     size_t p1_unescaped_len;
-    char *p1_unescaped = malloc(p1_len+1);
+    char *p1_unescaped;
+    geoip_cfg_t *cfg;
+
+    /* The database is engine wide, so always set on the main context. */
+    rc = ib_context_module_config(ib_context_main(cp->ib),
+                                  IB_MODULE_STRUCT_PTR, (void *)&cfg);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
 
+    p1_unescaped = malloc(p1_len+1);
     if ( p1_unescaped == NULL ) {
         IB_FTRACE_RET_STATUS(IB_EALLOC);
     }
@@ -318,20 +539,21 @@ static ib_status_t geoip_database_file_dir_param1(ib_cfgparser_t *cp,
         IB_FTRACE_RET_STATUS(rc);
     }
 
-    if (geoip_db != NULL)
+    /* Only this engine's database is replaced; others keep their own. */
+    if (cfg->db != NULL)
     {
-        GeoIP_delete(geoip_db);
-        geoip_db = NULL;
+        GeoIP_delete(cfg->db);
+        cfg->db = NULL;
     }
 
     IB_FTRACE_MSG("Initializing custom GeoIP database...");
     IB_FTRACE_MSG(p1_unescaped);
 
-    geoip_db = GeoIP_open(p1_unescaped, GEOIP_MMAP_CACHE);
+    cfg->db = GeoIP_open(p1_unescaped, GEOIP_MMAP_CACHE);
 
     free(p1_unescaped);
 
-    if (geoip_db == NULL)
+    if (cfg->db == NULL)
     {
         IB_FTRACE_MSG("Failed to initialize GeoIP database.");
         IB_FTRACE_RET_STATUS(IB_EUNKNOWN);
@@ -340,6 +562,43 @@ static ib_status_t geoip_database_file_dir_param1(ib_cfgparser_t *cp,
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
+static ib_status_t geoip_cache_size_dir_param1(ib_cfgparser_t *cp,
+                                               const char *name,
+                                               const char *p1,
+                                               void *cbdata)
+{
+    IB_FTRACE_INIT();
+
+    assert(cp!=NULL);
+    assert(name!=NULL);
+    assert(p1!=NULL);
+
+    ib_status_t rc;
+    ib_num_t size;
+
+    rc = ib_string_to_num(p1, 0, &size);
+    if ( (rc != IB_OK) || (size < 0) || (size >= UINT32_MAX) ) {
+        ib_log_error(cp->ib, "Invalid %s \"%s\"", name, p1);
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    /* The cache is engine wide, so always set on the main context. */
+    rc = ib_context_set_num(ib_context_main(cp->ib),
+                            MODULE_NAME_STR ".cache_size",
+                            size);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+static IB_CFGMAP_INIT_STRUCTURE(geoip_config_map) = {
+    IB_CFGMAP_INIT_ENTRY(
+        MODULE_NAME_STR ".cache_size",
+        IB_FTYPE_NUM,
+        geoip_cfg_t,
+        cache_size
+    ),
+    IB_CFGMAP_INIT_LAST
+};
+
 static IB_DIRMAP_INIT_STRUCTURE(geoip_directive_map) = {
 
     /* Give the config parser a callback for the directive GeoIPDatabaseFile */
@@ -349,6 +608,13 @@ static IB_DIRMAP_INIT_STRUCTURE(geoip_directive_map) = {
         NULL
     ),
 
+    /* Size of the engine wide lookup cache */
+    IB_DIRMAP_INIT_PARAM1(
+        "GeoIPCacheSize",
+        geoip_cache_size_dir_param1,
+        NULL
+    ),
+
     /* signal the end of the list */
     IB_DIRMAP_INIT_LAST
 };
@@ -359,14 +625,22 @@ static ib_status_t geoip_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
     IB_FTRACE_INIT();
 
     ib_status_t rc;
+    geoip_cfg_t *cfg;
+
+    rc = ib_context_module_config(ib_context_main(ib), m, (void *)&cfg);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to fetch GeoIP config: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
 
-    if (geoip_db == NULL)
+    if (cfg->db == NULL)
     {
         ib_log_debug(ib, "Initializing default GeoIP database...");
-        geoip_db = GeoIP_new(GEOIP_MMAP_CACHE);
+        cfg->db = GeoIP_new(GEOIP_MMAP_CACHE);
     }
 
-    if (geoip_db == NULL)
+    if (cfg->db == NULL)
     {
         ib_log_debug(ib, "Failed to initialize GeoIP database.");
         IB_FTRACE_RET_STATUS(IB_EUNKNOWN);
@@ -393,14 +667,76 @@ static ib_status_t geoip_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
-/* Called when module is unloaded. */
-static ib_status_t geoip_fini(ib_engine_t *ib, ib_module_t *m, void *cbdata)
+/* Called when a context is closed; creates the cache for the main one. */
+static ib_status_t geoip_context_close(ib_engine_t *ib,
+                                       ib_module_t *m,
+                                       ib_context_t *ctx,
+                                       void *cbdata)
+{
+    IB_FTRACE_INIT();
+
+    ib_status_t rc;
+    geoip_cfg_t *cfg;
+
+    if (ctx != ib_context_main(ib)) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    rc = ib_context_module_config(ctx, m, (void *)&cfg);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to fetch GeoIP config: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    if ( (cfg->cache_size > 0) && (cfg->cache == NULL) ) {
+        rc = ib_lrucache_create(&cfg->cache, (size_t)cfg->cache_size);
+        if (rc != IB_OK) {
+            ib_log_error(ib, "Failed to create GeoIP cache: %s",
+                         ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        ib_log_debug(ib, "GeoIP cache size %" PRId64, cfg->cache_size);
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/* Called when a context is destroyed; releases the main one's database
+ * and cache.  This is not done when the module is unloaded, as other
+ * engines may still be using the module. */
+static ib_status_t geoip_context_destroy(ib_engine_t *ib,
+                                         ib_module_t *m,
+                                         ib_context_t *ctx,
+                                         void *cbdata)
 {
     IB_FTRACE_INIT();
-    if (geoip_db!=NULL)
+
+    ib_status_t rc;
+    geoip_cfg_t *cfg;
+
+    if (ctx != ib_context_main(ib)) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    rc = ib_context_module_config(ctx, m, (void *)&cfg);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    geoip_cache_destroy(ib, cfg);
+    if (cfg->db != NULL)
     {
-        GeoIP_delete(geoip_db);
+        GeoIP_delete(cfg->db);
+        cfg->db = NULL;
     }
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/* Called when module is unloaded. */
+static ib_status_t geoip_fini(ib_engine_t *ib, ib_module_t *m, void *cbdata)
+{
+    IB_FTRACE_INIT();
     ib_log_debug(ib, "GeoIP module unloaded.");
     IB_FTRACE_RET_STATUS(IB_OK);
 }
@@ -409,8 +745,8 @@ static ib_status_t geoip_fini(ib_engine_t *ib, ib_module_t *m, void *cbdata)
 IB_MODULE_INIT(
     IB_MODULE_HEADER_DEFAULTS,           /* Default metadata */
     MODULE_NAME_STR,                     /* Module name */
-    IB_MODULE_CONFIG_NULL,               /* Global config data */
-    NULL,                                /* Configuration field map */
+    IB_MODULE_CONFIG(&geoip_global_cfg), /* Global config data */
+    geoip_config_map,                    /* Configuration field map */
     geoip_directive_map,                 /* Config directive map */
     geoip_init,                          /* Initialize function */
     NULL,                                /* Callback data */
@@ -418,9 +754,9 @@ IB_MODULE_INIT(
     NULL,                                /* Callback data */
     NULL,                                /* Context open function */
     NULL,                                /* Callback data */
-    NULL,                                /* Context close function */
+    geoip_context_close,                 /* Context close function */
     NULL,                                /* Callback data */
-    NULL,                                /* Context destroy function */
+    geoip_context_destroy,               /* Context destroy function */
     NULL                                 /* Callback data */
 );
 
@@ -45,6 +45,8 @@
 #include <ironbee/array.h>
 #include <ironbee/field.h>
 #include <ironbee/util.h>
+#include <ironbee/string.h>
+#include <ironbee/tstats.h>
 
 #include "lua/ironbee.h"
 
@@ -67,6 +69,9 @@
 
 #define MODLUA_CONN_KEY "lua-runtime"
 
+/** Registry key for the table of globals present after runtime creation. */
+#define MODLUA_PRISTINE_KEY "ironbee.modlua.pristine_globals"
+
 
 /* Define the public module symbol. */
 IB_MODULE_DECLARE();
@@ -76,6 +81,7 @@ typedef struct modlua_chunk_tracker_t modlua_chunk_tracker_t;
 typedef struct modlua_cpart_t modlua_cpart_t;
 typedef struct modlua_reg_t modlua_reg_t;
 typedef struct modlua_runtime_t modlua_runtime_t;
+typedef struct modlua_pool_t modlua_pool_t;
 typedef struct modlua_cfg_t modlua_cfg_t;
 typedef struct modlua_wrapper_cbdata_t modlua_wrapper_cbdata_t;
 
@@ -114,10 +120,25 @@ struct modlua_cpart_t {
 
 /**
  * @brief Lua runtime
- * @details Created for each connection and stored at MODLUA_CONN_KEY.
+ * @details Taken from the calling thread's pool (or created) for each
+ *          connection and stored at MODLUA_CONN_KEY.
  */
 struct modlua_runtime_t {
     lua_State          *L;            /**< Lua stack */
+    const modlua_cfg_t *modcfg;       /**< Config runtime was built for */
+    modlua_runtime_t   *next;         /**< Next idle runtime in pool */
+};
+
+/**
+ * @brief Per-thread pool of idle, fully initialized lua runtimes.
+ * @details Only the owning thread touches the idle list, so no locking is
+ *          required to take or return a runtime.  The pools are the
+ *          per-thread blocks of an ib_tstats_t registry, so that idle
+ *          runtimes can be closed when the engine is destroyed.
+ */
+struct modlua_pool_t {
+    modlua_runtime_t   *idle;         /**< Idle runtimes */
+    size_t              nidle;        /**< Number of idle runtimes */
 };
 
 /** Module Configuration Structure */
@@ -127,6 +148,9 @@ struct modlua_cfg_t {
     ib_list_t          *lua_modules;
     ib_list_t          *event_reg[IB_STATE_EVENT_NUM + 1];
     lua_State          *Lconfig;
+    ib_num_t            pool_size;    /**< Idle runtimes kept per thread */
+    ib_tstats_t        *pools;        /**< Runtime pools of the engine
+                                           (main context only) */
 };
 
 /** Lua Wrapper Callback Data Structure */
@@ -948,7 +972,7 @@ static ib_status_t modlua_load_ironbee_module(ib_engine_t *ib,
 static modlua_runtime_t *modlua_runtime_get(ib_conn_t *conn)
 {
     IB_FTRACE_INIT();
-    modlua_runtime_t *lua;
+    modlua_runtime_t *lua = NULL;
 
     ib_hash_get(conn->data, &lua, MODLUA_CONN_KEY);
 
@@ -1038,59 +1062,65 @@ static ib_status_t modlua_destroy_lua_runtime_cfg(ib_engine_t *ib,
 }
 
 /**
- * Initialize the lua runtime for this connection.
+ * @internal
+ * Close a lua runtime and release its memory.
+ *
+ * @param lua Lua runtime.
+ */
+static void modlua_runtime_close(modlua_runtime_t *lua)
+{
+    IB_FTRACE_INIT();
+
+    if (lua->L != NULL) {
+        lua_close(lua->L);
+    }
+    free(lua);
+
+    IB_FTRACE_RET_VOID();
+}
+
+/**
+ * @internal
+ * Create a fully initialized lua runtime for a configuration.
+ *
+ * Loads the ironbee module and every lua module for the configuration,
+ * then records the resulting globals so that the runtime can later be
+ * reset by modlua_runtime_reset().
  *
  * @param ib Engine.
- * @param event Event type.
- * @param conn Connection.
- * @param cbdata Unused.
+ * @param modcfg Module configuration.
+ * @param plua Address which new runtime is written.
  *
  * @return Status code.
  */
-static ib_status_t modlua_init_lua_runtime(ib_engine_t *ib,
-                                           ib_state_event_type_t event,
-                                           ib_conn_t *conn,
-                                           void *cbdata)
+static ib_status_t modlua_runtime_create(ib_engine_t *ib,
+                                         const modlua_cfg_t *modcfg,
+                                         modlua_runtime_t **plua)
 {
     IB_FTRACE_INIT();
-
-    assert(event == conn_started_event);
-
-    lua_State *L;
-    modlua_cfg_t *modcfg;
     modlua_runtime_t *lua;
+    lua_State *L;
     ib_list_node_t *node;
     ib_status_t rc;
 
-    /* Get the module config. */
-    rc = ib_context_module_config(conn->ctx, IB_MODULE_STRUCT_PTR, (void *)&modcfg);
-    if (rc != IB_OK) {
-        ib_log_alert(ib, "Failed to fetch module %s config: %s",
-                     MODULE_NAME_STR, ib_status_to_string(rc));
-        IB_FTRACE_RET_STATUS(rc);
+    /* Pooled runtimes outlive the connection, so use the heap. */
+    lua = (modlua_runtime_t *)calloc(1, sizeof(*lua));
+    if (lua == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
     }
+    lua->modcfg = modcfg;
 
-    /* Setup a fresh Lua state for this connection. */
-    ib_log_debug3(ib, "Initializing lua runtime for conn=%p", conn);
+    /* Setup a fresh Lua state. */
     L = luaL_newstate();
-    luaL_openlibs(L);
-
-    /* Create the lua runtime and store it with the connection. */
-    ib_log_debug3(ib, "Creating lua runtime for conn=%p", conn);
-    lua = ib_mpool_alloc(conn->mp, sizeof(*lua));
-    if (lua == NULL) {
+    if (L == NULL) {
+        free(lua);
         IB_FTRACE_RET_STATUS(IB_EALLOC);
     }
     lua->L = L;
-    rc = ib_hash_set(conn->data, MODLUA_CONN_KEY, lua);
-    ib_log_debug2(ib, "Setting lua runtime for conn=%p lua=%p L=%p", conn, lua, L);
-    if (rc != IB_OK) {
-        ib_log_debug(ib, "Failed to set lua runtime: %s", ib_status_to_string(rc));
-        IB_FTRACE_RET_STATUS(rc);
-    }
+    luaL_openlibs(L);
 
     /* Preload ironbee module for other modules to use. */
-    modlua_load_ironbee_module(ib, modcfg, L);
+    modlua_load_ironbee_module(ib, (modlua_cfg_t *)modcfg, L);
 
     /* Run through each lua module to be used in this context and
      * load it into the lua runtime.
@@ -1101,9 +1131,10 @@ static ib_status_t modlua_init_lua_runtime(ib_engine_t *ib,
             modlua_chunk_t *chunk = (modlua_chunk_t *)m->data;
             int ec;
 
-            ib_log_debug2(ib, "Loading lua module \"%s\" into runtime for conn=%p", m->name, conn);
+            ib_log_debug2(ib, "Loading lua module \"%s\" into runtime L=%p", m->name, L);
             rc = modlua_load_lua_data(ib, L, chunk);
             if (rc != IB_OK) {
+                modlua_runtime_close(lua);
                 IB_FTRACE_RET_STATUS(rc);
             }
 
@@ -1113,16 +1144,332 @@ static ib_status_t modlua_init_lua_runtime(ib_engine_t *ib,
             if (ec != 0) {
                 ib_log_error(ib, "Failed to execute lua module \"%s\" - %s (%d)",
                              m->name, lua_tostring(L, -1), ec);
+                modlua_runtime_close(lua);
                 IB_FTRACE_RET_STATUS(IB_EINVAL);
             }
         }
     }
 
+    /* Remember the globals as they are now (name => value). */
+    lua_newtable(L);
+    lua_pushnil(L);
+    while (lua_next(L, LUA_GLOBALSINDEX) != 0) {
+        lua_pushvalue(L, -2);  /* key */
+        lua_insert(L, -2);     /* key, key, value */
+        lua_rawset(L, -4);     /* pristine[key] = value */
+    }
+    lua_setfield(L, LUA_REGISTRYINDEX, MODLUA_PRISTINE_KEY);
+
+    *plua = lua;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * @internal
+ * Reset the per-connection state of a lua runtime.
+ *
+ * Globals created since the runtime was created are removed, and globals
+ * which were replaced or removed are restored.  State hidden inside module
+ * tables is not reset; lua modules should keep per-connection state keyed
+ * by connection.
+ *
+ * @param ib Engine.
+ * @param lua Lua runtime.
+ *
+ * @return Status code.
+ */
+static ib_status_t modlua_runtime_reset(ib_engine_t *ib,
+                                        modlua_runtime_t *lua)
+{
+    IB_FTRACE_INIT();
+    lua_State *L = lua->L;
+    int pristine;
+
+    lua_settop(L, 0);
+    lua_getfield(L, LUA_REGISTRYINDEX, MODLUA_PRISTINE_KEY);
+    if (! lua_istable(L, -1)) {
+        lua_settop(L, 0);
+        IB_FTRACE_RET_STATUS(IB_EUNKNOWN);
+    }
+    pristine = lua_gettop(L);
+
+    /* Remove new globals and restore replaced ones.  Assigning to
+     * existing fields is allowed while traversing with lua_next().
+     */
+    lua_pushnil(L);
+    while (lua_next(L, LUA_GLOBALSINDEX) != 0) {
+        lua_pushvalue(L, -2);         /* key */
+        lua_rawget(L, pristine);      /* original value (or nil) */
+        if (! lua_rawequal(L, -1, -2)) {
+            lua_pushvalue(L, -3);     /* key */
+            lua_insert(L, -2);        /* key, original */
+            lua_rawset(L, LUA_GLOBALSINDEX);
+        }
+        else {
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);                /* value; leave key for lua_next() */
+    }
+
+    /* Restore globals which were removed. */
+    lua_pushnil(L);
+    while (lua_next(L, pristine) != 0) {
+        lua_pushvalue(L, -2);         /* key */
+        lua_rawget(L, LUA_GLOBALSINDEX);
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            lua_pushvalue(L, -2);     /* key */
+            lua_insert(L, -2);        /* key, value */
+            lua_rawset(L, LUA_GLOBALSINDEX);
+        }
+        else {
+            lua_pop(L, 2);
+        }
+    }
+
+    lua_settop(L, 0);
+    ib_log_debug3(ib, "Reset lua runtime L=%p", L);
+
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
 /**
- * Destroy the lua runtime for this connection.
+ * @internal
+ * Get the calling thread's runtime pool for an engine, creating it if
+ * required.
+ *
+ * The pools belong to the engine (in its main context configuration), so
+ * engines which are alive at the same time never share runtimes.
+ *
+ * @param ib Engine.
+ * @param pmax_idle Address which number of idle runtimes to keep is
+ *                  written.
+ *
+ * @return Pool or NULL if pooling is disabled or on allocation failure.
+ */
+static modlua_pool_t *modlua_pool_get(ib_engine_t *ib,
+                                      size_t *pmax_idle)
+{
+    IB_FTRACE_INIT();
+    modlua_cfg_t *maincfg;
+    ib_status_t rc;
+
+    rc = ib_context_module_config(ib_context_main(ib),
+                                  IB_MODULE_STRUCT_PTR, (void *)&maincfg);
+    if ( (rc != IB_OK) || (maincfg->pools == NULL) ) {
+        IB_FTRACE_RET_PTR(modlua_pool_t, NULL);
+    }
+
+    *pmax_idle = (size_t)maincfg->pool_size;
+    IB_FTRACE_RET_PTR(modlua_pool_t,
+                      (modlua_pool_t *)ib_tstats_block(maincfg->pools));
+}
+
+/**
+ * @internal
+ * Take an idle runtime for a configuration from the calling thread's
+ * pool, or create one.
+ *
+ * @param ib Engine.
+ * @param modcfg Module configuration.
+ * @param plua Address which runtime is written.
+ *
+ * @return Status code.
+ */
+static ib_status_t modlua_runtime_acquire(ib_engine_t *ib,
+                                          const modlua_cfg_t *modcfg,
+                                          modlua_runtime_t **plua)
+{
+    IB_FTRACE_INIT();
+    size_t max_idle;
+    modlua_pool_t *pool = modlua_pool_get(ib, &max_idle);
+
+    if (pool != NULL) {
+        modlua_runtime_t **prev = &pool->idle;
+        modlua_runtime_t *lua;
+
+        for (lua = pool->idle; lua != NULL; lua = lua->next) {
+            if (lua->modcfg == modcfg) {
+                *prev = lua->next;
+                lua->next = NULL;
+                --pool->nidle;
+                ib_log_debug3(ib, "Reusing pooled lua runtime L=%p", lua->L);
+                *plua = lua;
+                IB_FTRACE_RET_STATUS(IB_OK);
+            }
+            prev = &lua->next;
+        }
+    }
+
+    IB_FTRACE_RET_STATUS(modlua_runtime_create(ib, modcfg, plua));
+}
+
+/**
+ * @internal
+ * Return a runtime to the calling thread's pool, or close it if the pool
+ * is full (or disabled) or the runtime can not be reset.
+ *
+ * @param ib Engine.
+ * @param lua Lua runtime.
+ */
+static void modlua_runtime_release(ib_engine_t *ib,
+                                   modlua_runtime_t *lua)
+{
+    IB_FTRACE_INIT();
+    size_t max_idle;
+    modlua_pool_t *pool = modlua_pool_get(ib, &max_idle);
+
+    if ( (pool != NULL) &&
+         (pool->nidle < max_idle) &&
+         (modlua_runtime_reset(ib, lua) == IB_OK) )
+    {
+        lua->next = pool->idle;
+        pool->idle = lua;
+        ++pool->nidle;
+        IB_FTRACE_RET_VOID();
+    }
+
+    modlua_runtime_close(lua);
+    IB_FTRACE_RET_VOID();
+}
+
+/**
+ * @internal
+ * Close the idle runtimes of one thread's pool.
+ *
+ * @param block Pool.
+ * @param cbdata Unused.
+ */
+static void modlua_pool_close(const void *block, void *cbdata)
+{
+    IB_FTRACE_INIT();
+    const modlua_pool_t *pool = (const modlua_pool_t *)block;
+    modlua_runtime_t *lua = pool->idle;
+
+    while (lua != NULL) {
+        modlua_runtime_t *next = lua->next;
+        modlua_runtime_close(lua);
+        lua = next;
+    }
+
+    IB_FTRACE_RET_VOID();
+}
+
+/**
+ * @internal
+ * Engine main memory pool cleanup: close all idle runtimes and release
+ * the pools.
+ *
+ * @param data Runtime pools.
+ *
+ * @return IB_OK
+ */
+static ib_status_t modlua_pools_destroy(void *data)
+{
+    IB_FTRACE_INIT();
+    ib_tstats_t *pools = (ib_tstats_t *)data;
+
+    ib_tstats_foreach(pools, modlua_pool_close, NULL);
+    ib_tstats_destroy(pools);
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * @internal
+ * Set up runtime pooling for an engine.
+ *
+ * The pools are released with the engine's main memory pool, so they
+ * live exactly as long as the engine which uses them.
+ *
+ * @param ib Engine.
+ * @param maincfg Module configuration of the main context.
+ *
+ * @return Status code.
+ */
+static ib_status_t modlua_pools_init(ib_engine_t *ib,
+                                     modlua_cfg_t *maincfg)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    ib_log_debug2(ib, "Lua runtime pool size: %" PRId64 " per thread",
+                  maincfg->pool_size);
+
+    if ( (maincfg->pool_size <= 0) || (maincfg->pools != NULL) ) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    rc = ib_tstats_create(&maincfg->pools, sizeof(modlua_pool_t));
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    rc = ib_mpool_cleanup_register(ib_engine_pool_main_get(ib),
+                                   modlua_pools_destroy,
+                                   maincfg->pools);
+    if (rc != IB_OK) {
+        ib_tstats_destroy(maincfg->pools);
+        maincfg->pools = NULL;
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * Initialize the lua runtime for this connection.
+ *
+ * @param ib Engine.
+ * @param event Event type.
+ * @param conn Connection.
+ * @param cbdata Unused.
+ *
+ * @return Status code.
+ */
+static ib_status_t modlua_init_lua_runtime(ib_engine_t *ib,
+                                           ib_state_event_type_t event,
+                                           ib_conn_t *conn,
+                                           void *cbdata)
+{
+    IB_FTRACE_INIT();
+
+    assert(event == conn_started_event);
+
+    modlua_cfg_t *modcfg;
+    modlua_runtime_t *lua;
+    ib_status_t rc;
+
+    /* Get the module config. */
+    rc = ib_context_module_config(conn->ctx, IB_MODULE_STRUCT_PTR, (void *)&modcfg);
+    if (rc != IB_OK) {
+        ib_log_alert(ib, "Failed to fetch module %s config: %s",
+                     MODULE_NAME_STR, ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    /* Take a runtime for this connection. */
+    ib_log_debug3(ib, "Initializing lua runtime for conn=%p", conn);
+    rc = modlua_runtime_acquire(ib, modcfg, &lua);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to create lua runtime: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    /* Store it with the connection. */
+    rc = ib_hash_set(conn->data, MODLUA_CONN_KEY, lua);
+    ib_log_debug2(ib, "Setting lua runtime for conn=%p lua=%p L=%p", conn, lua, lua->L);
+    if (rc != IB_OK) {
+        ib_log_debug(ib, "Failed to set lua runtime: %s", ib_status_to_string(rc));
+        modlua_runtime_release(ib, lua);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * Release the lua runtime for this connection.
  *
  * @param ib Engine.
  * @param event Event type.
@@ -1147,7 +1494,7 @@ static ib_status_t modlua_destroy_lua_runtime(ib_engine_t *ib,
 
     lua = modlua_runtime_get(conn);
     if (lua != NULL) {
-        lua_close(lua->L);
+        modlua_runtime_release(ib, lua);
     }
 
     rc = ib_hash_remove(conn->data, NULL, MODLUA_CONN_KEY);
@@ -1793,6 +2140,8 @@ static ib_status_t modlua_init(ib_engine_t *ib,
         sizeof(modlua_global_cfg.event_reg)
     );
     modlua_global_cfg.Lconfig = NULL;
+    modlua_global_cfg.pool_size = 0;
+    modlua_global_cfg.pools = NULL;
 
     /* Setup a list to track loaded lua modules. */
     rc = ib_list_create(&mlist, ib_engine_pool_config_get(ib));
@@ -2060,6 +2409,16 @@ static ib_status_t modlua_context_close(ib_engine_t  *ib,
         IB_FTRACE_RET_STATUS(rc);
     }
 
+    /* Runtime pooling is per thread, so it is configured engine wide. */
+    if (ctx == ib_context_main(ib)) {
+        rc = modlua_pools_init(ib, modcfg);
+        if (rc != IB_OK) {
+            ib_log_error(ib, "Failed to initialize lua runtime pool: %s",
+                         ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+
     /* Check for a valid lua state. */
     if (modcfg->Lconfig == NULL) {
         ib_log_error(ib, "Lua support not available");
@@ -2092,6 +2451,12 @@ static IB_CFGMAP_INIT_STRUCTURE(modlua_config_map) = {
         modlua_cfg_t,
         pkg_cpath
     ),
+    IB_CFGMAP_INIT_ENTRY(
+        MODULE_NAME_STR ".pool_size",
+        IB_FTYPE_NUM,
+        modlua_cfg_t,
+        pool_size
+    ),
 
     IB_CFGMAP_INIT_LAST
 };
@@ -2371,6 +2736,22 @@ static ib_status_t modlua_dir_param1(ib_cfgparser_t *cp,
         free(p1_unescaped);
         IB_FTRACE_RET_STATUS(rc);
     }
+    else if (strcasecmp("LuaRuntimePoolSize", name) == 0) {
+        /* Pools are per thread, not per context. */
+        ib_context_t *ctx = ib_context_main(ib);
+        ib_num_t pool_size;
+
+        rc = ib_string_to_num(p1_unescaped, 0, &pool_size);
+        if ( (rc != IB_OK) || (pool_size < 0) ) {
+            ib_log_error(ib, "Invalid %s \"%s\"", name, p1_unescaped);
+            free(p1_unescaped);
+            IB_FTRACE_RET_STATUS(IB_EINVAL);
+        }
+        ib_log_debug2(ib, "%s: %" PRId64, name, pool_size);
+        rc = ib_context_set_num(ctx, MODULE_NAME_STR ".pool_size", pool_size);
+        free(p1_unescaped);
+        IB_FTRACE_RET_STATUS(rc);
+    }
     else {
         ib_log_error(ib, "Unhandled directive: %s %s", name, p1_unescaped);
         free(p1_unescaped);
@@ -2398,6 +2779,11 @@ static IB_DIRMAP_INIT_STRUCTURE(modlua_directive_map) = {
         modlua_dir_param1,
         NULL
     ),
+    IB_DIRMAP_INIT_PARAM1(
+        "LuaRuntimePoolSize",
+        modlua_dir_param1,
+        NULL
+    ),
 
     /* End */
     IB_DIRMAP_INIT_LAST
@@ -173,6 +173,120 @@ static int modhtp_callback_log(htp_log_t *log)
 
 /* -- Field Generation Routines -- */
 
+/*
+ * Parser fields are created lazily (see ib_field_create_lazy()): their
+ * values are aliased from libhtp only when a rule or module reads them,
+ * so transactions do not pay for fields nobody uses.
+ */
+
+/** A libhtp table to turn into a collection on demand. */
+typedef struct {
+    ib_tx_t        *itx;          /**< Transaction */
+    const char     *name;         /**< Collection name */
+    table_t        *table;        /**< libhtp table (may be NULL) */
+    int             headers;      /**< Values are htp_header_t, not bstr */
+} modhtp_lazy_table_t;
+
+/**
+ * Generate a bytestr field value aliasing a libhtp bstr.
+ *
+ * @param[in] f Field
+ * @param[out] pval Address which bytestr is written
+ * @param[in] cbdata The bstr
+ *
+ * @returns Status code
+ */
+static ib_status_t modhtp_gen_lazy_bytestr(const ib_field_t *f,
+                                           void **pval,
+                                           void *cbdata)
+{
+    bstr *bs = (bstr *)cbdata;
+    ib_bytestr_t *ibs;
+    ib_status_t rc;
+
+    rc = ib_bytestr_alias_mem(&ibs, f->mp,
+                              (const uint8_t *)bstr_ptr(bs),
+                              bstr_len(bs));
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    *pval = ibs;
+    return IB_OK;
+}
+
+/**
+ * Generate a collection from a libhtp table.
+ *
+ * Each entry becomes a bytestr field aliasing libhtp memory.
+ *
+ * @param[in] f Field
+ * @param[out] pval Address which list is written
+ * @param[in] cbdata Table (modhtp_lazy_table_t)
+ *
+ * @returns Status code
+ */
+static ib_status_t modhtp_gen_lazy_table(const ib_field_t *f,
+                                         void **pval,
+                                         void *cbdata)
+{
+    const modhtp_lazy_table_t *lazy = (const modhtp_lazy_table_t *)cbdata;
+    ib_tx_t *itx = lazy->itx;
+    ib_list_t *list;
+    ib_status_t rc;
+    bstr *key;
+    void *value;
+
+    rc = ib_list_create(&list, f->mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    *pval = list;
+
+    if ((lazy->table == NULL) || (table_size(lazy->table) == 0)) {
+        /// @todo May be an error depending on HTTP protocol version
+        ib_log_debug3_tx(itx, "No %s", lazy->name);
+        return IB_OK;
+    }
+
+    ib_log_debug3_tx(itx, "Adding %s fields", lazy->name);
+    table_iterator_reset(lazy->table);
+    while ((key = table_iterator_next(lazy->table, &value)) != NULL) {
+        bstr *vbs = (bstr *)value;
+        ib_field_t *lf;
+
+        if (lazy->headers) {
+            const htp_header_t *h = (const htp_header_t *)value;
+            key = h->name;
+            vbs = h->value;
+        }
+
+        /* Create a list field as an alias into htp memory. */
+        rc = ib_field_create_bytestr_alias(&lf,
+                                           f->mp,
+                                           bstr_ptr(key),
+                                           bstr_len(key),
+                                           (uint8_t *)bstr_ptr(vbs),
+                                           bstr_len(vbs));
+        if (rc != IB_OK) {
+            ib_log_debug3_tx(itx,
+                             "Failed to create field: %s",
+                             ib_status_to_string(rc));
+            continue;
+        }
+
+        /* Add the field to the field list. */
+        rc = ib_list_push(list, lf);
+        if (rc != IB_OK) {
+            ib_log_debug3_tx(itx,
+                             "Failed to add field: %s",
+                             ib_status_to_string(rc));
+        }
+    }
+
+    return IB_OK;
+}
+
 
 static ib_status_t modhtp_field_gen_bytestr(ib_provider_inst_t *dpi,
                                             const char *name,
@@ -210,15 +324,64 @@ static ib_status_t modhtp_field_gen_bytestr(ib_provider_inst_t *dpi,
         return rc;
     }
 
-    /* If no field exists, then create one. */
-    rc = ib_data_add_bytestr_ex(dpi, name, strlen(name),
-                                (uint8_t *)bstr_ptr(bs),
-                                bstr_len(bs), pf);
+    /* If no field exists, then create one, aliasing the value only
+     * if something reads it. */
+    rc = ib_field_create_lazy(&f, dpi->mp, name, strlen(name),
+                              IB_FTYPE_BYTESTR,
+                              modhtp_gen_lazy_bytestr, bs);
+    if (rc == IB_OK) {
+        rc = ib_data_add(dpi, f);
+    }
     if (rc != IB_OK) {
         ib_log_error(dpi->pr->ib,
                      "Failed to generate \"%s\" field: %s",
                      name, ib_status_to_string(rc));
     }
+    else if (pf != NULL) {
+        *pf = f;
+    }
+
+    return rc;
+}
+
+/**
+ * Add a collection generated from a libhtp table when first read.
+ *
+ * @param[in] itx Transaction
+ * @param[in] name Collection name
+ * @param[in] table Table of bstr or htp_header_t values (may be NULL)
+ * @param[in] headers Non-zero if @a table holds htp_header_t values
+ *
+ * @returns Status code
+ */
+static ib_status_t modhtp_field_gen_table(ib_tx_t *itx,
+                                         const char *name,
+                                         table_t *table,
+                                         int headers)
+{
+    modhtp_lazy_table_t *lazy;
+    ib_field_t *f;
+    ib_status_t rc;
+
+    lazy = (modhtp_lazy_table_t *)ib_mpool_alloc(itx->mp, sizeof(*lazy));
+    if (lazy == NULL) {
+        return IB_EALLOC;
+    }
+    lazy->itx = itx;
+    lazy->name = name;
+    lazy->table = table;
+    lazy->headers = headers;
+
+    rc = ib_field_create_lazy(&f, itx->mp, name, strlen(name),
+                              IB_FTYPE_LIST,
+                              modhtp_gen_lazy_table, lazy);
+    if (rc == IB_OK) {
+        rc = ib_data_add(itx->dpi, f);
+    }
+    if (rc != IB_OK) {
+        ib_log_error_tx(itx, "Failed to create %s collection: %s",
+                        name, ib_status_to_string(rc));
+    }
 
     return rc;
 }
@@ -1286,7 +1449,6 @@ static ib_status_t modhtp_iface_gen_request_header_fields(ib_provider_inst_t *pi
     IB_FTRACE_INIT();
     ib_context_t *ctx = itx->ctx;
     ib_conn_t *iconn = itx->conn;
-    ib_field_t *f;
     modhtp_cfg_t *modcfg;
     modhtp_context_t *modctx;
     htp_tx_t *tx;
@@ -1363,135 +1525,14 @@ static ib_status_t modhtp_iface_gen_request_header_fields(ib_provider_inst_t *pi
                                  tx->parsed_uri->fragment,
                                  NULL);
 
-        rc = ib_data_add_list(itx->dpi, "request_headers", &f);
-        if (   (tx->request_headers != NULL)
-            && table_size(tx->request_headers)
-            && (rc == IB_OK))
-        {
-            bstr *key = NULL;
-            htp_header_t *h = NULL;
-
-            /// @todo Make this a function
-            table_iterator_reset(tx->request_headers);
-            ib_log_debug3_tx(itx, "Adding request_headers fields");
-            while ((key = table_iterator_next(tx->request_headers,
-                                              (void *)&h)) != NULL)
-            {
-                ib_field_t *lf;
-
-                /* Create a list field as an alias into htp memory. */
-                rc = ib_field_create_bytestr_alias(&lf,
-                                           itx->mp,
-                                           bstr_ptr(h->name),
-                                           bstr_len(h->name),
-                                           (uint8_t *)bstr_ptr(h->value),
-                                           bstr_len(h->value));
-                if (rc != IB_OK) {
-                    ib_log_debug3_tx(itx,
-                                 "Failed to create field: %s",
-                                 ib_status_to_string(rc));
-                }
-
-                /* Add the field to the field list. */
-                rc = ib_field_list_add(f, lf);
-                if (rc != IB_OK) {
-                    ib_log_debug3_tx(itx,
-                                 "Failed to add field: %s",
-                                 ib_status_to_string(rc));
-                }
-            }
-        }
-        else if (rc == IB_OK) {
-            /// @todo May be an error depending on HTTP protocol version
-            ib_log_debug3_tx(itx, "No request headers");
-        }
-        else {
-            ib_log_error_tx(itx,
-                         "Failed to create request headers list: %s",
-                         ib_status_to_string(rc));
-        }
+        modhtp_field_gen_table(itx, "request_headers",
+                               tx->request_headers, 1);
 
-        rc = ib_data_add_list(itx->dpi, "request_cookies", &f);
-        if (   (tx->request_cookies != NULL)
-            && table_size(tx->request_cookies)
-            && (rc == IB_OK))
-        {
-            bstr *key = NULL;
-            bstr *value = NULL;
-
-            /// @todo Make this a function
-            table_iterator_reset(tx->request_cookies);
-            ib_log_debug3_tx(itx, "Adding request_cookies fields");
-            while ((key = table_iterator_next(tx->request_cookies,
-                                              (void *)&value)) != NULL)
-            {
-                ib_field_t *lf;
-
-                /* Create a list field as an alias into htp memory. */
-                rc = ib_field_create_bytestr_alias(&lf,
-                                           itx->mp,
-                                           bstr_ptr(key),
-                                           bstr_len(key),
-                                           (uint8_t *)bstr_ptr(value),
-                                           bstr_len(value));
-                if (rc != IB_OK) {
-                    ib_log_debug3_tx(itx, "Failed to create field: %s", ib_status_to_string(rc));
-                }
-
-                /* Add the field to the field list. */
-                rc = ib_field_list_add(f, lf);
-                if (rc != IB_OK) {
-                    ib_log_debug3_tx(itx, "Failed to add field: %s", ib_status_to_string(rc));
-                }
-            }
-        }
-        else if (rc == IB_OK) {
-            ib_log_debug3_tx(itx, "No request cookies");
-        }
-        else {
-            ib_log_error_tx(itx, "Failed to create request cookies list: %s", ib_status_to_string(rc));
-        }
+        modhtp_field_gen_table(itx, "request_cookies",
+                               tx->request_cookies, 0);
 
-        rc = ib_data_add_list(itx->dpi, "request_uri_params", &f);
-        if (   (tx->request_params_query != NULL)
-            && table_size(tx->request_params_query)
-            && (rc == IB_OK))
-        {
-            bstr *key = NULL;
-            bstr *value = NULL;
-
-            /// @todo Make this a function
-            table_iterator_reset(tx->request_params_query);
-            ib_log_debug3_tx(itx, "Adding request_params_query fields");
-            while ((key = table_iterator_next(tx->request_params_query,
-                                              (void *)&value)) != NULL)
-            {
-                ib_field_t *lf;
-
-                /* Create a list field as an alias into htp memory. */
-                rc = ib_field_create_bytestr_alias(&lf,
-                                           itx->mp,
-                                           bstr_ptr(key),
-                                           bstr_len(key),
-                                           (uint8_t *)bstr_ptr(value),
-                                           bstr_len(value));
-                if (rc != IB_OK) {
-                    ib_log_debug3_tx(itx, "Failed to create field: %s", ib_status_to_string(rc));
-                }
-
-                /* Add the field to the field list. */
-                rc = ib_field_list_add(f, lf);
-                if (rc != IB_OK) {
-                    ib_log_debug3_tx(itx, "Failed to add field: %s", ib_status_to_string(rc));
-                }
-            }
-        }
-        else if (rc == IB_OK) {
-            ib_log_debug3_tx(itx, "No request URI parameters");
-        }
-        else {
-            ib_log_error_tx(itx, "Failed to create request URI parameters: %s", ib_status_to_string(rc));
-        }
+        modhtp_field_gen_table(itx, "request_uri_params",
+                               tx->request_params_query, 0);
     }
 
     IB_FTRACE_RET_STATUS(IB_OK);
@@ -1503,7 +1544,6 @@ static ib_status_t modhtp_iface_gen_response_header_fields(ib_provider_inst_t *p
     IB_FTRACE_INIT();
     ib_context_t *ctx = itx->ctx;
     ib_conn_t *iconn = itx->conn;
-    ib_field_t *f;
     modhtp_cfg_t *modcfg;
     modhtp_context_t *modctx;
     htp_tx_t *tx;
@@ -1533,52 +1573,8 @@ static ib_status_t modhtp_iface_gen_response_header_fields(ib_provider_inst_t *p
 
         /// @todo Need a table type that can have more than one
         ///       of the same header.
-        rc = ib_data_add_list(itx->dpi, "response_headers", &f);
-        if (   (tx->response_headers != NULL)
-            && table_size(tx->response_headers)
-            && (rc == IB_OK))
-        {
-            bstr *key = NULL;
-            htp_header_t *h = NULL;
-
-            /// @todo Make this a function
-            table_iterator_reset(tx->response_headers);
-            while ((key = table_iterator_next(tx->response_headers,
-                                              (void *)&h)) != NULL)
-            {
-                ib_field_t *lf;
-
-                /* Create a list field as an alias into htp memory. */
-                rc = ib_field_create_bytestr_alias(&lf,
-                                           itx->mp,
-                                           bstr_ptr(h->name),
-                                           bstr_len(h->name),
-                                           (uint8_t *)bstr_ptr(h->value),
-                                           bstr_len(h->value));
-                if (rc != IB_OK) {
-                    ib_log_debug3_tx(itx,
-                                 "Failed to create field: %s",
-                                 ib_status_to_string(rc));
-                }
-
-                /* Add the field to the field list. */
-                rc = ib_field_list_add(f, lf);
-                if (rc != IB_OK) {
-                    ib_log_debug3_tx(itx,
-                                 "Failed to add field: %s",
-                                 ib_status_to_string(rc));
-                }
-            }
-        }
-        else if (rc == IB_OK) {
-            /// @todo May be an error depending on HTTP protocol version
-            ib_log_debug3_tx(itx, "No response headers");
-        }
-        else {
-            ib_log_error_tx(itx,
-                         "Failed to create response headers list: %s",
-                         ib_status_to_string(rc));
-        }
+        modhtp_field_gen_table(itx, "response_headers",
+                               tx->response_headers, 1);
     }
 
     IB_FTRACE_RET_STATUS(IB_OK);
@@ -101,10 +101,201 @@ static modpcre_cfg_t modpcre_global_cfg = {
     5000  /* match_limit_recursion */
 };
 
+/**
+ * @internal
+ * Snapshot record of a compiled pattern.
+ *
+ * Followed by @a cpatt_sz bytes of compiled pattern and then @a study_sz
+ * bytes of study data.
+ */
+typedef struct {
+    uint32_t      cpatt_sz;               /**< Size of compiled pattern. */
+    uint32_t      study_sz;               /**< Size of study data. */
+} modpcre_snapshot_rec_t;
+
+/**
+ * @internal
+ * Build the snapshot key for a pattern.
+ *
+ * The key identifies everything the compiled form depends on: the PCRE
+ * library version, the flags and the pattern text.
+ *
+ * @param[in] patt Pattern
+ * @param[in] compile_flags Flags to pcre_compile()
+ * @param[in] study_flags Flags to pcre_study()
+ * @param[out] pklen Address which length of key is written
+ *
+ * @returns Key (free with free()) or NULL on allocation failure.
+ */
+static char *modpcre_snapshot_key(const char *patt,
+                                  int compile_flags,
+                                  int study_flags,
+                                  size_t *pklen)
+{
+    IB_FTRACE_INIT();
+
+    char prefix[128];
+    size_t plen;
+    size_t len;
+    char *key;
+
+    plen = snprintf(prefix, sizeof(prefix), "%s:%x:%x:",
+                    pcre_version(), compile_flags, study_flags);
+    if (plen >= sizeof(prefix)) {
+        plen = sizeof(prefix) - 1;
+    }
+    len = strlen(patt);
+
+    key = malloc(plen + len);
+    if (key == NULL) {
+        IB_FTRACE_RET_PTR(char, NULL);
+    }
+    memcpy(key, prefix, plen);
+    memcpy(key + plen, patt, len);
+    *pklen = plen + len;
+
+    IB_FTRACE_RET_PTR(char, key);
+}
+
+/**
+ * @internal
+ * Load a compiled pattern from the compile cache.
+ *
+ * On success @a pcpatt (and, if @a want_study is set and the pattern has
+ * study data, @a pedata) are allocated with pcre_malloc() as if they had
+ * been returned by pcre_compile() and pcre_study().
+ *
+ * @param[in] snap Snapshot
+ * @param[in] key Key from modpcre_snapshot_key()
+ * @param[in] klen Length of @a key
+ * @param[in] want_study Load study data too?
+ * @param[out] pcpatt Address which compiled pattern is written
+ * @param[out] pedata Address which study data is written
+ *
+ * @returns
+ *   - IB_OK if the pattern was loaded.
+ *   - IB_ENOENT if it is not in the snapshot.
+ *   - IB_EALLOC on allocation failure.
+ */
+static ib_status_t modpcre_snapshot_load(ib_snapshot_t *snap,
+                                         const char *key,
+                                         size_t klen,
+                                         int want_study,
+                                         pcre **pcpatt,
+                                         pcre_extra **pedata)
+{
+    IB_FTRACE_INIT();
+
+    const void *data;
+    size_t dlen;
+    modpcre_snapshot_rec_t rec;
+    const uint8_t *bytes;
+    pcre *cpatt;
+    pcre_extra *edata = NULL;
+    ib_status_t rc;
+
+    rc = ib_snapshot_get(snap, MODULE_NAME_STR, key, klen, &data, &dlen);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    /* Treat a malformed record as missing; it will be replaced. */
+    if (dlen < sizeof(rec)) {
+        IB_FTRACE_RET_STATUS(IB_ENOENT);
+    }
+    memcpy(&rec, data, sizeof(rec));
+    if ((rec.cpatt_sz == 0) ||
+        (dlen != sizeof(rec) + rec.cpatt_sz + rec.study_sz))
+    {
+        IB_FTRACE_RET_STATUS(IB_ENOENT);
+    }
+    bytes = (const uint8_t *)data + sizeof(rec);
+
+    cpatt = pcre_malloc(rec.cpatt_sz);
+    if (cpatt == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    memcpy(cpatt, bytes, rec.cpatt_sz);
+
+    /* Laid out as pcre_study() does: the study data follows the extra. */
+    if (want_study && (rec.study_sz != 0)) {
+        edata = pcre_malloc(sizeof(*edata) + rec.study_sz);
+        if (edata == NULL) {
+            pcre_free(cpatt);
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+        memset(edata, 0, sizeof(*edata));
+        edata->flags = PCRE_EXTRA_STUDY_DATA;
+        edata->study_data = (uint8_t *)edata + sizeof(*edata);
+        memcpy(edata->study_data, bytes + rec.cpatt_sz, rec.study_sz);
+    }
+
+    *pcpatt = cpatt;
+    *pedata = edata;
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * @internal
+ * Save a compiled pattern to the compile cache.
+ *
+ * Failure is not fatal; the pattern is simply compiled again next time.
+ *
+ * @param[in] snap Snapshot
+ * @param[in] key Key from modpcre_snapshot_key()
+ * @param[in] klen Length of @a key
+ * @param[in] cpatt Compiled pattern
+ * @param[in] cpatt_sz Size of @a cpatt
+ * @param[in] edata Study data (may be NULL)
+ * @param[in] study_data_sz Size of @a edata->study_data
+ */
+static void modpcre_snapshot_save(ib_snapshot_t *snap,
+                                  const char *key,
+                                  size_t klen,
+                                  const pcre *cpatt,
+                                  size_t cpatt_sz,
+                                  const pcre_extra *edata,
+                                  size_t study_data_sz)
+{
+    IB_FTRACE_INIT();
+
+    modpcre_snapshot_rec_t rec;
+    uint8_t *blob;
+    size_t blen;
+
+    if (edata == NULL) {
+        study_data_sz = 0;
+    }
+    rec.cpatt_sz = cpatt_sz;
+    rec.study_sz = study_data_sz;
+
+    blen = sizeof(rec) + cpatt_sz + study_data_sz;
+    blob = malloc(blen);
+    if (blob == NULL) {
+        IB_FTRACE_RET_VOID();
+    }
+    memcpy(blob, &rec, sizeof(rec));
+    memcpy(blob + sizeof(rec), cpatt, cpatt_sz);
+    if (study_data_sz != 0) {
+        memcpy(blob + sizeof(rec) + cpatt_sz,
+               edata->study_data, study_data_sz);
+    }
+
+    ib_snapshot_put(snap, MODULE_NAME_STR, key, klen, blob, blen);
+    free(blob);
+
+    IB_FTRACE_RET_VOID();
+}
+
 /**
  * Internal compilation of the modpcre pattern.
  *
+ * If @a snap is not NULL, the compiled pattern is taken from it when
+ * present and added to it otherwise.
+ *
  * @param[in] pool The memory pool to allocate memory out of.
+ * @param[in] snap Compile cache or NULL.
  * @param[out] pcre_cpatt Struct containing the compilation.
  * @param[in] patt The uncompiled pattern to match.
  * @param[out] errptr Pointer to an error message describing the failure.
@@ -113,6 +304,7 @@ static modpcre_cfg_t modpcre_global_cfg = {
  *          IB_EALLOC if memory allocation fails or IB_OK.
  */
 static ib_status_t modpcre_compile_internal(ib_mpool_t *pool,
+                                            ib_snapshot_t *snap,
                                             modpcre_cpatt_t **pcre_cpatt,
                                             const char *patt,
                                             const char **errptr,
@@ -152,19 +344,53 @@ static ib_status_t modpcre_compile_internal(ib_mpool_t *pool,
     const int study_flags = 0;
 #endif /* PCRE_HAVE_JIT */
 
-    cpatt = pcre_compile(patt, compile_flags, errptr, erroffset, NULL);
+    /* Snapshot key; NULL if there is no snapshot. */
+    char *key = NULL;
+    size_t klen = 0;
 
-    if (*errptr != NULL) {
-        ib_util_log_error("PCRE compile error for \"%s\": %s at offset %d",
-                          patt, *errptr, *erroffset);
-        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    /* Was cpatt loaded from the snapshot? */
+    int from_snapshot = 0;
+
+    if (snap != NULL) {
+        key = modpcre_snapshot_key(patt, compile_flags, study_flags, &klen);
+    }
+
+    /* JIT code cannot be saved, so with JIT only the compile is skipped. */
+    if (key != NULL) {
+#ifdef PCRE_HAVE_JIT
+        const int want_study = 0;
+#else
+        const int want_study = 1;
+#endif
+        from_snapshot = (modpcre_snapshot_load(snap, key, klen, want_study,
+                                               &cpatt, &edata) == IB_OK);
     }
 
-    edata = pcre_study(cpatt, study_flags, errptr);
+    if (from_snapshot) {
+        *errptr = NULL;
+    }
+    else {
+        cpatt = pcre_compile(patt, compile_flags, errptr, erroffset, NULL);
+
+        if (*errptr != NULL) {
+            ib_util_log_error("PCRE compile error for \"%s\": %s at offset %d",
+                              patt, *errptr, *erroffset);
+            free(key);
+            IB_FTRACE_RET_STATUS(IB_EINVAL);
+        }
+    }
+
+#ifndef PCRE_HAVE_JIT
+    if (! from_snapshot)
+#endif
+    {
+        edata = pcre_study(cpatt, study_flags, errptr);
+    }
 
 #ifdef PCRE_HAVE_JIT
     if(*errptr != NULL)  {
         pcre_free(cpatt);
+        free(key);
         ib_util_log_error("PCRE-JIT study failed: %s", *errptr);
         IB_FTRACE_RET_STATUS(IB_EINVAL);
     }
@@ -204,6 +430,12 @@ static ib_status_t modpcre_compile_internal(ib_mpool_t *pool,
         study_data_sz = 0;
     }
 
+    if ((key != NULL) && ! from_snapshot) {
+        modpcre_snapshot_save(snap, key, klen,
+                              cpatt, cpatt_sz, edata, study_data_sz);
+    }
+    free(key);
+
     /**
      * Below is only allocation and copy operations to pass the PCRE results
      * back to the output variable pcre_cpatt.
@@ -267,7 +499,7 @@ static ib_status_t modpcre_compile_internal(ib_mpool_t *pool,
 /* -- Matcher Interface -- */
 
 /**
- * @param[in] mpr Provider object. This is unused.
+ * @param[in] mpr Provider object. Used to find the engine's snapshot.
  * @param[in] pool The memory pool to allocate memory out of.
  * @param[out] pcpatt When the pattern is successfully compiled
  *             a modpcre_cpatt_t* is stored in *pcpatt.
@@ -289,6 +521,7 @@ static ib_status_t modpcre_compile(ib_provider_t *mpr,
     ib_status_t rc;
 
     rc = modpcre_compile_internal(pool,
+                                  ib_engine_snapshot_get(mpr->ib),
                                   (modpcre_cpatt_t **)pcpatt,
                                   patt,
                                   errptr,
@@ -396,6 +629,7 @@ static ib_status_t pcre_operator_create(ib_engine_t *ib,
     ib_status_t rc;
 
     rc = modpcre_compile_internal(pool,
+                                  ib_engine_snapshot_get(ib),
                                   &rule_data,
                                   pattern,
                                   &errptr,
@@ -796,7 +1030,8 @@ static ib_status_t modpcre_init(ib_engine_t *ib,
     /* Register operators. */
     ib_operator_register(ib,
                          "pcre",
-                         IB_OP_FLAG_PHASE|IB_OP_FLAG_STREAM,
+                         IB_OP_FLAG_PHASE|IB_OP_FLAG_STREAM|IB_OP_FLAG_PARALLEL|
+                         IB_OP_FLAG_DEFER,
                          pcre_operator_create,
                          pcre_operator_destroy,
                          pcre_operator_execute);
@@ -804,7 +1039,8 @@ static ib_status_t modpcre_init(ib_engine_t *ib,
     /* An alias of pcre. The same callbacks are registered. */
     ib_operator_register(ib,
                          "rx",
-                         IB_OP_FLAG_PHASE|IB_OP_FLAG_STREAM,
+                         IB_OP_FLAG_PHASE|IB_OP_FLAG_STREAM|IB_OP_FLAG_PARALLEL|
+                         IB_OP_FLAG_DEFER,
                          pcre_operator_create,
                          pcre_operator_destroy,
                          pcre_operator_execute);
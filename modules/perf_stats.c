@@ -21,6 +21,15 @@
  *
  * This module records performance stats
  *
+ * Two modes are supported (see the PerfStatsMode directive):
+ *
+ * - Connection: Per-connection counters, logged as each event starts and
+ *   stops.  Useful for debugging, too expensive for production.
+ * - Aggregate: Per-thread, cache line aligned counters per event type.  No
+ *   locking or logging on the hot path; cumulative snapshots (with
+ *   histogram based percentiles) are written periodically to a stats file
+ *   or a local Unix datagram socket (PerfStatsOutput).
+ *
  * @author William Metcalf <wmetcalf@qualys.com>
  */
 
@@ -28,17 +37,29 @@
 #include "ironbee_config_auto.h"
 
 #include <ironbee/engine.h>
+#include <ironbee/cfgmap.h>
 #include <ironbee/debug.h>
 #include <ironbee/module.h>
 #include <ironbee/provider.h>
 #include <ironbee/hash.h>
 #include <ironbee/mpool.h>
 #include <ironbee/clock.h>
+#include <ironbee/lock.h>
+#include <ironbee/tstats.h>
 
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <string.h>
 #include <ctype.h>
 #include <strings.h>
@@ -83,6 +104,69 @@ enum cb_data_type {
 
 int ib_state_event_cbdata_type(ib_state_event_type_t);
 
+/** Statistics modes */
+enum perf_stats_mode {
+    PERF_STATS_MODE_CONN,       /**< Per-connection counters (default) */
+    PERF_STATS_MODE_AGGREGATE,  /**< Per-thread counters, snapshots */
+};
+
+/** Aggregate mode state; one per engine */
+typedef struct perf_aggregate_t perf_aggregate_t;
+
+/** Module configuration */
+typedef struct {
+    ib_num_t          mode;         /**< Statistics mode (perf_stats_mode) */
+    ib_num_t          interval;     /**< Snapshot interval in seconds */
+    ib_num_t          coarse_clock; /**< Use the coarse clock? */
+    const char       *output;       /**< Snapshot output (path or unix:path) */
+    perf_aggregate_t *aggregate;    /**< Aggregate state (main context) */
+} perf_stats_cfg_t;
+
+/* Instantiate a module global configuration. */
+static perf_stats_cfg_t perf_stats_global_cfg = {
+    PERF_STATS_MODE_CONN,       /* mode */
+    60,                         /* interval */
+    0,                          /* coarse_clock */
+    NULL,                       /* output */
+    NULL                        /* aggregate */
+};
+
+/** Size of the snapshot buffer */
+#define PERF_SNAPSHOT_LEN    (IB_STATE_EVENT_NUM * 192 + 128)
+
+/**
+ * Per-thread counter block.
+ *
+ * Only ever written by the owning thread.  Blocks are cache line aligned
+ * and an ib_tstats_hist_t is a whole number of cache lines, so no two
+ * events share a line.
+ */
+typedef struct {
+    ib_tstats_hist_t counters[IB_STATE_EVENT_NUM]; /**< Counters, by event */
+    uint64_t         start_ns[IB_STATE_EVENT_NUM]; /**< Current event start */
+} perf_thread_t;
+
+/**
+ * Aggregate mode state.
+ *
+ * Allocated from the engine's main pool when the main context is closed,
+ * and released when it is destroyed, so that an engine which replaces
+ * another (a reload) has counters and output of its own.
+ */
+struct perf_aggregate_t {
+    ib_engine_t        *ib;             /**< Engine */
+    uint64_t          (*clock)(void);   /**< Clock function */
+    uint64_t            started_ns;     /**< Time aggregation started */
+    uint64_t            interval_ns;    /**< Snapshot interval */
+    volatile uint64_t   next_ns;        /**< Time of next snapshot */
+    const char         *output;         /**< Snapshot output or NULL */
+    FILE               *fp;             /**< Stats file */
+    int                 sock;           /**< Unix socket (or -1) */
+    struct sockaddr_un  addr;           /**< Unix socket address */
+    ib_lock_t           lock;           /**< Protects next_ns, output */
+    ib_tstats_t        *stats;          /**< Per-thread counter blocks */
+};
+
 
 /**
  * @internal
@@ -135,6 +219,336 @@ int ib_state_event_cbdata_type(ib_state_event_type_t event)
     IB_FTRACE_RET_INT(ib_state_event_name_cbdata_type_list[event]);
 }
 
+/**
+ * @internal
+ * Add a thread's counters to a snapshot's totals.
+ *
+ * @param[in] block Thread's counter block (perf_thread_t)
+ * @param[in] cbdata Totals, by event (ib_tstats_hist_t array)
+ */
+static void perf_aggregate_sum(const void *block, void *cbdata)
+{
+    const perf_thread_t *thread = (const perf_thread_t *)block;
+    ib_tstats_hist_t    *total = (ib_tstats_hist_t *)cbdata;
+    int                  event;
+
+    for (event = 0; event < IB_STATE_EVENT_NUM; ++event) {
+        ib_tstats_hist_add(&total[event], &thread->counters[event]);
+    }
+}
+
+/**
+ * @internal
+ * Write a snapshot buffer to the configured output.
+ *
+ * Called with agg->lock held.
+ *
+ * @param[in] agg Aggregate state
+ * @param[in] buf Snapshot text
+ * @param[in] len Length of @a buf
+ */
+static void perf_aggregate_output(perf_aggregate_t *agg,
+                                  const char *buf,
+                                  size_t len)
+{
+    ib_engine_t *ib = agg->ib;
+
+    if (agg->sock >= 0) {
+        /* Nobody listening is not an error; the snapshot is dropped. */
+        if (sendto(agg->sock, buf, len, 0,
+                   (const struct sockaddr *)&agg->addr,
+                   sizeof(agg->addr)) < 0)
+        {
+            if ( (errno != ENOENT) && (errno != ECONNREFUSED) &&
+                 (errno != EAGAIN) )
+            {
+                ib_log_error(ib, "Failed to send perf stats to %s: %s",
+                             agg->output, strerror(errno));
+            }
+        }
+    }
+    else if (agg->fp != NULL) {
+        if ( (fwrite(buf, 1, len, agg->fp) != len) ||
+             (fflush(agg->fp) != 0) )
+        {
+            ib_log_error(ib, "Failed to write perf stats to %s: %s",
+                         agg->output, strerror(errno));
+        }
+    }
+    else {
+        ib_log_info(ib, "%.*s", (int)len, buf);
+    }
+}
+
+/**
+ * @internal
+ * Sum the per-thread counters and write a snapshot.
+ *
+ * Counters are cumulative since aggregation started; consumers should
+ * difference consecutive snapshots for rates.  Reads of other threads'
+ * counters are not synchronized, so a snapshot may miss events that are
+ * in flight.
+ *
+ * @param[in] agg Aggregate state
+ * @param[in] label Snapshot label ("periodic" or "final")
+ */
+static void perf_aggregate_snapshot(perf_aggregate_t *agg,
+                                    const char *label)
+{
+    IB_FTRACE_INIT();
+    ib_tstats_hist_t total[IB_STATE_EVENT_NUM];
+    char           *buf;
+    size_t          used;
+    size_t          nthreads = 0;
+    int             event;
+    int             rv;
+
+    buf = (char *)malloc(PERF_SNAPSHOT_LEN);
+    if (buf == NULL) {
+        IB_FTRACE_RET_VOID();
+    }
+    memset(total, 0, sizeof(total));
+
+    ib_lock_lock(&agg->lock);
+
+    nthreads = ib_tstats_foreach(agg->stats,
+                                 perf_aggregate_sum, total);
+
+    rv = snprintf(buf, PERF_SNAPSHOT_LEN,
+                  "perf_stats %s time=%lu uptime=%" PRIu64 " threads=%zu\n",
+                  label, (unsigned long)time(NULL),
+                  (agg->clock() - agg->started_ns) /
+                  1000000000,
+                  nthreads);
+    used = (rv > 0) ? (size_t)rv : 0;
+
+    for (event = 0; event < IB_STATE_EVENT_NUM; ++event) {
+        const ib_tstats_hist_t *c = &total[event];
+
+        if ( (c->count == 0) || (used >= PERF_SNAPSHOT_LEN) ) {
+            continue;
+        }
+        rv = snprintf(buf + used, PERF_SNAPSHOT_LEN - used,
+                      "%s count=%" PRIu64 " total_ns=%" PRIu64
+                      " avg_ns=%" PRIu64 " max_ns=%" PRIu64
+                      " p50_ns=%" PRIu64 " p90_ns=%" PRIu64
+                      " p99_ns=%" PRIu64 "\n",
+                      event_info[event].name, c->count, c->total_ns,
+                      c->total_ns / c->count, c->max_ns,
+                      ib_tstats_hist_percentile(c, 50),
+                      ib_tstats_hist_percentile(c, 90),
+                      ib_tstats_hist_percentile(c, 99));
+        if (rv > 0) {
+            used += (size_t)rv;
+        }
+    }
+    if (used > PERF_SNAPSHOT_LEN - 1) {
+        used = PERF_SNAPSHOT_LEN - 1;
+    }
+
+    perf_aggregate_output(agg, buf, used);
+    ib_lock_unlock(&agg->lock);
+
+    free(buf);
+    IB_FTRACE_RET_VOID();
+}
+
+/**
+ * @internal
+ * Record the start of an event (aggregate mode).
+ *
+ * @param[in] agg Aggregate state
+ * @param[in] eventp Event info.
+ */
+static void perf_aggregate_start(perf_aggregate_t *agg,
+                                 const event_info_t *eventp)
+{
+    perf_thread_t *thread =
+        (perf_thread_t *)ib_tstats_block(agg->stats);
+
+    if (thread != NULL) {
+        thread->start_ns[eventp->number] = agg->clock();
+    }
+}
+
+/**
+ * @internal
+ * Record the end of an event (aggregate mode).
+ *
+ * @param[in] agg Aggregate state
+ * @param[in] eventp Event info.
+ */
+static void perf_aggregate_stop(perf_aggregate_t *agg,
+                                const event_info_t *eventp)
+{
+    perf_thread_t  *thread =
+        (perf_thread_t *)ib_tstats_block(agg->stats);
+    uint64_t        now;
+
+    if ( (thread == NULL) || (thread->start_ns[eventp->number] == 0) ) {
+        return;
+    }
+
+    now = agg->clock();
+    ib_tstats_hist_record(&thread->counters[eventp->number],
+                          now - thread->start_ns[eventp->number]);
+    thread->start_ns[eventp->number] = 0;
+
+    /* Periodic snapshot; only one thread wins the race for it. */
+    if ( (agg->interval_ns != 0) && (now >= agg->next_ns) ) {
+        ib_bool_t snapshot = IB_FALSE;
+
+        ib_lock_lock(&agg->lock);
+        if (now >= agg->next_ns) {
+            agg->next_ns = now + agg->interval_ns;
+            snapshot = IB_TRUE;
+        }
+        ib_lock_unlock(&agg->lock);
+
+        if (snapshot == IB_TRUE) {
+            perf_aggregate_snapshot(agg, "periodic");
+        }
+    }
+}
+
+/**
+ * @internal
+ * Get the aggregate state of an engine.
+ *
+ * @param[in] ib IronBee object.
+ *
+ * @returns Aggregate state, or NULL if not in aggregate mode
+ */
+static perf_aggregate_t *perf_aggregate_get(const ib_engine_t *ib)
+{
+    perf_stats_cfg_t *cfg;
+    ib_status_t       rc;
+
+    rc = ib_context_module_config(ib_context_main(ib),
+                                  IB_MODULE_STRUCT_PTR, (void *)&cfg);
+    if (rc != IB_OK) {
+        return NULL;
+    }
+    return cfg->aggregate;
+}
+
+/**
+ * @internal
+ * Enable aggregate mode.
+ *
+ * @param[in] ib IronBee object.
+ * @param[in,out] cfg Main context configuration.
+ *
+ * @returns Status code
+ */
+static ib_status_t perf_aggregate_init(ib_engine_t *ib,
+                                       perf_stats_cfg_t *cfg)
+{
+    IB_FTRACE_INIT();
+    const char       *output = cfg->output;
+    perf_aggregate_t *agg;
+    ib_status_t       rc;
+
+    if (cfg->aggregate != NULL) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    agg = (perf_aggregate_t *)ib_mpool_calloc(ib_engine_pool_main_get(ib),
+                                              1, sizeof(*agg));
+    if (agg == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    agg->ib = ib;
+    agg->sock = -1;
+    agg->fp = NULL;
+    agg->stats = NULL;
+    agg->output = output;
+    agg->clock = (cfg->coarse_clock != 0) ?
+        ib_clock_get_time_ns_coarse : ib_clock_get_time_ns;
+
+    if ( (output != NULL) && (strncmp(output, "unix:", 5) == 0) ) {
+        const char *path = output + 5;
+
+        if (strlen(path) >= sizeof(agg->addr.sun_path)) {
+            ib_log_error(ib, "Perf stats socket path too long: %s", path);
+            IB_FTRACE_RET_STATUS(IB_EINVAL);
+        }
+        agg->sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (agg->sock < 0) {
+            ib_log_error(ib, "Failed to create perf stats socket: %s",
+                         strerror(errno));
+            IB_FTRACE_RET_STATUS(IB_EUNKNOWN);
+        }
+        fcntl(agg->sock, F_SETFL, O_NONBLOCK);
+        memset(&agg->addr, 0, sizeof(agg->addr));
+        agg->addr.sun_family = AF_UNIX;
+        strcpy(agg->addr.sun_path, path);
+    }
+    else if (output != NULL) {
+        agg->fp = fopen(output, "a");
+        if (agg->fp == NULL) {
+            ib_log_error(ib, "Failed to open perf stats file %s: %s",
+                         output, strerror(errno));
+            IB_FTRACE_RET_STATUS(IB_EOTHER);
+        }
+    }
+
+    rc = ib_lock_init(&agg->lock);
+    if (rc == IB_OK) {
+        rc = ib_tstats_create(&agg->stats, sizeof(perf_thread_t));
+        if (rc != IB_OK) {
+            ib_lock_destroy(&agg->lock);
+        }
+    }
+    if (rc != IB_OK) {
+        if (agg->fp != NULL) {
+            fclose(agg->fp);
+        }
+        if (agg->sock >= 0) {
+            close(agg->sock);
+        }
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    agg->started_ns = agg->clock();
+    agg->interval_ns = (uint64_t)cfg->interval * 1000000000;
+    agg->next_ns = agg->started_ns + agg->interval_ns;
+    cfg->aggregate = agg;
+
+    ib_log_debug(ib, "Perf stats aggregating, snapshot every %ds to %s",
+                 (int)cfg->interval, (output != NULL) ? output : "log");
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * @internal
+ * Write the final snapshot and release aggregate mode resources.
+ *
+ * @param[in] agg Aggregate state
+ */
+static void perf_aggregate_fini(perf_aggregate_t *agg)
+{
+    IB_FTRACE_INIT();
+
+    perf_aggregate_snapshot(agg, "final");
+
+    if (agg->fp != NULL) {
+        fclose(agg->fp);
+        agg->fp = NULL;
+    }
+    if (agg->sock >= 0) {
+        close(agg->sock);
+        agg->sock = -1;
+    }
+    ib_tstats_destroy(agg->stats);
+    agg->stats = NULL;
+    ib_lock_destroy(&agg->lock);
+
+    IB_FTRACE_RET_VOID();
+}
+
 /**
  * Perf Event Start Event Callback.
  *
@@ -162,6 +576,12 @@ static ib_status_t mod_perf_stats_reg_conn_counter(
     int rc;
     int event;
 
+    perf_aggregate_t *agg = perf_aggregate_get(ib);
+    if (agg != NULL) {
+        perf_aggregate_start(agg, eventp);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
     perf_info = ib_mpool_alloc(connp->mp, sizeof(*perf_info) * IB_STATE_EVENT_NUM);
 
     for (event = 0; event < IB_STATE_EVENT_NUM; ++event) {
@@ -324,6 +744,12 @@ static ib_status_t mod_perf_stats_event_start_conn_callback(
     event_info_t *eventp = (event_info_t *)cbdata;
     perf_info_t *perf_info;
 
+    perf_aggregate_t *agg = perf_aggregate_get(ib);
+    if (agg != NULL) {
+        perf_aggregate_start(agg, eventp);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
     ib_status_t rc = ib_hash_get(
         conn->data,
         &perf_info,
@@ -361,6 +787,12 @@ static ib_status_t mod_perf_stats_event_start_conndata_callback(
     event_info_t *eventp = (event_info_t *)cbdata;
     perf_info_t *perf_info;
 
+    perf_aggregate_t *agg = perf_aggregate_get(ib);
+    if (agg != NULL) {
+        perf_aggregate_start(agg, eventp);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
     ib_status_t rc = ib_hash_get(
         conndata->conn->data,
         &perf_info,
@@ -398,6 +830,12 @@ static ib_status_t mod_perf_stats_event_start_tx_callback(
     event_info_t *eventp = (event_info_t *)cbdata;
     perf_info_t *perf_info;
 
+    perf_aggregate_t *agg = perf_aggregate_get(ib);
+    if (agg != NULL) {
+        perf_aggregate_start(agg, eventp);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
     ib_status_t rc = ib_hash_get(
         tx->conn->data,
         &perf_info,
@@ -436,6 +874,12 @@ static ib_status_t mod_perf_stats_event_start_txdata_callback(
     event_info_t *eventp = (event_info_t *)cbdata;
     perf_info_t *perf_info;
 
+    perf_aggregate_t *agg = perf_aggregate_get(ib);
+    if (agg != NULL) {
+        perf_aggregate_start(agg, eventp);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
     ib_status_t rc = ib_hash_get(
         tx->conn->data,
         &perf_info,
@@ -474,6 +918,12 @@ static ib_status_t mod_perf_stats_event_stop_conn_callback(
     event_info_t *eventp = (event_info_t *)cbdata;
     perf_info_t *perf_info;
 
+    perf_aggregate_t *agg = perf_aggregate_get(ib);
+    if (agg != NULL) {
+        perf_aggregate_stop(agg, eventp);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
     ib_status_t rc = ib_hash_get(
         conn->data,
         &perf_info,
@@ -513,6 +963,12 @@ static ib_status_t mod_perf_stats_event_stop_conndata_callback(
     event_info_t *eventp = (event_info_t *)cbdata;
     perf_info_t *perf_info;
 
+    perf_aggregate_t *agg = perf_aggregate_get(ib);
+    if (agg != NULL) {
+        perf_aggregate_stop(agg, eventp);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
     ib_status_t rc = ib_hash_get(
         conndata->conn->data,
         &perf_info,
@@ -551,6 +1007,12 @@ static ib_status_t mod_perf_stats_event_stop_tx_callback(
     event_info_t *eventp = (event_info_t *)cbdata;
     perf_info_t *perf_info;
 
+    perf_aggregate_t *agg = perf_aggregate_get(ib);
+    if (agg != NULL) {
+        perf_aggregate_stop(agg, eventp);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
     ib_status_t rc = ib_hash_get(
         tx->conn->data,
         &perf_info,
@@ -591,6 +1053,12 @@ static ib_status_t mod_perf_stats_event_stop_txdata_callback(
     event_info_t *eventp = (event_info_t *)cbdata;
     perf_info_t *perf_info;
 
+    perf_aggregate_t *agg = perf_aggregate_get(ib);
+    if (agg != NULL) {
+        perf_aggregate_stop(agg, eventp);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
     ib_status_t rc = ib_hash_get(
         tx->conn->data,
         &perf_info,
@@ -730,11 +1198,26 @@ static ib_status_t perf_stats_context_close(ib_engine_t  *ib,
     ib_status_t rc;
     int event;
 
+    perf_stats_cfg_t *cfg;
+
     /* Check that we are in the main ctx otherwise return */
     if (ctx != ib_context_main(ib)) {
         IB_FTRACE_RET_STATUS(IB_OK);
     }
 
+    rc = ib_context_module_config(ctx, IB_MODULE_STRUCT_PTR, (void *)&cfg);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to fetch perf stats config: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    if (cfg->mode == PERF_STATS_MODE_AGGREGATE) {
+        rc = perf_aggregate_init(ib, cfg);
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+
     for (event = 0; event < IB_STATE_EVENT_NUM; ++event) {
         event_info_t *eventp = &event_info[event];
 
@@ -799,6 +1282,44 @@ static ib_status_t perf_stats_context_close(ib_engine_t  *ib,
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
+/**
+ * @internal
+ * Finish a context for the perf_stats module.
+ *
+ * Writes the engine's final aggregate snapshot when its main context is
+ * destroyed.  This is not done when the module is unloaded, as other
+ * engines may still be using the module.
+ *
+ * @param[in] ib IronBee object
+ * @param[in] m Module object
+ * @param[in] ctx Context object
+ * @param[in] cbdata Callback data (unused)
+ */
+static ib_status_t perf_stats_context_destroy(ib_engine_t  *ib,
+                                              ib_module_t  *m,
+                                              ib_context_t *ctx,
+                                              void         *cbdata)
+{
+    IB_FTRACE_INIT();
+    perf_stats_cfg_t *cfg;
+    ib_status_t rc;
+
+    if (ctx != ib_context_main(ib)) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    rc = ib_context_module_config(ctx, m, (void *)&cfg);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    if (cfg->aggregate != NULL) {
+        perf_aggregate_fini(cfg->aggregate);
+        cfg->aggregate = NULL;
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
 /* Called when module is unloaded. */
 static ib_status_t perf_stats_fini(ib_engine_t *ib,
                                    ib_module_t *m,
@@ -809,13 +1330,142 @@ static ib_status_t perf_stats_fini(ib_engine_t *ib,
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
+/**
+ * @internal
+ * Handle single parameter directives.
+ *
+ * @param[in] cp Config parser
+ * @param[in] name Directive name
+ * @param[in] p1 First parameter
+ * @param[in] cbdata Callback data (unused)
+ *
+ * @returns Status code
+ */
+static ib_status_t perf_stats_dir_param1(ib_cfgparser_t *cp,
+                                         const char *name,
+                                         const char *p1,
+                                         void *cbdata)
+{
+    IB_FTRACE_INIT();
+    ib_engine_t  *ib = cp->ib;
+    ib_context_t *ctx = ib_context_main(ib);
+    ib_status_t   rc;
+
+    assert(name != NULL);
+    assert(p1 != NULL);
+
+    ib_log_debug2(ib, "%s: %s", name, p1);
+
+    /* These are engine wide, so always set on the main context. */
+    if (strcasecmp("PerfStatsMode", name) == 0) {
+        if (strcasecmp("Aggregate", p1) == 0) {
+            rc = ib_context_set_num(ctx, MODULE_NAME_STR ".mode",
+                                    PERF_STATS_MODE_AGGREGATE);
+        }
+        else if (strcasecmp("Connection", p1) == 0) {
+            rc = ib_context_set_num(ctx, MODULE_NAME_STR ".mode",
+                                    PERF_STATS_MODE_CONN);
+        }
+        else {
+            ib_log_error(ib, "Invalid %s \"%s\"", name, p1);
+            rc = IB_EINVAL;
+        }
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    else if (strcasecmp("PerfStatsInterval", name) == 0) {
+        long interval = strtol(p1, NULL, 0);
+
+        if (interval < 0) {
+            ib_log_error(ib, "Invalid %s \"%s\"", name, p1);
+            IB_FTRACE_RET_STATUS(IB_EINVAL);
+        }
+        rc = ib_context_set_num(ctx, MODULE_NAME_STR ".interval", interval);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    else if (strcasecmp("PerfStatsClock", name) == 0) {
+        if (strcasecmp("Coarse", p1) == 0) {
+            rc = ib_context_set_num(ctx, MODULE_NAME_STR ".coarse_clock", 1);
+        }
+        else if (strcasecmp("Precise", p1) == 0) {
+            rc = ib_context_set_num(ctx, MODULE_NAME_STR ".coarse_clock", 0);
+        }
+        else {
+            ib_log_error(ib, "Invalid %s \"%s\"", name, p1);
+            rc = IB_EINVAL;
+        }
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    else if (strcasecmp("PerfStatsOutput", name) == 0) {
+        rc = ib_context_set_string(ctx, MODULE_NAME_STR ".output", p1);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    ib_log_error(ib, "Unhandled directive: %s %s", name, p1);
+    IB_FTRACE_RET_STATUS(IB_EINVAL);
+}
+
+static IB_CFGMAP_INIT_STRUCTURE(perf_stats_config_map) = {
+    IB_CFGMAP_INIT_ENTRY(
+        MODULE_NAME_STR ".mode",
+        IB_FTYPE_NUM,
+        perf_stats_cfg_t,
+        mode
+    ),
+    IB_CFGMAP_INIT_ENTRY(
+        MODULE_NAME_STR ".interval",
+        IB_FTYPE_NUM,
+        perf_stats_cfg_t,
+        interval
+    ),
+    IB_CFGMAP_INIT_ENTRY(
+        MODULE_NAME_STR ".coarse_clock",
+        IB_FTYPE_NUM,
+        perf_stats_cfg_t,
+        coarse_clock
+    ),
+    IB_CFGMAP_INIT_ENTRY(
+        MODULE_NAME_STR ".output",
+        IB_FTYPE_NULSTR,
+        perf_stats_cfg_t,
+        output
+    ),
+
+    IB_CFGMAP_INIT_LAST
+};
+
+static IB_DIRMAP_INIT_STRUCTURE(perf_stats_directive_map) = {
+    IB_DIRMAP_INIT_PARAM1(
+        "PerfStatsMode",
+        perf_stats_dir_param1,
+        NULL
+    ),
+    IB_DIRMAP_INIT_PARAM1(
+        "PerfStatsInterval",
+        perf_stats_dir_param1,
+        NULL
+    ),
+    IB_DIRMAP_INIT_PARAM1(
+        "PerfStatsClock",
+        perf_stats_dir_param1,
+        NULL
+    ),
+    IB_DIRMAP_INIT_PARAM1(
+        "PerfStatsOutput",
+        perf_stats_dir_param1,
+        NULL
+    ),
+
+    /* End */
+    IB_DIRMAP_INIT_LAST
+};
+
 /* Initialize the module structure. */
 IB_MODULE_INIT(
     IB_MODULE_HEADER_DEFAULTS,      /* Default metadata */
     MODULE_NAME_STR,                /* Module name */
-    IB_MODULE_CONFIG_NULL,          /* Global config data */
-    NULL,                           /* Configuration field map */
-    NULL,                           /* Config directive map */
+    IB_MODULE_CONFIG(&perf_stats_global_cfg), /* Global config data */
+    perf_stats_config_map,          /* Configuration field map */
+    perf_stats_directive_map,       /* Config directive map */
     perf_stats_init,                /* Initialize function */
     NULL,                           /* Callback data */
     perf_stats_fini,                /* Finish function */
@@ -824,7 +1474,7 @@ IB_MODULE_INIT(
     NULL,                           /* Callback data */
     perf_stats_context_close,       /* Context close function */
     NULL,                           /* Callback data */
-    NULL,                           /* Context destroy function */
+    perf_stats_context_destroy,     /* Context destroy function */
     NULL                            /* Callback data */
 );
 
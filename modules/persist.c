@@ -0,0 +1,585 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; Persistent Collection Module
+ *
+ * Numeric collections which persist across transactions and, for servers
+ * which fork their workers after configuration, across processes.
+ *
+ * @code
+ * LoadModule ibmod_persist.so
+ * PersistMaxEntries 100000
+ * PersistCollection IP %{remote_addr} 60
+ *
+ * Rule remote_addr @exists "" id:rate/count phase:REQUEST_HEADER \
+ *     setvar:IP:requests=+1
+ * Rule IP:requests @gt 100 id:rate/ip phase:REQUEST_HEADER block
+ * @endcode
+ *
+ * Each collection is named by the first parameter of PersistCollection and
+ * is keyed by its second, which is expanded for every transaction.  Every
+ * transaction with the same key sees the same values.  The optional third
+ * parameter is a time to live in seconds: a value expires that long after
+ * it was set, or after it was first incremented, so counters count over a
+ * fixed window.  Values are numbers; increments with setvar are atomic.
+ *
+ * All collections share one table of PersistMaxEntries values in shared
+ * memory (about 160 bytes each), created when configuration is finished.
+ * When it is full the least recently used value is evicted.  The table
+ * belongs to the engine, so values do not survive a reload.
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include <ironbee/cfgmap.h>
+#include <ironbee/config.h>
+#include <ironbee/debug.h>
+#include <ironbee/engine.h>
+#include <ironbee/expand.h>
+#include <ironbee/field.h>
+#include <ironbee/list.h>
+#include <ironbee/module.h>
+#include <ironbee/mpool.h>
+#include <ironbee/shmtable.h>
+#include <ironbee/util.h>
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Define the module name as well as a string version of it. */
+#define MODULE_NAME        persist
+#define MODULE_NAME_STR    IB_XSTRINGIFY(MODULE_NAME)
+
+/* Declare the public module symbol. */
+IB_MODULE_DECLARE();
+
+/**
+ * @internal
+ * A persistent collection.
+ */
+typedef struct {
+    const char           *name;        /**< Collection name */
+    const char           *key;         /**< Key, before expansion */
+    ib_expand_template_t *tmpl;        /**< Compiled key expansion */
+    uint32_t              ttl;         /**< Time to live or 0 */
+} persist_coll_t;
+
+/**
+ * @internal
+ * Module configuration.
+ *
+ * Only the main context's configuration is used.
+ */
+typedef struct {
+    ib_num_t       max_entries;        /**< Size of table */
+    ib_list_t     *colls;              /**< persist_coll_t, or NULL */
+    ib_shmtable_t *table;              /**< Table, once configured */
+} persist_cfg_t;
+
+/* Instantiate a module global configuration. */
+static persist_cfg_t persist_global_cfg = {
+    65536,                             /* max_entries */
+    NULL,                              /* colls */
+    NULL                               /* table */
+};
+
+/**
+ * @internal
+ * A persistent collection as seen by one transaction.
+ *
+ * Table keys are the collection name, the expanded collection key and the
+ * name within the collection, separated by NULs.
+ */
+typedef struct {
+    ib_tx_t              *tx;          /**< Transaction */
+    const persist_coll_t *coll;        /**< Collection */
+    ib_shmtable_t        *table;       /**< Table */
+    char                  key[IB_SHMTABLE_KEY_MAX]; /**< Key prefix */
+    size_t                klen;        /**< Length of key prefix */
+} persist_tx_coll_t;
+
+/**
+ * @internal
+ * Build the table key of a name within a collection.
+ *
+ * @param[in] txcoll Transaction collection
+ * @param[in] name Name within collection
+ * @param[in] nlen Length of @a name
+ * @param[out] key Buffer of IB_SHMTABLE_KEY_MAX bytes
+ * @param[out] pklen Address which length of key is written
+ *
+ * @returns IB_OK, or IB_EINVAL if the key is too long
+ */
+static ib_status_t persist_key(const persist_tx_coll_t *txcoll,
+                               const void *name,
+                               size_t nlen,
+                               char *key,
+                               size_t *pklen)
+{
+    if (txcoll->klen + nlen > IB_SHMTABLE_KEY_MAX) {
+        ib_log_error_tx(txcoll->tx,
+                        "Key of %s:%.*s is too long for the persistent "
+                        "collection table",
+                        txcoll->coll->name, (int)nlen, (const char *)name);
+        return IB_EINVAL;
+    }
+    memcpy(key, txcoll->key, txcoll->klen);
+    memcpy(key + txcoll->klen, name, nlen);
+    *pklen = txcoll->klen + nlen;
+    return IB_OK;
+}
+
+/**
+ * @internal
+ * Collection field getter.
+ *
+ * With a name, writes a numeric field holding its value, or NULL if it has
+ * none.  Collections cannot be listed, so without a name writes an empty
+ * list.
+ */
+static ib_status_t persist_get(const ib_field_t *field,
+                               void *out_pval,
+                               const void *arg,
+                               size_t alen,
+                               void *data)
+{
+    IB_FTRACE_INIT();
+    const persist_tx_coll_t *txcoll = (const persist_tx_coll_t *)data;
+    ib_mpool_t *mp = txcoll->tx->mp;
+    char key[IB_SHMTABLE_KEY_MAX];
+    size_t klen;
+    ib_num_t val;
+    ib_field_t *f;
+    ib_status_t rc;
+
+    if (arg == NULL) {
+        rc = ib_list_create((ib_list_t **)out_pval, mp);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    rc = persist_key(txcoll, arg, alen, key, &klen);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    rc = ib_shmtable_get(txcoll->table, key, klen, &val);
+    if (rc == IB_ENOENT) {
+        *(ib_field_t **)out_pval = NULL;
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    else if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    rc = ib_field_create(&f, mp, (const char *)arg, alen,
+                         IB_FTYPE_NUM, ib_ftype_num_in(&val));
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    *(ib_field_t **)out_pval = f;
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * @internal
+ * Collection field setter.
+ *
+ * @a in_pval is a field holding the new value, which must be numeric.
+ */
+static ib_status_t persist_set(ib_field_t *field,
+                               const void *arg,
+                               size_t alen,
+                               void *in_pval,
+                               void *data)
+{
+    IB_FTRACE_INIT();
+    const persist_tx_coll_t *txcoll = (const persist_tx_coll_t *)data;
+    const ib_field_t *f = (const ib_field_t *)in_pval;
+    char key[IB_SHMTABLE_KEY_MAX];
+    size_t klen;
+    ib_num_t val;
+    ib_status_t rc;
+
+    if ( (arg == NULL) || (f == NULL) ) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    rc = ib_field_value_type(f, ib_ftype_num_out(&val), IB_FTYPE_NUM);
+    if (rc != IB_OK) {
+        ib_log_error_tx(txcoll->tx,
+                        "Persistent collection %s only holds numbers",
+                        txcoll->coll->name);
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    rc = persist_key(txcoll, arg, alen, key, &klen);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    rc = ib_shmtable_set(txcoll->table, key, klen, val, txcoll->coll->ttl);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+/**
+ * @internal
+ * Collection field adjust function; atomic.
+ */
+static ib_status_t persist_adjust(ib_field_t *field,
+                                  const void *arg,
+                                  size_t alen,
+                                  ib_num_t adjval,
+                                  void *data)
+{
+    IB_FTRACE_INIT();
+    const persist_tx_coll_t *txcoll = (const persist_tx_coll_t *)data;
+    char key[IB_SHMTABLE_KEY_MAX];
+    size_t klen;
+    ib_status_t rc;
+
+    if (arg == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    rc = persist_key(txcoll, arg, alen, key, &klen);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    rc = ib_shmtable_add(txcoll->table, key, klen,
+                         adjval, txcoll->coll->ttl, NULL);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+/**
+ * @internal
+ * Add a transaction's persistent collections to its data.
+ *
+ * A collection whose key expands to an empty string is left out.
+ *
+ * @param[in] ib IronBee engine
+ * @param[in] tx Transaction
+ * @param[in] event Event type
+ * @param[in] cbdata Callback data (unused)
+ *
+ * @returns Status code
+ */
+static ib_status_t persist_tx(ib_engine_t *ib,
+                              ib_tx_t *tx,
+                              ib_state_event_type_t event,
+                              void *cbdata)
+{
+    IB_FTRACE_INIT();
+    persist_cfg_t *cfg;
+    const ib_list_node_t *node;
+    ib_status_t rc;
+
+    rc = ib_context_module_config(ib_context_main(ib), IB_MODULE_STRUCT_PTR,
+                                  (void *)&cfg);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    if (cfg->table == NULL) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    IB_LIST_LOOP_CONST(cfg->colls, node) {
+        const persist_coll_t *coll =
+            (const persist_coll_t *)ib_list_node_data_const(node);
+        persist_tx_coll_t *txcoll;
+        size_t nlen = strlen(coll->name);
+        char *value;
+        size_t vlen;
+        ib_field_t *f;
+
+        rc = ib_data_expand_template(tx->dpi, coll->tmpl, IB_FALSE,
+                                     &value, &vlen);
+        if (rc != IB_OK) {
+            ib_log_error_tx(tx, "Failed to expand key \"%s\" of persistent "
+                            "collection %s: %s",
+                            coll->key, coll->name, ib_status_to_string(rc));
+            continue;
+        }
+        if (vlen == 0) {
+            ib_log_debug_tx(tx, "Empty key for persistent collection %s",
+                            coll->name);
+            continue;
+        }
+        if (nlen + vlen + 2 >= IB_SHMTABLE_KEY_MAX) {
+            ib_log_error_tx(tx, "Key \"%.*s\" of persistent collection %s "
+                            "is too long", (int)vlen, value, coll->name);
+            continue;
+        }
+
+        txcoll = (persist_tx_coll_t *)
+            ib_mpool_alloc(tx->mp, sizeof(*txcoll));
+        if (txcoll == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+        txcoll->tx = tx;
+        txcoll->coll = coll;
+        txcoll->table = cfg->table;
+        memcpy(txcoll->key, coll->name, nlen + 1);
+        memcpy(txcoll->key + nlen + 1, value, vlen);
+        txcoll->key[nlen + 1 + vlen] = '\0';
+        txcoll->klen = nlen + vlen + 2;
+
+        rc = ib_field_create_dynamic(&f, tx->mp, coll->name, nlen,
+                                     IB_FTYPE_LIST,
+                                     persist_get, txcoll,
+                                     persist_set, txcoll);
+        if (rc == IB_OK) {
+            rc = ib_field_dynamic_adjust(f, persist_adjust, txcoll);
+        }
+        if (rc == IB_OK) {
+            rc = ib_data_add(tx->dpi, f);
+        }
+        if (rc != IB_OK) {
+            ib_log_error_tx(tx, "Failed to add persistent collection %s: %s",
+                            coll->name, ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+static ib_status_t persist_max_entries_dir_param1(ib_cfgparser_t *cp,
+                                                  const char *name,
+                                                  const char *p1,
+                                                  void *cbdata)
+{
+    IB_FTRACE_INIT();
+
+    assert(cp != NULL);
+    assert(name != NULL);
+    assert(p1 != NULL);
+
+    ib_status_t rc;
+    char *end;
+    long size = strtol(p1, &end, 0);
+
+    if ( (*end != '\0') || (size <= 0) ) {
+        ib_log_error(cp->ib, "Invalid %s \"%s\"", name, p1);
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    /* The table is engine wide, so always set on the main context. */
+    rc = ib_context_set_num(ib_context_main(cp->ib),
+                            MODULE_NAME_STR ".max_entries",
+                            size);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+static ib_status_t persist_collection_dir(ib_cfgparser_t *cp,
+                                          const char *name,
+                                          const ib_list_t *args,
+                                          void *cbdata)
+{
+    IB_FTRACE_INIT();
+
+    assert(cp != NULL);
+    assert(name != NULL);
+    assert(args != NULL);
+
+    ib_engine_t *ib = cp->ib;
+    ib_mpool_t *mp = ib_engine_pool_main_get(ib);
+    const ib_list_node_t *node;
+    persist_cfg_t *cfg;
+    persist_coll_t *coll;
+    const char *ttl = NULL;
+    ib_status_t rc;
+
+    if ( (ib_list_elements(args) < 2) || (ib_list_elements(args) > 3) ) {
+        ib_log_error(ib, "%s requires a name, a key and an optional "
+                     "time to live", name);
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    rc = ib_context_module_config(ib_context_main(ib), IB_MODULE_STRUCT_PTR,
+                                  (void *)&cfg);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    coll = (persist_coll_t *)ib_mpool_calloc(mp, 1, sizeof(*coll));
+    if (coll == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    node = ib_list_first_const(args);
+    coll->name =
+        ib_mpool_strdup(mp, (const char *)ib_list_node_data_const(node));
+    node = ib_list_node_next_const(node);
+    coll->key =
+        ib_mpool_strdup(mp, (const char *)ib_list_node_data_const(node));
+    node = ib_list_node_next_const(node);
+    if (node != NULL) {
+        ttl = (const char *)ib_list_node_data_const(node);
+    }
+    if ( (coll->name == NULL) || (coll->key == NULL) ) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    if ( (*coll->name == '\0') || (strchr(coll->name, ':') != NULL) ) {
+        ib_log_error(ib, "Invalid %s name \"%s\"", name, coll->name);
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    if (ttl != NULL) {
+        char *end;
+        long secs = strtol(ttl, &end, 0);
+
+        if ( (*end != '\0') || (secs < 0) || (secs > UINT32_MAX) ) {
+            ib_log_error(ib, "Invalid %s time to live \"%s\"", name, ttl);
+            IB_FTRACE_RET_STATUS(IB_EINVAL);
+        }
+        coll->ttl = (uint32_t)secs;
+    }
+
+    rc = ib_data_expand_compile(mp, coll->key, strlen(coll->key),
+                                &(coll->tmpl));
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Invalid %s key \"%s\": %s",
+                     name, coll->key, ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    if (cfg->colls == NULL) {
+        rc = ib_list_create(&(cfg->colls), mp);
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+    rc = ib_list_push(cfg->colls, coll);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    ib_log_debug(ib, "Persistent collection %s keyed by \"%s\" ttl=%u",
+                 coll->name, coll->key, (unsigned)coll->ttl);
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+static IB_CFGMAP_INIT_STRUCTURE(persist_config_map) = {
+    IB_CFGMAP_INIT_ENTRY(
+        MODULE_NAME_STR ".max_entries",
+        IB_FTYPE_NUM,
+        persist_cfg_t,
+        max_entries
+    ),
+    IB_CFGMAP_INIT_LAST
+};
+
+static IB_DIRMAP_INIT_STRUCTURE(persist_directive_map) = {
+
+    /* Size of the table */
+    IB_DIRMAP_INIT_PARAM1(
+        "PersistMaxEntries",
+        persist_max_entries_dir_param1,
+        NULL
+    ),
+
+    /* Define a collection */
+    IB_DIRMAP_INIT_LIST(
+        "PersistCollection",
+        persist_collection_dir,
+        NULL
+    ),
+
+    /* signal the end of the list */
+    IB_DIRMAP_INIT_LAST
+};
+
+/* Called when module is loaded. */
+static ib_status_t persist_init(ib_engine_t *ib,
+                                ib_module_t *m,
+                                void *cbdata)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    rc = ib_hook_tx_register(ib,
+                             handle_context_tx_event,
+                             persist_tx,
+                             NULL);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+/* Called when a context is closed; creates the table for the main one. */
+static ib_status_t persist_context_close(ib_engine_t *ib,
+                                         ib_module_t *m,
+                                         ib_context_t *ctx,
+                                         void *cbdata)
+{
+    IB_FTRACE_INIT();
+    persist_cfg_t *cfg;
+    ib_status_t rc;
+
+    if (ctx != ib_context_main(ib)) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    rc = ib_context_module_config(ctx, IB_MODULE_STRUCT_PTR, (void *)&cfg);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to fetch persist config: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    if ( (cfg->colls == NULL) || (cfg->table != NULL) ) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    /* Created now, before the server forks its workers. */
+    rc = ib_shmtable_create(&(cfg->table), ib_engine_pool_main_get(ib),
+                            (size_t)cfg->max_entries);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to create persistent collection table "
+                     "of %" PRId64 " entries: %s",
+                     cfg->max_entries, ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    ib_log_debug(ib, "Persistent collection table size %" PRId64,
+                 cfg->max_entries);
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/* Initialize the module structure. */
+IB_MODULE_INIT(
+    IB_MODULE_HEADER_DEFAULTS,             /* Default metadata */
+    MODULE_NAME_STR,                       /* Module name */
+    IB_MODULE_CONFIG(&persist_global_cfg), /* Global config data */
+    persist_config_map,                    /* Configuration field map */
+    persist_directive_map,                 /* Config directive map */
+    persist_init,                          /* Initialize function */
+    NULL,                                  /* Callback data */
+    NULL,                                  /* Finish function */
+    NULL,                                  /* Callback data */
+    NULL,                                  /* Context open function */
+    NULL,                                  /* Callback data */
+    persist_context_close,                 /* Context close function */
+    NULL,                                  /* Callback data */
+    NULL,                                  /* Context destroy function */
+    NULL                                   /* Callback data */
+);
@@ -80,14 +80,50 @@ static phase_lookup_t phase_lookup_table[] =
 };
 
 /**
- * Ironbee's root rule state.
+ * Lua state of an engine.
  */
-static lua_State *g_ironbee_rules_lua;
+typedef struct {
+    lua_State *L;               /**< Ironbee's root rule state */
+    ib_lock_t  lock;            /**< Protects Lua thread creation and
+                                 *   destruction */
+} rules_lua_t;
 
 /**
- * @brief Semaphore ID used to protect Lua thread creation and destruction.
+ * Module configuration.
+ *
+ * The Lua state belongs to the engine: it is only set on the main context,
+ * and is closed when that is destroyed.
  */
-static ib_lock_t g_lua_lock;
+typedef struct {
+    rules_lua_t *lua;           /**< Lua state, or NULL if unavailable */
+} rules_cfg_t;
+
+/* Instantiate a module global configuration. */
+static rules_cfg_t rules_global_cfg = {
+    NULL                        /* lua */
+};
+
+/**
+ * Get the Lua state of an engine.
+ * @internal
+ *
+ * @param[in] ib IronBee engine
+ *
+ * @returns Lua state, or NULL if Lua is not available
+ */
+static rules_lua_t *rules_lua_get(const ib_engine_t *ib)
+{
+    IB_FTRACE_INIT();
+    rules_cfg_t *cfg;
+    ib_status_t rc;
+
+    rc = ib_context_module_config(ib_context_main(ib),
+                                  IB_MODULE_STRUCT_PTR, (void *)&cfg);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_PTR(rules_lua_t, NULL);
+    }
+    IB_FTRACE_RET_PTR(rules_lua_t, cfg->lua);
+}
 
 
 /**
@@ -117,7 +153,7 @@ static ib_status_t lookup_phase(const char *str,
 }
 
 /**
- * @brief Callback type for functions executed protected by g_lua_lock.
+ * @brief Callback type for functions executed protected by the Lua lock.
  * @details This callback should take a @c ib_engine_t* which is used
  *          for logging, @c a lua_State* which is used to create the
  *          new thread, and a @c lua_State** which will be assigned a
@@ -233,14 +269,15 @@ static ib_status_t parse_operator(ib_cfgparser_t *cp,
         }
     }
 
-    /* Create the operator instance */
-    rc = ib_operator_inst_create(cp->ib,
-                                 cp->cur_ctx,
-                                 ib_rule_required_op_flags(rule),
-                                 op,
-                                 args,
-                                 flags,
-                                 &operator);
+    /* Create the operator instance; expensive operators (i.e. regular
+     * expressions) are compiled in parallel once configuration is done. */
+    rc = ib_operator_inst_create_deferred(cp->ib,
+                                          cp->cur_ctx,
+                                          ib_rule_required_op_flags(rule),
+                                          op,
+                                          args,
+                                          flags,
+                                          &operator);
     if (rc != IB_OK) {
         ib_log_error(cp->ib,
                      "Failed to create operator instance '%s': %s",
@@ -683,6 +720,14 @@ static ib_status_t parse_modifier(ib_cfgparser_t *cp,
         }
         if (expand == IB_TRUE) {
             rule->meta.flags |= IB_RULEMD_FLAG_EXPAND_MSG;
+            rc = ib_data_expand_compile(ib_rule_mpool(cp->ib),
+                                        value, strlen(value),
+                                        &(rule->meta.msg_tmpl));
+            if (rc != IB_OK) {
+                ib_log_error(cp->ib, "Failed to compile message expansion: %d",
+                             rc);
+                IB_FTRACE_RET_STATUS(rc);
+            }
         }
         IB_FTRACE_RET_STATUS(IB_OK);
     }
@@ -698,6 +743,14 @@ static ib_status_t parse_modifier(ib_cfgparser_t *cp,
         }
         if (expand == IB_TRUE) {
             rule->meta.flags |= IB_RULEMD_FLAG_EXPAND_DATA;
+            rc = ib_data_expand_compile(ib_rule_mpool(cp->ib),
+                                        value, strlen(value),
+                                        &(rule->meta.data_tmpl));
+            if (rc != IB_OK) {
+                ib_log_error(cp->ib, "Failed to compile logdata expansion: %d",
+                             rc);
+                IB_FTRACE_RET_STATUS(rc);
+            }
         }
         IB_FTRACE_RET_STATUS(IB_OK);
     }
@@ -809,11 +862,11 @@ static ib_status_t parse_modifier(ib_cfgparser_t *cp,
 }
 
 /**
- * @brief This will use @c g_lua_lock to atomically call @a fn.
+ * @brief This will use the engine's Lua lock to atomically call @a fn.
  * @details The argument @a fn will be either
  *          ib_lua_new_thread(ib_engine_t*, lua_State**) or
  *          ib_lua_join_thread(ib_engine_t*, lua_State**) which will be called
- *          only if @c g_lua_lock can be locked using @c semop.
+ *          only if the lock can be locked.
  * @param[in] ib IronBee context. Used for logging.
  * @param[in] fn The function to execute. This is passed @a ib and @a fn.
  * @param[in,out] L The Lua State to create or destroy. Passed to @a fn.
@@ -831,8 +884,15 @@ static ib_status_t call_in_critical_section(ib_engine_t *ib,
     ib_status_t ib_rc;
     /* Return code form critical call. */
     ib_status_t critical_rc;
+    /* The engine's Lua state. */
+    rules_lua_t *lua = rules_lua_get(ib);
+
+    if (lua == NULL) {
+        ib_log_error(ib, "Lua is not available");
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
 
-    ib_rc  = ib_lock_lock(&g_lua_lock);
+    ib_rc  = ib_lock_lock(&lua->lock);
 
     /* Report semop error and return. */
     if (ib_rc != IB_OK) {
@@ -841,9 +901,9 @@ static ib_status_t call_in_critical_section(ib_engine_t *ib,
     }
 
     /* Execute lua call in critical section. */
-    critical_rc = fn(ib, g_ironbee_rules_lua, L);
+    critical_rc = fn(ib, lua->L, L);
 
-    ib_rc = ib_lock_unlock(&g_lua_lock);
+    ib_rc = ib_lock_unlock(&lua->lock);
 
     if (critical_rc != IB_OK) {
         ib_log_error(ib, "Critical call failed: %s",
@@ -965,9 +1025,10 @@ static ib_status_t rules_ruleext_params(ib_cfgparser_t *cp,
     ib_rule_t *rule;
     ib_operator_inst_t *op_inst;
     const char *file_name;
+    rules_lua_t *lua = rules_lua_get(cp->ib);
 
     /* Check if lua is available. */
-    if (g_ironbee_rules_lua == NULL) {
+    if (lua == NULL) {
         ib_log_error(cp->ib, "Lua is not available");
         IB_FTRACE_RET_STATUS(IB_EINVAL);
     }
@@ -1009,7 +1070,7 @@ static ib_status_t rules_ruleext_params(ib_cfgparser_t *cp,
     /* Using the rule->meta and file_name, load and stage the ext rule. */
     if (strncasecmp(file_name, "lua:", 4) == 0) {
         rc = ib_lua_load_func(cp->ib,
-                             g_ironbee_rules_lua,
+                             lua->L,
                              file_name+4,
                              ib_rule_id(rule));
 
@@ -1324,11 +1385,6 @@ static IB_DIRMAP_INIT_STRUCTURE(rules_directive_map) = {
     IB_DIRMAP_INIT_LAST
 };
 
-static void clean_up_ipc_mem(void)
-{
-    ib_lock_destroy(&g_lua_lock);
-}
-
 static ib_status_t rules_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
 {
     IB_FTRACE_INIT();
@@ -1355,28 +1411,45 @@ static ib_status_t rules_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
 
     int i = 0; /**< An iterator. */
 
-    ib_rc = ib_lock_init(&g_lua_lock);
+    rules_cfg_t *cfg;            /**< Main context configuration. */
+    rules_lua_t *lua;            /**< This engine's Lua state. */
 
+    if (m == NULL) {
+        IB_FTRACE_MSG("Module is null.");
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    /* Each engine has its own Lua state, as the rules of each are loaded
+     * into it.  It is closed with the main context, not when the module is
+     * unloaded, as other engines may still be using the module. */
+    ib_rc = ib_context_module_config(ib_context_main(ib), m, (void *)&cfg);
     if (ib_rc != IB_OK) {
-        ib_log_error(ib, "Failed to initialize lua global lock.");
+        ib_log_error(ib, "Could not retrieve rules module configuration.");
+        IB_FTRACE_RET_STATUS(ib_rc);
     }
 
-    atexit(&clean_up_ipc_mem);
+    lua = (rules_lua_t *)ib_mpool_calloc(ib_engine_pool_main_get(ib),
+                                         1, sizeof(*lua));
+    if (lua == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
 
-    if (m == NULL) {
-        IB_FTRACE_MSG("Module is null.");
-        clean_up_ipc_mem();
-        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    ib_rc = ib_lock_init(&lua->lock);
+    if (ib_rc != IB_OK) {
+        ib_log_error(ib, "Failed to initialize lua lock.");
+        IB_FTRACE_RET_STATUS(ib_rc);
     }
 
-    g_ironbee_rules_lua = luaL_newstate();
+    lua->L = luaL_newstate();
 
-    if (g_ironbee_rules_lua == NULL) {
+    if (lua->L == NULL) {
         ib_log_alert(ib, "Failed to create LuaJIT state.");
+        ib_lock_destroy(&lua->lock);
         IB_FTRACE_RET_STATUS(IB_OK);
     }
+    cfg->lua = lua;
 
-    luaL_openlibs(g_ironbee_rules_lua);
+    luaL_openlibs(lua->L);
 
     ib_rc = ib_context_module_config(ib_context_main(ib),
                                      ib_core_module(),
@@ -1411,7 +1484,7 @@ static ib_status_t rules_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
         strcpy(path + strlen(path), "/");
         strcpy(path + strlen(path), lua_file_pattern);
 
-        ib_lua_add_require_path(ib, g_ironbee_rules_lua, path);
+        ib_lua_add_require_path(ib, lua->L, path);
 
         ib_log_debug(ib,"Added %s to lua search path.", path);
     }
@@ -1424,7 +1497,7 @@ static ib_status_t rules_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
     for (i = 0; lua_preloads[i][0] != NULL; ++i)
     {
         ib_rc = ib_lua_require(ib,
-                               g_ironbee_rules_lua,
+                               lua->L,
                                lua_preloads[i][0],
                                lua_preloads[i][1]);
         if (ib_rc != IB_OK)
@@ -1433,7 +1506,6 @@ static ib_status_t rules_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
                 "Failed to load mode %s into %s.",
                 lua_preloads[i][1],
                 lua_preloads[i][0]);
-            clean_up_ipc_mem();
             IB_FTRACE_RET_STATUS(ib_rc);
         }
     }
@@ -1441,15 +1513,29 @@ static ib_status_t rules_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
-static ib_status_t rules_fini(ib_engine_t *ib, ib_module_t *m, void *cbdata)
+static ib_status_t rules_context_destroy(ib_engine_t *ib,
+                                         ib_module_t *m,
+                                         ib_context_t *ctx,
+                                         void *cbdata)
 {
     IB_FTRACE_INIT();
+    rules_cfg_t *cfg;
+    ib_status_t rc;
 
-    ib_lock_destroy(&g_lua_lock);
+    /* The Lua state is engine wide; close it with the main context. */
+    if (ctx != ib_context_main(ib)) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    rc = ib_context_module_config(ctx, m, (void *)&cfg);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
 
-    if (g_ironbee_rules_lua != NULL) {
-        lua_close(g_ironbee_rules_lua);
-        g_ironbee_rules_lua = NULL;
+    if (cfg->lua != NULL) {
+        lua_close(cfg->lua->L);
+        ib_lock_destroy(&cfg->lua->lock);
+        cfg->lua = NULL;
     }
 
     IB_FTRACE_RET_STATUS(IB_OK);
@@ -1459,17 +1545,17 @@ static ib_status_t rules_fini(ib_engine_t *ib, ib_module_t *m, void *cbdata)
 IB_MODULE_INIT(
     IB_MODULE_HEADER_DEFAULTS,           /* Default metadata */
     MODULE_NAME_STR,                     /* Module name */
-    IB_MODULE_CONFIG_NULL,               /* Global config data */
+    IB_MODULE_CONFIG(&rules_global_cfg), /* Global config data */
     NULL,                                /* Configuration field map */
     rules_directive_map,                 /* Config directive map */
     rules_init,                          /* Initialize function */
     NULL,                                /* Callback data */
-    rules_fini,                          /* Finish function */
+    NULL,                                /* Finish function */
     NULL,                                /* Callback data */
     NULL,                                /* Context open function */
     NULL,                                /* Callback data */
     NULL,                                /* Context close function */
     NULL,                                /* Callback data */
-    NULL,                                /* Context destroy function */
+    rules_context_destroy,               /* Context destroy function */
     NULL                                 /* Callback data */
 );
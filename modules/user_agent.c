@@ -26,11 +26,14 @@
 
 #include <user_agent_private.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <sys/types.h>
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
 
 #include <ironbee/types.h>
 #include <ironbee/engine.h>
@@ -41,6 +44,9 @@
 #include <ironbee/bytestr.h>
 #include <ironbee/mpool.h>
 #include <ironbee/field.h>
+#include <ironbee/cfgmap.h>
+#include <ironbee/lru.h>
+#include <ironbee/string.h>
 
 /* Define the module name as well as a string version of it. */
 #define MODULE_NAME        user_agent
@@ -168,149 +174,506 @@ static ib_status_t modua_parse_uastring(char *str,
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
-/* Macros used to return the correct value based on a value and an
- * match value.
- * av: Actual value
- * mv: Match value
+/* Number of user agent fields that rules can match against */
+#define MODUA_NUM_FIELDS  3
+
+/* Maximum number of distinct patterns in the compiled rule set */
+#define MODUA_MAX_PATTERNS (MODUA_MAX_MATCH_RULES * MODUA_MAX_FIELD_RULES)
+
+/* Where a pattern was seen in a field (see modua_scan_field()) */
+#define MODUA_SEEN_ANY    0x01     /**< Pattern found anywhere */
+#define MODUA_SEEN_START  0x02     /**< Pattern found at start of field */
+#define MODUA_SEEN_END    0x04     /**< Pattern found at end of field */
+#define MODUA_SEEN_EXACT  0x08     /**< Pattern is the entire field */
+
+/* Goto edge of an automaton state */
+typedef struct modua_edge_t modua_edge_t;
+struct modua_edge_t {
+    modua_edge_t      *next;          /**< Next edge of the same state */
+    int32_t            state;         /**< Target state */
+    uint8_t            c;             /**< Input byte */
+};
+
+/* Automaton state */
+typedef struct {
+    modua_edge_t      *edges;         /**< Goto edges */
+    int32_t            fail;          /**< Failure state */
+    int32_t            pattern;       /**< Pattern ending here, or -1 */
+    int32_t            dict;          /**< Next fail state with a pattern */
+} modua_state_t;
+
+/* Aho-Corasick automaton over the patterns of a single field */
+typedef struct {
+    modua_state_t     *states;        /**< State array; 0 is the root */
+    size_t             num_states;    /**< Number of states in use */
+    int32_t            root[256];     /**< Root goto table (-1 = none) */
+} modua_automaton_t;
+
+/* A distinct pattern string used by the rule set */
+typedef struct {
+    const char        *string;        /**< The pattern */
+    size_t             slen;          /**< Length of the pattern */
+    modua_matchfield_t field;         /**< Field the pattern applies to */
+} modua_pattern_t;
+
+/* Compiled field rule */
+typedef struct {
+    modua_matchfield_t  field;        /**< Field to test */
+    modua_matchtype_t   type;         /**< Type of the match */
+    int32_t             pattern;      /**< Pattern number, or -1 */
+    modua_matchresult_t result;       /**< Expected result */
+} modua_ctest_t;
+
+/* Compiled match rule */
+typedef struct {
+    const modua_match_rule_t *rule;   /**< The original rule */
+    const modua_ctest_t      *tests;  /**< Compiled field rules */
+    unsigned int              num_tests; /**< Number of field rules */
+} modua_crule_t;
+
+/* Compiled rule set */
+typedef struct {
+    modua_automaton_t  fields[MODUA_NUM_FIELDS]; /**< Per-field automata */
+    modua_pattern_t   *patterns;      /**< Distinct patterns */
+    size_t             num_patterns;  /**< Number of patterns */
+    modua_crule_t     *rules;         /**< Compiled rules, in rule order */
+    unsigned int       num_rules;     /**< Number of rules */
+} modua_compiled_t;
+
+/* Module configuration
+ *
+ * The compiled rules and the cache belong to the engine: they are set on
+ * the main context only, and are released when it is destroyed. */
+typedef struct {
+    ib_num_t          cache_size; /**< Max cached agent strings (0=disabled) */
+    modua_compiled_t *compiled;   /**< Compiled rules */
+    ib_lrucache_t    *cache;      /**< Agent string cache or NULL */
+} modua_cfg_t;
+
+/* Instantiate a module global configuration. */
+static modua_cfg_t modua_global_cfg = {
+    4096,                       /* cache_size */
+    NULL,                       /* compiled */
+    NULL                        /* cache */
+};
+
+/**
+ * @internal
+ * Look up the goto transition of a state.
+ *
+ * @param[in] am Automaton
+ * @param[in] state State number
+ * @param[in] c Input byte
+ *
+ * @returns Target state, or -1 if there is no transition
  */
-#define RESULT_EQ(av,mv)  ( ((av) == (mv)) ? YES : NO )
-#define RESULT_NE(av,mv) ( ((av) != (mv)) ? YES : NO )
+static int32_t modua_goto(const modua_automaton_t *am,
+                          int32_t state,
+                          uint8_t c)
+{
+    const modua_edge_t *edge;
+
+    if (state == 0) {
+        return am->root[c];
+    }
+    for (edge = am->states[state].edges; edge != NULL; edge = edge->next) {
+        if (edge->c == c) {
+            return edge->state;
+        }
+    }
+    return -1;
+}
 
 /**
  * @internal
- * Match a field against the specified match rule.
+ * Add a pattern to an automaton.
+ *
+ * @param[in] mp Memory pool to allocate from
+ * @param[in,out] am Automaton
+ * @param[in] pat Pattern to add
+ * @param[in] patnum Pattern number
  *
- * Attempts to match the field string (or NULL) against the field match rule.
- * NULL)
+ * @returns Status code
+ */
+static ib_status_t modua_automaton_add(ib_mpool_t *mp,
+                                       modua_automaton_t *am,
+                                       const modua_pattern_t *pat,
+                                       int32_t patnum)
+{
+    IB_FTRACE_INIT();
+    int32_t state = 0;
+    size_t n;
+
+    for (n = 0; n < pat->slen; ++n) {
+        uint8_t c = (uint8_t)pat->string[n];
+        int32_t next = modua_goto(am, state, c);
+
+        if (next < 0) {
+            modua_state_t *ns;
+
+            next = (int32_t)am->num_states++;
+            ns = &(am->states[next]);
+            ns->edges = NULL;
+            ns->fail = 0;
+            ns->pattern = -1;
+            ns->dict = -1;
+
+            if (state == 0) {
+                am->root[c] = next;
+            }
+            else {
+                modua_edge_t *edge;
+                edge = (modua_edge_t *)ib_mpool_alloc(mp, sizeof(*edge));
+                if (edge == NULL) {
+                    IB_FTRACE_RET_STATUS(IB_EALLOC);
+                }
+                edge->c = c;
+                edge->state = next;
+                edge->next = am->states[state].edges;
+                am->states[state].edges = edge;
+            }
+        }
+        state = next;
+    }
+    am->states[state].pattern = patnum;
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * @internal
+ * Compute the failure and dictionary links of an automaton.
  *
- * @param[in] str User agent string to match
- * @param[in] rule Field match rule to match the string against
+ * @param[in] mp Memory pool to allocate from
+ * @param[in,out] am Automaton
  *
- * @returns 1 if the string matches, 0 if not.
+ * @returns Status code
  */
-static modua_matchresult_t modua_frule_match(const char *str,
-                                             const modua_field_rule_t *rule)
+static ib_status_t modua_automaton_link(ib_mpool_t *mp,
+                                        modua_automaton_t *am)
 {
     IB_FTRACE_INIT();
+    int32_t *queue;
+    size_t head = 0;
+    size_t tail = 0;
+    unsigned int c;
+
+    queue = (int32_t *)ib_mpool_alloc(mp, am->num_states * sizeof(*queue));
+    if (queue == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
 
-    /* First, handle the simple NULL string case */
-    if (str == NULL) {
-        IB_FTRACE_RET_INT(NO);
-    }
-
-    /* Match using the rule's match type */
-    switch (rule->match_type) {
-        case EXISTS:         /* Note: NULL/NO handled above */
-            IB_FTRACE_RET_INT(YES);
-        case MATCHES:
-            IB_FTRACE_RET_INT(RESULT_EQ(strcmp(str, rule->string), 0));
-        case STARTSWITH:
-            IB_FTRACE_RET_INT(RESULT_EQ(strncmp(str, rule->string, rule->slen), 0));
-        case CONTAINS:
-            IB_FTRACE_RET_INT(RESULT_NE(strstr(str, rule->string), NULL));
-        case ENDSWITH: {
-            size_t slen = strlen(str);
-            size_t offset;
-            if (slen < rule->slen) {
-                IB_FTRACE_RET_INT(0);
+    /* Children of the root fail to the root */
+    for (c = 0; c < 256; ++c) {
+        if (am->root[c] >= 0) {
+            queue[tail++] = am->root[c];
+        }
+    }
+
+    /* Breadth first over the rest of the trie */
+    while (head < tail) {
+        int32_t state = queue[head++];
+        const modua_edge_t *edge;
+
+        for (edge = am->states[state].edges; edge != NULL; edge = edge->next) {
+            modua_state_t *child = &(am->states[edge->state]);
+            int32_t f = am->states[state].fail;
+            int32_t next;
+
+            while ( (f != 0) && (modua_goto(am, f, edge->c) < 0) ) {
+                f = am->states[f].fail;
             }
-            offset = (slen - rule->slen);
-            IB_FTRACE_RET_INT(RESULT_EQ(strcmp(str+offset, rule->string), 0));
+            next = modua_goto(am, f, edge->c);
+            child->fail = (next < 0) ? 0 : next;
+            child->dict = (am->states[child->fail].pattern >= 0) ?
+                child->fail : am->states[child->fail].dict;
+            queue[tail++] = edge->state;
         }
-        default :
-            fprintf(stderr,
-                    "modua_frule_match: invalid match type %d",
-                    rule->match_type);
     }
 
-    /* Should never get here! */
-    IB_FTRACE_RET_INT(NO);
+    IB_FTRACE_RET_STATUS(IB_OK);
 }
 
 /**
  * @internal
- * Apply the user agent category rules.
+ * Scan a field, recording where each pattern was seen.
  *
- * Walks through the internal static category rules, attempts to apply
- * each of them to the passed in agent info.
+ * @param[in] cm Compiled rule set
+ * @param[in] field Field number
+ * @param[in] str Field value
+ * @param[in,out] seen Array of MODUA_SEEN_xxx flags, indexed by pattern
+ */
+static void modua_scan_field(const modua_compiled_t *cm,
+                             modua_matchfield_t field,
+                             const char *str,
+                             uint8_t *seen)
+{
+    const modua_automaton_t *am = &(cm->fields[field]);
+    size_t slen = strlen(str);
+    int32_t state = 0;
+    size_t n;
+
+    for (n = 0; n < slen; ++n) {
+        uint8_t c = (uint8_t)str[n];
+        int32_t next;
+        int32_t out;
+
+        while ( (state != 0) && (modua_goto(am, state, c) < 0) ) {
+            state = am->states[state].fail;
+        }
+        next = modua_goto(am, state, c);
+        state = (next < 0) ? 0 : next;
+
+        out = (am->states[state].pattern >= 0) ?
+            state : am->states[state].dict;
+        while (out >= 0) {
+            int32_t patnum = am->states[out].pattern;
+            size_t end = n + 1;
+            size_t start = end - cm->patterns[patnum].slen;
+            uint8_t flags = MODUA_SEEN_ANY;
+
+            if (start == 0) {
+                flags |= MODUA_SEEN_START;
+            }
+            if (end == slen) {
+                flags |= MODUA_SEEN_END;
+            }
+            if ( (start == 0) && (end == slen) ) {
+                flags |= MODUA_SEEN_EXACT;
+            }
+            seen[patnum] |= flags;
+            out = am->states[out].dict;
+        }
+    }
+}
+
+/**
+ * @internal
+ * Find or add a distinct pattern.
  *
- * @param[in] fields Array of fields to match (0=product,1=platform,2=extra)
- * @param[in] rule Match rule to match against
+ * @param[in,out] cm Compiled rule set
+ * @param[in] fr Field rule whose pattern to add
  *
- * @returns 1 if all rules match, otherwise 0
+ * @returns Pattern number
  */
-static int modua_mrule_match( const char *fields[],
-                              const modua_match_rule_t *rule)
+static int32_t modua_pattern_get(modua_compiled_t *cm,
+                                 const modua_field_rule_t *fr)
+{
+    size_t n;
+
+    for (n = 0; n < cm->num_patterns; ++n) {
+        const modua_pattern_t *pat = &(cm->patterns[n]);
+        if ( (pat->field == fr->match_field) &&
+             (pat->slen == fr->slen) &&
+             (memcmp(pat->string, fr->string, fr->slen) == 0) )
+        {
+            return (int32_t)n;
+        }
+    }
+    cm->patterns[n].string = fr->string;
+    cm->patterns[n].slen = fr->slen;
+    cm->patterns[n].field = fr->match_field;
+    ++cm->num_patterns;
+    return (int32_t)n;
+}
+
+/**
+ * @internal
+ * Compile the match rule set.
+ *
+ * Collects the distinct pattern strings of each field into an
+ * Aho-Corasick automaton, so that classifying a user agent is one pass
+ * over each field followed by table lookups for each field rule.
+ *
+ * @param[in] mp Memory pool to allocate from
+ * @param[in] ruleset Rule set to compile
+ * @param[out] pcm Compiled rule set
+ *
+ * @returns Status code
+ */
+static ib_status_t modua_ruleset_compile(ib_mpool_t *mp,
+                                         const modua_match_ruleset_t *ruleset,
+                                         modua_compiled_t **pcm)
 {
     IB_FTRACE_INIT();
-    const modua_field_rule_t *fr;
+    modua_compiled_t *cm;
+    modua_ctest_t *tests;
+    size_t max_states[MODUA_NUM_FIELDS] = { 1, 1, 1 };
     unsigned int ruleno;
+    size_t n;
+    int field;
+    ib_status_t rc;
+
+    cm = (modua_compiled_t *)ib_mpool_calloc(mp, 1, sizeof(*cm));
+    if (cm == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    cm->patterns = (modua_pattern_t *)
+        ib_mpool_calloc(mp, MODUA_MAX_PATTERNS, sizeof(*cm->patterns));
+    cm->rules = (modua_crule_t *)
+        ib_mpool_calloc(mp, ruleset->num_rules, sizeof(*cm->rules));
+    tests = (modua_ctest_t *)
+        ib_mpool_calloc(mp,
+                        ruleset->num_rules * MODUA_MAX_FIELD_RULES,
+                        sizeof(*tests));
+    if ( (cm->patterns == NULL) || (cm->rules == NULL) || (tests == NULL) ) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
 
-    /* Walk through the rules; if any fail, return NULL */
-    for (ruleno = 0, fr = rule->rules;
-         ruleno < rule->num_rules;
-         ++ruleno, ++fr) {
+    /* Translate the field rules, collecting the distinct patterns */
+    for (ruleno = 0; ruleno < ruleset->num_rules; ++ruleno) {
+        const modua_match_rule_t *rule = &(ruleset->rules[ruleno]);
+        modua_crule_t *crule = &(cm->rules[ruleno]);
+        unsigned int frno;
+
+        crule->rule = rule;
+        crule->tests = tests;
+        crule->num_tests = rule->num_rules;
+        for (frno = 0; frno < rule->num_rules; ++frno) {
+            const modua_field_rule_t *fr = &(rule->rules[frno]);
+            modua_ctest_t *test = tests++;
+
+            test->field = fr->match_field;
+            test->type = fr->match_type;
+            test->result = fr->match_result;
+            if ( (fr->match_type == EXISTS) || (fr->slen == 0) ) {
+                test->pattern = -1;
+            }
+            else {
+                size_t before = cm->num_patterns;
+                test->pattern = modua_pattern_get(cm, fr);
+                if (cm->num_patterns != before) {
+                    max_states[fr->match_field] += fr->slen;
+                }
+            }
+        }
+    }
+    cm->num_rules = ruleset->num_rules;
 
-        /* Apply the rule */
-        modua_matchresult_t result =
-            modua_frule_match(fields[fr->match_field], fr);
+    /* Build an automaton per field */
+    for (field = 0; field < MODUA_NUM_FIELDS; ++field) {
+        modua_automaton_t *am = &(cm->fields[field]);
 
-        /* If it doesn't match the expect results, we're done, return 0 */
-        if (result != fr->match_result) {
-            IB_FTRACE_RET_INT( 0 );
+        am->states = (modua_state_t *)
+            ib_mpool_alloc(mp, max_states[field] * sizeof(*am->states));
+        if (am->states == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+        am->states[0].edges = NULL;
+        am->states[0].fail = 0;
+        am->states[0].pattern = -1;
+        am->states[0].dict = -1;
+        am->num_states = 1;
+        for (n = 0; n < 256; ++n) {
+            am->root[n] = -1;
+        }
+    }
+    for (n = 0; n < cm->num_patterns; ++n) {
+        const modua_pattern_t *pat = &(cm->patterns[n]);
+        rc = modua_automaton_add(mp, &(cm->fields[pat->field]), pat,
+                                 (int32_t)n);
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+    }
+    for (field = 0; field < MODUA_NUM_FIELDS; ++field) {
+        rc = modua_automaton_link(mp, &(cm->fields[field]));
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
         }
     }
 
-    /* If we've applied all of the field rules, and all have passed,
-     * return the 1 to signify a match */
-    IB_FTRACE_RET_INT( 1 );
+    *pcm = cm;
+    IB_FTRACE_RET_STATUS(IB_OK);
 }
 
 /**
  * @internal
  * Apply the user agent category rules.
  *
- * Walks through the internal static category rules, attempts to apply
- * each of them to the passed in agent info, and returns a pointer to the
- * first rule that matches, or NULL if no rules match.
+ * Scans each field once with the compiled automata, then walks the
+ * compiled rules, and returns a pointer to the first rule that matches,
+ * or NULL if no rules match.
  *
  * Note that the fields array (filled in below) uses values from the
  * modua_matchfield_t enum (PRODUCT, PLATFORM, EXTRA).
  *
+ * @param[in] cm Compiled rules
  * @param[in] product UA product component
  * @param[in] platform UA platform component
  * @param[in] extra UA extra component
  *
  * @returns Pointer to rule that matched
  */
-static const modua_match_rule_t *modua_match_cat_rules(const char *product,
-                                                       const char *platform,
-                                                       const char *extra)
+static const modua_match_rule_t *modua_match_cat_rules(
+    const modua_compiled_t *cm,
+    const char *product,
+    const char *platform,
+    const char *extra)
 {
     IB_FTRACE_INIT();
-    const char *fields[3] = { product, platform, extra };
-    const modua_match_rule_t *rule;
+    const char *fields[MODUA_NUM_FIELDS] = { product, platform, extra };
+    uint8_t seen[MODUA_MAX_PATTERNS];
     unsigned int ruleno;
+    int field;
 
-    assert(modua_match_ruleset != NULL);
+    assert(cm != NULL);
+
+    memset(seen, 0, cm->num_patterns);
+    for (field = 0; field < MODUA_NUM_FIELDS; ++field) {
+        if (fields[field] != NULL) {
+            modua_scan_field(cm, (modua_matchfield_t)field, fields[field],
+                             seen);
+        }
+    }
 
     /* Walk through the rules; the first to match "wins" */
-    for (ruleno = 0, rule = modua_match_ruleset->rules;
-         ruleno < modua_match_ruleset->num_rules;
-         ++ruleno, ++rule ) {
-        int result;
+    for (ruleno = 0; ruleno < cm->num_rules; ++ruleno) {
+        const modua_crule_t *crule = &(cm->rules[ruleno]);
+        unsigned int testno;
+
+        for (testno = 0; testno < crule->num_tests; ++testno) {
+            const modua_ctest_t *test = &(crule->tests[testno]);
+            modua_matchresult_t result;
+            uint8_t mask;
+
+            switch (test->type) {
+                case MATCHES:    mask = MODUA_SEEN_EXACT; break;
+                case STARTSWITH: mask = MODUA_SEEN_START; break;
+                case CONTAINS:   mask = MODUA_SEEN_ANY;   break;
+                case ENDSWITH:   mask = MODUA_SEEN_END;   break;
+                default:         mask = 0;                break;
+            }
 
-        /* Apply the field rules */
-        result = modua_mrule_match(fields, rule);
+            /* A missing field never matches */
+            if (fields[test->field] == NULL) {
+                result = NO;
+            }
+            else if (test->type == EXISTS) {
+                result = YES;
+            }
+            else if (test->pattern < 0) {
+                /* Empty pattern: only an exact match can fail */
+                result = ( (test->type != MATCHES) ||
+                           (*fields[test->field] == '\0') ) ? YES : NO;
+            }
+            else {
+                result = ((seen[test->pattern] & mask) != 0) ? YES : NO;
+            }
+
+            if (result != test->result) {
+                break;
+            }
+        }
 
         /* If the entire rule set matches, return the matching rule */
-        if (result != 0) {
-            IB_FTRACE_RET_PTR( const modua_match_rule_t, rule );
+        if (testno == crule->num_tests) {
+            IB_FTRACE_RET_PTR(const modua_match_rule_t, crule->rule);
         }
     }
 
     /* If we've applied all rules, and have had success, return NULL */
-    IB_FTRACE_RET_PTR( const modua_match_rule_t, NULL );
+    IB_FTRACE_RET_PTR(const modua_match_rule_t, NULL);
 }
 
 /**
@@ -370,73 +733,211 @@ static ib_status_t modua_store_field(ib_engine_t *ib,
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
+/* Result of parsing and classifying a user agent string */
+typedef struct {
+    char                     *agent;     /**< Copy of the agent string */
+    char                     *product;   /**< Product component */
+    char                     *platform;  /**< Platform component */
+    char                     *extra;     /**< Extra component */
+    const modua_match_rule_t *rule;      /**< Matching rule or NULL */
+    ib_status_t               parse_rc;  /**< Result of parsing */
+} modua_result_t;
+
+/* Cached result for a single user agent string, keyed by the string.
+ *
+ * The data block holds the original agent string followed by the parsed
+ * copy of it (with NULs inserted by modua_parse_uastring()); the component
+ * offsets are relative to the parsed copy. */
+typedef struct {
+    size_t                    len;       /**< Length of the agent string */
+    const modua_match_rule_t *rule;      /**< Matching rule or NULL */
+    ib_status_t               parse_rc;  /**< Result of parsing */
+    ssize_t                   product;   /**< Offset of product or -1 */
+    ssize_t                   platform;  /**< Offset of platform or -1 */
+    ssize_t                   extra;     /**< Offset of extra or -1 */
+    char                      data[];    /**< Agent string + parsed copy */
+} modua_cache_entry_t;
+
+/**
+ * @internal
+ * Look up a user agent string in the cache.
+ *
+ * On a hit the cached entry is copied into @a mp with a single
+ * allocation and @a result is filled in.
+ *
+ * @param[in] cache Cache
+ * @param[in] mp Memory pool to copy the result into
+ * @param[in] data Agent string
+ * @param[in] len Length of @a data
+ * @param[out] result Cached result
+ *
+ * @returns IB_OK on a hit, IB_ENOENT on a miss, or IB_EALLOC
+ */
+static ib_status_t modua_cache_lookup(ib_lrucache_t *cache,
+                                      ib_mpool_t *mp,
+                                      const uint8_t *data,
+                                      size_t len,
+                                      modua_result_t *result)
+{
+    IB_FTRACE_INIT();
+    modua_cache_entry_t *entry;
+    char *parsed;
+    ib_status_t rc;
+
+    rc = ib_lrucache_get(cache, mp, data, len, (void **)&entry, NULL);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    parsed = entry->data + len + 1;
+
+    result->agent = entry->data;
+    result->product = (entry->product < 0) ? NULL : parsed + entry->product;
+    result->platform = (entry->platform < 0) ? NULL : parsed + entry->platform;
+    result->extra = (entry->extra < 0) ? NULL : parsed + entry->extra;
+    result->rule = entry->rule;
+    result->parse_rc = entry->parse_rc;
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * @internal
+ * Add a classified user agent string to the cache.
+ *
+ * Failure to add an entry is not an error; the result is simply not
+ * cached.
+ *
+ * @param[in] cache Cache
+ * @param[in] mp Memory pool for the temporary entry
+ * @param[in] len Length of the agent string
+ * @param[in] result Result to cache; result->agent must be followed by
+ *            the parsed copy, as built by modua_agent_fields()
+ */
+static void modua_cache_insert(ib_lrucache_t *cache,
+                               ib_mpool_t *mp,
+                               size_t len,
+                               const modua_result_t *result)
+{
+    IB_FTRACE_INIT();
+    modua_cache_entry_t *entry;
+    const char *parsed = result->agent + len + 1;
+    size_t size = sizeof(*entry) + (2 * (len + 1));
+
+    entry = (modua_cache_entry_t *)ib_mpool_alloc(mp, size);
+    if (entry == NULL) {
+        IB_FTRACE_RET_VOID();
+    }
+    entry->len = len;
+    entry->rule = result->rule;
+    entry->parse_rc = result->parse_rc;
+    entry->product = (result->product == NULL) ? -1 : result->product - parsed;
+    entry->platform =
+        (result->platform == NULL) ? -1 : result->platform - parsed;
+    entry->extra = (result->extra == NULL) ? -1 : result->extra - parsed;
+    memcpy(entry->data, result->agent, 2 * (len + 1));
+
+    ib_lrucache_set(cache, result->agent, len, entry, size);
+    IB_FTRACE_RET_VOID();
+}
+
 /**
  * @internal
  * Parse the user agent header, splitting into component fields.
  *
  * Attempt to tokenize the user agent string passed in, storing the
- * result in the DPI associated with the transaction.
+ * result in the DPI associated with the transaction.  Results are taken
+ * from the user agent cache when possible.
  *
  * @param[in] ib IronBee object
  * @param[in,out] tx Transaction object
+ * @param[in] cfg Main context configuration
  * @param[in] bs Byte string containing the agent string
  *
  * @returns Status code
  */
 static ib_status_t modua_agent_fields(ib_engine_t *ib,
                                       ib_tx_t *tx,
+                                      const modua_cfg_t *cfg,
                                       const ib_bytestr_t *bs)
 {
     IB_FTRACE_INIT();
-    const modua_match_rule_t *rule = NULL;
+    modua_result_t            result;
     ib_field_t               *agent_list = NULL;
-    char                     *product = NULL;
-    char                     *platform = NULL;
-    char                     *extra = NULL;
-    char                     *agent;
-    char                     *buf;
+    const uint8_t            *data;
     size_t                    len;
-    ib_status_t               rc;
+    ib_status_t               rc = IB_ENOENT;
 
     /* Get the length of the byte string */
     len = ib_bytestr_length(bs);
+    data = ib_bytestr_const_ptr(bs);
 
-    /* Allocate memory for a copy of the string to split up below. */
-    buf = (char *)ib_mpool_calloc(tx->mp, 1, len+1);
-    if (buf == NULL) {
-        ib_log_error_tx(tx,
-                      "Failed to allocate %d bytes for agent string",
-                      len+1);
-        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    /* Look for a cached result */
+    if (cfg->cache != NULL) {
+        rc = modua_cache_lookup(cfg->cache, tx->mp, data, len, &result);
+        if (rc == IB_EALLOC) {
+            ib_log_error_tx(tx,
+                          "Failed to allocate %d bytes for agent string",
+                          2 * (len + 1));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        else if (rc == IB_OK) {
+            ib_log_debug_tx(tx, "Found cached user agent: '%s'",
+                            result.agent);
+        }
     }
 
-    /* Copy the string out */
-    memcpy(buf, ib_bytestr_const_ptr(bs), len);
-    buf[len] = '\0';
-    ib_log_debug_tx(tx, "Found user agent: '%s'", buf);
+    if (rc != IB_OK) {
+        char *buf;
+
+        /* Allocate memory for a copy of the agent string, followed by
+         * a second copy to split up below. */
+        buf = (char *)ib_mpool_alloc(tx->mp, 2 * (len + 1));
+        if (buf == NULL) {
+            ib_log_error_tx(tx,
+                          "Failed to allocate %d bytes for agent string",
+                          2 * (len + 1));
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
 
-    /* Copy the agent string */
-    agent = (char *)ib_mpool_strdup(tx->mp, buf);
-    if (agent == NULL) {
-        ib_log_error_tx(tx, "Failed to allocate copy of agent string");
-        IB_FTRACE_RET_STATUS(IB_EALLOC);
+        /* Copy the string out */
+        memcpy(buf, data, len);
+        buf[len] = '\0';
+        memcpy(buf + len + 1, buf, len + 1);
+        result.agent = buf;
+        ib_log_debug_tx(tx, "Found user agent: '%s'", buf);
+
+        /* Parse the user agent string */
+        result.parse_rc = modua_parse_uastring(buf + len + 1,
+                                               &result.product,
+                                               &result.platform,
+                                               &result.extra);
+
+        /* Categorize the parsed string */
+        result.rule = NULL;
+        if (result.parse_rc == IB_OK) {
+            result.rule = modua_match_cat_rules(cfg->compiled,
+                                                result.product,
+                                                result.platform,
+                                                result.extra);
+        }
+
+        if (cfg->cache != NULL) {
+            modua_cache_insert(cfg->cache, tx->mp, len, &result);
+        }
     }
 
-    /* Parse the user agent string */
-    rc = modua_parse_uastring(buf, &product, &platform, &extra);
-    if (rc != IB_OK) {
-        ib_log_debug_tx(tx, "Failed to parse User Agent string '%s'", agent);
+    if (result.parse_rc != IB_OK) {
+        ib_log_debug_tx(tx, "Failed to parse User Agent string '%s'",
+                        result.agent);
         IB_FTRACE_RET_STATUS(IB_OK);
     }
 
-    /* Categorize the parsed string */
-    rule = modua_match_cat_rules(product, platform, extra);
-    if (rule == NULL) {
+    if (result.rule == NULL) {
         ib_log_debug_tx(tx, "No rule matched" );
     }
     else {
         ib_log_debug_tx(tx, "Matched to rule #%d / category '%s'",
-                     rule->rule_num, rule->category );
+                     result.rule->rule_num, result.rule->category );
     }
 
     /* Build a new list. */
@@ -448,33 +949,33 @@ static ib_status_t modua_agent_fields(ib_engine_t *ib,
     }
 
     /* Store Agent */
-    rc = modua_store_field(ib, tx->mp, agent_list, "agent", agent);
+    rc = modua_store_field(ib, tx->mp, agent_list, "agent", result.agent);
     if (rc != IB_OK) {
         IB_FTRACE_RET_STATUS(rc);
     }
 
     /* Store product */
-    rc = modua_store_field(ib, tx->mp, agent_list, "PRODUCT", product);
+    rc = modua_store_field(ib, tx->mp, agent_list, "PRODUCT", result.product);
     if (rc != IB_OK) {
         IB_FTRACE_RET_STATUS(rc);
     }
 
     /* Store Platform */
-    rc = modua_store_field(ib, tx->mp, agent_list, "OS", platform);
+    rc = modua_store_field(ib, tx->mp, agent_list, "OS", result.platform);
     if (rc != IB_OK) {
         IB_FTRACE_RET_STATUS(rc);
     }
 
     /* Store Extra */
-    rc = modua_store_field(ib, tx->mp, agent_list, "extra", extra);
+    rc = modua_store_field(ib, tx->mp, agent_list, "extra", result.extra);
     if (rc != IB_OK) {
         IB_FTRACE_RET_STATUS(rc);
     }
 
     /* Store Extra */
-    if (rule != NULL) {
+    if (result.rule != NULL) {
         rc = modua_store_field(ib, tx->mp, agent_list,
-                               "category", rule->category);
+                               "category", result.rule->category);
     }
     else {
         rc = modua_store_field(ib, tx->mp, agent_list, "category", NULL );
@@ -515,6 +1016,7 @@ static ib_status_t modua_user_agent(ib_engine_t *ib,
     ib_field_t         *req_agent = NULL;
     ib_status_t         rc = IB_OK;
     const ib_bytestr_t *bs;
+    modua_cfg_t        *cfg;
 
     /* Extract the request headers field from the provider instance */
     rc = ib_data_get(tx->dpi, "request_headers:User-Agent", &req_agent);
@@ -529,8 +1031,17 @@ static ib_status_t modua_user_agent(ib_engine_t *ib,
         IB_FTRACE_RET_STATUS(rc);
     }
 
+    /* The compiled rules and cache are on the main context */
+    rc = ib_context_module_config(ib_context_main(ib),
+                                  IB_MODULE_STRUCT_PTR, (void *)&cfg);
+    if (rc != IB_OK) {
+        ib_log_error_tx(tx, "Failed to fetch user agent config: %s",
+                        ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
     /* Finally, split it up & store the components */
-    rc = modua_agent_fields(ib, tx, bs);
+    rc = modua_agent_fields(ib, tx, cfg, bs);
     IB_FTRACE_RET_STATUS(rc);
 }
 
@@ -644,6 +1155,7 @@ static ib_status_t modua_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
     ib_status_t  rc;
     modua_match_rule_t *failed_rule;
     unsigned int failed_frule_num;
+    modua_cfg_t *cfg;
 
     /* Register the user agent callback */
     rc = ib_hook_tx_register(ib, request_headers_event,
@@ -680,23 +1192,199 @@ static ib_status_t modua_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
                  "Found %d match rules",
                  modua_match_ruleset->num_rules);
 
+    /* Compile them for this engine */
+    rc = ib_context_module_config(ib_context_main(ib), m, (void *)&cfg);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to fetch user agent config: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    rc = modua_ruleset_compile(ib_engine_pool_main_get(ib),
+                               modua_match_ruleset,
+                               &cfg->compiled);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to compile user agent rules: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    ib_log_debug(ib,
+                 "Compiled %zu distinct user agent patterns",
+                 cfg->compiled->num_patterns);
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * @internal
+ * Called when a context is closed.
+ *
+ * Creates the user agent cache once the main context is configured.
+ *
+ * @param[in] ib IronBee object
+ * @param[in] m Module object
+ * @param[in] ctx Context being closed
+ * @param[in] cbdata (unused)
+ *
+ * @returns Status code
+ */
+static ib_status_t modua_context_close(ib_engine_t  *ib,
+                                       ib_module_t  *m,
+                                       ib_context_t *ctx,
+                                       void         *cbdata)
+{
+    IB_FTRACE_INIT();
+    modua_cfg_t *cfg;
+    ib_status_t rc;
+
+    /* The cache is engine wide, so only the main context matters */
+    if (ctx != ib_context_main(ib)) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    rc = ib_context_module_config(ctx, m, (void *)&cfg);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to fetch user agent config: %s",
+                     ib_status_to_string(rc));
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    if ( (cfg->cache_size > 0) && (cfg->cache == NULL) ) {
+        rc = ib_lrucache_create(&cfg->cache, (size_t)cfg->cache_size);
+        if (rc != IB_OK) {
+            ib_log_error(ib, "Failed to create user agent cache: %s",
+                         ib_status_to_string(rc));
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        ib_log_debug(ib, "User agent cache size %" PRId64, cfg->cache_size);
+    }
+
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
+/**
+ * @internal
+ * Called when a context is destroyed.
+ *
+ * Destroys the engine's user agent cache with the main context.  This is
+ * not done when the module is unloaded, as other engines may still be
+ * using the module.
+ *
+ * @param[in] ib IronBee object
+ * @param[in] m Module object
+ * @param[in] ctx Context being destroyed
+ * @param[in] cbdata (unused)
+ *
+ * @returns Status code
+ */
+static ib_status_t modua_context_destroy(ib_engine_t  *ib,
+                                         ib_module_t  *m,
+                                         ib_context_t *ctx,
+                                         void         *cbdata)
+{
+    IB_FTRACE_INIT();
+    modua_cfg_t *cfg;
+    uint64_t hits;
+    uint64_t misses;
+    ib_status_t rc;
+
+    if (ctx != ib_context_main(ib)) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    rc = ib_context_module_config(ctx, m, (void *)&cfg);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    if (cfg->cache != NULL) {
+        ib_lrucache_stats(cfg->cache, &hits, &misses);
+        ib_log_debug(ib,
+                     "User agent cache: %" PRIu64 " hits, %" PRIu64 " misses",
+                     hits, misses);
+        ib_lrucache_destroy(cfg->cache);
+        cfg->cache = NULL;
+    }
+    cfg->compiled = NULL;
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/**
+ * @internal
+ * Handle single parameter directives.
+ *
+ * @param[in] cp Config parser
+ * @param[in] name Directive name
+ * @param[in] p1 First parameter
+ * @param[in] cbdata Callback data (unused)
+ *
+ * @returns Status code
+ */
+static ib_status_t modua_dir_param1(ib_cfgparser_t *cp,
+                                    const char *name,
+                                    const char *p1,
+                                    void *cbdata)
+{
+    IB_FTRACE_INIT();
+    ib_engine_t *ib = cp->ib;
+    ib_status_t  rc;
+
+    assert(name != NULL);
+    assert(p1 != NULL);
+
+    ib_log_debug2(ib, "%s: %s", name, p1);
+
+    if (strcasecmp("UserAgentCacheSize", name) == 0) {
+        ib_num_t size;
+
+        rc = ib_string_to_num(p1, 0, &size);
+        if ( (rc != IB_OK) || (size < 0) || (size >= UINT32_MAX) ) {
+            ib_log_error(ib, "Invalid %s \"%s\"", name, p1);
+            IB_FTRACE_RET_STATUS(IB_EINVAL);
+        }
+        /* Engine wide, so always set on the main context. */
+        rc = ib_context_set_num(ib_context_main(ib),
+                                MODULE_NAME_STR ".cache_size", size);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    ib_log_error(ib, "Unhandled directive: %s %s", name, p1);
+    IB_FTRACE_RET_STATUS(IB_EINVAL);
+}
+
+static IB_CFGMAP_INIT_STRUCTURE(modua_config_map) = {
+    IB_CFGMAP_INIT_ENTRY(
+        MODULE_NAME_STR ".cache_size",
+        IB_FTYPE_NUM,
+        modua_cfg_t,
+        cache_size
+    ),
+    IB_CFGMAP_INIT_LAST
+};
+
+static IB_DIRMAP_INIT_STRUCTURE(modua_directive_map) = {
+    IB_DIRMAP_INIT_PARAM1(
+        "UserAgentCacheSize",
+        modua_dir_param1,
+        NULL
+    ),
+    IB_DIRMAP_INIT_LAST
+};
+
 IB_MODULE_INIT(
     IB_MODULE_HEADER_DEFAULTS,      /* Default metadata */
     MODULE_NAME_STR,                /* Module name */
-    IB_MODULE_CONFIG_NULL,          /* Global config data */
-    NULL,                           /* Module config map */
-    NULL,                           /* Module directive map */
+    IB_MODULE_CONFIG(&modua_global_cfg), /* Global config data */
+    modua_config_map,               /* Module config map */
+    modua_directive_map,            /* Module directive map */
     modua_init,                     /* Initialize function */
     NULL,                           /* Callback data */
     NULL,                           /* Finish function */
     NULL,                           /* Callback data */
     NULL,                           /* Context open function */
     NULL,                           /* Callback data */
-    NULL,                           /* Context close function */
+    modua_context_close,            /* Context close function */
     NULL,                           /* Callback data */
-    NULL,                           /* Context destroy function */
+    modua_context_destroy,          /* Context destroy function */
     NULL                            /* Callback data */
 );
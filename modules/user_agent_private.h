@@ -90,7 +90,9 @@ typedef struct modua_match_ruleset_s {
  * @internal
  * Initialize the user agent category rules.
  *
- * Initializes the rules used to categorize user agent strings.
+ * Initializes the rules used to categorize user agent strings.  The rules
+ * are static and shared by every engine, so only the first call does any
+ * work; later calls (engine reloads) leave them alone.
  *
  * @param[out] failed_rule Pointer to the match rule that failed
  * @param[out] failed_field_rule_num Number of field rule that caused the error
@@ -1015,6 +1015,15 @@ ib_status_t modua_ruleset_init(modua_match_rule_t **failed_rule,
     ib_status_t          rc;
     modua_field_rule_t  *field_rule;
 
+    /* No failures */
+    *failed_rule = NULL;
+    *failed_field_rule_num = 0;
+
+    /* Already initialized (by another engine)? */
+    if (modua_match_ruleset.num_rules != 0) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
     /* For each of the rules, */
     for (match_rule_num = 0, match_rule = modua_match_ruleset.rules;
          match_rule->category != NULL;
@@ -1041,14 +1050,10 @@ ib_status_t modua_ruleset_init(modua_match_rule_t **failed_rule,
             }
             ++match_rule->num_rules;
         }
-
-        /* Update the match rule count */
-        ++modua_match_ruleset.num_rules;
     }
 
-    /* No failures */
-    *failed_rule = NULL;
-    *failed_field_rule_num = 0;
+    /* Set the match rule count only once all of the rules are good */
+    modua_match_ruleset.num_rules = match_rule_num;
 
     /* Done */
     IB_FTRACE_RET_STATUS(IB_OK);
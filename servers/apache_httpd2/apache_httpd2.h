@@ -45,6 +45,7 @@ struct ironbee_config_t {
     const char    *config;            /**< Config file */
     size_t         buf_size;          /**< Buffer size. */
     size_t         flush_size;        /**< Bytes in buffer to trigger flush. */
+    size_t         stream_window;     /**< Bytes held back when streaming. */
 };
 
 #ifdef __cplusplus
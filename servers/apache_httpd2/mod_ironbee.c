@@ -109,6 +109,8 @@ struct ironbee_conn_context {
     int                      direction;
     ib_conn_t               *iconn;
     int                      status;
+    apr_bucket_brigade      *held;      /**< Stream window (streaming mode) */
+    apr_off_t                held_len;  /**< Data bytes in @c held */
 };
 typedef struct mod_ib_conn_ctx mod_ib_conn_ctx;
 struct mod_ib_conn_ctx {
@@ -327,6 +329,150 @@ static void process_bucket(ap_filter_t *f, apr_bucket *b)
     }
 }
 
+/**
+ * @internal
+ *
+ * Is IronBee still inspecting the body in a stream's direction?
+ *
+ * While it is, the trailing stream window is held back so that a block
+ * can still stop it from being passed on.
+ */
+static int stream_holding(const ironbee_conn_context *ctx)
+{
+    ib_tx_t *itx = ctx->iconn->tx;
+
+    if (itx == NULL) {
+        return 0;
+    }
+    if (ctx->direction == IRONBEE_REQUEST) {
+        return ib_tx_flags_isset(itx, IB_TX_FREQ_SEENHEADERS) &&
+               !ib_tx_flags_isset(itx, IB_TX_FREQ_FINISHED);
+    }
+    return ib_tx_flags_isset(itx, IB_TX_FRES_STARTED) &&
+           !ib_tx_flags_isset(itx, IB_TX_FRES_FINISHED);
+}
+
+/**
+ * @internal
+ *
+ * Has IronBee asked for the stream to be stopped?
+ */
+static int stream_blocked(ap_filter_t *f)
+{
+    ironbee_conn_context *ctx = f->ctx;
+    mod_ib_conn_ctx *cctx = ap_get_module_config(f->c->conn_config,
+                                                 &ironbee_module);
+    ib_tx_t *itx = ctx->iconn->tx;
+
+    if ((cctx != NULL) && (cctx->status != 0)) {
+        return 1;
+    }
+    return (itx != NULL) && ib_tx_flags_isset(itx, IB_TX_FBLOCKED);
+}
+
+/**
+ * @internal
+ *
+ * Inspects the buckets in @a bb and moves them to the stream window.
+ *
+ * Processed data is not needed by IronBee afterwards, so it is also
+ * discarded from the transaction's drain rather than re-injected.
+ *
+ * @returns 1 if a metadata bucket (flush, EOS, ...) was seen.
+ */
+static int stream_hold(ap_filter_t *f, apr_bucket_brigade *bb)
+{
+    ironbee_conn_context *ctx = f->ctx;
+    ib_tx_t *itx;
+    ib_stream_t *istream;
+    apr_bucket *b;
+    int meta = 0;
+
+    if (ctx->held == NULL) {
+        ctx->held = apr_brigade_create(f->c->pool, f->c->bucket_alloc);
+    }
+
+    while (!APR_BRIGADE_EMPTY(bb)) {
+        b = APR_BRIGADE_FIRST(bb);
+        process_bucket(f, b);
+
+        APR_BUCKET_REMOVE(b);
+        apr_bucket_setaside(b, f->c->pool);
+        if (APR_BUCKET_IS_METADATA(b)) {
+            meta = 1;
+        }
+        else {
+            ctx->held_len += b->length;
+        }
+        APR_BRIGADE_INSERT_TAIL(ctx->held, b);
+    }
+
+    itx = ctx->iconn->tx;
+    if (itx != NULL) {
+        ib_fctl_drain(itx->fctl, &istream);
+        if (istream != NULL) {
+            while (ib_stream_pull(istream, NULL) == IB_OK) {
+                /* Discard. */
+            }
+        }
+    }
+
+    return meta;
+}
+
+/**
+ * @internal
+ *
+ * Moves buckets from the front of the stream window to the tail of
+ * @a bb until at most @a window data bytes remain held, splitting a
+ * bucket where the window starts.  A zero @a window releases everything.
+ */
+static void stream_release(ironbee_conn_context *ctx,
+                           apr_bucket_brigade *bb,
+                           apr_off_t window)
+{
+    while (!APR_BRIGADE_EMPTY(ctx->held)) {
+        apr_bucket *b = APR_BRIGADE_FIRST(ctx->held);
+
+        if (!APR_BUCKET_IS_METADATA(b)) {
+            apr_off_t excess = ctx->held_len - window;
+
+            if (excess <= 0) {
+                break;
+            }
+            if (((apr_off_t)b->length > excess) &&
+                (apr_bucket_split(b, (apr_size_t)excess) != APR_SUCCESS))
+            {
+                break;
+            }
+            ctx->held_len -= b->length;
+        }
+
+        APR_BUCKET_REMOVE(b);
+        APR_BRIGADE_INSERT_TAIL(bb, b);
+    }
+}
+
+/**
+ * @internal
+ *
+ * Drops the stream window after IronBee has blocked the stream.
+ */
+static apr_status_t stream_abort(ap_filter_t *f)
+{
+    ironbee_conn_context *ctx = f->ctx;
+
+    ap_log_cerror(APLOG_MARK, APLOG_DEBUG, 0, f->c,
+                  IB_PRODUCT_NAME ": blocked %s stream, dropping %" APR_OFF_T_FMT
+                  " held bytes",
+                  ((ctx->direction == IRONBEE_REQUEST) ? "request" : "response"),
+                  ctx->held_len);
+    apr_brigade_cleanup(ctx->held);
+    ctx->held_len = 0;
+
+    return APR_ECONNABORTED;
+}
+
 /**
  * @internal
  *
@@ -581,6 +727,56 @@ static int ironbee_dbg_input_filter(ap_filter_t *f, apr_bucket_brigade *bb,
 }
 #endif
 
+/**
+ * @internal
+ *
+ * Streaming form of the input filter.
+ *
+ * Data is inspected as it arrives and passed on at once, except for the
+ * trailing @a window bytes of a request body still being inspected, which
+ * are held back until IronBee has either finished with the request or
+ * blocked it.
+ */
+static int ironbee_input_stream(ap_filter_t *f, apr_bucket_brigade *bb,
+                                ap_input_mode_t mode, apr_read_type_e block,
+                                apr_off_t readbytes, apr_off_t window)
+{
+    conn_rec *c = f->c;
+    ironbee_conn_context *ctx = f->ctx;
+    apr_status_t rc;
+
+    /* The caller expects data back, so keep reading while everything
+     * read so far is inside the window.
+     */
+    do {
+        rc = ap_get_brigade(f->next, bb, mode, block, readbytes);
+        if (rc != APR_SUCCESS) {
+            if ((ctx->held != NULL) && !APR_BRIGADE_EMPTY(ctx->held) &&
+                (APR_STATUS_IS_EOF(rc) || APR_STATUS_IS_TIMEUP(rc)))
+            {
+                /* Nothing more is coming; pass on what is held. */
+                stream_release(ctx, bb, 0);
+                return APR_SUCCESS;
+            }
+            if (APR_STATUS_IS_EOF(rc) || APR_STATUS_IS_TIMEUP(rc)) {
+                ap_log_error(APLOG_MARK, APLOG_DEBUG, 0, c->base_server,
+                             IB_PRODUCT_NAME ": %s connection closed (%d)",
+                             f->frec->name, rc);
+                ap_remove_input_filter(f);
+            }
+            return rc;
+        }
+
+        stream_hold(f, bb);
+        if (stream_blocked(f)) {
+            return stream_abort(f);
+        }
+        stream_release(ctx, bb, stream_holding(ctx) ? window : 0);
+    } while (APR_BRIGADE_EMPTY(bb) && (block == APR_BLOCK_READ));
+
+    return APR_BRIGADE_EMPTY(bb) ? APR_EAGAIN : APR_SUCCESS;
+}
+
 /**
  * @internal
  *
@@ -594,6 +790,9 @@ static int ironbee_input_filter(ap_filter_t *f, apr_bucket_brigade *bb,
     conn_rec *c = f->c;
     ironbee_conn_context *ctx = f->ctx;
     ib_conn_t *iconn = ctx->iconn;
+    ironbee_config_t *modcfg =
+        (ironbee_config_t *)ap_get_module_config(c->base_server->module_config,
+                                                 &ironbee_module);
     ib_core_cfg_t *corecfg;
     ib_stream_t *istream;
     apr_bucket *b;
@@ -611,6 +810,12 @@ static int ironbee_input_filter(ap_filter_t *f, apr_bucket_brigade *bb,
         buffering = (int)corecfg->buffer_req;
     }
 
+    /* With a stream window, buffering only holds back the window. */
+    if (buffering && (modcfg->stream_window > 0)) {
+        return ironbee_input_stream(f, bb, mode, block, readbytes,
+                                    (apr_off_t)modcfg->stream_window);
+    }
+
     /* When buffering, data is removed from the brigade and handed
      * to IronBee. The filter must not return an empty brigade in this
      * case and keeps reading until there is processed data that comes
@@ -771,6 +976,32 @@ static int ironbee_input_filter(ap_filter_t *f, apr_bucket_brigade *bb,
 }
 
 
+/**
+ * @internal
+ *
+ * Streaming form of the output filter.
+ *
+ * As ironbee_input_stream(), holding back the trailing @a window bytes of
+ * a response body.  A flush or other metadata bucket releases everything.
+ */
+static int ironbee_output_stream(ap_filter_t *f, apr_bucket_brigade *bb,
+                                 apr_off_t window)
+{
+    ironbee_conn_context *ctx = f->ctx;
+    int meta;
+
+    meta = stream_hold(f, bb);
+    if (stream_blocked(f)) {
+        return stream_abort(f);
+    }
+    stream_release(ctx, bb, (meta || !stream_holding(ctx)) ? 0 : window);
+
+    if (APR_BRIGADE_EMPTY(bb)) {
+        return APR_SUCCESS;
+    }
+    return ap_pass_brigade(f->next, bb);
+}
+
 /**
  * @internal
  *
@@ -779,6 +1010,21 @@ static int ironbee_input_filter(ap_filter_t *f, apr_bucket_brigade *bb,
 static int ironbee_output_filter (ap_filter_t *f, apr_bucket_brigade *bb)
 {
     apr_bucket *b;
+    ironbee_conn_context *octx = f->ctx;
+    ironbee_config_t *modcfg =
+        (ironbee_config_t *)ap_get_module_config(f->c->base_server->module_config,
+                                                 &ironbee_module);
+    ib_core_cfg_t *ocorecfg;
+
+    /* With a stream window, response buffering holds back the window. */
+    if (modcfg->stream_window > 0) {
+        ib_context_module_config(octx->iconn->ctx, ib_core_module(),
+                                 (void *)&ocorecfg);
+        if ((ocorecfg != NULL) && ocorecfg->buffer_res) {
+            return ironbee_output_stream(f, bb,
+                                         (apr_off_t)modcfg->stream_window);
+        }
+    }
 #if 0
     conn_rec *c = f->c;
     ironbee_conn_context *ctx = f->ctx;
@@ -840,6 +1086,7 @@ static void *ironbee_create_config(apr_pool_t *p, server_rec *s)
     modcfg->enabled = 0;
     modcfg->buf_size = IRONBEE_DEFAULT_BUFLEN;
     modcfg->flush_size = IRONBEE_DEFAULT_FLUSHLEN;
+    modcfg->stream_window = 0;
 
     return modcfg;
 }
@@ -861,6 +1108,7 @@ static void *ironbee_merge_config(apr_pool_t *p, void *parent, void *child)
 
     modcfg->enabled = (modcfgc->enabled == IRONBEE_UNSET) ? modcfgp->enabled
                                                         : modcfgc->enabled;
+    modcfg->stream_window = modcfgp->stream_window;
 
     return modcfg;
 }
@@ -1030,7 +1278,8 @@ static const char *ironbee_cmd_ibconfig(cmd_parms *cmd,
 /**
  * @internal
  *
- * "IronBeeBufferSize" and "IronBeeBufferFlushSize" configuration directives.
+ * "IronBeeBufferSize", "IronBeeBufferFlushSize" and "IronBeeStreamWindow"
+ * configuration directives.
  */
 static const char *ironbee_cmd_sz(cmd_parms *cmd, void *dummy, const char *p1)
 {
@@ -1075,6 +1324,13 @@ static const command_rec ironbee_cmds[] = {
       RSRC_CONF,
       "specify buffer size (bytes) to trigger a flush"
     ),
+    AP_INIT_TAKE1(
+      "IronBeeStreamWindow",
+      ironbee_cmd_sz,
+      (void *)APR_OFFSETOF(ironbee_config_t, stream_window),
+      RSRC_CONF,
+      "stream buffered data, holding back this many bytes (0 to disable)"
+    ),
     { NULL }
 };
 
@@ -29,7 +29,6 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <time.h>
-#include <ctype.h>
 #include <ts/ts.h>
 
 #include <sys/socket.h>
@@ -40,6 +39,7 @@
 # include <inttypes.h>
 
 #include <ironbee/engine.h>
+#include <ironbee/engine_manager.h>
 #include <ironbee/config.h>
 #include <ironbee/module.h> /* Only needed while config is in here. */
 #include <ironbee/provider.h>
@@ -55,11 +55,18 @@ static void addr2str(const struct sockaddr *addr, char *str, int *port);
 
 #define ADDRSIZE 48 /* what's the longest IPV6 addr ? */
 
-ib_engine_t DLL_LOCAL *ironbee = NULL;
+/* Engines; a reconfigure swaps in a new one (see ironbee_reconfigure). */
+ib_manager_t DLL_LOCAL *ironbee_manager = NULL;
+static const char *ironbee_config_file = NULL;
 TSTextLogObject ironbee_log;
 #define DEFAULT_LOG "ts-ironbee"
 
+/* Engines alive at once: the current one plus ones still finishing
+ * connections opened before a reconfigure. */
+#define MAX_ENGINES 8
+
 typedef struct {
+    ib_engine_t *ib; /* engine acquired for this session */
     ib_conn_t *iconn;
     /* store the IPs here so we can clean them up and not leak memory */
     char remote_ip[ADDRSIZE];
@@ -358,7 +365,9 @@ static void ib_ssn_ctx_destroy(ib_ssn_ctx * data)
 {
     if (data) {
         if (data->iconn) /* notify_conn_closed calls conn_destroy */
-            ib_state_notify_conn_closed(ironbee, data->iconn);
+            ib_state_notify_conn_closed(data->ib, data->iconn);
+        if (data->ib)
+            ib_manager_engine_release(ironbee_manager, data->ib);
         TSfree(data);
     }
 }
@@ -413,7 +422,7 @@ static void process_data(TSCont contp, ibd_ctx* ibd)
         itxdata.dtype = IB_DTYPE_HTTP_BODY;
         itxdata.data = (uint8_t *)ibd->data->buf;
         itxdata.dlen = ibd->data->buflen;
-        (*ibd->ibd->ib_notify_body)(ironbee, data->tx, &itxdata);
+        (*ibd->ibd->ib_notify_body)(data->tx->ib, data->tx, &itxdata);
         TSfree(ibd->data->buf);
         ibd->data->buf = NULL;
         ibd->data->buflen = 0;
@@ -483,7 +492,7 @@ static void process_data(TSCont contp, ibd_ctx* ibd)
                     itxdata.dtype = IB_DTYPE_HTTP_BODY;
                     itxdata.data = (uint8_t *)ibd->data->buf;
                     itxdata.dlen = ibd->data->buflen;
-                    (*ibd->ibd->ib_notify_body)(ironbee, data->tx,
+                    (*ibd->ibd->ib_notify_body)(data->tx->ib, data->tx,
                                                 (ilength!=0) ? &itxdata : NULL);
                 }
 
@@ -586,7 +595,7 @@ static int data_event(TSCont contp, TSEvent event, ibd_ctx *ibd)
             TSVConnShutdown(TSTransformOutputVConnGet(contp), 0, 1);
 
             data = TSContDataGet(contp);
-            (*ibd->ibd->ib_notify_end)(ironbee, data->tx);
+            (*ibd->ibd->ib_notify_end)(data->tx->ib, data->tx);
             break;
         case TS_EVENT_VCONN_WRITE_READY:
             TSDebug("ironbee", "\tEvent is TS_EVENT_VCONN_WRITE_READY");
@@ -661,44 +670,89 @@ static int in_data_event(TSCont contp, TSEvent event, void *edata)
 }
 /**
  * @internal
- * Parse lines in an HTTP header buffer
+ * Add the MIME fields of an ATS header to an IronBee header list.
  *
- * Given a line terminated by "\r\n", this finds the end-of-line.
- * Where a line is wrapped, continuation lines are included in
- * in the (multi-)line parsed.
+ * Names and values are passed to IronBee as views into the ATS marshal
+ * buffer, which is not modified until @a hdr_loc is released.
  *
- * @param[in] line Buffer to parse
- * @param[out] lenp Line length (excluding line end)
- * @return 1 if a line was parsed, 0 for a blank line (no more headers),
- *         -1 for a parse error
+ * @param[in] tx IronBee transaction
+ * @param[in] bufp ATS marshal buffer
+ * @param[in] hdr_loc ATS header location
+ * @param[out] pibhdrs Address which header list is written
+ * @return IronBee status code
  */
-static int get_line(char * const line, size_t *lenp)
+static ib_status_t get_hdr_fields(ib_tx_t *tx, TSMBuffer bufp, TSMLoc hdr_loc,
+                                  ib_parsed_header_wrapper_t **pibhdrs)
 {
-    size_t len = 0;
-    char *end;
-    if (line[0] == '\r' && line[1] == '\n') {
-        return 0; /* blank line = no more hdr lines */
+    ib_parsed_header_wrapper_t *ibhdrs;
+    ib_status_t rc;
+    int nfields;
+    int i;
+
+    rc = ib_parsed_name_value_pair_list_wrapper_create(&ibhdrs, tx);
+    if (rc != IB_OK) {
+        return rc;
     }
-    else {
-        /* Use a loop here to catch theoretically-unlimited numbers
-         * of continuation lines in a folded header.  The isspace
-         * tests for a continuation line
-         */
-        do {
-            if (len > 0) {
-                /* we have a continuation line.  Add the lineend. */
-                len += 2;
-            }
-            end = strstr(line + len, "\r\n");
-            if (!end) {
-                return -1;
-            }
-            len = end - line;
-        } while (isspace(end[2]) && end[2] != '\r');
 
-        *lenp = len;
-        return 1;
+    nfields = TSMimeHdrFieldsCount(bufp, hdr_loc);
+    for (i = 0; i < nfields; ++i) {
+        TSMLoc field_loc;
+        const char *name;
+        const char *value;
+        int n_len;
+        int v_len;
+
+        field_loc = TSMimeHdrFieldGet(bufp, hdr_loc, i);
+        if (field_loc == TS_NULL_MLOC) {
+            continue;
+        }
+        name = TSMimeHdrFieldNameGet(bufp, hdr_loc, field_loc, &n_len);
+        value = TSMimeHdrFieldValueStringGet(bufp, hdr_loc, field_loc,
+                                             -1, &v_len);
+        if ((name != NULL) && (n_len > 0)) {
+            rc = ib_parsed_name_value_pair_list_add(ibhdrs,
+                                                    name, n_len,
+                                                    value == NULL ? "" : value,
+                                                    value == NULL ? 0 : v_len);
+        }
+        TSHandleMLocRelease(bufp, hdr_loc, field_loc);
+        if (rc != IB_OK) {
+            return rc;
+        }
     }
+
+    *pibhdrs = ibhdrs;
+    return IB_OK;
+}
+
+/**
+ * @internal
+ * Format the protocol of an ATS header as "HTTP/major.minor".
+ *
+ * @param[in] tx IronBee transaction whose memory pool is used
+ * @param[in] bufp ATS marshal buffer
+ * @param[in] hdr_loc ATS header location
+ * @param[out] plen Length of the returned string
+ * @return Protocol string, or NULL on allocation failure
+ */
+static const char *get_hdr_protocol(ib_tx_t *tx, TSMBuffer bufp,
+                                    TSMLoc hdr_loc, size_t *plen)
+{
+    char *protocol;
+    int version;
+    int len;
+
+    *plen = 0;
+    version = TSHttpHdrVersionGet(bufp, hdr_loc);
+    protocol = ib_mpool_alloc(tx->mp, sizeof("HTTP/nnnnnnnnnn.nnnnnnnnnn"));
+    if (protocol == NULL) {
+        return NULL;
+    }
+    len = sprintf(protocol, "HTTP/%d.%d",
+                  TS_HTTP_MAJOR(version), TS_HTTP_MINOR(version));
+
+    *plen = len;
+    return protocol;
 }
 
 /**
@@ -707,6 +761,9 @@ static int get_line(char * const line, size_t *lenp)
  *
  * Handles an HTTP header, called from ironbee_plugin.
  *
+ * The start line and MIME fields are read in place through the ATS header
+ * API rather than printing and re-parsing the header.
+ *
  * @param[in,out] data Transaction context
  * @param[in,out] txnp ATS transaction pointer
  * @param[in,out] ibd unknown
@@ -717,208 +774,108 @@ static int process_hdr(ib_txn_ctx *data, TSHttpTxn txnp,
     int rv;
     TSMBuffer bufp;
     TSMLoc hdr_loc;
-    TSIOBuffer iobufp;
-    TSIOBufferReader readerp;
-    TSIOBufferBlock blockp;
-    int64_t len;
     hdr_do *hdr;
-    char *line, *lptr;
-    size_t line_len = 0;
-    int offset = 0;
-
-    char *head_buf;
-    char *head_ptr;
-    void *head_start;
-    int first_time = 1;
-    unsigned char *dptr, *icdatabuf;
-    size_t icdatalen;
+    ib_parsed_header_wrapper_t *ibhdrs;
 
     TSDebug("ironbee", "process %s headers\n", ibd->word);
 
-    /* Use alternative simpler path to get the un-doctored request
-     * if we have the fix for TS-998
-     *
-     * This check will want expanding/fine-tuning according to what released
-     * versions incorporate the fix
-     */
-    /* We'll get a bogus URL from TS-998 */
-
     rv = (*ibd->hdr_get)(txnp, &bufp, &hdr_loc);
     if (rv) {
         TSError ("couldn't retrieve %s header: %d\n", ibd->word, rv);
         return 0;
     }
 
-    /* Get the data into an IOBuffer so we can access them! */
-    //iobufp = TSIOBufferSizedCreate(...);
-    iobufp = TSIOBufferCreate();
-    TSHttpHdrPrint(bufp, hdr_loc, iobufp);
-
-    readerp = TSIOBufferReaderAlloc(iobufp);
-    blockp = TSIOBufferReaderStart(readerp);
-
-    len = TSIOBufferBlockReadAvail(blockp, readerp);
-    //ib_log_debug(ironbee, 9,
-                 //"ts/ironbee/process_header: len=%ld", len );
-
-    /* if we're going to enable manipulation of headers, we need a copy */
-    icdatalen = len;
-    icdatabuf = dptr = TSmalloc(len);
+    /* feed the start line and fields to ironbee as parsed data */
+    if (ibd->dir == IBD_REQ) {
+        const char *method, *protocol;
+        char *uri, *url;
+        int m_len, url_len;
+        size_t u_len, p_len;
+        TSMLoc url_loc;
+        ib_parsed_req_line_t *rline;
 
-    for (head_buf = (void *)TSIOBufferBlockReadStart(blockp, readerp, &len);
-         len > 0;
-         head_buf = (void *)TSIOBufferBlockReadStart(
-                        TSIOBufferReaderStart(readerp), readerp, &len)) {
+        m_len = 0;
+        method = TSHttpHdrMethodGet(bufp, hdr_loc, &m_len);
+        protocol = get_hdr_protocol(data->tx, bufp, hdr_loc, &p_len);
 
-        if (first_time && (ibd->dir == IBD_REQ)) {
-            /* Workaround:
-             * Search for and remove the extra "http://" in the path by
-             * advancing the bytes preceding the extra string forward.
-             *
-             * EX: Here 1 would become 2 (x are removed bytes)
-             *  1) "GET http:///foo HTTP/1.0"
-             *  2) "xxxxxxxGET /foo HTTP/1.0"
-             */
-            head_ptr = (char *)memchr(head_buf, ' ', len);
-            if ((head_ptr != NULL) &&
-                (len - (head_ptr - head_buf) >= 9) &&
-                (head_ptr[1] == 'h') && (head_ptr[2] == 't') &&
-                (head_ptr[3] == 't') && (head_ptr[4] == 'p')) {
-                if ((head_ptr[5] == ':') && (head_ptr[6] == '/') &&
-                    (head_ptr[7] == '/') && (head_ptr[8] == '/')) {
-                    offset = 7;
+        /* The URL string is allocated by ATS, so copy it to the
+         * transaction once and let ironbee alias the copy.
+         */
+        uri = NULL;
+        u_len = 0;
+        if (TSHttpHdrUrlGet(bufp, hdr_loc, &url_loc) == TS_SUCCESS) {
+            url = TSUrlStringGet(bufp, url_loc, &url_len);
+            if (url != NULL) {
+                const char *start = url;
+
+                /* Workaround (TS-998):
+                 * Remove the extra "http://" in the path.
+                 *
+                 * EX: "http:///foo" becomes "/foo"
+                 */
+                if ((url_len >= 8) && (strncmp(url, "http:///", 8) == 0)) {
+                    start += 7;
                 }
-                else if ((head_ptr[5] == 's') &&
-                         (head_ptr[6] == ':') && (head_ptr[7] == '/') &&
-                         (head_ptr[8] == '/') && (head_ptr[9] == '/')) {
-                    offset = 8;
+                else if ((url_len >= 9) &&
+                         (strncmp(url, "https:///", 9) == 0)) {
+                    start += 8;
                 }
+                u_len = url_len - (start - url);
+                uri = ib_mpool_memdup(data->tx->mp, start, u_len);
+                TSfree(url);
             }
-            if (offset > 0) {
-                TSError("ATS Workaround - Removing extra http:// from request line: %.*s\n", 50, (char *)head_buf);
-                while (head_ptr >= head_buf) {
-                    *(head_ptr + offset) = *head_ptr;
-                    --head_ptr;
-                }
-                head_start = head_buf + offset;
-                icdatalen -= offset;
-                memcpy(dptr, head_start, len - offset);
-                dptr += len - offset;
-                TSError("ATS Workaround - DATA[%d]: %.*s ...\n", (int)len, 25, (char *)head_start);
-            }
-            else {
-                head_start = head_buf;
-                memcpy(dptr, head_start, len);
-                dptr += len;
-            }
+            TSHandleMLocRelease(bufp, hdr_loc, url_loc);
         }
-        else {
-            memcpy(dptr, head_buf, len);
-            dptr += len;
-        }
-        first_time = 0;
-
-
-        /* if there's more to come, go round again ... */
-        TSIOBufferReaderConsume(readerp, len);
-    }
-
-    /* parse into lines and feed to ironbee as parsed data */
-    if (ibd->dir == IBD_REQ) {
-        char *method, *uri, *protocol;
-        size_t m_len, u_len, p_len, n_len, v_len;
-        ib_parsed_header_wrapper_t *ibhdrs;
-        ib_parsed_req_line_t *rline;
 
-        line = (char*)icdatabuf;
-        rv = get_line(line, &line_len);
-
-        /* method is alphanumeric */
-        method = line;
-        for (lptr = line; isalpha(*lptr); ++lptr);
-        m_len = lptr - line;
-        while (isspace(*lptr))
-            ++lptr;
-        /* uri for our purposes is anything-but-whitespace */
-        uri = lptr;
-        u_len = strcspn(uri, " \t\r\n");
-        lptr += u_len;
-        while (isspace(*lptr))
-            ++lptr;
-        /* protocol is the rest of the line, but tolerate trailing whitespace */
-        protocol = lptr;
-        p_len = strcspn(protocol, " \t\r\n");
         rv = ib_parsed_req_line_create(data->tx, &rline,
-                                       line, line_len,
+                                       NULL, 0,
                                        method, m_len,
                                        uri, u_len,
                                        protocol, p_len);
-        ib_state_notify_request_started(ironbee, data->tx, rline);
-
-        /* now loop over req header lines */
-        rv = ib_parsed_name_value_pair_list_wrapper_create(&ibhdrs, data->tx);
-        for (line += line_len + 2;
-             get_line(line, &line_len) == 1;
-             line += line_len + 2) {
-            n_len = strcspn(line, ":");
-            lptr = line + n_len + 1;
-            while (isspace(*lptr))
-                ++lptr;
-            v_len = line_len - (lptr - line);
-            rv = ib_parsed_name_value_pair_list_add(ibhdrs,
-                                                    line, n_len,
-                                                    lptr, v_len);
+        ib_state_notify_request_started(data->tx->ib, data->tx, rline);
+
+        rv = get_hdr_fields(data->tx, bufp, hdr_loc, &ibhdrs);
+        if (rv == IB_OK) {
+            rv = ib_state_notify_request_headers_data(data->tx->ib, data->tx,
+                                                      ibhdrs);
         }
-        rv = ib_state_notify_request_headers_data(ironbee, data->tx, ibhdrs);
-        rv = ib_state_notify_request_headers(ironbee, data->tx);
+        rv = ib_state_notify_request_headers(data->tx->ib, data->tx);
     }
     else {
-        //ib_parsed_header_t *ibhdr = NULL, *newhdr;
-        ib_parsed_header_wrapper_t *ibhdrs;
         ib_parsed_resp_line_t *rline;
-        char *protocol, *code, *msg;
-        size_t p_len, c_len, m_len, n_len, v_len;
-
-        line = (char*)icdatabuf;
-        rv = get_line(line, &line_len);
-        ib_log_debug_tx(data->tx, "RESP_LINE: %.*s", (int)line_len, line);
-
-        /* "protocol code msg". */
-        protocol = lptr = line;
-        while (!isspace(*lptr)) ++lptr;
-        p_len = lptr - line;
-        while (isspace(*lptr)) ++lptr;
-        code = lptr;
-        while (!isspace(*lptr)) ++lptr;
-        c_len = lptr - code;
-        while (isspace(*lptr)) ++lptr;
-        msg = lptr;
-        m_len = line_len - (lptr - line);
+        const char *protocol, *msg;
+        char *code;
+        size_t p_len, c_len;
+        int m_len;
+
+        protocol = get_hdr_protocol(data->tx, bufp, hdr_loc, &p_len);
+        code = ib_mpool_alloc(data->tx->mp, sizeof("-nnnnnnnnnn"));
+        if ((protocol == NULL) || (code == NULL)) {
+            TSError("ironbee: failed to allocate response line");
+            TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+            return 0;
+        }
+        c_len = sprintf(code, "%d", (int)TSHttpHdrStatusGet(bufp, hdr_loc));
+        m_len = 0;
+        msg = TSHttpHdrReasonGet(bufp, hdr_loc, &m_len);
+        ib_log_debug_tx(data->tx, "RESP_LINE: %.*s %.*s %.*s",
+                        (int)p_len, protocol, (int)c_len, code,
+                        msg == NULL ? 0 : m_len, msg == NULL ? "" : msg);
 
         rv = ib_parsed_resp_line_create(data->tx, &rline,
-                                        line, line_len,
+                                        NULL, 0,
                                         protocol, p_len,
                                         code, c_len,
                                         msg, m_len);
         ib_log_debug_tx(data->tx, "ib_state_notify_response_started rline=%p", rline);
-        rv = ib_state_notify_response_started(ironbee, data->tx, rline);
-
-        /* now loop over resp header lines */
-        rv = ib_parsed_name_value_pair_list_wrapper_create(&ibhdrs, data->tx);
-        for (line += line_len + 2;
-             get_line(line, &line_len) == 1;
-             line += line_len + 2) {
-            n_len = strcspn(line, ":");
-            lptr = line + n_len + 1;
-            while (isspace(*lptr))
-                ++lptr;
-            v_len = line_len - (lptr - line);
-            rv = ib_parsed_name_value_pair_list_add(ibhdrs,
-                                                    line, n_len,
-                                                    lptr, v_len);
+        rv = ib_state_notify_response_started(data->tx->ib, data->tx, rline);
+
+        rv = get_hdr_fields(data->tx, bufp, hdr_loc, &ibhdrs);
+        if (rv == IB_OK) {
+            rv = ib_state_notify_response_headers_data(data->tx->ib, data->tx,
+                                                       ibhdrs);
         }
-        rv = ib_state_notify_response_headers_data(ironbee, data->tx, ibhdrs);
-        rv = ib_state_notify_response_headers(ironbee, data->tx);
+        rv = ib_state_notify_response_headers(data->tx->ib, data->tx);
     }
 
     /* Now manipulate headers as requested by ironbee */
@@ -975,9 +932,6 @@ add_hdr:
     }
 
     TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
-    TSIOBufferReaderFree(readerp);
-    TSIOBufferDestroy(iobufp);
-    TSfree(icdatabuf);
 
     return data->status;
 }
@@ -1030,19 +984,29 @@ static int ironbee_plugin(TSCont contp, TSEvent event, void *edata)
             /* First req on a connection, we set up conn stuff */
             ssndata = TSContDataGet(contp);
             if (ssndata == NULL) {
+                ib_engine_t *ib = NULL;
                 ib_conn_t *iconn = NULL;
                 ib_status_t rc;
-                rc = ib_conn_create(ironbee, &iconn, contp);
+
+                /* The session keeps this engine even if it is replaced. */
+                rc = ib_manager_engine_acquire(ironbee_manager, &ib);
+                if (rc != IB_OK) {
+                    TSError("ironbee: ib_manager_engine_acquire: %d\n", rc);
+                    return rc; // FIXME - figure out what to do
+                }
+                rc = ib_conn_create(ib, &iconn, contp);
                 if (rc != IB_OK) {
                     TSError("ironbee: ib_conn_create: %d\n", rc);
+                    ib_manager_engine_release(ironbee_manager, ib);
                     return rc; // FIXME - figure out what to do
                 }
                 ssndata = TSmalloc(sizeof(ib_ssn_ctx));
                 memset(ssndata, 0, sizeof(ib_ssn_ctx));
+                ssndata->ib = ib;
                 ssndata->iconn = iconn;
                 ssndata->txnp = txnp;
                 TSContDataSet(contp, ssndata);
-                ib_state_notify_conn_opened(ironbee, iconn);
+                ib_state_notify_conn_opened(ib, iconn);
             }
 
             /* create a txn cont (request ctx) */
@@ -1352,55 +1316,149 @@ static IB_PROVIDER_IFACE_TYPE(logger) ironbee_logger_iface = {
 static void ibexit(void)
 {
     TSTextLogObjectDestroy(ironbee_log);
-    ib_engine_destroy(ironbee);
+    ib_manager_destroy(ironbee_manager);
 }
 
 /**
  * @internal
- * Initialize IronBee for ATS.
- *
- * Performs IB initializations for the ATS plugin.
+ * Create and configure an IronBee engine.
  *
+ * @param[out] pib Address which new engine is written
  * @param[in] configfile Configuration file
- * @param[in] logfile Log file
  *
  * @returns status
  */
-static int ironbee_init(const char *configfile, const char *logfile)
+static ib_status_t ironbee_engine_create(ib_engine_t **pib,
+                                         const char *configfile)
 {
-    /* grab from httpd module's post-config */
     ib_status_t rc;
-//  ib_provider_t *lpr;
     ib_cfgparser_t *cp;
     ib_context_t *ctx;
-    int rv;
+    ib_engine_t *ib;
 
-    rc = ib_initialize();
+    rc = ib_engine_create(&ib, &ibplugin);
     if (rc != IB_OK) {
         return rc;
     }
 
-    ib_util_log_level(4);
+    rc = ib_provider_register(ib, IB_PROVIDER_TYPE_LOGGER, "ironbee-ts",
+                              NULL, &ironbee_logger_iface, NULL);
+    if (rc != IB_OK) {
+        goto failed;
+    }
 
-    ib_trace_init(TRACEFILE);
+    ib_context_set_string(ib_context_engine(ib),
+                          IB_PROVIDER_TYPE_LOGGER, "ironbee-ts");
+    ib_context_set_num(ib_context_engine(ib),
+                       IB_PROVIDER_TYPE_LOGGER ".log_level", 4);
 
-    rc = ib_engine_create(&ironbee, &ibplugin);
+    rc = ib_engine_init(ib);
     if (rc != IB_OK) {
-        return rc;
+        goto failed;
     }
 
-    rc = ib_provider_register(ironbee, IB_PROVIDER_TYPE_LOGGER, "ironbee-ts",
-                              NULL, &ironbee_logger_iface, NULL);
+    ib_hook_conn_register(ib, conn_opened_event,
+                          ironbee_conn_init, NULL);
+
+
+    ib_state_notify_cfg_started(ib);
+    ctx = ib_context_main(ib);
+
+    ib_context_set_string(ctx, IB_PROVIDER_TYPE_LOGGER, "ironbee-ts");
+    ib_context_set_num(ctx, "logger.log_level", 4);
+
+    rc = ib_cfgparser_create(&cp, ib);
+    if (rc != IB_OK) {
+        goto failed;
+    }
+    rc = ib_cfgparser_parse(cp, configfile);
+    ib_cfgparser_destroy(cp);
+    if (rc != IB_OK) {
+        goto failed;
+    }
+    rc = ib_state_notify_cfg_finished(ib);
+    if (rc != IB_OK) {
+        goto failed;
+    }
+
+    *pib = ib;
+    return IB_OK;
+
+failed:
+    ib_engine_destroy(ib);
+    return rc;
+}
+
+/**
+ * @internal
+ * Handle a Traffic Server reconfigure (traffic_line -x).
+ *
+ * Builds a new engine from the configuration file and makes it current.
+ * Sessions already open finish on the engine they started with.  If the
+ * new configuration fails, the current engine is kept.
+ *
+ * @param[in,out] contp Pointer to the continuation
+ * @param[in,out] event Event from ATS
+ * @param[in,out] edata Event data
+ *
+ * @returns status
+ */
+static int ironbee_reconfigure(TSCont contp, TSEvent event, void *edata)
+{
+    ib_engine_t *ib;
+    ib_status_t rc;
+
+    if (event != TS_EVENT_MGMT_UPDATE) {
+        return 0;
+    }
+
+    TSDebug("ironbee", "Reloading configuration %s", ironbee_config_file);
+    rc = ironbee_engine_create(&ib, ironbee_config_file);
+    if (rc != IB_OK) {
+        TSError("[ironbee] reload of %s failed with %d; "
+                "keeping current configuration\n",
+                ironbee_config_file, rc);
+        return 0;
+    }
+    rc = ib_manager_engine_add(ironbee_manager, ib);
+    if (rc != IB_OK) {
+        TSError("[ironbee] reload of %s could not be applied: %d\n",
+                ironbee_config_file, rc);
+        ib_engine_destroy(ib);
+        return 0;
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ * Initialize IronBee for ATS.
+ *
+ * Performs IB initializations for the ATS plugin.
+ *
+ * @param[in] configfile Configuration file
+ * @param[in] logfile Log file
+ *
+ * @returns status
+ */
+static int ironbee_init(const char *configfile, const char *logfile)
+{
+    /* grab from httpd module's post-config */
+    ib_status_t rc;
+    ib_engine_t *ib;
+    int rv;
+
+    rc = ib_initialize();
     if (rc != IB_OK) {
         return rc;
     }
 
-    ib_context_set_string(ib_context_engine(ironbee),
-                          IB_PROVIDER_TYPE_LOGGER, "ironbee-ts");
-    ib_context_set_num(ib_context_engine(ironbee),
-                       IB_PROVIDER_TYPE_LOGGER ".log_level", 4);
+    ib_util_log_level(4);
 
-    rc = ib_engine_init(ironbee);
+    ib_trace_init(TRACEFILE);
+
+    rc = ib_manager_create(&ironbee_manager, MAX_ENGINES);
     if (rc != IB_OK) {
         return rc;
     }
@@ -1418,26 +1476,16 @@ static int ironbee_init(const char *configfile, const char *logfile)
         return IB_OK + rv;
     }
 
-    ib_hook_conn_register(ironbee, conn_opened_event,
-                          ironbee_conn_init, NULL);
-
-
-    ib_state_notify_cfg_started(ironbee);
-    ctx = ib_context_main(ironbee);
-
-    ib_context_set_string(ctx, IB_PROVIDER_TYPE_LOGGER, "ironbee-ts");
-    ib_context_set_num(ctx, "logger.log_level", 4);
-
-    rc = ib_cfgparser_create(&cp, ironbee);
+    ironbee_config_file = TSstrdup(configfile);
+    rc = ironbee_engine_create(&ib, ironbee_config_file);
     if (rc != IB_OK) {
         return rc;
     }
-    if (cp != NULL) {  // huh?
-        ib_cfgparser_parse(cp, configfile);
-        ib_cfgparser_destroy(cp);
+    rc = ib_manager_engine_add(ironbee_manager, ib);
+    if (rc != IB_OK) {
+        ib_engine_destroy(ib);
+        return rc;
     }
-    ib_state_notify_cfg_finished(ironbee);
-
 
     return IB_OK;
 }
@@ -1485,7 +1533,12 @@ void TSPluginInit(int argc, const char *argv[])
     rv = ironbee_init(argv[1], argc >= 3 ? argv[2] : DEFAULT_LOG);
     if (rv != IB_OK) {
         TSError("[ironbee] initialization failed with %d\n", rv);
+        return;
     }
+
+    /* Reload the configuration on "traffic_line -x". */
+    TSMgmtUpdateRegister(TSContCreate(ironbee_reconfigure, TSMutexCreate()),
+                         "ironbee");
     return;
 
 Lerror:
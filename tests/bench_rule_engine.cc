@@ -0,0 +1,692 @@
+//////////////////////////////////////////////////////////////////////////////
+// Licensed to Qualys, Inc. (QUALYS) under one or more
+// contributor license agreements.  See the NOTICE file distributed with
+// this work for additional information regarding copyright ownership.
+// QUALYS licenses this file to You under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief IronBee &mdash; Rule Engine Micro-Benchmark
+///
+/// Builds an engine in-process, loads a generated rule set of configurable
+/// size and operator mix and drives synthetic transactions through
+/// ib_state_notify_*().  Reports time and heap allocations per transaction
+/// along with a per-event time breakdown, as text, JSON or CSV.
+///
+/// This is not run by "make check"; build and run it with "make bench".
+/// Arguments can be passed via BENCH_FLAGS, e.g.:
+///
+/// @code
+/// make bench BENCH_FLAGS="--rules 5000 --mix rx=50,streq=50 --format json"
+/// @endcode
+///
+/// @author Brian Rectanus <brectanus@qualys.com>
+//////////////////////////////////////////////////////////////////////////////
+
+#include "ironbee_config_auto.h"
+
+#include <ironbee/release.h>
+#include <ironbee/core.h>
+#include <ironbee/engine.h>
+#include <ironbee/state_notify.h>
+#include <ironbee/debug.h>
+#include "ironbee_private.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+using namespace std;
+
+/* -- Allocation counting -- */
+
+static size_t g_allocs = 0;       /**< Heap allocations so far */
+static size_t g_alloc_bytes = 0;  /**< Heap bytes allocated so far */
+
+#ifdef __GLIBC__
+/* Interpose the heap so that all allocations made by the engine and its
+ * modules, including memory pool pages, are counted. */
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    ++g_allocs;
+    g_alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    ++g_allocs;
+    g_alloc_bytes += nmemb * size;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    ++g_allocs;
+    g_alloc_bytes += size;
+    return __libc_realloc(ptr, size);
+}
+}
+#define HAVE_ALLOC_COUNTS 1
+#else
+#define HAVE_ALLOC_COUNTS 0
+#endif
+
+/* -- Timing -- */
+
+/**
+ * Current monotonic time in nanoseconds.
+ */
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Per-event timing.
+ *
+ * Hooks registered by the benchmark run after those registered by the core
+ * and the modules, so the time between the previous event and this hook
+ * firing is the cost of everything that handled this event, including the
+ * rule engine.
+ */
+struct event_timing_t {
+    uint64_t last_ns;                        /**< Time of last event */
+    uint64_t total_ns[IB_STATE_EVENT_NUM];   /**< Time charged per event */
+    uint64_t count[IB_STATE_EVENT_NUM];      /**< Times event fired */
+};
+
+static event_timing_t g_timing;
+
+/**
+ * Transaction events that are timed, in the order they fire.
+ */
+static const ib_state_event_type_t g_tx_events[] = {
+    tx_started_event,
+    handle_context_tx_event,
+    request_headers_event,
+    handle_request_headers_event,
+    request_finished_event,
+    handle_request_event,
+    tx_process_event,
+    response_headers_event,
+    handle_response_headers_event,
+    response_finished_event,
+    handle_response_event,
+    handle_postprocess_event,
+    tx_finished_event
+};
+
+static bool g_timing_enabled = false;
+
+static ib_status_t timing_tx_hook(ib_engine_t *ib,
+                                  ib_tx_t *tx,
+                                  ib_state_event_type_t event,
+                                  void *cbdata)
+{
+    if (g_timing_enabled) {
+        uint64_t t = now_ns();
+        g_timing.total_ns[event] += t - g_timing.last_ns;
+        ++g_timing.count[event];
+        g_timing.last_ns = t;
+    }
+    return IB_OK;
+}
+
+/* -- Options -- */
+
+/**
+ * Benchmark options.
+ */
+struct bench_options_t {
+    size_t            rules;         /**< Number of rules to generate */
+    map<string, int>  mix;           /**< Rule type => weight */
+    size_t            tfns;          /**< Transformations per target */
+    size_t            transactions;  /**< Transactions to measure */
+    size_t            warmup;        /**< Transactions before measuring */
+    size_t            tx_per_conn;   /**< Transactions per connection */
+    string            format;        /**< text, json or csv */
+    string            workdir;       /**< Where to write generated config */
+};
+
+static void usage(const char *prog)
+{
+    cerr << "Usage: " << prog << " [options]\n"
+         << "  --rules N         Number of rules (default 1000)\n"
+         << "  --mix SPEC        Rule mix as type=weight,... (default\n"
+         << "                    rx=30,pm=20,streq=20,ipmatch=10,chain=20)\n"
+         << "                    Types: rx pm streq contains ipmatch chain lua\n"
+         << "  --tfns N          Transformations per target (default 1)\n"
+         << "  --transactions N  Transactions to measure (default 10000)\n"
+         << "  --warmup N        Transactions before measuring (default 100)\n"
+         << "  --tx-per-conn N   Transactions per connection (default 10)\n"
+         << "  --format F        text, json or csv (default text)\n"
+         << "  --workdir DIR     Directory for generated config (default /tmp)\n";
+}
+
+static map<string, int> parse_mix(const string &spec)
+{
+    map<string, int> mix;
+    stringstream ss(spec);
+    string item;
+
+    while (getline(ss, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == string::npos) {
+            throw runtime_error("Invalid mix item: " + item);
+        }
+        mix[item.substr(0, eq)] = atoi(item.substr(eq + 1).c_str());
+    }
+    return mix;
+}
+
+static bench_options_t parse_options(int argc, char **argv)
+{
+    bench_options_t opts;
+
+    opts.rules = 1000;
+    opts.mix = parse_mix("rx=30,pm=20,streq=20,ipmatch=10,chain=20");
+    opts.tfns = 1;
+    opts.transactions = 10000;
+    opts.warmup = 100;
+    opts.tx_per_conn = 10;
+    opts.format = "text";
+    opts.workdir = "/tmp";
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--help") {
+            usage(argv[0]);
+            exit(0);
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            throw runtime_error("Missing value for " + arg);
+        }
+        string value = argv[++i];
+
+        if      (arg == "--rules")        opts.rules = atol(value.c_str());
+        else if (arg == "--mix")          opts.mix = parse_mix(value);
+        else if (arg == "--tfns")         opts.tfns = atol(value.c_str());
+        else if (arg == "--transactions") opts.transactions = atol(value.c_str());
+        else if (arg == "--warmup")       opts.warmup = atol(value.c_str());
+        else if (arg == "--tx-per-conn")  opts.tx_per_conn = atol(value.c_str());
+        else if (arg == "--format")       opts.format = value;
+        else if (arg == "--workdir")      opts.workdir = value;
+        else {
+            usage(argv[0]);
+            throw runtime_error("Unknown option " + arg);
+        }
+    }
+
+    if (opts.tx_per_conn == 0) {
+        opts.tx_per_conn = 1;
+    }
+    if (opts.format != "text" && opts.format != "json" && opts.format != "csv") {
+        throw runtime_error("Unknown format " + opts.format);
+    }
+    return opts;
+}
+
+/* -- Rule set generation -- */
+
+/**
+ * Transformation chain for a target.
+ */
+static string tfn_chain(size_t n)
+{
+    static const char *tfns[] = {
+        "lowercase", "trim", "compressWhitespace", "removeWhitespace"
+    };
+    string s;
+    for (size_t i = 0; i < n; ++i) {
+        s += string(".") + tfns[i % (sizeof(tfns) / sizeof(*tfns))] + "()";
+    }
+    return s;
+}
+
+/**
+ * Generate a single rule of type @a type.
+ *
+ * Rules are built to mostly not match, as in production; every 50th rule
+ * uses a pattern that matches the synthetic traffic.
+ */
+static string generate_rule(const bench_options_t &opts,
+                            const string &type,
+                            size_t n,
+                            const string &lua_path)
+{
+    static const char *phases[] = { "REQUEST_HEADER", "REQUEST" };
+    ostringstream rule;
+    bool hit = (n % 50) == 0;
+    const char *phase = phases[n % 2];
+    string tfns = tfn_chain(opts.tfns);
+
+    if (type == "rx") {
+        rule << "Rule request_uri_path" << tfns
+             << "|request_uri_query" << tfns
+             << " \"@rx ";
+        if (hit) {
+            rule << "ind[a-z]x\"";
+        }
+        else {
+            rule << "attack" << n << "[0-9]+\"";
+        }
+    }
+    else if (type == "pm") {
+        rule << "Rule request_headers" << tfns
+             << " \"@pm ";
+        if (hit) {
+            rule << "bench";
+        }
+        else {
+            rule << "evil" << n;
+        }
+        rule << " sqlmap" << n << " nikto" << n << "\"";
+    }
+    else if (type == "streq") {
+        rule << "Rule request_method"
+             << " \"@streq ";
+        if (hit) {
+            rule << "GET\"";
+        }
+        else {
+            rule << "M" << n << "\"";
+        }
+    }
+    else if (type == "contains") {
+        rule << "Rule request_uri_query" << tfns
+             << " \"@contains ";
+        if (hit) {
+            rule << "id=\"";
+        }
+        else {
+            rule << "../" << n << "\"";
+        }
+    }
+    else if (type == "ipmatch") {
+        rule << "Rule remote_addr \"@ipmatch ";
+        if (hit) {
+            rule << "1.0.0.0/8\"";
+        }
+        else {
+            rule << "10." << (n % 256) << ".0.0/16\"";
+        }
+    }
+    else if (type == "chain") {
+        rule << "Rule request_method \"@streq GET\" id:bench/" << n
+             << " phase:" << phase << " chain\n"
+             << "Rule request_uri_path" << tfns
+             << " \"@rx /admin" << n << "\"";
+        return rule.str() + " \"msg:bench chain\"\n";
+    }
+    else if (type == "lua") {
+        rule << "RuleExt lua:" << lua_path;
+    }
+    else {
+        throw runtime_error("Unknown rule type " + type);
+    }
+
+    rule << " id:bench/" << n << " phase:" << phase;
+    if (type != "lua") {
+        rule << " \"msg:bench " << type << "\"";
+    }
+    return rule.str() + "\n";
+}
+
+/**
+ * Write the configuration file and any support files.
+ *
+ * Rule types are interleaved according to their weights so that rules of
+ * each type are spread over the rule set rather than grouped.
+ *
+ * @returns Path to the configuration file.
+ */
+static string generate_config(const bench_options_t &opts)
+{
+    string config_path = opts.workdir + "/bench_rule_engine.config";
+    string lua_path = opts.workdir + "/bench_rule_engine.lua";
+    bool have_lua = opts.mix.count("lua") && opts.mix.find("lua")->second > 0;
+
+    ofstream config(config_path.c_str());
+    if (! config) {
+        throw runtime_error("Could not write " + config_path);
+    }
+
+    config << "LogLevel 1\n"
+           << "SensorId AAAABBBB-1111-2222-3333-FFFF00000023\n"
+           << "LoadModule \"ibmod_htp.so\"\n"
+           << "LoadModule \"ibmod_pcre.so\"\n"
+           << "LoadModule \"ibmod_ac.so\"\n"
+           << "LoadModule \"ibmod_rules.so\"\n"
+           << "Set parser \"htp\"\n"
+           << "RequestBuffering On\n\n";
+
+    if (have_lua) {
+        ofstream lua(lua_path.c_str());
+        lua << "return 0\n";
+    }
+
+    /* Weighted round robin over the mix. */
+    int total_weight = 0;
+    for (map<string, int>::const_iterator i = opts.mix.begin();
+         i != opts.mix.end();
+         ++i)
+    {
+        total_weight += i->second;
+    }
+    if (total_weight <= 0) {
+        throw runtime_error("Rule mix has no weight.");
+    }
+
+    map<string, int> credit;
+    for (size_t n = 0; n < opts.rules; ++n) {
+        string best;
+        for (map<string, int>::const_iterator i = opts.mix.begin();
+             i != opts.mix.end();
+             ++i)
+        {
+            credit[i->first] += i->second;
+            if (best.empty() || credit[i->first] > credit[best]) {
+                best = i->first;
+            }
+        }
+        credit[best] -= total_weight;
+        config << generate_rule(opts, best, n, lua_path);
+    }
+
+    return config_path;
+}
+
+/* -- Traffic -- */
+
+static const char *g_requests[] = {
+    "GET /index.html?id=42&q=bench HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) bench\r\n"
+    "Accept: text/html\r\n"
+    "Cookie: session=abcdef0123456789\r\n"
+    "\r\n",
+
+    "POST /login HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: curl/7.24.0\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: 27\r\n"
+    "\r\n"
+    "user=admin&password=s3cr3t!",
+
+    "GET /static/app.js HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 6.1) bench\r\n"
+    "Referer: http://www.example.com/index.html\r\n"
+    "\r\n",
+};
+
+static const char *g_response =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/html\r\n"
+    "Content-Length: 12\r\n"
+    "\r\n"
+    "Hello World!";
+
+static void send_data(ib_engine_t *ib,
+                      ib_conn_t *conn,
+                      const char *data,
+                      bool in)
+{
+    ib_conndata_t *conndata;
+    size_t len = strlen(data);
+    ib_status_t rc;
+
+    rc = ib_conn_data_create(conn, &conndata, len);
+    if (rc != IB_OK) {
+        throw runtime_error("ib_conn_data_create failed");
+    }
+    conndata->dlen = len;
+    memcpy(conndata->data, data, len);
+
+    rc = in ? ib_state_notify_conn_data_in(ib, conndata)
+            : ib_state_notify_conn_data_out(ib, conndata);
+    if (rc != IB_OK) {
+        throw runtime_error("ib_state_notify_conn_data failed");
+    }
+}
+
+/**
+ * Run @a n transactions through the engine.
+ */
+static void run_transactions(ib_engine_t *ib,
+                             const bench_options_t &opts,
+                             size_t n)
+{
+    size_t nreq = sizeof(g_requests) / sizeof(*g_requests);
+    size_t sent = 0;
+
+    while (sent < n) {
+        ib_conn_t *conn;
+        if (ib_conn_create(ib, &conn, NULL) != IB_OK) {
+            throw runtime_error("ib_conn_create failed");
+        }
+        conn->local_ipstr = "1.0.0.1";
+        conn->remote_ipstr = "1.0.0.2";
+        conn->local_port = 80;
+        conn->remote_port = 65534;
+        ib_state_notify_conn_opened(ib, conn);
+
+        for (size_t i = 0; i < opts.tx_per_conn && sent < n; ++i, ++sent) {
+            send_data(ib, conn, g_requests[sent % nreq], true);
+            send_data(ib, conn, g_response, false);
+        }
+
+        ib_state_notify_conn_closed(ib, conn);
+    }
+}
+
+/* -- Reporting -- */
+
+struct bench_result_t {
+    uint64_t elapsed_ns;
+    size_t   allocs;
+    size_t   alloc_bytes;
+};
+
+static string mix_string(const bench_options_t &opts)
+{
+    string s;
+    for (map<string, int>::const_iterator i = opts.mix.begin();
+         i != opts.mix.end();
+         ++i)
+    {
+        if (! s.empty()) {
+            s += ",";
+        }
+        ostringstream item;
+        item << i->first << "=" << i->second;
+        s += item.str();
+    }
+    return s;
+}
+
+static void report(const bench_options_t &opts, const bench_result_t &r)
+{
+    double ntx = opts.transactions ? (double)opts.transactions : 1.0;
+    double ns_per_tx = r.elapsed_ns / ntx;
+    double allocs_per_tx = HAVE_ALLOC_COUNTS ? r.allocs / ntx : -1;
+    double bytes_per_tx = HAVE_ALLOC_COUNTS ? r.alloc_bytes / ntx : -1;
+
+    if (opts.format == "json") {
+        printf("{\n");
+        printf("  \"rules\": %zu,\n", opts.rules);
+        printf("  \"mix\": \"%s\",\n", mix_string(opts).c_str());
+        printf("  \"tfns\": %zu,\n", opts.tfns);
+        printf("  \"transactions\": %zu,\n", opts.transactions);
+        printf("  \"ns_per_tx\": %.1f,\n", ns_per_tx);
+        printf("  \"allocs_per_tx\": %.1f,\n", allocs_per_tx);
+        printf("  \"alloc_bytes_per_tx\": %.1f,\n", bytes_per_tx);
+        printf("  \"events\": {");
+        const char *sep = "\n";
+        for (int e = 0; e < IB_STATE_EVENT_NUM; ++e) {
+            if (g_timing.count[e] == 0) {
+                continue;
+            }
+            printf("%s    \"%s\": %.1f", sep,
+                   ib_state_event_name((ib_state_event_type_t)e),
+                   g_timing.total_ns[e] / ntx);
+            sep = ",\n";
+        }
+        printf("\n  }\n}\n");
+    }
+    else if (opts.format == "csv") {
+        printf("metric,value\n");
+        printf("rules,%zu\n", opts.rules);
+        printf("mix,\"%s\"\n", mix_string(opts).c_str());
+        printf("tfns,%zu\n", opts.tfns);
+        printf("transactions,%zu\n", opts.transactions);
+        printf("ns_per_tx,%.1f\n", ns_per_tx);
+        printf("allocs_per_tx,%.1f\n", allocs_per_tx);
+        printf("alloc_bytes_per_tx,%.1f\n", bytes_per_tx);
+        for (int e = 0; e < IB_STATE_EVENT_NUM; ++e) {
+            if (g_timing.count[e] != 0) {
+                printf("event.%s,%.1f\n",
+                       ib_state_event_name((ib_state_event_type_t)e),
+                       g_timing.total_ns[e] / ntx);
+            }
+        }
+    }
+    else {
+        printf("Rules:            %zu (%s, %zu tfns/target)\n",
+               opts.rules, mix_string(opts).c_str(), opts.tfns);
+        printf("Transactions:     %zu\n", opts.transactions);
+        printf("ns/transaction:   %.1f\n", ns_per_tx);
+        if (HAVE_ALLOC_COUNTS) {
+            printf("allocs/tx:        %.1f (%.1f bytes)\n",
+                   allocs_per_tx, bytes_per_tx);
+        }
+        printf("Per event ns/transaction:\n");
+        for (int e = 0; e < IB_STATE_EVENT_NUM; ++e) {
+            if (g_timing.count[e] != 0) {
+                printf("  %-32s %12.1f\n",
+                       ib_state_event_name((ib_state_event_type_t)e),
+                       g_timing.total_ns[e] / ntx);
+            }
+        }
+    }
+}
+
+/* -- Main -- */
+
+int main(int argc, char **argv)
+{
+    bench_options_t opts;
+    ib_engine_t    *ib;
+    ib_server_t     server;
+    ib_core_cfg_t  *corecfg = NULL;
+    ib_status_t     rc;
+
+    try {
+        opts = parse_options(argc, argv);
+    }
+    catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    server.vernum = IB_VERNUM;
+    server.abinum = IB_ABINUM;
+    server.version = IB_VERSION;
+    server.filename = __FILE__;
+    server.name = "bench_rule_engine";
+
+    ib_initialize();
+    ib_trace_init(NULL);
+    if ( (ib_engine_create(&ib, &server) != IB_OK) ||
+         (ib_engine_init(ib) != IB_OK) )
+    {
+        cerr << "Failed to create engine." << endl;
+        return 1;
+    }
+
+    ib_context_module_config(ib->ctx, ib_core_module(), (void *)&corecfg);
+    corecfg->module_base_path = IB_XSTRINGIFY(MODULE_BASE_PATH);
+    corecfg->rule_base_path = IB_XSTRINGIFY(RULE_BASE_PATH);
+
+    try {
+        string config_path = generate_config(opts);
+        ib_cfgparser_t *cp;
+
+        ib_state_notify_cfg_started(ib);
+        rc = ib_cfgparser_create(&cp, ib);
+        if (rc == IB_OK) {
+            rc = ib_cfgparser_parse(cp, config_path.c_str());
+        }
+        if (rc != IB_OK) {
+            throw runtime_error("Failed to parse " + config_path);
+        }
+        rc = ib_state_notify_cfg_finished(ib);
+        if (rc != IB_OK) {
+            throw runtime_error("Failed to finish configuration.");
+        }
+
+        /* Register timing hooks last so they run after all others. */
+        for (size_t i = 0; i < sizeof(g_tx_events) / sizeof(*g_tx_events); ++i) {
+            ib_hook_tx_register(ib, g_tx_events[i], timing_tx_hook, NULL);
+        }
+
+        run_transactions(ib, opts, opts.warmup);
+
+        memset(&g_timing, 0, sizeof(g_timing));
+        bench_result_t result;
+        size_t allocs = g_allocs;
+        size_t alloc_bytes = g_alloc_bytes;
+        uint64_t start = now_ns();
+        g_timing.last_ns = start;
+        g_timing_enabled = true;
+
+        run_transactions(ib, opts, opts.transactions);
+
+        g_timing_enabled = false;
+        result.elapsed_ns = now_ns() - start;
+        result.allocs = g_allocs - allocs;
+        result.alloc_bytes = g_alloc_bytes - alloc_bytes;
+
+        report(opts, result);
+    }
+    catch (const exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        ib_engine_destroy(ib);
+        ib_shutdown();
+        return 1;
+    }
+
+    ib_engine_destroy(ib);
+    ib_shutdown();
+    return 0;
+}
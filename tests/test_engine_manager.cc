@@ -0,0 +1,197 @@
+//////////////////////////////////////////////////////////////////////////////
+// Licensed to Qualys, Inc. (QUALYS) under one or more
+// contributor license agreements.  See the NOTICE file distributed with
+// this work for additional information regarding copyright ownership.
+// QUALYS licenses this file to You under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief IronBee &mdash; Engine Manager Test Functions
+///
+/// @author Nick LeRoy <nleroy@qualys.com>
+//////////////////////////////////////////////////////////////////////////////
+
+#include "gtest/gtest.h"
+#include "gtest/gtest-spi.h"
+
+#include <ironbee/engine_manager.h>
+#include <ironbee/state_notify.h>
+
+#include "config-parser.h"
+#include "ibtest_util.hh"
+
+#include <string.h>
+
+/// Create and configure an (empty) engine.
+static void create_engine(ib_engine_t **pib)
+{
+    const char *cfgbuf = "LogLevel 4\n";
+
+    ibtest_engine_create(pib);
+    ibtest_engine_config_buf(*pib, cfgbuf, strlen(cfgbuf), "test.conf", 1);
+}
+
+/// Create and configure an engine with the user agent module, which keeps
+/// compiled rules and a cache for the engine.
+static void create_ua_engine(ib_engine_t **pib)
+{
+    const char *cfgbuf =
+        "LogLevel 4\n"
+        "ModuleBasePath " IB_XSTRINGIFY(MODULE_BASE_PATH) "\n"
+        "LoadModule ibmod_htp.so\n"
+        "LoadModule ibmod_user_agent.so\n"
+        "Set parser htp\n";
+
+    ibtest_engine_create(pib);
+    ibtest_engine_config_buf(*pib, cfgbuf, strlen(cfgbuf), "test.conf", 1);
+}
+
+/// Run a request with a User-Agent header; check that it was parsed.
+static void run_ua_tx(ib_engine_t *ib)
+{
+    const char *req =
+        "GET / HTTP/1.1\r\n"
+        "Host: UnitTest\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) Firefox/15.0\r\n"
+        "\r\n";
+    ib_conn_t *conn;
+    ib_conndata_t *conndata;
+    ib_field_t *f;
+
+    ASSERT_EQ(IB_OK, ib_conn_create(ib, &conn, NULL));
+    conn->local_ipstr = "1.0.0.1";
+    conn->remote_ipstr = "1.0.0.2";
+    conn->remote_port = 65534;
+    conn->local_port = 80;
+    ASSERT_EQ(IB_OK, ib_state_notify_conn_opened(ib, conn));
+
+    ASSERT_EQ(IB_OK, ib_conn_data_create(conn, &conndata, strlen(req)));
+    conndata->dlen = strlen(req);
+    memcpy(conndata->data, req, strlen(req));
+    ASSERT_EQ(IB_OK, ib_state_notify_conn_data_in(ib, conndata));
+
+    ASSERT_TRUE(conn->tx != NULL);
+    EXPECT_EQ(IB_OK, ib_data_get(conn->tx->dpi, "UA", &f));
+
+    ASSERT_EQ(IB_OK, ib_state_notify_conn_closed(ib, conn));
+}
+
+TEST(TestEngineManager, create)
+{
+    ib_manager_t *manager;
+    ib_engine_t *ib;
+
+    ASSERT_EQ(IB_EINVAL, ib_manager_create(&manager, 0));
+    ASSERT_EQ(IB_OK, ib_manager_create(&manager, 2));
+    EXPECT_EQ(0UL, ib_manager_engine_count(manager));
+    EXPECT_EQ(0UL, ib_manager_generation(manager));
+    EXPECT_EQ(IB_ENOENT, ib_manager_engine_acquire(manager, &ib));
+    ib_manager_destroy(manager);
+}
+
+TEST(TestEngineManager, reload)
+{
+    ib_manager_t *manager;
+    ib_engine_t *ib1;
+    ib_engine_t *ib2;
+    ib_engine_t *ib;
+
+    ASSERT_EQ(IB_OK, ib_manager_create(&manager, 2));
+
+    create_engine(&ib1);
+    ASSERT_EQ(IB_OK, ib_manager_engine_add(manager, ib1));
+    EXPECT_EQ(1UL, ib_manager_generation(manager));
+
+    // A connection on the first generation.
+    ASSERT_EQ(IB_OK, ib_manager_engine_acquire(manager, &ib));
+    EXPECT_EQ(ib1, ib);
+
+    // Reload; new connections get the new engine.
+    create_engine(&ib2);
+    ASSERT_EQ(IB_OK, ib_manager_engine_add(manager, ib2));
+    EXPECT_EQ(2UL, ib_manager_generation(manager));
+    EXPECT_EQ(2UL, ib_manager_engine_count(manager));
+    ASSERT_EQ(IB_OK, ib_manager_engine_acquire(manager, &ib));
+    EXPECT_EQ(ib2, ib);
+
+    // Old engine goes with its last connection.
+    ASSERT_EQ(IB_OK, ib_manager_engine_release(manager, ib1));
+    EXPECT_EQ(1UL, ib_manager_engine_count(manager));
+    EXPECT_EQ(IB_EINVAL, ib_manager_engine_release(manager, ib1));
+
+    // Current engine stays after its connections are gone.
+    ASSERT_EQ(IB_OK, ib_manager_engine_release(manager, ib2));
+    EXPECT_EQ(1UL, ib_manager_engine_count(manager));
+
+    ib_manager_destroy(manager);
+}
+
+TEST(TestEngineManager, full)
+{
+    ib_manager_t *manager;
+    ib_engine_t *ib1;
+    ib_engine_t *ib2;
+    ib_engine_t *ib3;
+    ib_engine_t *ib;
+
+    ASSERT_EQ(IB_OK, ib_manager_create(&manager, 1));
+
+    // An idle current engine is replaced in place.
+    create_engine(&ib1);
+    ASSERT_EQ(IB_OK, ib_manager_engine_add(manager, ib1));
+    create_engine(&ib2);
+    ASSERT_EQ(IB_OK, ib_manager_engine_add(manager, ib2));
+    EXPECT_EQ(1UL, ib_manager_engine_count(manager));
+
+    // A busy one is not.
+    ASSERT_EQ(IB_OK, ib_manager_engine_acquire(manager, &ib));
+    create_engine(&ib3);
+    EXPECT_EQ(IB_EAGAIN, ib_manager_engine_add(manager, ib3));
+    ASSERT_EQ(IB_OK, ib_manager_engine_release(manager, ib));
+    ASSERT_EQ(IB_OK, ib_manager_engine_add(manager, ib3));
+    EXPECT_EQ(3UL, ib_manager_generation(manager));
+
+    ib_manager_destroy(manager);
+}
+
+TEST(TestEngineManager, reload_module)
+{
+    ib_manager_t *manager;
+    ib_engine_t *ib1;
+    ib_engine_t *ib2;
+    ib_engine_t *ib;
+
+    ASSERT_EQ(IB_OK, ib_manager_create(&manager, 2));
+
+    create_ua_engine(&ib1);
+    ASSERT_EQ(IB_OK, ib_manager_engine_add(manager, ib1));
+    ASSERT_EQ(IB_OK, ib_manager_engine_acquire(manager, &ib));
+    run_ua_tx(ib);
+
+    // Reload, then destroy the old engine; the module stays loaded.
+    create_ua_engine(&ib2);
+    ASSERT_EQ(IB_OK, ib_manager_engine_add(manager, ib2));
+    ASSERT_EQ(IB_OK, ib_manager_engine_release(manager, ib1));
+    EXPECT_EQ(1UL, ib_manager_engine_count(manager));
+
+    // The new engine's rules and cache are still there (second run hits
+    // the cache).
+    ASSERT_EQ(IB_OK, ib_manager_engine_acquire(manager, &ib));
+    EXPECT_EQ(ib2, ib);
+    run_ua_tx(ib);
+    run_ua_tx(ib);
+    ASSERT_EQ(IB_OK, ib_manager_engine_release(manager, ib2));
+
+    ib_manager_destroy(manager);
+}
@@ -136,6 +136,95 @@ TEST_F(OperatorTest, OperatorCallTest)
     ASSERT_EQ(IB_OK, status);
 }
 
+ib_status_t test_create_fail_fn(ib_engine_t *ib,
+                                ib_context_t *ctx,
+                                ib_mpool_t *pool,
+                                const char *data,
+                                ib_operator_inst_t *op_inst)
+{
+    if (strcmp(data, "bad") == 0) {
+        return IB_EINVAL;
+    }
+    return test_create_fn(ib, ctx, pool, data, op_inst);
+}
+
+TEST_F(OperatorTest, DeferredCreate)
+{
+    static const size_t num_ops = 16;
+    ib_operator_inst_t *op[num_ops];
+    char data[32];
+
+    ASSERT_EQ(IB_OK, ib_operator_register(ib_engine,
+                                          "test_op_defer",
+                                          IB_OP_FLAG_PHASE|IB_OP_FLAG_DEFER,
+                                          test_create_fn,
+                                          test_destroy_fn,
+                                          test_execute_fn));
+
+    ASSERT_EQ(IB_OK, ib_operator_defer_start(ib_engine));
+    for (size_t n = 0; n < num_ops; ++n) {
+        snprintf(data, sizeof(data), "data%zd", n);
+        ASSERT_EQ(IB_OK,
+                  ib_operator_inst_create_deferred(ib_engine,
+                                                   NULL,
+                                                   IB_OP_FLAG_PHASE,
+                                                   "test_op_defer",
+                                                   data,
+                                                   IB_OPINST_FLAG_NONE,
+                                                   &op[n]));
+        EXPECT_TRUE(op[n]->data == NULL);
+    }
+    ASSERT_EQ(IB_OK, ib_operator_defer_finish(ib_engine, 4));
+
+    for (size_t n = 0; n < num_ops; ++n) {
+        snprintf(data, sizeof(data), "data%zd", n);
+        ASSERT_TRUE(op[n]->data != NULL);
+        EXPECT_STREQ(data, (const char *)op[n]->data);
+    }
+
+    /* No longer configuring: created immediately. */
+    ASSERT_EQ(IB_OK,
+              ib_operator_inst_create_deferred(ib_engine,
+                                               NULL,
+                                               IB_OP_FLAG_PHASE,
+                                               "test_op_defer",
+                                               "now",
+                                               IB_OPINST_FLAG_NONE,
+                                               &op[0]));
+    EXPECT_STREQ("now", (const char *)op[0]->data);
+}
+
+TEST_F(OperatorTest, DeferredCreateError)
+{
+    ib_operator_inst_t *op;
+
+    ASSERT_EQ(IB_OK, ib_operator_register(ib_engine,
+                                          "test_op_defer_fail",
+                                          IB_OP_FLAG_PHASE|IB_OP_FLAG_DEFER,
+                                          test_create_fail_fn,
+                                          test_destroy_fn,
+                                          test_execute_fn));
+
+    ASSERT_EQ(IB_OK, ib_operator_defer_start(ib_engine));
+    ASSERT_EQ(IB_OK,
+              ib_operator_inst_create_deferred(ib_engine,
+                                               NULL,
+                                               IB_OP_FLAG_PHASE,
+                                               "test_op_defer_fail",
+                                               "good",
+                                               IB_OPINST_FLAG_NONE,
+                                               &op));
+    ASSERT_EQ(IB_OK,
+              ib_operator_inst_create_deferred(ib_engine,
+                                               NULL,
+                                               IB_OP_FLAG_PHASE,
+                                               "test_op_defer_fail",
+                                               "bad",
+                                               IB_OPINST_FLAG_NONE,
+                                               &op));
+    EXPECT_EQ(IB_EINVAL, ib_operator_defer_finish(ib_engine, -1));
+}
+
 
 class CoreOperatorsTest : public BaseFixture {
 };
@@ -411,8 +411,9 @@ TEST_F(TestIBUtilAhoCorasick, ib_ac_consume_multiple_common_prefix)
     );
     ASSERT_EQ(IB_OK, rc);
 
+    /* expensive: Expensive, Expen, pen, sive and ve */
     ASSERT_TRUE(ac_mctx.match_list);
-    ASSERT_EQ(4UL, ib_list_elements(ac_mctx.match_list));
+    ASSERT_EQ(5UL, ib_list_elements(ac_mctx.match_list));
 }
 
 /// @test Check the list of matches
@@ -547,3 +548,65 @@ TEST_F(TestIBUtilAhoCorasick, ib_ac_consume_contained_patterns)
     ASSERT_TRUE(ac_mctx.match_list != NULL);
     ASSERT_EQ(9UL, ib_list_elements(ac_mctx.match_list));
 }
+
+/// @test Patterns which end inside another pattern's branch are matched
+TEST_F(TestIBUtilAhoCorasick, ib_ac_consume_suffix_patterns)
+{
+    ib_status_t rc;
+    ib_ac_t *ac_tree = NULL;
+    ib_ac_context_t ac_mctx;
+
+    rc = ib_ac_create(&ac_tree, 0, m_pool);
+    ASSERT_EQ(IB_OK, rc);
+
+    rc = ib_ac_add_pattern(ac_tree, "abcd", callback, (void *)"abcd", 0);
+    ASSERT_EQ(IB_OK, rc);
+
+    rc = ib_ac_add_pattern(ac_tree, "bc", callback, (void *)"bc", 0);
+    ASSERT_EQ(IB_OK, rc);
+
+    rc = ib_ac_add_pattern(ac_tree, "xabq", callback, (void *)"xabq", 0);
+    ASSERT_EQ(IB_OK, rc);
+
+    rc = ib_ac_add_pattern(ac_tree, "abq", callback, (void *)"abq", 0);
+    ASSERT_EQ(IB_OK, rc);
+
+    rc = ib_ac_add_pattern(ac_tree, "bz", callback, (void *)"bz", 0);
+    ASSERT_EQ(IB_OK, rc);
+
+    rc = ib_ac_build_links(ac_tree);
+    ASSERT_EQ(IB_OK, rc);
+
+    /* "bc" ends in the middle of the "abcd" branch */
+    ib_ac_init_ctx(&ac_mctx, ac_tree);
+    rc = ib_ac_consume(
+        &ac_mctx,
+        "abce",
+        4,
+        IB_AC_FLAG_CONSUME_DOLIST | IB_AC_FLAG_CONSUME_MATCHALL,
+        m_pool
+    );
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_TRUE(ac_mctx.match_list != NULL);
+    ASSERT_EQ(1UL, ib_list_elements(ac_mctx.match_list));
+
+    /* "bz" is only reachable through the fail link of "xab" */
+    ib_ac_init_ctx(&ac_mctx, ac_tree);
+    rc = ib_ac_consume(
+        &ac_mctx,
+        "xabz",
+        4,
+        IB_AC_FLAG_CONSUME_DOLIST | IB_AC_FLAG_CONSUME_MATCHALL,
+        m_pool
+    );
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_TRUE(ac_mctx.match_list != NULL);
+    ASSERT_EQ(1UL, ib_list_elements(ac_mctx.match_list));
+
+    /* Without MATCHALL, the first match is reported */
+    ib_ac_init_ctx(&ac_mctx, ac_tree);
+    rc = ib_ac_consume(&ac_mctx, "abce", 4, IB_AC_FLAG_CONSUME_DEFAULT,
+                       m_pool);
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_EQ(1UL, ac_mctx.match_cnt);
+}
@@ -73,6 +73,7 @@ public:
             { "Key6", IB_FTYPE_NUM,     NULL,     -1, 0 },
             { "Key7", IB_FTYPE_UNUM,    NULL,     0,  0 },
             { "Key8", IB_FTYPE_UNUM,    NULL,     0,  1 },
+            { "Ref1", IB_FTYPE_NULSTR,  "%{Key1}", 0, 0 },
             { NULL,   IB_FTYPE_GENERIC, NULL,     0,  0 },
         };
         ib_status_t rc;
@@ -288,6 +289,46 @@ public:
     }
 };
 
+class TestIBUtilExpandTemplate : public TestIBUtilExpand
+{
+public:
+    ib_status_t ExpandTemplate(const char *text,
+                               const char *prefix,
+                               const char *suffix,
+                               char **result,
+                               size_t *result_len)
+    {
+        ib_expand_template_t *tmpl;
+        ib_status_t rc;
+
+        rc = ::ib_expand_compile(m_pool, text, strlen(text),
+                                 prefix, suffix, &tmpl);
+        if (rc != IB_OK) {
+            return rc;
+        }
+        return ::ib_expand_template_exec(m_pool, tmpl, IB_TRUE, m_hash,
+                                         result, result_len);
+    }
+
+    void RunTest( ib_num_t lineno,
+                  const char *text,
+                  const char *prefix,
+                  const char *suffix,
+                  const char *expected )
+    {
+        char *result;
+        size_t result_len;
+        ib_status_t rc;
+        rc = ExpandTemplate(text, prefix, suffix, &result, &result_len);
+        ASSERT_EQ(IB_OK, rc);
+        EXPECT_EQ(strlen(expected), result_len);
+        if (strcmp(result, expected) != 0) {
+            PrintError(lineno, text, prefix, suffix, expected, result);
+            ADD_FAILURE();
+        }
+    }
+};
+
 
 /* -- Tests -- */
 
@@ -428,3 +469,65 @@ TEST_F(TestIBUtilExpandTestStr, test_expand_test_str)
     RunTest(__LINE__, "text:${Key1}",     "${", "}",  IB_TRUE);
     RunTest(__LINE__, "text:%{Key2}",     "%{", "}",  IB_TRUE);
 }
+
+TEST_F(TestIBUtilExpandTemplate, test_template_errors)
+{
+    ib_expand_template_t *tmpl;
+    ib_status_t rc;
+
+    rc = ::ib_expand_compile(m_pool, "%{foo}", 6, "", "}", &tmpl);
+    ASSERT_EQ(IB_EINVAL, rc);
+    ASSERT_EQ( (ib_expand_template_t *)NULL, tmpl);
+
+    rc = ::ib_expand_compile(m_pool, "%{foo}", 6, "%{", "", &tmpl);
+    ASSERT_EQ(IB_EINVAL, rc);
+    ASSERT_EQ( (ib_expand_template_t *)NULL, tmpl);
+
+    rc = ::ib_expand_compile(m_pool, "%{foo}", 6, "%{", "}", &tmpl);
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_EQ(IB_TRUE, ::ib_expand_template_expands(tmpl));
+
+    rc = ::ib_expand_compile(m_pool, "simple", 6, "%{", "}", &tmpl);
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_EQ(IB_FALSE, ::ib_expand_template_expands(tmpl));
+}
+
+TEST_F(TestIBUtilExpandTemplate, test_template_expand)
+{
+    RunTest(__LINE__, "",                 "%{", "}",  "");
+    RunTest(__LINE__, "simple text",      "%{", "}",  "simple text");
+    RunTest(__LINE__, "text:%{Key1}",     "%{", "}",  "text:Value1");
+    RunTest(__LINE__, "text:%{Key1}",     "$(", ")",  "text:%{Key1}");
+    RunTest(__LINE__, "text:<<Key1>>",    "<<", ">>", "text:Value1");
+    RunTest(__LINE__, "%{}",              "%{", "}",  "");
+    RunTest(__LINE__, "%{}%{",            "%{", "}",  "%{");
+    RunTest(__LINE__, "%{}}",             "%{", "}",  "}");
+    RunTest(__LINE__, "%%{Key1}",         "%{", "}",  "%Value1");
+    RunTest(__LINE__, "%{%{Key1}",        "%{", "}",  "");
+    RunTest(__LINE__, "%{%{Key1}}",       "%{", "}",  "}");
+    RunTest(__LINE__, "%{Key9}",          "%{", "}",  "");
+    RunTest(__LINE__, "%{Key3}:%{Key1}",  "%{", "}",  "Value3:Value1");
+    RunTest(__LINE__, "%{Key1}:%{Key2}==%{Key3}", "%{", "}",
+             "Value1:Value2==Value3");
+    RunTest(__LINE__, "%{Key4}-%{Key6}",  "%{", "}",  "0--1");
+    RunTest(__LINE__, "%{Key4}+%{Key8}",  "%{", "}",  "0+1");
+}
+
+TEST_F(TestIBUtilExpandTemplate, test_template_no_reexpand)
+{
+    /* Values are substituted verbatim, never expanded again */
+    RunTest(__LINE__, "x%{Ref1}x",        "%{", "}",  "x%{Key1}x");
+}
+
+TEST_F(TestIBUtilExpandTemplate, test_template_many_segments)
+{
+    std::string text;
+    std::string expected;
+
+    /* More segments than fit in the on-stack scratch space */
+    for (int i = 0; i < 40; ++i) {
+        text += "-%{Key1}";
+        expected += "-Value1";
+    }
+    RunTest(__LINE__, text.c_str(), "%{", "}", expected.c_str());
+}
@@ -273,3 +273,152 @@ TEST_F(TestIBUtilField, Alias)
     ASSERT_EQ(IB_OK, rc);
     ASSERT_EQ(std::string(v), std::string(s));
 }
+
+TEST_F(TestIBUtilField, Symbol)
+{
+    ib_symtab_t       *symtab;
+    const ib_symbol_t *sym;
+    ib_bytestr_t      *bs;
+    const ib_bytestr_t *v;
+    ib_field_t        *f;
+    ib_status_t        rc;
+
+    ASSERT_EQ(IB_OK, ib_symtab_create(&symtab, m_pool));
+    ASSERT_EQ(IB_OK, ib_symtab_intern(symtab, "foo", 3, &sym));
+    ASSERT_EQ(IB_OK, ib_bytestr_dup_nulstr(&bs, m_pool, "hello"));
+
+    rc = ib_field_create_sym(&f, m_pool, sym, IB_FTYPE_BYTESTR, bs);
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_TRUE(f);
+    EXPECT_EQ(sym, f->sym);
+    EXPECT_EQ(sym->name, f->name);
+    EXPECT_EQ(3UL, f->nlen);
+
+    rc = ib_field_value(f, ib_ftype_bytestr_out(&v));
+    ASSERT_EQ(IB_OK, rc);
+    EXPECT_EQ(bs, v);
+
+    /* Fields created by name have no symbol. */
+    rc = ib_field_create(&f, m_pool, IB_FIELD_NAME("foo"), IB_FTYPE_BYTESTR,
+                         bs);
+    ASSERT_EQ(IB_OK, rc);
+    EXPECT_FALSE(f->sym);
+}
+
+static int g_lazy_calls;
+
+static ib_status_t lazy_gen(
+    const ib_field_t  *field,
+    void             **pval,
+    void              *data
+)
+{
+    ++g_lazy_calls;
+    *pval = data;
+    return IB_OK;
+}
+
+TEST_F(TestIBUtilField, Lazy)
+{
+    const char *v;
+    ib_field_t *f;
+    ib_status_t rc;
+
+    g_lazy_calls = 0;
+    rc = ib_field_create_lazy(&f, m_pool, IB_FIELD_NAME("foo"),
+                              IB_FTYPE_NULSTR, lazy_gen, (void *)"hello");
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_TRUE(f);
+    EXPECT_TRUE(ib_field_is_dynamic(f));
+    EXPECT_EQ(0, g_lazy_calls);
+
+    /* Reading generates the value once, leaving a static field. */
+    rc = ib_field_value(f, ib_ftype_nulstr_out(&v));
+    ASSERT_EQ(IB_OK, rc);
+    EXPECT_EQ(std::string("hello"), v);
+    EXPECT_FALSE(ib_field_is_dynamic(f));
+
+    rc = ib_field_value(f, ib_ftype_nulstr_out(&v));
+    ASSERT_EQ(IB_OK, rc);
+    EXPECT_EQ(std::string("hello"), v);
+    EXPECT_EQ(1, g_lazy_calls);
+
+    /* Resolving a resolved (or any non-lazy) field does nothing. */
+    ASSERT_EQ(IB_OK, ib_field_resolve_lazy(f));
+    EXPECT_EQ(1, g_lazy_calls);
+}
+
+TEST_F(TestIBUtilField, LazyResolve)
+{
+    const char *v;
+    ib_field_t *f;
+    ib_status_t rc;
+
+    g_lazy_calls = 0;
+    rc = ib_field_create_lazy(&f, m_pool, IB_FIELD_NAME("foo"),
+                              IB_FTYPE_NULSTR, lazy_gen, (void *)"hello");
+    ASSERT_EQ(IB_OK, rc);
+
+    ASSERT_EQ(IB_OK, ib_field_resolve_lazy(f));
+    EXPECT_EQ(1, g_lazy_calls);
+    EXPECT_FALSE(ib_field_is_dynamic(f));
+
+    rc = ib_field_value(f, ib_ftype_nulstr_out(&v));
+    ASSERT_EQ(IB_OK, rc);
+    EXPECT_EQ(std::string("hello"), v);
+    EXPECT_EQ(1, g_lazy_calls);
+}
+
+static ib_status_t adjust_fn(ib_field_t *field,
+                             const void *arg,
+                             size_t alen,
+                             ib_num_t adjval,
+                             void *data)
+{
+    if (alen != 3 || memcmp(arg, "key", 3) != 0) {
+        return IB_ENOENT;
+    }
+    *(ib_num_t *)data += adjval;
+    return IB_OK;
+}
+
+TEST_F(TestIBUtilField, Adjust)
+{
+    ib_num_t n = 5;
+    ib_unum_t u = 5;
+    ib_num_t counter = 0;
+    ib_field_t *f;
+    ib_status_t rc;
+
+    rc = ib_field_create(&f, m_pool, IB_FIELD_NAME("num"), IB_FTYPE_NUM,
+                         ib_ftype_num_in(&n));
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_EQ(IB_OK, ib_field_adjust_ex(f, -7, NULL, 0));
+    ASSERT_EQ(IB_OK, ib_field_value(f, ib_ftype_num_out(&n)));
+    EXPECT_EQ(-2, n);
+    EXPECT_EQ(IB_EINVAL, ib_field_adjust_ex(f, 1, "key", 3));
+
+    rc = ib_field_create(&f, m_pool, IB_FIELD_NAME("unum"), IB_FTYPE_UNUM,
+                         ib_ftype_unum_in(&u));
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_EQ(IB_OK, ib_field_adjust_ex(f, 2, NULL, 0));
+    ASSERT_EQ(IB_OK, ib_field_value(f, ib_ftype_unum_out(&u)));
+    EXPECT_EQ(7U, u);
+
+    rc = ib_field_create(&f, m_pool, IB_FIELD_NAME("str"), IB_FTYPE_NULSTR,
+                         ib_ftype_nulstr_in("x"));
+    ASSERT_EQ(IB_OK, rc);
+    EXPECT_EQ(IB_EINVAL, ib_field_adjust_ex(f, 1, NULL, 0));
+    EXPECT_EQ(IB_EINVAL, ib_field_dynamic_adjust(f, adjust_fn, &counter));
+
+    /* Dynamic fields need an adjust function, which gets the argument. */
+    rc = ib_field_create_dynamic(&f, m_pool, IB_FIELD_NAME("dyn"),
+                                 IB_FTYPE_LIST, NULL, NULL, NULL, NULL);
+    ASSERT_EQ(IB_OK, rc);
+    EXPECT_EQ(IB_EINVAL, ib_field_adjust_ex(f, 1, "key", 3));
+    ASSERT_EQ(IB_OK, ib_field_dynamic_adjust(f, adjust_fn, &counter));
+    ASSERT_EQ(IB_OK, ib_field_adjust_ex(f, 3, "key", 3));
+    ASSERT_EQ(IB_OK, ib_field_adjust_ex(f, 4, "key", 3));
+    EXPECT_EQ(IB_ENOENT, ib_field_adjust_ex(f, 4, "other", 5));
+    EXPECT_EQ(7, counter);
+}
@@ -0,0 +1,161 @@
+//////////////////////////////////////////////////////////////////////////////
+// Licensed to Qualys, Inc. (QUALYS) under one or more
+// contributor license agreements.  See the NOTICE file distributed with
+// this work for additional information regarding copyright ownership.
+// QUALYS licenses this file to You under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief IronBee &mdash; LRU Hash Test
+///
+/// @author Nick LeRoy <nleroy@qualys.com>
+//////////////////////////////////////////////////////////////////////////////
+
+#include <ironbee/lru.h>
+
+#include "ironbee_config_auto.h"
+
+#include "gtest/gtest.h"
+#include "gtest/gtest-spi.h"
+
+#include <ironbee/mpool.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static int match_num(uint32_t idx, const void *key, size_t klen, void *cbdata)
+{
+    const int *keys = (const int *)cbdata;
+
+    return (klen == sizeof(int)) && (keys[idx] == *(const int *)key);
+}
+
+TEST(TestIBUtilLRU, test_hash)
+{
+    // Reference FNV-1a values.
+    ASSERT_EQ(0x811c9dc5U, ib_lru_hash("", 0));
+    ASSERT_EQ(0xe40c292cU, ib_lru_hash("a", 1));
+    ASSERT_EQ(0xbf9cf968U, ib_lru_hash("foobar", 6));
+}
+
+TEST(TestIBUtilLRU, test_index)
+{
+    ib_lru_t lru;
+    uint32_t buckets[4];
+    ib_lru_node_t nodes[3];
+    int keys[3];
+    ib_bool_t evicted;
+    uint32_t idx;
+    int key;
+
+    ib_lru_reset(&lru, buckets, 4, nodes, 3);
+    ASSERT_EQ(0U, lru.count);
+
+    for (key = 1; key <= 3; ++key) {
+        idx = ib_lru_insert(&lru, buckets, nodes,
+                            ib_lru_hash(&key, sizeof(key)), &evicted);
+        ASSERT_FALSE(evicted);
+        keys[idx] = key;
+    }
+    ASSERT_EQ(3U, lru.count);
+
+    // Use 1, so that 2 is the least recently used.
+    key = 1;
+    idx = ib_lru_find(&lru, buckets, nodes, ib_lru_hash(&key, sizeof(key)),
+                      &key, sizeof(key), match_num, keys);
+    ASSERT_NE(IB_LRU_NIL, idx);
+    ib_lru_touch(&lru, nodes, idx);
+
+    key = 4;
+    idx = ib_lru_insert(&lru, buckets, nodes,
+                        ib_lru_hash(&key, sizeof(key)), &evicted);
+    ASSERT_TRUE(evicted);
+    ASSERT_EQ(2, keys[idx]);
+    keys[idx] = key;
+    ASSERT_EQ(3U, lru.count);
+
+    key = 2;
+    ASSERT_EQ(IB_LRU_NIL,
+              ib_lru_find(&lru, buckets, nodes,
+                          ib_lru_hash(&key, sizeof(key)),
+                          &key, sizeof(key), match_num, keys));
+    key = 3;
+    idx = ib_lru_find(&lru, buckets, nodes, ib_lru_hash(&key, sizeof(key)),
+                      &key, sizeof(key), match_num, keys);
+    ASSERT_NE(IB_LRU_NIL, idx);
+    ib_lru_remove(&lru, buckets, nodes, idx);
+    ASSERT_EQ(2U, lru.count);
+    ASSERT_EQ(IB_LRU_NIL,
+              ib_lru_find(&lru, buckets, nodes,
+                          ib_lru_hash(&key, sizeof(key)),
+                          &key, sizeof(key), match_num, keys));
+
+    // The freed node is reused before anything is evicted.
+    key = 5;
+    ib_lru_insert(&lru, buckets, nodes,
+                  ib_lru_hash(&key, sizeof(key)), &evicted);
+    ASSERT_FALSE(evicted);
+}
+
+TEST(TestIBUtilLRU, test_cache)
+{
+    ib_mpool_t *mp;
+    ib_lrucache_t *cache;
+    void *value;
+    size_t vlen;
+    uint64_t hits;
+    uint64_t misses;
+    char key[32];
+
+    ASSERT_EQ(IB_OK, ib_mpool_create(&mp, NULL, NULL));
+    ASSERT_EQ(IB_EINVAL, ib_lrucache_create(&cache, 0));
+    ASSERT_EQ(IB_OK, ib_lrucache_create(&cache, 2));
+
+    ASSERT_EQ(IB_ENOENT, ib_lrucache_get(cache, mp, "a", 1, &value, &vlen));
+    ASSERT_EQ(IB_OK, ib_lrucache_set(cache, "a", 1, "one", 4));
+    ASSERT_EQ(IB_OK, ib_lrucache_set(cache, "b", 1, "two", 4));
+    ASSERT_EQ(IB_OK, ib_lrucache_get(cache, mp, "a", 1, &value, &vlen));
+    ASSERT_EQ(4U, vlen);
+    ASSERT_STREQ("one", (const char *)value);
+
+    // Replace a value.
+    ASSERT_EQ(IB_OK, ib_lrucache_set(cache, "a", 1, "uno", 4));
+    ASSERT_EQ(IB_OK, ib_lrucache_get(cache, mp, "a", 1, &value, NULL));
+    ASSERT_STREQ("uno", (const char *)value);
+
+    // "b" is the least recently used, so "c" evicts it.
+    ASSERT_EQ(IB_OK, ib_lrucache_set(cache, "c", 1, "three", 6));
+    ASSERT_EQ(IB_ENOENT, ib_lrucache_get(cache, mp, "b", 1, &value, &vlen));
+    ASSERT_EQ(IB_OK, ib_lrucache_get(cache, mp, "c", 1, &value, &vlen));
+
+    ib_lrucache_stats(cache, &hits, &misses);
+    ASSERT_EQ(3U, hits);
+    ASSERT_EQ(2U, misses);
+    ib_lrucache_destroy(cache);
+
+    // A striped cache holds its maximum.
+    ASSERT_EQ(IB_OK, ib_lrucache_create(&cache, 1024));
+    for (int n = 0; n < 4096; ++n) {
+        snprintf(key, sizeof(key), "key%d", n);
+        ASSERT_EQ(IB_OK, ib_lrucache_set(cache, key, strlen(key), &n,
+                                         sizeof(n)));
+    }
+    snprintf(key, sizeof(key), "key%d", 4095);
+    ASSERT_EQ(IB_OK, ib_lrucache_get(cache, mp, key, strlen(key),
+                                     &value, &vlen));
+    ASSERT_EQ(4095, *(int *)value);
+    ib_lrucache_destroy(cache);
+
+    ib_mpool_destroy(mp);
+}
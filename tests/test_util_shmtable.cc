@@ -0,0 +1,172 @@
+//////////////////////////////////////////////////////////////////////////////
+// Licensed to Qualys, Inc. (QUALYS) under one or more
+// contributor license agreements.  See the NOTICE file distributed with
+// this work for additional information regarding copyright ownership.
+// QUALYS licenses this file to You under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief IronBee &mdash; Shared Memory Counter Table Test
+///
+/// @author Nick LeRoy <nleroy@qualys.com>
+//////////////////////////////////////////////////////////////////////////////
+
+#include <ironbee/shmtable.h>
+
+#include "ironbee_config_auto.h"
+
+#include "gtest/gtest.h"
+#include "gtest/gtest-spi.h"
+
+#include <ironbee/mpool.h>
+
+#include <stdexcept>
+#include <string>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+class TestIBUtilShmTable : public testing::Test
+{
+public:
+    void SetUp()
+    {
+        if (ib_mpool_create(&m_pool, NULL, NULL) != IB_OK) {
+            throw std::runtime_error("Could not initialize mpool.");
+        }
+    }
+
+    void TearDown()
+    {
+        ib_mpool_destroy(m_pool);
+    }
+
+protected:
+    ib_mpool_t *m_pool;
+};
+
+TEST_F(TestIBUtilShmTable, test_shmtable_basic)
+{
+    ib_shmtable_t *table;
+    ib_num_t val;
+    size_t count;
+    char key[IB_SHMTABLE_KEY_MAX + 1];
+
+    ASSERT_EQ(IB_EINVAL, ib_shmtable_create(&table, m_pool, 0));
+    ASSERT_EQ(IB_OK, ib_shmtable_create(&table, m_pool, 100));
+
+    ASSERT_EQ(IB_ENOENT, ib_shmtable_get(table, "a", 1, &val));
+    ASSERT_EQ(IB_OK, ib_shmtable_set(table, "a", 1, 5, 0));
+    ASSERT_EQ(IB_OK, ib_shmtable_get(table, "a", 1, &val));
+    ASSERT_EQ(5, val);
+
+    ASSERT_EQ(IB_OK, ib_shmtable_add(table, "a", 1, 2, 0, &val));
+    ASSERT_EQ(7, val);
+    ASSERT_EQ(IB_OK, ib_shmtable_add(table, "b", 1, -1, 0, &val));
+    ASSERT_EQ(-1, val);
+    ASSERT_EQ(IB_OK, ib_shmtable_add(table, "a\0b", 3, 1, 0, NULL));
+    ASSERT_EQ(IB_OK, ib_shmtable_get(table, "a", 1, &val));
+    ASSERT_EQ(7, val);
+
+    ib_shmtable_stats(table, &count, NULL);
+    ASSERT_EQ(3U, count);
+
+    ASSERT_EQ(IB_OK, ib_shmtable_remove(table, "a", 1));
+    ASSERT_EQ(IB_ENOENT, ib_shmtable_remove(table, "a", 1));
+    ASSERT_EQ(IB_ENOENT, ib_shmtable_get(table, "a", 1, &val));
+
+    memset(key, 'k', sizeof(key));
+    ASSERT_EQ(IB_EINVAL, ib_shmtable_set(table, key, sizeof(key), 1, 0));
+    ASSERT_EQ(IB_OK, ib_shmtable_set(table, key, sizeof(key) - 1, 1, 0));
+}
+
+TEST_F(TestIBUtilShmTable, test_shmtable_lru)
+{
+    ib_shmtable_t *table;
+    ib_num_t val;
+    size_t count;
+    uint64_t evictions;
+    char key[32];
+
+    // Small enough for a single stripe.
+    ASSERT_EQ(IB_OK, ib_shmtable_create(&table, m_pool, 10));
+    for (int n = 0; n < 10; ++n) {
+        snprintf(key, sizeof(key), "key%d", n);
+        ASSERT_EQ(IB_OK, ib_shmtable_set(table, key, strlen(key), n, 0));
+    }
+
+    // Use key0 so key1 is the least recently used.
+    ASSERT_EQ(IB_OK, ib_shmtable_get(table, "key0", 4, &val));
+    ASSERT_EQ(IB_OK, ib_shmtable_set(table, "new", 3, 1, 0));
+
+    ASSERT_EQ(IB_OK, ib_shmtable_get(table, "key0", 4, &val));
+    ASSERT_EQ(0, val);
+    ASSERT_EQ(IB_ENOENT, ib_shmtable_get(table, "key1", 4, &val));
+    ASSERT_EQ(IB_OK, ib_shmtable_get(table, "new", 3, &val));
+
+    ib_shmtable_stats(table, &count, &evictions);
+    ASSERT_EQ(10U, count);
+    ASSERT_EQ(1U, evictions);
+}
+
+TEST_F(TestIBUtilShmTable, test_shmtable_ttl)
+{
+    ib_shmtable_t *table;
+    ib_num_t val;
+
+    ASSERT_EQ(IB_OK, ib_shmtable_create(&table, m_pool, 10));
+    ASSERT_EQ(IB_OK, ib_shmtable_add(table, "a", 1, 1, 1, NULL));
+    ASSERT_EQ(IB_OK, ib_shmtable_set(table, "b", 1, 1, 0));
+    ASSERT_EQ(IB_OK, ib_shmtable_add(table, "a", 1, 1, 1, &val));
+    ASSERT_EQ(2, val);
+
+    usleep(1100000);
+
+    ASSERT_EQ(IB_ENOENT, ib_shmtable_get(table, "a", 1, &val));
+    ASSERT_EQ(IB_OK, ib_shmtable_get(table, "b", 1, &val));
+
+    // An expired counter starts over.
+    ASSERT_EQ(IB_OK, ib_shmtable_add(table, "a", 1, 1, 1, &val));
+    ASSERT_EQ(1, val);
+}
+
+TEST_F(TestIBUtilShmTable, test_shmtable_fork)
+{
+    ib_shmtable_t *table;
+    ib_num_t val;
+    const int procs = 4;
+    const int iterations = 1000;
+
+    ASSERT_EQ(IB_OK, ib_shmtable_create(&table, m_pool, 1000));
+
+    for (int n = 0; n < procs; ++n) {
+        pid_t pid = fork();
+        ASSERT_NE(-1, pid);
+        if (pid == 0) {
+            for (int i = 0; i < iterations; ++i) {
+                ib_shmtable_add(table, "hits", 4, 1, 0, NULL);
+            }
+            _exit(0);
+        }
+    }
+    for (int n = 0; n < procs; ++n) {
+        int status;
+        ASSERT_NE(-1, wait(&status));
+    }
+
+    ASSERT_EQ(IB_OK, ib_shmtable_get(table, "hits", 4, &val));
+    ASSERT_EQ(procs * iterations, val);
+}
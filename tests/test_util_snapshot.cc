@@ -0,0 +1,184 @@
+//////////////////////////////////////////////////////////////////////////////
+// Licensed to Qualys, Inc. (QUALYS) under one or more
+// contributor license agreements.  See the NOTICE file distributed with
+// this work for additional information regarding copyright ownership.
+// QUALYS licenses this file to You under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief IronBee &mdash; Compile Cache Snapshot Test
+///
+/// @author Nick LeRoy <nleroy@qualys.com>
+//////////////////////////////////////////////////////////////////////////////
+
+#include <ironbee/snapshot.h>
+
+#include "ironbee_config_auto.h"
+
+#include "gtest/gtest.h"
+#include "gtest/gtest-spi.h"
+
+#include <ironbee/mpool.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+class TestIBUtilSnapshot : public testing::Test
+{
+public:
+    TestIBUtilSnapshot()
+    {
+        char path[] = "/tmp/ib_snapshot_XXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0) {
+            throw std::runtime_error("Could not create temporary file.");
+        }
+        close(fd);
+        unlink(path);
+        m_path = path;
+    }
+
+    ~TestIBUtilSnapshot()
+    {
+        unlink(m_path.c_str());
+    }
+
+    /* Open the snapshot in a fresh pool, as a new engine would. */
+    ib_snapshot_t *open()
+    {
+        ib_mpool_t *mp;
+        ib_snapshot_t *snap;
+
+        if (ib_mpool_create(&mp, NULL, NULL) != IB_OK) {
+            throw std::runtime_error("Could not initialize mpool.");
+        }
+        m_pools.push_back(mp);
+        if (ib_snapshot_open(&snap, mp, m_path.c_str()) != IB_OK) {
+            throw std::runtime_error("Could not open snapshot.");
+        }
+        return snap;
+    }
+
+    void TearDown()
+    {
+        for (size_t n = 0; n < m_pools.size(); ++n) {
+            ib_mpool_destroy(m_pools[n]);
+        }
+        m_pools.clear();
+    }
+
+protected:
+    std::string m_path;
+    std::vector<ib_mpool_t *> m_pools;
+};
+
+TEST_F(TestIBUtilSnapshot, test_snapshot_roundtrip)
+{
+    ib_snapshot_t *snap;
+    const void *data;
+    size_t dlen;
+    size_t hits;
+    size_t misses;
+
+    snap = open();
+    ASSERT_EQ(0U, ib_snapshot_config_hash(snap));
+    ASSERT_EQ(IB_ENOENT, ib_snapshot_get(snap, "a", "k1", 2, &data, &dlen));
+    ASSERT_EQ(IB_OK, ib_snapshot_put(snap, "a", "k1", 2, "value1", 6));
+    ASSERT_EQ(IB_OK, ib_snapshot_put(snap, "b", "k1", 2, "other", 5));
+    ASSERT_EQ(IB_OK, ib_snapshot_put(snap, "a", "k\0z", 3, "", 0));
+    ASSERT_EQ(IB_OK, ib_snapshot_get(snap, "a", "k1", 2, &data, &dlen));
+    ASSERT_EQ(6U, dlen);
+    ASSERT_EQ(0, memcmp(data, "value1", 6));
+    ASSERT_EQ(IB_OK, ib_snapshot_commit(snap, 1234));
+
+    snap = open();
+    ASSERT_EQ(1234U, ib_snapshot_config_hash(snap));
+    ASSERT_EQ(IB_OK, ib_snapshot_get(snap, "a", "k1", 2, &data, &dlen));
+    ASSERT_EQ(6U, dlen);
+    ASSERT_EQ(0, memcmp(data, "value1", 6));
+    ASSERT_EQ(0U, (uintptr_t)data % 8);
+    ASSERT_EQ(IB_OK, ib_snapshot_get(snap, "b", "k1", 2, &data, &dlen));
+    ASSERT_EQ(5U, dlen);
+    ASSERT_EQ(0, memcmp(data, "other", 5));
+    ASSERT_EQ(IB_OK, ib_snapshot_get(snap, "a", "k\0z", 3, &data, &dlen));
+    ASSERT_EQ(0U, dlen);
+    ASSERT_EQ(IB_ENOENT, ib_snapshot_get(snap, "a", "k\0y", 3, &data, &dlen));
+    ASSERT_EQ(IB_ENOENT, ib_snapshot_get(snap, "c", "k1", 2, &data, &dlen));
+
+    ib_snapshot_stats(snap, &hits, &misses);
+    ASSERT_EQ(3U, hits);
+    ASSERT_EQ(2U, misses);
+}
+
+TEST_F(TestIBUtilSnapshot, test_snapshot_prune)
+{
+    ib_snapshot_t *snap;
+    const void *data;
+    size_t dlen;
+
+    snap = open();
+    ASSERT_EQ(IB_OK, ib_snapshot_put(snap, "a", "old", 3, "1", 1));
+    ASSERT_EQ(IB_OK, ib_snapshot_put(snap, "a", "keep", 4, "2", 1));
+    ASSERT_EQ(IB_OK, ib_snapshot_commit(snap, 1));
+
+    /* Only entries used by this run survive the next commit. */
+    snap = open();
+    ASSERT_EQ(IB_OK, ib_snapshot_get(snap, "a", "keep", 4, &data, &dlen));
+    ASSERT_EQ(IB_OK, ib_snapshot_commit(snap, 2));
+
+    snap = open();
+    ASSERT_EQ(2U, ib_snapshot_config_hash(snap));
+    ASSERT_EQ(IB_ENOENT, ib_snapshot_get(snap, "a", "old", 3, &data, &dlen));
+    ASSERT_EQ(IB_OK, ib_snapshot_get(snap, "a", "keep", 4, &data, &dlen));
+    ASSERT_EQ(0, memcmp(data, "2", 1));
+}
+
+TEST_F(TestIBUtilSnapshot, test_snapshot_invalid)
+{
+    ib_snapshot_t *snap;
+    const void *data;
+    size_t dlen;
+    FILE *fp;
+
+    fp = fopen(m_path.c_str(), "w");
+    ASSERT_TRUE(fp != NULL);
+    fputs("not a snapshot", fp);
+    fclose(fp);
+
+    snap = open();
+    ASSERT_EQ(0U, ib_snapshot_config_hash(snap));
+    ASSERT_EQ(IB_ENOENT, ib_snapshot_get(snap, "a", "k", 1, &data, &dlen));
+    ASSERT_EQ(IB_OK, ib_snapshot_put(snap, "a", "k", 1, "v", 1));
+    ASSERT_EQ(IB_OK, ib_snapshot_commit(snap, 7));
+
+    snap = open();
+    ASSERT_EQ(7U, ib_snapshot_config_hash(snap));
+    ASSERT_EQ(IB_OK, ib_snapshot_get(snap, "a", "k", 1, &data, &dlen));
+}
+
+TEST_F(TestIBUtilSnapshot, test_snapshot_hash)
+{
+    uint64_t h = IB_SNAPSHOT_HASH_INIT;
+
+    ASSERT_EQ(h, ib_snapshot_hash(h, "", 0));
+    /* FNV-1a test vector. */
+    ASSERT_EQ(0xaf63dc4c8601ec8cULL, ib_snapshot_hash(h, "a", 1));
+    ASSERT_EQ(ib_snapshot_hash(ib_snapshot_hash(h, "ab", 2), "c", 1),
+              ib_snapshot_hash(h, "abc", 3));
+}
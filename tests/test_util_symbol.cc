@@ -0,0 +1,168 @@
+//////////////////////////////////////////////////////////////////////////////
+// Licensed to Qualys, Inc. (QUALYS) under one or more
+// contributor license agreements.  See the NOTICE file distributed with
+// this work for additional information regarding copyright ownership.
+// QUALYS licenses this file to You under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief IronBee &mdash; Symbol Table Test
+///
+/// @author Nick LeRoy <nleroy@qualys.com>
+//////////////////////////////////////////////////////////////////////////////
+
+#include <ironbee/symbol.h>
+
+#include "ironbee_config_auto.h"
+
+#include "gtest/gtest.h"
+#include "gtest/gtest-spi.h"
+
+#include <ironbee/hash.h>
+#include <ironbee/mpool.h>
+
+#include <stdexcept>
+
+#include <string.h>
+
+class TestIBUtilSymbol : public testing::Test
+{
+public:
+    TestIBUtilSymbol()
+    {
+        ib_status_t rc = ib_mpool_create(&m_pool, NULL, NULL);
+        if (rc != IB_OK) {
+            throw std::runtime_error("Could not initialize mpool.");
+        }
+    }
+
+    ~TestIBUtilSymbol()
+    {
+        ib_mpool_destroy(m_pool);
+    }
+
+protected:
+    ib_mpool_t* m_pool;
+};
+
+TEST_F(TestIBUtilSymbol, test_symtab_intern)
+{
+    ib_symtab_t       *symtab = NULL;
+    const ib_symbol_t *sym1 = NULL;
+    const ib_symbol_t *sym2 = NULL;
+    const ib_symbol_t *sym3 = NULL;
+
+    ASSERT_EQ(IB_OK, ib_symtab_create(&symtab, m_pool));
+    ASSERT_TRUE(symtab);
+    EXPECT_EQ(0UL, ib_symtab_size(symtab));
+
+    ASSERT_EQ(IB_OK, ib_symtab_intern(symtab, "Request_Uri", 11, &sym1));
+    ASSERT_TRUE(sym1);
+    EXPECT_STREQ("Request_Uri", sym1->name);
+    EXPECT_EQ(11UL, sym1->nlen);
+
+    /* Same name, any case, is the same symbol. */
+    ASSERT_EQ(IB_OK, ib_symtab_intern(symtab, "request_uriXX", 11, &sym2));
+    EXPECT_EQ(sym1, sym2);
+
+    ASSERT_EQ(IB_OK, ib_symtab_intern(symtab, "request_line", 12, &sym3));
+    EXPECT_NE(sym1, sym3);
+    EXPECT_EQ(2UL, ib_symtab_size(symtab));
+
+    ASSERT_EQ(IB_OK, ib_symtab_lookup(symtab, "REQUEST_LINE", 12, &sym2));
+    EXPECT_EQ(sym3, sym2);
+    EXPECT_EQ(IB_ENOENT, ib_symtab_lookup(symtab, "args", 4, &sym2));
+}
+
+TEST_F(TestIBUtilSymbol, test_symtab_freeze)
+{
+    ib_symtab_t       *symtab = NULL;
+    const ib_symbol_t *sym1 = NULL;
+    const ib_symbol_t *sym2 = NULL;
+
+    ASSERT_EQ(IB_OK, ib_symtab_create(&symtab, m_pool));
+    ASSERT_EQ(IB_OK, ib_symtab_intern(symtab, "args", 4, &sym1));
+    ib_symtab_freeze(symtab);
+
+    ASSERT_EQ(IB_OK, ib_symtab_intern(symtab, "ARGS", 4, &sym2));
+    EXPECT_EQ(sym1, sym2);
+    EXPECT_EQ(IB_EINVAL, ib_symtab_intern(symtab, "headers", 7, &sym2));
+    EXPECT_EQ(1UL, ib_symtab_size(symtab));
+}
+
+TEST_F(TestIBUtilSymbol, test_symbol_hash)
+{
+    ib_symtab_t       *symtab = NULL;
+    const ib_symbol_t *sym = NULL;
+    const char        *name = "Request_Headers";
+
+    ASSERT_EQ(IB_OK, ib_symtab_create(&symtab, m_pool));
+    ASSERT_EQ(IB_OK, ib_symtab_intern(symtab, name, strlen(name), &sym));
+
+    for (uint32_t r = 0; r < 1000; r += 7) {
+        EXPECT_EQ(ib_hashfunc_djb2_nocase(name, strlen(name), r * 40503U),
+                  ib_symbol_hash(sym, r * 40503U));
+    }
+}
+
+TEST_F(TestIBUtilSymbol, test_hash_sym)
+{
+    ib_symtab_t       *symtab = NULL;
+    ib_hash_t         *hash = NULL;
+    const ib_symbol_t *sym1 = NULL;
+    const ib_symbol_t *sym2 = NULL;
+    const char        *value = NULL;
+
+    ASSERT_EQ(IB_OK, ib_symtab_create(&symtab, m_pool));
+    ASSERT_EQ(IB_OK, ib_symtab_intern(symtab, "Key", 3, &sym1));
+    ASSERT_EQ(IB_OK, ib_symtab_intern(symtab, "Other", 5, &sym2));
+    ASSERT_EQ(IB_OK, ib_hash_create_nocase(&hash, m_pool));
+
+    /* Set by symbol, get by name. */
+    ASSERT_EQ(IB_OK, ib_hash_set_sym(hash, sym1, (void *)"value"));
+    EXPECT_EQ(IB_OK, ib_hash_get(hash, &value, "KEY"));
+    EXPECT_STREQ("value", value);
+
+    /* Set by name, get by symbol. */
+    ASSERT_EQ(IB_OK, ib_hash_set(hash, "other", (void *)"value2"));
+    EXPECT_EQ(IB_OK, ib_hash_get_sym(hash, &value, sym2));
+    EXPECT_STREQ("value2", value);
+    EXPECT_EQ(2UL, ib_hash_size(hash));
+
+    /* Replace and remove by symbol. */
+    ASSERT_EQ(IB_OK, ib_hash_set_sym(hash, sym2, (void *)"value3"));
+    EXPECT_EQ(2UL, ib_hash_size(hash));
+    EXPECT_EQ(IB_OK, ib_hash_get_sym(hash, &value, sym2));
+    EXPECT_STREQ("value3", value);
+    ASSERT_EQ(IB_OK, ib_hash_set_sym(hash, sym1, NULL));
+    EXPECT_EQ(IB_ENOENT, ib_hash_get_sym(hash, &value, sym1));
+    EXPECT_FALSE(value);
+}
+
+TEST_F(TestIBUtilSymbol, test_hash_sym_case_sensitive)
+{
+    ib_symtab_t       *symtab = NULL;
+    ib_hash_t         *hash = NULL;
+    const ib_symbol_t *sym = NULL;
+    const char        *value = NULL;
+
+    /* Tables with other hash functions hash the symbol's name. */
+    ASSERT_EQ(IB_OK, ib_symtab_create(&symtab, m_pool));
+    ASSERT_EQ(IB_OK, ib_symtab_intern(symtab, "Key", 3, &sym));
+    ASSERT_EQ(IB_OK, ib_hash_create(&hash, m_pool));
+
+    ASSERT_EQ(IB_OK, ib_hash_set(hash, "Key", (void *)"value"));
+    EXPECT_EQ(IB_OK, ib_hash_get_sym(hash, &value, sym));
+    EXPECT_STREQ("value", value);
+}
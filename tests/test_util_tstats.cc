@@ -0,0 +1,123 @@
+//////////////////////////////////////////////////////////////////////////////
+// Licensed to Qualys, Inc. (QUALYS) under one or more
+// contributor license agreements.  See the NOTICE file distributed with
+// this work for additional information regarding copyright ownership.
+// QUALYS licenses this file to You under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief IronBee &mdash; Per-Thread Statistics Test
+///
+/// @author Nick LeRoy <nleroy@qualys.com>
+//////////////////////////////////////////////////////////////////////////////
+
+#include <ironbee/tstats.h>
+
+#include "ironbee_config_auto.h"
+
+#include "gtest/gtest.h"
+#include "gtest/gtest-spi.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+TEST(TestIBUtilTStats, test_hist)
+{
+    ib_tstats_hist_t h;
+    ib_tstats_hist_t sum;
+    char buf[64];
+
+    memset(&h, 0, sizeof(h));
+    memset(&sum, 0, sizeof(sum));
+    ASSERT_EQ(256U, sizeof(h));
+
+    // Bucket 0 holds 0 and 1 ns, bucket 3 holds 8-15 ns.
+    ib_tstats_hist_record(&h, 1);
+    ib_tstats_hist_record(&h, 8);
+    ib_tstats_hist_record(&h, 15);
+    ib_tstats_hist_record(&h, 1000);
+    ASSERT_EQ(4U, h.count);
+    ASSERT_EQ(1024U, h.total_ns);
+    ASSERT_EQ(1000U, h.max_ns);
+    ASSERT_EQ(1U, h.hist[0]);
+    ASSERT_EQ(2U, h.hist[3]);
+    ASSERT_EQ(1U, h.hist[9]);
+
+    ASSERT_EQ(2U, ib_tstats_hist_percentile(&h, 25));
+    ASSERT_EQ(16U, ib_tstats_hist_percentile(&h, 50));
+    ASSERT_EQ(1024U, ib_tstats_hist_percentile(&h, 100));
+
+    ib_tstats_hist_format(&h, buf, sizeof(buf));
+    ASSERT_STREQ("0:1 3:2 9:1", buf);
+
+    // Overflow goes to the last bucket; its percentile is the maximum.
+    ib_tstats_hist_record(&h, UINT64_C(1) << 40);
+    ASSERT_EQ(1U, h.hist[IB_TSTATS_BUCKETS - 1]);
+    ASSERT_EQ(UINT64_C(1) << 40, ib_tstats_hist_percentile(&h, 100));
+
+    ib_tstats_hist_add(&sum, &h);
+    ib_tstats_hist_add(&sum, &h);
+    ASSERT_EQ(10U, sum.count);
+    ASSERT_EQ(h.max_ns, sum.max_ns);
+    ASSERT_EQ(4U, sum.hist[3]);
+}
+
+static void *record_thread(void *arg)
+{
+    ib_tstats_t *ts = (ib_tstats_t *)arg;
+
+    for (int i = 0; i < 1000; ++i) {
+        uint64_t *block = (uint64_t *)ib_tstats_block(ts);
+        if (block == NULL) {
+            return NULL;
+        }
+        ++block[0];
+    }
+    return NULL;
+}
+
+static void sum_block(const void *block, void *cbdata)
+{
+    *(uint64_t *)cbdata += *(const uint64_t *)block;
+}
+
+TEST(TestIBUtilTStats, test_registry)
+{
+    ib_tstats_t *ts;
+    pthread_t threads[4];
+    uint64_t total = 0;
+    void *block;
+
+    ASSERT_EQ(IB_EINVAL, ib_tstats_create(&ts, 0));
+    ASSERT_EQ(IB_OK, ib_tstats_create(&ts, 100));
+
+    // A thread always gets the same, aligned block.
+    block = ib_tstats_block(ts);
+    ASSERT_TRUE(block != NULL);
+    ASSERT_EQ(block, ib_tstats_block(ts));
+    ASSERT_EQ(0U, (uintptr_t)block % IB_TSTATS_CACHE_LINE);
+
+    for (int n = 0; n < 4; ++n) {
+        ASSERT_EQ(0, pthread_create(&threads[n], NULL, record_thread, ts));
+    }
+    for (int n = 0; n < 4; ++n) {
+        ASSERT_EQ(0, pthread_join(threads[n], NULL));
+    }
+
+    ASSERT_EQ(5U, ib_tstats_foreach(ts, sum_block, &total));
+    ASSERT_EQ(4000U, total);
+
+    ib_tstats_destroy(ts);
+}
@@ -202,7 +202,7 @@ ib_status_t ib_ac_add_pattern(ib_ac_t *ac_tree,
             child->level = i;
 
             child->pattern = (char *)ib_mpool_calloc(ac_tree->mp, 1,
-                                                  i + 1);
+                                                  i + 2);
             if (child->pattern == NULL) {
                 IB_FTRACE_RET_STATUS(IB_EALLOC);
             }
@@ -282,67 +282,6 @@ static void ib_ac_link_outputs(ib_ac_t *ac_tree,
     IB_FTRACE_RET_VOID();
 }
 
-/**
- * @internal
- * Remove unuseful failure links to skip using an invalid transition
- *
- * @param ac_tree the matcher that holds the patterns
- * @param state the state where it should start (it's used recursively)
- *
- */
-static void ib_ac_unlink_unuseful(ib_ac_t *ac_tree,
-                               ib_ac_state_t *state)
-{
-    IB_FTRACE_INIT();
-    ib_ac_state_t *child = NULL;
-    ib_ac_state_t *fail_state = NULL;
-    ib_ac_state_t *found = NULL;
-
-    for (child = state->child;
-         child != NULL;
-         child = child->sibling)
-    {
-        if (child->fail == NULL ||
-            child->fail->child == NULL ||
-            child->child == NULL)
-        {
-            continue;
-        }
-
-        for (fail_state = child->fail->child;
-             fail_state != ac_tree->root && fail_state != NULL;
-             fail_state = fail_state->sibling)
-        {
-            found = ib_ac_child_for_code(child, fail_state->letter);
-            if (found == NULL) {
-                break;
-            }
-        }
-
-        if (found != NULL) {
-            /* There's no transition in the fail state that will
-             * success, since the fail state doesn't have any letter not
-             * present at the goto() of the main state. So let's
-             * change the fail state to parent. Consider that this is
-             * different to the output links (they'll still valid) */
-             child->fail = ac_tree->root;
-
-             /* printf("Removing invalid fails\n"); */
-        }
-    }
-
-    for (child = state->child;
-         child != NULL;
-         child = child->sibling)
-    {
-        if (child->child != NULL) {
-            ib_ac_unlink_unuseful(ac_tree, child);
-        }
-    }
-
-    IB_FTRACE_RET_VOID();
-}
-
 /**
  * @internal
  * Add items to the bintree for fast goto() transitions. Recursive calls
@@ -543,11 +482,22 @@ static ib_status_t ib_ac_link_fail_states(ib_ac_t *ac_tree)
 
         state->fail = ac_tree->root;
 
+        /* Follow the parent's fail links until one has a transition for
+         * this letter; the root is the last resort */
         if (state->parent != ac_tree->root) {
-            goto_state = ib_ac_child_for_code(state->parent->fail,
-                                             state->letter);
-            if (goto_state != NULL) {
-                state->fail = goto_state;
+            ib_ac_state_t *fail_state = state->parent->fail;
+
+            for (;;) {
+                goto_state = ib_ac_child_for_code(fail_state,
+                                                 state->letter);
+                if (goto_state != NULL) {
+                    state->fail = goto_state;
+                    break;
+                }
+                if (fail_state == ac_tree->root) {
+                    break;
+                }
+                fail_state = fail_state->fail;
             }
         }
 
@@ -565,10 +515,6 @@ static ib_status_t ib_ac_link_fail_states(ib_ac_t *ac_tree)
     /* Link common outputs of subpatterns present in the branch*/
     ib_ac_link_outputs(ac_tree, ac_tree->root);
 
-    /* Unlink invalid fail transitions. This guarantees that there will
-     * be at least one letter with transition in each fail state*/
-    ib_ac_unlink_unuseful(ac_tree, ac_tree->root);
-
     if (ac_tree->root->child != NULL) {
         ib_ac_build_bintree(ac_tree, ac_tree->root);
     }
@@ -667,6 +613,66 @@ static void ib_ac_do_callback(ib_ac_context_t *ac_ctx,
     IB_FTRACE_RET_VOID();
 }
 
+/**
+ * @internal
+ *
+ * Record a match of the pattern ending at the given output state
+ *
+ * @param ac_ctx the matching context
+ * @param state the output state of the matched pattern
+ * @param flags options to use while matching
+ * @param mp memory pool to use
+ *
+ * @returns Status code
+ */
+static ib_status_t ib_ac_add_match(ib_ac_context_t *ac_ctx,
+                                   ib_ac_state_t *state,
+                                   uint8_t flags,
+                                   ib_mpool_t *mp)
+{
+    IB_FTRACE_INIT();
+
+    ac_ctx->match_cnt++;
+
+    if (flags & IB_AC_FLAG_CONSUME_DOCALLBACK)
+    {
+        ib_ac_do_callback(ac_ctx, state);
+    }
+    else {
+        state->match_cnt++;
+    }
+
+    if (flags & IB_AC_FLAG_CONSUME_DOLIST)
+    {
+        ib_ac_match_t *mt = NULL;
+
+        /* If list is not created yet, create it */
+        if (ac_ctx->match_list == NULL)
+        {
+            ib_status_t rc;
+            rc = ib_list_create(&ac_ctx->match_list, mp);
+            if (rc != IB_OK) {
+                IB_FTRACE_RET_STATUS(rc);
+            }
+        }
+
+        mt = (ib_ac_match_t *)ib_mpool_calloc(mp, 1, sizeof(ib_ac_match_t));
+        if (mt == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+
+        mt->pattern = state->pattern;
+        mt->data = state->data;
+        mt->pattern_len = state->level + 1;
+        mt->offset = ac_ctx->processed - (state->level + 1);
+        mt->relative_offset = ac_ctx->current_offset - (state->level + 1);
+
+        ib_list_enqueue(ac_ctx->match_list, (void *) mt);
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
 /**
  * Search patterns of the ac_tree matcher in the given buffer using a
  * matching context. The matching context stores offsets used to process
@@ -728,102 +734,44 @@ ib_status_t ib_ac_consume(ib_ac_context_t *ac_ctx,
             fgoto = ib_ac_bintree_goto(state, letter);
 
             if (fgoto != NULL) {
+                ib_ac_state_t *outs = NULL;
+                ib_status_t rc;
+
+                state = fgoto;
+                ac_ctx->current = fgoto;
 
                 if (fgoto->flags & IB_AC_FLAG_STATE_OUTPUT) {
                     flag_match = 1;
 
-                    fgoto->match_cnt++;
-                    ac_ctx->match_cnt++;
-
-                    ac_ctx->current = fgoto;
-                    state = fgoto;
-
-                    if (flags & IB_AC_FLAG_CONSUME_DOCALLBACK)
-                    {
-                        ib_ac_do_callback(ac_ctx, state);
-                    }
-
-                    if (flags & IB_AC_FLAG_CONSUME_DOLIST)
-                    {
-                        /* If list is not created yet, create it */
-                        if (ac_ctx->match_list == NULL)
-                        {
-                            ib_status_t rc;
-                            rc = ib_list_create(&ac_ctx->match_list, mp);
-                            if (rc != IB_OK) {
-                                IB_FTRACE_RET_STATUS(rc);
-                            }
-                        }
-
-                        ib_ac_match_t *mt = NULL;
-                        mt = (ib_ac_match_t *)ib_mpool_calloc(mp,
-                                          1, sizeof(ib_ac_match_t));
-                        if (mt == NULL) {
-                            IB_FTRACE_RET_STATUS(IB_EALLOC);
-                        }
-
-                        mt->pattern = state->pattern;
-                        mt->data = state->data;
-                        mt->pattern_len = state->level + 1;
-                        mt->offset = ac_ctx->processed - (fgoto->level + 1);
-                        mt->relative_offset = ac_ctx->current_offset -
-                                                         (fgoto->level + 1);
-
-                        ib_list_enqueue(ac_ctx->match_list, (void *) mt);
+                    rc = ib_ac_add_match(ac_ctx, fgoto, flags, mp);
+                    if (rc != IB_OK) {
+                        IB_FTRACE_RET_STATUS(rc);
                     }
 
                     if ( !(flags & IB_AC_FLAG_CONSUME_MATCHALL))
                     {
                         IB_FTRACE_RET_STATUS(IB_OK);
                     }
+                }
 
-                    ib_ac_state_t *outs = NULL;
+                /* These are subpatterns of the current walked branch that
+                 * are present as independent patterns as well in the tree.
+                 * They have to be reported whether or not the current
+                 * state is itself an output. */
+                for (outs = fgoto->outputs;
+                     outs != NULL;
+                     outs = outs->outputs)
+                {
+                    flag_match = 1;
+
+                    rc = ib_ac_add_match(ac_ctx, outs, flags, mp);
+                    if (rc != IB_OK) {
+                        IB_FTRACE_RET_STATUS(rc);
+                    }
 
-                    for (outs = state->outputs;
-                         outs != NULL;
-                         outs = outs->outputs)
+                    if ( !(flags & IB_AC_FLAG_CONSUME_MATCHALL))
                     {
-                        /* This are subpatterns of the current walked branch
-                         * that are present as independent patterns as well
-                         * in the tree */
-
-                        outs->match_cnt++;
-                        ac_ctx->match_cnt++;
-
-                        if (flags & IB_AC_FLAG_CONSUME_DOCALLBACK)
-                        {
-                            ib_ac_do_callback(ac_ctx, outs);
-                        }
-
-                        if (flags & IB_AC_FLAG_CONSUME_DOLIST)
-                        {
-                            /* If list is not created yet, create it */
-                            if (ac_ctx->match_list == NULL)
-                            {
-                                ib_status_t rc;
-                                rc = ib_list_create(&ac_ctx->match_list, mp);
-                                if (rc != IB_OK) {
-                                    IB_FTRACE_RET_STATUS(rc);
-                                }
-                            }
-
-                            ib_ac_match_t *mt = NULL;
-                            mt = (ib_ac_match_t *)ib_mpool_calloc(mp,
-                                              1, sizeof(ib_ac_match_t));
-                            if (mt == NULL) {
-                                IB_FTRACE_RET_STATUS(IB_EALLOC);
-                            }
-
-                            mt->pattern = outs->pattern;
-                            mt->data = state->data;
-                            mt->pattern_len = outs->level + 1;
-                            mt->offset = ac_ctx->processed - (outs->level + 1);
-                            mt->relative_offset = ac_ctx->current_offset -
-                                                         (outs->level + 1);
-
-                            ib_list_enqueue(ac_ctx->match_list,
-                                            (void *) mt);
-                        }
+                        IB_FTRACE_RET_STATUS(IB_OK);
                     }
                 }
             }
@@ -77,3 +77,31 @@ ib_time_t ib_clock_get_time(void) {
 #endif
     return us;
 }
+
+uint64_t ib_clock_get_time_ns(void) {
+    uint64_t ns;
+
+#ifdef IB_CLOCK
+    struct timespec ts;
+
+    clock_gettime(IB_CLOCK, &ts);
+    ns = ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    ns = ((uint64_t)tv.tv_sec * 1000000000) + (tv.tv_usec * 1000);
+#endif
+    return ns;
+}
+
+uint64_t ib_clock_get_time_ns_coarse(void) {
+#ifdef CLOCK_MONOTONIC_COARSE
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+#else
+    return ib_clock_get_time_ns();
+#endif
+}
@@ -25,13 +25,52 @@
 
 #include <ironbee/debug.h>
 
+#include <ironbee/clock.h>
+#include <ironbee/lock.h>
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
+#include <pthread.h>
 
 #ifdef IB_DEBUG
 
 static FILE *ib_trace_fh;
 
+int ib_trace_ring_mode = 0;
+
+/**
+ * @internal
+ * Per-thread event ring.
+ *
+ * Only the owning thread writes to a ring, so recording takes no locks.
+ */
+typedef struct trace_ring_t trace_ring_t;
+struct trace_ring_t {
+    ib_trace_event_t  *events;        /**< Events (trace_rings.size) */
+    volatile uint64_t  head;          /**< Events ever recorded */
+    int                enabled;       /**< Recording on this thread? */
+    uint64_t           thread;        /**< Thread number */
+    trace_ring_t      *next;          /**< Next ring in registry */
+};
+
+/**
+ * @internal
+ * Ring backend state.
+ */
+static struct {
+    char              *fn;            /**< Output file */
+    uint64_t           size;          /**< Events per ring (power of 2) */
+    pthread_key_t      key;           /**< Key for per-thread ring */
+    ib_lock_t          lock;          /**< Protects sites and rings */
+    ib_trace_site_t  **sites;         /**< Sites, by ID - 1 */
+    uint32_t           nsites;        /**< Number of sites */
+    uint32_t           asites;        /**< Allocated size of sites */
+    trace_ring_t      *rings;         /**< Registry of rings */
+    uint64_t           nthreads;      /**< Number of rings */
+} trace_rings;
+
 /* --Tracing -- */
 
 void ib_trace_init(const char *fn)
@@ -147,5 +186,213 @@ void ib_trace_status(const char *file,
     fflush(ib_trace_fh);
 }
 
+/* -- Ring Tracing -- */
+
+void ib_trace_ring_init(const char *fn, size_t nevents)
+{
+    char *copy = strdup(fn);
+
+    if (copy == NULL) {
+        return;
+    }
+
+    if (ib_trace_ring_mode) {
+        ib_lock_lock(&trace_rings.lock);
+        free(trace_rings.fn);
+        trace_rings.fn = copy;
+        ib_lock_unlock(&trace_rings.lock);
+        return;
+    }
+
+    if ( (ib_lock_init(&trace_rings.lock) != IB_OK) ||
+         (pthread_key_create(&trace_rings.key, NULL) != 0) )
+    {
+        free(copy);
+        return;
+    }
+    trace_rings.fn = copy;
+    trace_rings.size = 1024;
+    while (trace_rings.size < nevents) {
+        trace_rings.size <<= 1;
+    }
+
+    ib_trace_ring_mode = 1;
+}
+
+void ib_trace_ring_enable(int on)
+{
+    trace_ring_t *ring;
+
+    if (! ib_trace_ring_mode) {
+        return;
+    }
+
+    ring = (trace_ring_t *)pthread_getspecific(trace_rings.key);
+    if ( (ring == NULL) && on) {
+        ring = (trace_ring_t *)calloc(1, sizeof(*ring));
+        if (ring == NULL) {
+            return;
+        }
+        ring->events = (ib_trace_event_t *)
+            malloc(trace_rings.size * sizeof(*ring->events));
+        if (ring->events == NULL) {
+            free(ring);
+            return;
+        }
+
+        /* Rings outlive their threads so they can still be flushed. */
+        ib_lock_lock(&trace_rings.lock);
+        ring->thread = ++trace_rings.nthreads;
+        ring->next = trace_rings.rings;
+        trace_rings.rings = ring;
+        ib_lock_unlock(&trace_rings.lock);
+
+        pthread_setspecific(trace_rings.key, ring);
+    }
+
+    if (ring != NULL) {
+        ring->enabled = on;
+    }
+}
+
+/**
+ * @internal
+ * Assign a site its ID.
+ *
+ * @param site Trace site
+ */
+static void trace_site_register(ib_trace_site_t *site)
+{
+    ib_lock_lock(&trace_rings.lock);
+    if (site->id == 0) {
+        if (trace_rings.nsites == trace_rings.asites) {
+            uint32_t asites = trace_rings.asites ? trace_rings.asites * 2 : 256;
+            ib_trace_site_t **sites = (ib_trace_site_t **)
+                realloc(trace_rings.sites, asites * sizeof(*sites));
+            if (sites == NULL) {
+                ib_lock_unlock(&trace_rings.lock);
+                return;
+            }
+            trace_rings.sites = sites;
+            trace_rings.asites = asites;
+        }
+        trace_rings.sites[trace_rings.nsites++] = site;
+        site->id = trace_rings.nsites;
+    }
+    ib_lock_unlock(&trace_rings.lock);
+}
+
+/**
+ * @internal
+ * Record an event to the calling thread's ring, if it is enabled.
+ *
+ * @param site Trace site
+ * @param flags Zero or IB_TRACE_EVENT_RETURN
+ * @param value Returned value
+ */
+static inline void trace_record(ib_trace_site_t *site,
+                                uint32_t flags,
+                                int64_t value)
+{
+    trace_ring_t *ring;
+    ib_trace_event_t *ev;
+
+    ring = (trace_ring_t *)pthread_getspecific(trace_rings.key);
+    if ( (ring == NULL) || (! ring->enabled) ) {
+        return;
+    }
+    if (site->id == 0) {
+        trace_site_register(site);
+        if (site->id == 0) {
+            return;
+        }
+    }
+
+    ev = &ring->events[ring->head & (trace_rings.size - 1)];
+    ev->ns = ib_clock_get_time_ns();
+    ev->site = site->id | flags;
+    ev->value = (int32_t)value;
+    ring->head = ring->head + 1;
+}
+
+void ib_trace_enter(ib_trace_site_t *site)
+{
+    trace_record(site, 0, 0);
+}
+
+void ib_trace_leave(ib_trace_site_t *site, int64_t value)
+{
+    trace_record(site, IB_TRACE_EVENT_RETURN, value);
+}
+
+ib_status_t ib_trace_ring_flush(void)
+{
+    ib_trace_file_header_t hdr;
+    const trace_ring_t *ring;
+    FILE *fp;
+    uint32_t n;
+    int ok = 1;
+
+    if (! ib_trace_ring_mode) {
+        return IB_OK;
+    }
+
+    ib_lock_lock(&trace_rings.lock);
+
+    fp = fopen(trace_rings.fn, "wb");
+    if (fp == NULL) {
+        ib_lock_unlock(&trace_rings.lock);
+        return IB_EOTHER;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, IB_TRACE_RING_MAGIC, sizeof(hdr.magic));
+    hdr.version = IB_TRACE_RING_VERSION;
+    hdr.nsites = trace_rings.nsites;
+    hdr.nthreads = (uint32_t)trace_rings.nthreads;
+    ok &= (fwrite(&hdr, sizeof(hdr), 1, fp) == 1);
+
+    for (n = 0; n < trace_rings.nsites; ++n) {
+        const ib_trace_site_t *site = trace_rings.sites[n];
+        ib_trace_file_site_t rec;
+
+        rec.id = site->id;
+        rec.line = (uint32_t)site->line;
+        rec.flen = (uint32_t)strlen(site->file);
+        rec.nlen = (uint32_t)strlen(site->func);
+        ok &= (fwrite(&rec, sizeof(rec), 1, fp) == 1);
+        ok &= (fwrite(site->file, 1, rec.flen, fp) == rec.flen);
+        ok &= (fwrite(site->func, 1, rec.nlen, fp) == rec.nlen);
+    }
+
+    for (ring = trace_rings.rings; ring != NULL; ring = ring->next) {
+        ib_trace_file_thread_t rec;
+        uint64_t head = ring->head;
+        uint64_t start;
+        uint64_t first;
+
+        rec.thread = ring->thread;
+        rec.nevents = (head < trace_rings.size) ? head : trace_rings.size;
+        rec.dropped = head - rec.nevents;
+        ok &= (fwrite(&rec, sizeof(rec), 1, fp) == 1);
+
+        /* Oldest first: from the wrap point to the end, then the rest. */
+        start = (head - rec.nevents) & (trace_rings.size - 1);
+        first = trace_rings.size - start;
+        if (first > rec.nevents) {
+            first = rec.nevents;
+        }
+        ok &= (fwrite(ring->events + start, sizeof(*ring->events),
+                      first, fp) == first);
+        ok &= (fwrite(ring->events, sizeof(*ring->events),
+                      rec.nevents - first, fp) == rec.nevents - first);
+    }
+
+    ok &= (fclose(fp) == 0);
+    ib_lock_unlock(&trace_rings.lock);
+
+    return ok ? IB_OK : IB_EOTHER;
+}
+
 #endif /* IB_DEBUG */
 
@@ -491,3 +491,295 @@ ib_status_t ib_expand_test_str_ex(const char *str,
     *result = IB_TRUE;
     IB_FTRACE_RET_STATUS(IB_OK);
 }
+
+/**
+ * Number of segments expanded using stack storage; larger templates
+ * allocate their scratch space from the memory pool.
+ */
+#define TEMPLATE_STACK_SEGS 16
+
+/**
+ * A single segment of a compiled template.
+ */
+typedef struct {
+    const char *ptr;            /**< Literal text or name */
+    size_t      len;            /**< Length of @a ptr */
+    ib_bool_t   is_name;        /**< IB_TRUE if @a ptr is a name to expand */
+} template_seg_t;
+
+/**
+ * Compiled expansion template.
+ */
+struct ib_expand_template_t {
+    template_seg_t *segs;       /**< Array of segments */
+    size_t          nsegs;      /**< Number of segments */
+    size_t          nnames;     /**< Number of name segments */
+    size_t          lit_len;    /**< Total length of literal segments */
+};
+
+/**
+ * Value of an expanded segment.
+ */
+typedef struct {
+    const char *ptr;            /**< Value */
+    size_t      len;            /**< Length of @a ptr */
+    char        numbuf[24];     /**< Storage for numbers converted to text */
+} template_val_t;
+
+/**
+ * Resolve a name segment to its value.
+ * @internal
+ *
+ * Names not found in the hash, and fields of types that cannot be
+ * converted, resolve to an empty value.
+ *
+ * @param[in] hash Hash to lookup the name in
+ * @param[in] seg Name segment
+ * @param[out] val Resulting value
+ *
+ * @returns status code
+ */
+static ib_status_t template_resolve(ib_hash_t *hash,
+                                    const template_seg_t *seg,
+                                    template_val_t *val)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+    ib_field_t *f;
+
+    val->ptr = "";
+    val->len = 0;
+
+    if (seg->len == 0) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    rc = ib_hash_get_ex(hash, &f, (void *)seg->ptr, seg->len);
+    if (rc == IB_ENOENT) {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    else if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    if (f->type == IB_FTYPE_NULSTR) {
+        const char *s;
+        rc = ib_field_value(f, ib_ftype_nulstr_out(&s));
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        val->ptr = s;
+        val->len = strlen(s);
+    }
+    else if (f->type == IB_FTYPE_BYTESTR) {
+        const ib_bytestr_t *bs;
+        rc = ib_field_value(f, ib_ftype_bytestr_out(&bs));
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        val->ptr = (const char *)ib_bytestr_const_ptr(bs);
+        val->len = ib_bytestr_length(bs);
+    }
+    else if (f->type == IB_FTYPE_NUM) {
+        ib_num_t n;
+        rc = ib_field_value(f, ib_ftype_num_out(&n));
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        snprintf(val->numbuf, sizeof(val->numbuf), "%"PRId64, n);
+        val->ptr = val->numbuf;
+        val->len = strlen(val->numbuf);
+    }
+    else if (f->type == IB_FTYPE_UNUM) {
+        ib_unum_t n;
+        rc = ib_field_value(f, ib_ftype_unum_out(&n));
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        snprintf(val->numbuf, sizeof(val->numbuf), "%"PRIu64, n);
+        val->ptr = val->numbuf;
+        val->len = strlen(val->numbuf);
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/*
+ * Compile a string into an expansion template.  See expand.h.
+ */
+ib_status_t ib_expand_compile(ib_mpool_t *mp,
+                              const char *str,
+                              size_t str_len,
+                              const char *prefix,
+                              const char *suffix,
+                              ib_expand_template_t **tmpl)
+{
+    IB_FTRACE_INIT();
+    ib_expand_template_t *t;
+    size_t pre_len;
+    size_t suf_len;
+    size_t maxsegs;
+    const char *buf = str;
+    size_t buflen = str_len;
+
+    assert(mp != NULL);
+    assert(str != NULL);
+    assert(prefix != NULL);
+    assert(suffix != NULL);
+    assert(tmpl != NULL);
+
+    *tmpl = NULL;
+
+    if ( (*prefix == '\0') || (*suffix == '\0') ) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+    pre_len = strlen(prefix);
+    suf_len = strlen(suffix);
+
+    t = (ib_expand_template_t *)ib_mpool_calloc(mp, 1, sizeof(*t));
+    if (t == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    /* Each reference yields at most two segments, plus a trailing literal */
+    maxsegs = ((str_len / (pre_len + suf_len)) * 2) + 1;
+    t->segs = (template_seg_t *)ib_mpool_alloc(mp, maxsegs * sizeof(*t->segs));
+    if (t->segs == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    while (buflen > 0) {
+        const char *pre;
+        const char *post = NULL;
+        size_t pre_off;
+
+        pre = ib_strstr_ex(buf, buflen, prefix, pre_len);
+        if (pre != NULL) {
+            pre_off = pre - buf;
+            post = ib_strstr_ex(pre + pre_len,
+                                buflen - (pre_off + pre_len),
+                                suffix,
+                                suf_len);
+        }
+        if (post == NULL) {
+            break;
+        }
+
+        /* Literal block up to the prefix */
+        if (pre > buf) {
+            template_seg_t *seg = &(t->segs[t->nsegs++]);
+            seg->ptr = buf;
+            seg->len = pre - buf;
+            seg->is_name = IB_FALSE;
+            t->lit_len += seg->len;
+        }
+
+        /* The name between prefix and suffix */
+        {
+            template_seg_t *seg = &(t->segs[t->nsegs++]);
+            seg->ptr = pre + pre_len;
+            seg->len = post - seg->ptr;
+            seg->is_name = IB_TRUE;
+            ++t->nnames;
+        }
+
+        buflen -= (post + suf_len) - buf;
+        buf = post + suf_len;
+    }
+
+    /* Trailing literal */
+    if (buflen > 0) {
+        template_seg_t *seg = &(t->segs[t->nsegs++]);
+        seg->ptr = buf;
+        seg->len = buflen;
+        seg->is_name = IB_FALSE;
+        t->lit_len += seg->len;
+    }
+    assert(t->nsegs <= maxsegs);
+
+    *tmpl = t;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/*
+ * Expand a compiled template.  See expand.h.
+ */
+ib_status_t ib_expand_template_exec(ib_mpool_t *mp,
+                                    const ib_expand_template_t *tmpl,
+                                    ib_bool_t nul,
+                                    ib_hash_t *hash,
+                                    char **result,
+                                    size_t *result_len)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+    template_val_t stack_vals[TEMPLATE_STACK_SEGS];
+    template_val_t *vals = stack_vals;
+    size_t total;
+    size_t n;
+    char *buf;
+    char *p;
+
+    assert(mp != NULL);
+    assert(tmpl != NULL);
+    assert(hash != NULL);
+    assert(result != NULL);
+    assert(result_len != NULL);
+
+    *result = NULL;
+    *result_len = 0;
+
+    if (tmpl->nsegs > TEMPLATE_STACK_SEGS) {
+        vals = (template_val_t *)
+            ib_mpool_alloc(mp, tmpl->nsegs * sizeof(*vals));
+        if (vals == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+    }
+
+    /* First pass: resolve the names and size the result */
+    total = tmpl->lit_len;
+    for (n = 0; n < tmpl->nsegs; ++n) {
+        const template_seg_t *seg = &(tmpl->segs[n]);
+        if (seg->is_name == IB_TRUE) {
+            rc = template_resolve(hash, seg, &vals[n]);
+            if (rc != IB_OK) {
+                IB_FTRACE_RET_STATUS(rc);
+            }
+            total += vals[n].len;
+        }
+        else {
+            vals[n].ptr = seg->ptr;
+            vals[n].len = seg->len;
+        }
+    }
+
+    /* Second pass: copy everything into a single buffer (the extra byte
+     * holds the NUL if requested, and avoids a zero sized allocation) */
+    buf = (char *)ib_mpool_alloc(mp, total + 1);
+    if (buf == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    p = buf;
+    for (n = 0; n < tmpl->nsegs; ++n) {
+        memcpy(p, vals[n].ptr, vals[n].len);
+        p += vals[n].len;
+    }
+    if (nul == IB_TRUE) {
+        *p = '\0';
+    }
+
+    *result = buf;
+    *result_len = total;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+/*
+ * Determine if a compiled template has names to expand.  See expand.h.
+ */
+ib_bool_t ib_expand_template_expands(const ib_expand_template_t *tmpl)
+{
+    assert(tmpl != NULL);
+
+    return (tmpl->nnames != 0) ? IB_TRUE : IB_FALSE;
+}
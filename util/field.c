@@ -229,6 +229,57 @@ failed:
     IB_FTRACE_RET_STATUS(rc);
 }
 
+ib_status_t ib_field_create_sym(
+    ib_field_t        **pf,
+    ib_mpool_t         *mp,
+    const ib_symbol_t  *sym,
+    ib_ftype_t          type,
+    void               *mutable_in_pval
+)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    assert(sym != NULL);
+
+    /* Allocate the field structure; the name is the symbol's. */
+    *pf = (ib_field_t *)ib_mpool_alloc(mp, sizeof(**pf));
+    if (*pf == NULL) {
+        rc = IB_EALLOC;
+        goto failed;
+    }
+    (*pf)->mp = mp;
+    (*pf)->type = type;
+    (*pf)->tfn = NULL;
+    (*pf)->name = sym->name;
+    (*pf)->nlen = sym->nlen;
+    (*pf)->sym = sym;
+
+    (*pf)->val = (ib_field_val_t *)ib_mpool_calloc(mp, 1, sizeof(*((*pf)->val)));
+    if ((*pf)->val == NULL) {
+        rc = IB_EALLOC;
+        goto failed;
+    }
+
+    /* Point to internal memory */
+    (*pf)->val->pval = &((*pf)->val->u);
+
+    rc = ib_field_setv_no_copy((*pf), mutable_in_pval);
+    if (rc != IB_OK) {
+        goto failed;
+    }
+
+    ib_field_util_log_debug("FIELD_CREATE_SYM", (*pf));
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+
+failed:
+    /* Make sure everything is cleaned up on failure. */
+    *pf = NULL;
+
+    IB_FTRACE_RET_STATUS(rc);
+}
+
 ib_status_t ib_field_create_alias(
     ib_field_t **pf,
     ib_mpool_t  *mp,
@@ -251,6 +302,7 @@ ib_status_t ib_field_create_alias(
     (*pf)->mp = mp;
     (*pf)->type = type;
     (*pf)->tfn = NULL;
+    (*pf)->sym = NULL;
 
     /* Copy the name. */
     (*pf)->nlen = nlen;
@@ -306,6 +358,122 @@ ib_status_t ib_field_create_dynamic(
     IB_FTRACE_RET_STATUS(rc);
 }
 
+/**
+ * Lazy field generator and its data.
+ * @internal
+ */
+typedef struct {
+    ib_field_gen_fn_t  fn_gen;        /**< Generator */
+    void              *cbdata_gen;    /**< Generator data */
+} field_lazy_t;
+
+/**
+ * Getter of a lazy field which has not been resolved.
+ * @internal
+ *
+ * Resolves the field, then reads it as any static field.
+ */
+static ib_status_t field_lazy_get(
+    const ib_field_t *f,
+    void             *out_pval,
+    const void       *arg,
+    size_t            alen,
+    void             *data
+)
+{
+    IB_FTRACE_INIT();
+    ib_status_t rc;
+
+    /* The field is only const to the reader; resolving caches its value. */
+    rc = ib_field_resolve_lazy((ib_field_t *)f);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    IB_FTRACE_RET_STATUS(ib_field_value_ex(f, out_pval, arg, alen));
+}
+
+ib_status_t ib_field_create_lazy(
+    ib_field_t        **pf,
+    ib_mpool_t         *mp,
+    const char         *name,
+    size_t              nlen,
+    ib_ftype_t          type,
+    ib_field_gen_fn_t   fn_gen,
+    void               *cbdata_gen
+)
+{
+    IB_FTRACE_INIT();
+    field_lazy_t *lazy;
+    ib_status_t rc;
+
+    assert(fn_gen != NULL);
+
+    lazy = (field_lazy_t *)ib_mpool_alloc(mp, sizeof(*lazy));
+    if (lazy == NULL) {
+        *pf = NULL;
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    lazy->fn_gen = fn_gen;
+    lazy->cbdata_gen = cbdata_gen;
+
+    rc = ib_field_create_dynamic(pf, mp, name, nlen, type,
+                                 field_lazy_get, lazy,
+                                 NULL, NULL);
+
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+ib_status_t ib_field_dynamic_adjust(
+    ib_field_t           *f,
+    ib_field_adjust_fn_t  fn_adjust,
+    void                 *cbdata_adjust
+)
+{
+    IB_FTRACE_INIT();
+
+    if (! ib_field_is_dynamic(f)) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    f->val->fn_adjust     = fn_adjust;
+    f->val->cbdata_adjust = cbdata_adjust;
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_field_resolve_lazy(
+    ib_field_t *f
+)
+{
+    IB_FTRACE_INIT();
+    const field_lazy_t *lazy;
+    void *val = NULL;
+    ib_status_t rc;
+
+    if (   (! ib_field_is_dynamic(f))
+        || (f->val->fn_get != field_lazy_get))
+    {
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    lazy = (const field_lazy_t *)f->val->cbdata_get;
+    rc = lazy->fn_gen(f, &val, lazy->cbdata_gen);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    rc = ib_field_make_static(f);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    rc = ib_field_setv_no_copy(f, val);
+
+    ib_field_util_log_debug("FIELD_RESOLVE_LAZY", f);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
 ib_status_t ib_field_alias(
     ib_field_t **pf,
     ib_mpool_t  *mp,
@@ -361,6 +529,10 @@ ib_status_t ib_field_copy(
             src->val->fn_set,
             src->val->cbdata_set
         );
+        if (rc == IB_OK) {
+            (*pf)->val->fn_adjust     = src->val->fn_adjust;
+            (*pf)->val->cbdata_adjust = src->val->cbdata_adjust;
+        }
     }
     else {
         switch (src->type) {
@@ -521,6 +693,8 @@ ib_status_t ib_field_make_static(
     f->val->fn_set     = NULL;
     f->val->cbdata_get = NULL;
     f->val->cbdata_set = NULL;
+    f->val->fn_adjust  = NULL;
+    f->val->cbdata_adjust = NULL;
 
     ib_field_util_log_debug("FIELD_MAKE_STATIC", f);
 
@@ -671,6 +845,45 @@ failed:
     IB_FTRACE_RET_STATUS(rc);
 }
 
+ib_status_t ib_field_adjust_ex(
+    ib_field_t *f,
+    ib_num_t    adjval,
+    const void *arg,
+    size_t      alen
+)
+{
+    IB_FTRACE_INIT();
+
+    if (ib_field_is_dynamic(f)) {
+        if (f->val->fn_adjust == NULL) {
+            IB_FTRACE_RET_STATUS(IB_EINVAL);
+        }
+        IB_FTRACE_RET_STATUS(
+            f->val->fn_adjust(f, arg, alen, adjval, f->val->cbdata_adjust)
+        );
+    }
+
+    if (arg != NULL) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    /// @todo Check for overflow
+    switch (f->type) {
+    case IB_FTYPE_NUM:
+        *(ib_num_t *)(f->val->pval) += adjval;
+        break;
+    case IB_FTYPE_UNUM:
+        *(ib_unum_t *)(f->val->pval) += (ib_unum_t)adjval;
+        break;
+    default:
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    ib_field_util_log_debug("FIELD_ADJUST", f);
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
 ib_status_t ib_field_value_ex(
     const ib_field_t *f,
     void             *out_pval,
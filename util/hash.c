@@ -165,6 +165,47 @@ static ib_hash_entry_t *ib_hash_find_htentry(
      uint32_t         hash_value
 );
 
+/**
+ * Hash value of the interned name @a sym in @a hash.
+ * @internal
+ *
+ * Uses the symbol's precomputed hash when @a hash uses
+ * ib_hashfunc_djb2_nocase().
+ *
+ * @param[in] hash Hash table.
+ * @param[in] sym  Symbol.
+ *
+ * @returns Hash value of the symbol's name.
+ */
+static uint32_t ib_hash_sym_value(
+    const ib_hash_t   *hash,
+    const ib_symbol_t *sym
+);
+
+/**
+ * Set value of @a key, whose hash is @a hash_value, in @a hash.
+ * @internal
+ *
+ * @sa ib_hash_set_ex()
+ *
+ * @param[in,out] hash       Hash table.
+ * @param[in]     key        Key.
+ * @param[in]     key_length Length of @a key
+ * @param[in]     hash_value Hash value of @a key.
+ * @param[in]     value      Value.
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EALLOC if @a hash attempted to grow and failed.
+ */
+static ib_status_t ib_hash_set_hashed(
+    ib_hash_t  *hash,
+    const void *key,
+    size_t      key_length,
+    uint32_t    hash_value,
+    void       *value
+);
+
 /**
  * Return iterator pointing to first entry of @a hash.
  * @internal
@@ -247,9 +288,16 @@ ib_hash_entry_t *ib_hash_find_htentry(
     {
         if (
             current_entry->hash_value == hash_value &&
-            hash->equal_predicate(
-                key,                key_length,
-                current_entry->key, current_entry->key_length
+            (
+                /* Same (e.g. interned) key needs no comparison. */
+                (
+                    current_entry->key == key &&
+                    current_entry->key_length == key_length
+                ) ||
+                hash->equal_predicate(
+                    key,                key_length,
+                    current_entry->key, current_entry->key_length
+                )
             )
         ) {
             IB_FTRACE_RET_PTR(ib_hash_entry_t, current_entry);
@@ -297,6 +345,19 @@ ib_status_t ib_hash_find_entry(
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
+uint32_t ib_hash_sym_value(
+    const ib_hash_t   *hash,
+    const ib_symbol_t *sym
+) {
+    assert(hash != NULL);
+    assert(sym  != NULL);
+
+    if (hash->hash_function == ib_hashfunc_djb2_nocase) {
+        return ib_symbol_hash(sym, hash->randomizer);
+    }
+    return hash->hash_function(sym->name, sym->nlen, hash->randomizer);
+}
+
 ib_hash_iterator_t ib_hash_first(
     const ib_hash_t *hash
 ) {
@@ -630,6 +691,36 @@ ib_status_t ib_hash_get(
     ));
 }
 
+ib_status_t ib_hash_get_sym(
+    const ib_hash_t   *hash,
+    void              *value,
+    const ib_symbol_t *sym
+) {
+    IB_FTRACE_INIT();
+
+    assert(value != NULL);
+    assert(hash  != NULL);
+    assert(sym   != NULL);
+
+    ib_hash_entry_t *current_entry = NULL;
+    uint32_t         hash_value    = ib_hash_sym_value(hash, sym);
+
+    current_entry = ib_hash_find_htentry(
+        hash,
+        hash->slots[hash_value & hash->max_slot],
+        sym->name,
+        sym->nlen,
+        hash_value
+    );
+    if (current_entry == NULL) {
+        *(void **)value = NULL;
+        IB_FTRACE_RET_STATUS(IB_ENOENT);
+    }
+
+    *(void **)value = current_entry->value;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
 ib_status_t ib_hash_get_all(
     const ib_hash_t *hash,
     ib_list_t       *list
@@ -652,10 +743,11 @@ ib_status_t ib_hash_get_all(
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
-ib_status_t ib_hash_set_ex(
+ib_status_t ib_hash_set_hashed(
     ib_hash_t  *hash,
     const void *key,
     size_t      key_length,
+    uint32_t    hash_value,
     void       *value
 ) {
     IB_FTRACE_INIT();
@@ -663,7 +755,6 @@ ib_status_t ib_hash_set_ex(
     assert(hash != NULL);
     assert(key  != NULL);
 
-    uint32_t     hash_value = 0;
     size_t       slot_index = 0;
     int          found      = 0;
 
@@ -671,7 +762,6 @@ ib_status_t ib_hash_set_ex(
     /* Points to pointer that points to current_entry */
     ib_hash_entry_t **current_entry_handle  = NULL;
 
-    hash_value = hash->hash_function(key, key_length, hash->randomizer);
     slot_index = (hash_value & hash->max_slot);
 
     current_entry_handle = &hash->slots[slot_index];
@@ -680,9 +770,15 @@ ib_status_t ib_hash_set_ex(
         current_entry = *current_entry_handle;
         if (
             current_entry->hash_value == hash_value &&
-            hash->equal_predicate(
-               current_entry->key, current_entry->key_length,
-               key,                key_length
+            (
+                (
+                    current_entry->key == key &&
+                    current_entry->key_length == key_length
+                ) ||
+                hash->equal_predicate(
+                   current_entry->key, current_entry->key_length,
+                   key,                key_length
+                )
             )
         ) {
             found = 1;
@@ -753,6 +849,45 @@ ib_status_t ib_hash_set_ex(
     IB_FTRACE_RET_STATUS(IB_OK);
 }
 
+ib_status_t ib_hash_set_ex(
+    ib_hash_t  *hash,
+    const void *key,
+    size_t      key_length,
+    void       *value
+) {
+    IB_FTRACE_INIT();
+
+    assert(hash != NULL);
+    assert(key  != NULL);
+
+    IB_FTRACE_RET_STATUS(ib_hash_set_hashed(
+        hash,
+        key,
+        key_length,
+        hash->hash_function(key, key_length, hash->randomizer),
+        value
+    ));
+}
+
+ib_status_t ib_hash_set_sym(
+    ib_hash_t         *hash,
+    const ib_symbol_t *sym,
+    void              *value
+) {
+    IB_FTRACE_INIT();
+
+    assert(hash != NULL);
+    assert(sym  != NULL);
+
+    IB_FTRACE_RET_STATUS(ib_hash_set_hashed(
+        hash,
+        sym->name,
+        sym->nlen,
+        ib_hash_sym_value(hash, sym),
+        value
+    ));
+}
+
 ib_status_t ib_hash_set(
     ib_hash_t  *hash,
     const char *key,
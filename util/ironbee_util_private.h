@@ -294,6 +294,8 @@ struct ib_field_val_t {
     ib_field_set_fn_t  fn_set;        /**< Function to set a value. */
     void              *cbdata_get;    /**< Data passed to fn_get. */
     void              *cbdata_set;    /**< Data passed to fn_get. */
+    ib_field_adjust_fn_t fn_adjust;   /**< Function to adjust a value. */
+    void              *cbdata_adjust; /**< Data passed to fn_adjust. */
     void              *pval;          /**< Address where value is stored */
     union {
         ib_num_t       num;           /**< Generic numeric value */
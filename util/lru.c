@@ -0,0 +1,545 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; LRU Hash Implementation
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include "ironbee_config_auto.h"
+
+#include <ironbee/lru.h>
+
+#include <ironbee/debug.h>
+#include <ironbee/lock.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Maximum number of cache stripes. */
+#define LRU_MAX_STRIPES 16
+
+/** Minimum number of entries in a cache stripe. */
+#define LRU_MIN_PER_STRIPE 64
+
+/**
+ * Cache entry: the value, followed by the key.
+ * @internal
+ */
+typedef struct {
+    size_t            klen;          /**< Length of key */
+    size_t            vlen;          /**< Length of value */
+    char              data[];        /**< Value + key */
+} lru_item_t;
+
+/**
+ * Cache stripe.
+ * @internal
+ */
+typedef struct {
+    ib_lock_t         lock;          /**< Protects everything below */
+    ib_lru_t          lru;           /**< LRU index */
+    uint32_t         *buckets;       /**< Hash buckets */
+    ib_lru_node_t    *nodes;         /**< Nodes */
+    lru_item_t      **items;         /**< Entries, parallel to nodes */
+    uint64_t          hits;          /**< Successful gets */
+    uint64_t          misses;        /**< Failed gets */
+} lru_stripe_t;
+
+/**
+ * Cache; typedef in ironbee/lru.h
+ */
+struct ib_lrucache_t {
+    size_t            nstripes;      /**< Number of stripes; power of 2 */
+    lru_stripe_t     *stripes;       /**< Stripes */
+};
+
+/**
+ * Bucket of a hash.
+ * @internal
+ *
+ * @param[in] lru LRU index
+ * @param[in] hash Hash
+ *
+ * @returns Bucket index
+ */
+static inline uint32_t lru_bucket(const ib_lru_t *lru, uint32_t hash)
+{
+    return (hash >> 8) & lru->bmask;
+}
+
+/**
+ * Unlink a node from the LRU list.
+ * @internal
+ *
+ * @param[in,out] lru LRU index
+ * @param[in,out] nodes Nodes
+ * @param[in] idx Node index
+ */
+static void lru_unlink(ib_lru_t *lru, ib_lru_node_t *nodes, uint32_t idx)
+{
+    ib_lru_node_t *node = &nodes[idx];
+
+    if (node->prev != IB_LRU_NIL) {
+        nodes[node->prev].next = node->next;
+    }
+    else {
+        lru->head = node->next;
+    }
+    if (node->next != IB_LRU_NIL) {
+        nodes[node->next].prev = node->prev;
+    }
+    else {
+        lru->tail = node->prev;
+    }
+    node->prev = node->next = IB_LRU_NIL;
+}
+
+/**
+ * Link a node at the front of the LRU list.
+ * @internal
+ *
+ * @param[in,out] lru LRU index
+ * @param[in,out] nodes Nodes
+ * @param[in] idx Node index
+ */
+static void lru_push(ib_lru_t *lru, ib_lru_node_t *nodes, uint32_t idx)
+{
+    ib_lru_node_t *node = &nodes[idx];
+
+    node->prev = IB_LRU_NIL;
+    node->next = lru->head;
+    if (lru->head != IB_LRU_NIL) {
+        nodes[lru->head].prev = idx;
+    }
+    lru->head = idx;
+    if (lru->tail == IB_LRU_NIL) {
+        lru->tail = idx;
+    }
+}
+
+uint32_t ib_lru_hash(const void *key, size_t klen)
+{
+    const unsigned char *p = (const unsigned char *)key;
+    uint32_t hash = 0x811c9dc5;
+    size_t n;
+
+    for (n = 0; n < klen; ++n) {
+        hash ^= p[n];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+void ib_lru_reset(ib_lru_t *lru,
+                  uint32_t *buckets,
+                  size_t nbuckets,
+                  ib_lru_node_t *nodes,
+                  size_t nnodes)
+{
+    size_t n;
+
+    assert(lru != NULL);
+    assert(buckets != NULL);
+    assert( (nbuckets != 0) && ((nbuckets & (nbuckets - 1)) == 0) );
+    assert(nodes != NULL);
+    assert( (nnodes != 0) && (nnodes < IB_LRU_NIL) );
+
+    for (n = 0; n < nbuckets; ++n) {
+        buckets[n] = IB_LRU_NIL;
+    }
+    for (n = 0; n < nnodes; ++n) {
+        nodes[n].hnext = (n + 1 < nnodes) ? (uint32_t)(n + 1) : IB_LRU_NIL;
+        nodes[n].prev = nodes[n].next = IB_LRU_NIL;
+    }
+    lru->bmask = (uint32_t)(nbuckets - 1);
+    lru->nnodes = (uint32_t)nnodes;
+    lru->head = lru->tail = IB_LRU_NIL;
+    lru->free = 0;
+    lru->count = 0;
+}
+
+uint32_t ib_lru_find(const ib_lru_t *lru,
+                     const uint32_t *buckets,
+                     const ib_lru_node_t *nodes,
+                     uint32_t hash,
+                     const void *key,
+                     size_t klen,
+                     ib_lru_match_fn_t match,
+                     void *cbdata)
+{
+    uint32_t idx;
+
+    assert(lru != NULL);
+    assert(buckets != NULL);
+    assert(nodes != NULL);
+    assert(match != NULL);
+
+    for (idx = buckets[lru_bucket(lru, hash)];
+         idx != IB_LRU_NIL;
+         idx = nodes[idx].hnext)
+    {
+        if ( (nodes[idx].hash == hash) && match(idx, key, klen, cbdata) ) {
+            return idx;
+        }
+    }
+    return IB_LRU_NIL;
+}
+
+void ib_lru_touch(ib_lru_t *lru, ib_lru_node_t *nodes, uint32_t idx)
+{
+    assert(lru != NULL);
+    assert(nodes != NULL);
+    assert(idx < lru->nnodes);
+
+    if (lru->head != idx) {
+        lru_unlink(lru, nodes, idx);
+        lru_push(lru, nodes, idx);
+    }
+}
+
+uint32_t ib_lru_insert(ib_lru_t *lru,
+                       uint32_t *buckets,
+                       ib_lru_node_t *nodes,
+                       uint32_t hash,
+                       ib_bool_t *pevicted)
+{
+    uint32_t *bucket;
+    uint32_t idx;
+
+    assert(lru != NULL);
+    assert(buckets != NULL);
+    assert(nodes != NULL);
+
+    if (pevicted != NULL) {
+        *pevicted = (lru->free == IB_LRU_NIL) ? IB_TRUE : IB_FALSE;
+    }
+    if (lru->free == IB_LRU_NIL) {
+        assert(lru->tail != IB_LRU_NIL);
+        ib_lru_remove(lru, buckets, nodes, lru->tail);
+    }
+
+    idx = lru->free;
+    lru->free = nodes[idx].hnext;
+    ++lru->count;
+
+    bucket = &buckets[lru_bucket(lru, hash)];
+    nodes[idx].hash = hash;
+    nodes[idx].hnext = *bucket;
+    *bucket = idx;
+    lru_push(lru, nodes, idx);
+
+    return idx;
+}
+
+void ib_lru_remove(ib_lru_t *lru,
+                   uint32_t *buckets,
+                   ib_lru_node_t *nodes,
+                   uint32_t idx)
+{
+    uint32_t *link;
+
+    assert(lru != NULL);
+    assert(buckets != NULL);
+    assert(nodes != NULL);
+    assert(idx < lru->nnodes);
+
+    link = &buckets[lru_bucket(lru, nodes[idx].hash)];
+    while (*link != idx) {
+        assert(*link != IB_LRU_NIL);
+        link = &nodes[*link].hnext;
+    }
+    *link = nodes[idx].hnext;
+
+    lru_unlink(lru, nodes, idx);
+    nodes[idx].hnext = lru->free;
+    lru->free = idx;
+    --lru->count;
+}
+
+/**
+ * Key comparison for cache entries.
+ * @internal
+ *
+ * @param[in] idx Node index
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[in] cbdata Entries of the stripe
+ *
+ * @returns Non-zero if entry @a idx has key @a key
+ */
+static int lru_item_match(uint32_t idx,
+                          const void *key,
+                          size_t klen,
+                          void *cbdata)
+{
+    const lru_item_t *item = ((lru_item_t **)cbdata)[idx];
+
+    return (item->klen == klen) &&
+           (memcmp(item->data + item->vlen, key, klen) == 0);
+}
+
+/**
+ * Find the stripe of a hash.
+ * @internal
+ *
+ * @param[in] cache Cache
+ * @param[in] hash Hash
+ *
+ * @returns Stripe
+ */
+static inline lru_stripe_t *lru_stripe(const ib_lrucache_t *cache,
+                                       uint32_t hash)
+{
+    return &cache->stripes[hash & (cache->nstripes - 1)];
+}
+
+ib_status_t ib_lrucache_create(ib_lrucache_t **pcache,
+                               size_t max_entries)
+{
+    IB_FTRACE_INIT();
+    ib_lrucache_t *cache;
+    size_t per_stripe;
+    size_t nbuckets;
+    size_t n;
+    ib_status_t rc;
+
+    assert(pcache != NULL);
+
+    if ( (max_entries == 0) || (max_entries >= IB_LRU_NIL) ) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    cache = (ib_lrucache_t *)calloc(1, sizeof(*cache));
+    if (cache == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    /* Only split caches big enough for it to matter. */
+    cache->nstripes = 1;
+    while ( (cache->nstripes < LRU_MAX_STRIPES) &&
+            (max_entries / (cache->nstripes * 2) >= LRU_MIN_PER_STRIPE) )
+    {
+        cache->nstripes *= 2;
+    }
+    per_stripe = (max_entries + cache->nstripes - 1) / cache->nstripes;
+    nbuckets = 1;
+    while (nbuckets < per_stripe) {
+        nbuckets <<= 1;
+    }
+
+    cache->stripes = (lru_stripe_t *)
+        calloc(cache->nstripes, sizeof(*cache->stripes));
+    if (cache->stripes == NULL) {
+        free(cache);
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    for (n = 0; n < cache->nstripes; ++n) {
+        lru_stripe_t *stripe = &cache->stripes[n];
+
+        stripe->buckets = (uint32_t *)malloc(nbuckets * sizeof(uint32_t));
+        stripe->nodes = (ib_lru_node_t *)
+            malloc(per_stripe * sizeof(ib_lru_node_t));
+        stripe->items = (lru_item_t **)
+            calloc(per_stripe, sizeof(lru_item_t *));
+        if ( (stripe->buckets == NULL) ||
+             (stripe->nodes == NULL) ||
+             (stripe->items == NULL) )
+        {
+            rc = IB_EALLOC;
+            goto failed;
+        }
+        rc = ib_lock_init(&stripe->lock);
+        if (rc != IB_OK) {
+            goto failed;
+        }
+        ib_lru_reset(&stripe->lru, stripe->buckets, nbuckets,
+                     stripe->nodes, per_stripe);
+    }
+
+    *pcache = cache;
+    IB_FTRACE_RET_STATUS(IB_OK);
+
+failed:
+    free(cache->stripes[n].buckets);
+    free(cache->stripes[n].nodes);
+    free(cache->stripes[n].items);
+    while (n-- > 0) {
+        ib_lock_destroy(&cache->stripes[n].lock);
+        free(cache->stripes[n].buckets);
+        free(cache->stripes[n].nodes);
+        free(cache->stripes[n].items);
+    }
+    free(cache->stripes);
+    free(cache);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+ib_status_t ib_lrucache_get(ib_lrucache_t *cache,
+                            ib_mpool_t *mp,
+                            const void *key,
+                            size_t klen,
+                            void **pvalue,
+                            size_t *pvlen)
+{
+    IB_FTRACE_INIT();
+    uint32_t hash = ib_lru_hash(key, klen);
+    lru_stripe_t *stripe;
+    const lru_item_t *item;
+    void *value;
+    uint32_t idx;
+
+    assert(cache != NULL);
+    assert(mp != NULL);
+    assert(pvalue != NULL);
+
+    stripe = lru_stripe(cache, hash);
+    ib_lock_lock(&stripe->lock);
+    idx = ib_lru_find(&stripe->lru, stripe->buckets, stripe->nodes,
+                      hash, key, klen, lru_item_match, stripe->items);
+    if (idx == IB_LRU_NIL) {
+        ++stripe->misses;
+        ib_lock_unlock(&stripe->lock);
+        IB_FTRACE_RET_STATUS(IB_ENOENT);
+    }
+    ++stripe->hits;
+    ib_lru_touch(&stripe->lru, stripe->nodes, idx);
+
+    item = stripe->items[idx];
+    value = ib_mpool_alloc(mp, (item->vlen == 0) ? 1 : item->vlen);
+    if (value == NULL) {
+        ib_lock_unlock(&stripe->lock);
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    memcpy(value, item->data, item->vlen);
+    if (pvlen != NULL) {
+        *pvlen = item->vlen;
+    }
+    ib_lock_unlock(&stripe->lock);
+
+    *pvalue = value;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_lrucache_set(ib_lrucache_t *cache,
+                            const void *key,
+                            size_t klen,
+                            const void *value,
+                            size_t vlen)
+{
+    IB_FTRACE_INIT();
+    uint32_t hash = ib_lru_hash(key, klen);
+    lru_stripe_t *stripe;
+    lru_item_t *item;
+    lru_item_t *old = NULL;
+    ib_bool_t evicted;
+    uint32_t idx;
+
+    assert(cache != NULL);
+
+    /* Build the entry before taking the lock. */
+    item = (lru_item_t *)malloc(sizeof(*item) + vlen + klen);
+    if (item == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    item->klen = klen;
+    item->vlen = vlen;
+    memcpy(item->data, value, vlen);
+    memcpy(item->data + vlen, key, klen);
+
+    stripe = lru_stripe(cache, hash);
+    ib_lock_lock(&stripe->lock);
+    idx = ib_lru_find(&stripe->lru, stripe->buckets, stripe->nodes,
+                      hash, key, klen, lru_item_match, stripe->items);
+    if (idx != IB_LRU_NIL) {
+        ib_lru_touch(&stripe->lru, stripe->nodes, idx);
+        old = stripe->items[idx];
+    }
+    else {
+        idx = ib_lru_insert(&stripe->lru, stripe->buckets, stripe->nodes,
+                            hash, &evicted);
+        if (evicted == IB_TRUE) {
+            old = stripe->items[idx];
+        }
+    }
+    stripe->items[idx] = item;
+    ib_lock_unlock(&stripe->lock);
+
+    free(old);
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+void ib_lrucache_stats(ib_lrucache_t *cache,
+                       uint64_t *phits,
+                       uint64_t *pmisses)
+{
+    IB_FTRACE_INIT();
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t n;
+
+    assert(cache != NULL);
+
+    for (n = 0; n < cache->nstripes; ++n) {
+        lru_stripe_t *stripe = &cache->stripes[n];
+
+        ib_lock_lock(&stripe->lock);
+        hits += stripe->hits;
+        misses += stripe->misses;
+        ib_lock_unlock(&stripe->lock);
+    }
+
+    if (phits != NULL) {
+        *phits = hits;
+    }
+    if (pmisses != NULL) {
+        *pmisses = misses;
+    }
+    IB_FTRACE_RET_VOID();
+}
+
+void ib_lrucache_destroy(ib_lrucache_t *cache)
+{
+    IB_FTRACE_INIT();
+    size_t n;
+    uint32_t idx;
+
+    if (cache == NULL) {
+        IB_FTRACE_RET_VOID();
+    }
+
+    for (n = 0; n < cache->nstripes; ++n) {
+        lru_stripe_t *stripe = &cache->stripes[n];
+
+        for (idx = stripe->lru.head;
+             idx != IB_LRU_NIL;
+             idx = stripe->nodes[idx].next)
+        {
+            free(stripe->items[idx]);
+        }
+        ib_lock_destroy(&stripe->lock);
+        free(stripe->buckets);
+        free(stripe->nodes);
+        free(stripe->items);
+    }
+    free(cache->stripes);
+    free(cache);
+    IB_FTRACE_RET_VOID();
+}
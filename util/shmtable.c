@@ -0,0 +1,526 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; Shared Memory Counter Table Implementation
+ *
+ * The mapping holds an array of stripes, then the LRU nodes, the entries
+ * and the hash buckets of every stripe.  Each stripe owns a fixed share of
+ * the nodes, entries and buckets, and indexes them with an ib_lru_t.
+ * Because the mapping may be at a different address in another process,
+ * ib_lru_t links nodes by index rather than by pointer.
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include "ironbee_config_auto.h"
+
+#include <ironbee/shmtable.h>
+
+#include <ironbee/clock.h>
+#include <ironbee/debug.h>
+#include <ironbee/lru.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/** Maximum number of stripes. */
+#define SHM_MAX_STRIPES 16
+
+/** Minimum number of entries in a stripe. */
+#define SHM_MIN_PER_STRIPE 64
+
+/**
+ * Entry; linked by the node of the same index.
+ * @internal
+ */
+typedef struct {
+    ib_time_t         expires;       /**< Expiry time; 0 if none */
+    ib_num_t          value;         /**< Value */
+    uint32_t          klen;          /**< Length of key */
+    char              key[IB_SHMTABLE_KEY_MAX]; /**< Key */
+} shm_entry_t;
+
+/**
+ * Stripe.
+ * @internal
+ */
+typedef struct {
+    pthread_mutex_t   mutex;         /**< Protects everything below */
+    ib_lru_t          lru;           /**< LRU index of the stripe */
+    uint64_t          evictions;     /**< Unexpired entries evicted */
+} shm_stripe_t;
+
+/**
+ * Table.
+ *
+ * This is process local; everything it points to is in the mapping.
+ * @internal
+ */
+struct ib_shmtable_t {
+    void             *map;           /**< Shared mapping */
+    size_t            map_len;       /**< Length of map */
+    size_t            nstripes;      /**< Number of stripes; power of 2 */
+    size_t            per_stripe;    /**< Entries per stripe */
+    size_t            nbuckets;      /**< Buckets per stripe */
+    shm_stripe_t     *stripes;       /**< Stripes */
+    uint32_t         *buckets;       /**< Hash buckets of all stripes */
+    ib_lru_node_t    *nodes;         /**< LRU nodes of all stripes */
+    shm_entry_t      *entries;       /**< Entries of all stripes */
+};
+
+/**
+ * Memory pool cleanup: unmap the table.
+ *
+ * The locks are not destroyed; other processes may still be using them.
+ * @internal
+ *
+ * @param[in] data Table
+ *
+ * @returns IB_OK
+ */
+static ib_status_t shm_cleanup(void *data)
+{
+    ib_shmtable_t *table = (ib_shmtable_t *)data;
+
+    munmap(table->map, table->map_len);
+    return IB_OK;
+}
+
+/**
+ * Empty a stripe.
+ * @internal
+ *
+ * @param[in] table Table
+ * @param[in] sidx Stripe index
+ */
+static void shm_stripe_reset(ib_shmtable_t *table, size_t sidx)
+{
+    ib_lru_reset(&table->stripes[sidx].lru,
+                 table->buckets + (sidx * table->nbuckets),
+                 table->nbuckets,
+                 table->nodes + (sidx * table->per_stripe),
+                 table->per_stripe);
+}
+
+/**
+ * Lock a stripe.
+ *
+ * If the previous owner died while holding the lock the stripe may be
+ * half updated, so it is emptied.
+ * @internal
+ *
+ * @param[in] table Table
+ * @param[in] sidx Stripe index
+ */
+static void shm_lock(ib_shmtable_t *table, size_t sidx)
+{
+    int rc = pthread_mutex_lock(&table->stripes[sidx].mutex);
+
+#ifdef EOWNERDEAD
+    if (rc == EOWNERDEAD) {
+        shm_stripe_reset(table, sidx);
+        pthread_mutex_consistent(&table->stripes[sidx].mutex);
+    }
+#endif
+    (void)rc;
+}
+
+/**
+ * Unlock a stripe.
+ * @internal
+ *
+ * @param[in] table Table
+ * @param[in] sidx Stripe index
+ */
+static void shm_unlock(ib_shmtable_t *table, size_t sidx)
+{
+    pthread_mutex_unlock(&table->stripes[sidx].mutex);
+}
+
+/**
+ * Location of a key within the table.
+ * @internal
+ */
+typedef struct {
+    size_t            sidx;          /**< Stripe index */
+    shm_stripe_t     *stripe;        /**< Stripe */
+    uint32_t         *buckets;       /**< Hash buckets of stripe */
+    ib_lru_node_t    *nodes;         /**< LRU nodes of stripe */
+    shm_entry_t      *entries;       /**< Entries of stripe */
+    uint32_t          hash;          /**< Hash of key */
+} shm_loc_t;
+
+/**
+ * Locate the stripe of a key.
+ * @internal
+ *
+ * @param[in] table Table
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[out] loc Location
+ */
+static void shm_locate(ib_shmtable_t *table,
+                       const void *key,
+                       size_t klen,
+                       shm_loc_t *loc)
+{
+    loc->hash = ib_lru_hash(key, klen);
+    loc->sidx = loc->hash & (table->nstripes - 1);
+    loc->stripe = &table->stripes[loc->sidx];
+    loc->buckets = table->buckets + (loc->sidx * table->nbuckets);
+    loc->nodes = table->nodes + (loc->sidx * table->per_stripe);
+    loc->entries = table->entries + (loc->sidx * table->per_stripe);
+}
+
+/**
+ * Key comparison for ib_lru_find().
+ * @internal
+ *
+ * @param[in] idx Entry index
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[in] cbdata Entries of the stripe
+ *
+ * @returns Non-zero if entry @a idx has key @a key
+ */
+static int shm_match(uint32_t idx,
+                     const void *key,
+                     size_t klen,
+                     void *cbdata)
+{
+    const shm_entry_t *entry = &((const shm_entry_t *)cbdata)[idx];
+
+    return (entry->klen == klen) && (memcmp(entry->key, key, klen) == 0);
+}
+
+/**
+ * Find an entry (stripe must be locked).
+ *
+ * An expired entry is freed and not found.
+ * @internal
+ *
+ * @param[in] loc Location of @a key
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[in] now Current time
+ *
+ * @returns Entry index or IB_LRU_NIL
+ */
+static uint32_t shm_find(const shm_loc_t *loc,
+                         const void *key,
+                         size_t klen,
+                         ib_time_t now)
+{
+    const shm_entry_t *entry;
+    uint32_t idx;
+
+    idx = ib_lru_find(&loc->stripe->lru, loc->buckets, loc->nodes,
+                      loc->hash, key, klen, shm_match, loc->entries);
+    if (idx == IB_LRU_NIL) {
+        return IB_LRU_NIL;
+    }
+    entry = &loc->entries[idx];
+    if ( (entry->expires != 0) && (entry->expires <= now) ) {
+        ib_lru_remove(&loc->stripe->lru, loc->buckets, loc->nodes, idx);
+        return IB_LRU_NIL;
+    }
+    return idx;
+}
+
+/**
+ * Allocate an entry for a key, evicting the least recently used entry of
+ * the stripe if it is full (stripe must be locked).
+ * @internal
+ *
+ * @param[in] loc Location of @a key
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[in] now Current time
+ *
+ * @returns Entry index
+ */
+static uint32_t shm_entry_alloc(const shm_loc_t *loc,
+                                const void *key,
+                                size_t klen,
+                                ib_time_t now)
+{
+    shm_entry_t *entry;
+    ib_bool_t evicted;
+    uint32_t idx;
+
+    idx = ib_lru_insert(&loc->stripe->lru, loc->buckets, loc->nodes,
+                        loc->hash, &evicted);
+    entry = &loc->entries[idx];
+    if ( (evicted == IB_TRUE) &&
+         ((entry->expires == 0) || (entry->expires > now)) )
+    {
+        ++loc->stripe->evictions;
+    }
+
+    entry->klen = (uint32_t)klen;
+    memcpy(entry->key, key, klen);
+
+    return idx;
+}
+
+ib_status_t ib_shmtable_create(ib_shmtable_t **ptable,
+                               ib_mpool_t *mp,
+                               size_t max_entries)
+{
+    IB_FTRACE_INIT();
+    ib_shmtable_t *table;
+    pthread_mutexattr_t attr;
+    size_t nbuckets;
+    size_t n;
+    ib_status_t rc;
+
+    assert(ptable != NULL);
+    assert(mp != NULL);
+
+    if ( (max_entries == 0) || (max_entries >= IB_LRU_NIL) ) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    table = (ib_shmtable_t *)ib_mpool_calloc(mp, 1, sizeof(*table));
+    if (table == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    /* Only split tables big enough for it to matter. */
+    table->nstripes = 1;
+    while ( (table->nstripes < SHM_MAX_STRIPES) &&
+            (max_entries / (table->nstripes * 2) >= SHM_MIN_PER_STRIPE) )
+    {
+        table->nstripes *= 2;
+    }
+    table->per_stripe =
+        (max_entries + table->nstripes - 1) / table->nstripes;
+    nbuckets = 1;
+    while (nbuckets < table->per_stripe) {
+        nbuckets <<= 1;
+    }
+    table->nbuckets = nbuckets;
+
+    table->map_len =
+        (table->nstripes * sizeof(shm_stripe_t)) +
+        (table->nstripes * table->per_stripe * sizeof(ib_lru_node_t)) +
+        (table->nstripes * table->per_stripe * sizeof(shm_entry_t)) +
+        (table->nstripes * nbuckets * sizeof(uint32_t));
+    table->map = mmap(NULL, table->map_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (table->map == MAP_FAILED) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    table->stripes = (shm_stripe_t *)table->map;
+    table->nodes = (ib_lru_node_t *)(table->stripes + table->nstripes);
+    table->entries = (shm_entry_t *)
+        (table->nodes + (table->nstripes * table->per_stripe));
+    table->buckets = (uint32_t *)
+        (table->entries + (table->nstripes * table->per_stripe));
+
+    if (pthread_mutexattr_init(&attr) != 0) {
+        munmap(table->map, table->map_len);
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+#ifdef EOWNERDEAD
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+#endif
+    for (n = 0; n < table->nstripes; ++n) {
+        if (pthread_mutex_init(&table->stripes[n].mutex, &attr) != 0) {
+            pthread_mutexattr_destroy(&attr);
+            munmap(table->map, table->map_len);
+            IB_FTRACE_RET_STATUS(IB_EALLOC);
+        }
+        shm_stripe_reset(table, n);
+    }
+    pthread_mutexattr_destroy(&attr);
+
+    rc = ib_mpool_cleanup_register(mp, shm_cleanup, table);
+    if (rc != IB_OK) {
+        munmap(table->map, table->map_len);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    *ptable = table;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_shmtable_get(ib_shmtable_t *table,
+                            const void *key,
+                            size_t klen,
+                            ib_num_t *pval)
+{
+    IB_FTRACE_INIT();
+    shm_loc_t loc;
+    uint32_t idx;
+
+    assert(table != NULL);
+    assert(key != NULL);
+    assert(pval != NULL);
+
+    if (klen > IB_SHMTABLE_KEY_MAX) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    shm_locate(table, key, klen, &loc);
+    shm_lock(table, loc.sidx);
+    idx = shm_find(&loc, key, klen, ib_clock_get_time());
+    if (idx == IB_LRU_NIL) {
+        shm_unlock(table, loc.sidx);
+        IB_FTRACE_RET_STATUS(IB_ENOENT);
+    }
+    *pval = loc.entries[idx].value;
+    ib_lru_touch(&loc.stripe->lru, loc.nodes, idx);
+    shm_unlock(table, loc.sidx);
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_shmtable_set(ib_shmtable_t *table,
+                            const void *key,
+                            size_t klen,
+                            ib_num_t val,
+                            uint32_t ttl)
+{
+    IB_FTRACE_INIT();
+    ib_time_t now = ib_clock_get_time();
+    shm_loc_t loc;
+    uint32_t idx;
+
+    assert(table != NULL);
+    assert(key != NULL);
+
+    if (klen > IB_SHMTABLE_KEY_MAX) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    shm_locate(table, key, klen, &loc);
+    shm_lock(table, loc.sidx);
+    idx = shm_find(&loc, key, klen, now);
+    if (idx == IB_LRU_NIL) {
+        idx = shm_entry_alloc(&loc, key, klen, now);
+    }
+    else {
+        ib_lru_touch(&loc.stripe->lru, loc.nodes, idx);
+    }
+    loc.entries[idx].value = val;
+    loc.entries[idx].expires = (ttl == 0) ? 0 : now + (ttl * 1000000ULL);
+    shm_unlock(table, loc.sidx);
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_shmtable_add(ib_shmtable_t *table,
+                            const void *key,
+                            size_t klen,
+                            ib_num_t adjval,
+                            uint32_t ttl,
+                            ib_num_t *presult)
+{
+    IB_FTRACE_INIT();
+    ib_time_t now = ib_clock_get_time();
+    shm_loc_t loc;
+    uint32_t idx;
+    ib_num_t result;
+
+    assert(table != NULL);
+    assert(key != NULL);
+
+    if (klen > IB_SHMTABLE_KEY_MAX) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    shm_locate(table, key, klen, &loc);
+    shm_lock(table, loc.sidx);
+    idx = shm_find(&loc, key, klen, now);
+    if (idx == IB_LRU_NIL) {
+        idx = shm_entry_alloc(&loc, key, klen, now);
+        loc.entries[idx].value = adjval;
+        loc.entries[idx].expires =
+            (ttl == 0) ? 0 : now + (ttl * 1000000ULL);
+    }
+    else {
+        loc.entries[idx].value += adjval;
+        ib_lru_touch(&loc.stripe->lru, loc.nodes, idx);
+    }
+    result = loc.entries[idx].value;
+    shm_unlock(table, loc.sidx);
+
+    if (presult != NULL) {
+        *presult = result;
+    }
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_shmtable_remove(ib_shmtable_t *table,
+                               const void *key,
+                               size_t klen)
+{
+    IB_FTRACE_INIT();
+    shm_loc_t loc;
+    uint32_t idx;
+
+    assert(table != NULL);
+    assert(key != NULL);
+
+    if (klen > IB_SHMTABLE_KEY_MAX) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    shm_locate(table, key, klen, &loc);
+    shm_lock(table, loc.sidx);
+    idx = shm_find(&loc, key, klen, ib_clock_get_time());
+    if (idx != IB_LRU_NIL) {
+        ib_lru_remove(&loc.stripe->lru, loc.buckets, loc.nodes, idx);
+    }
+    shm_unlock(table, loc.sidx);
+
+    IB_FTRACE_RET_STATUS((idx == IB_LRU_NIL) ? IB_ENOENT : IB_OK);
+}
+
+void ib_shmtable_stats(ib_shmtable_t *table,
+                       size_t *pcount,
+                       uint64_t *pevictions)
+{
+    IB_FTRACE_INIT();
+    size_t count = 0;
+    uint64_t evictions = 0;
+    size_t n;
+
+    assert(table != NULL);
+
+    for (n = 0; n < table->nstripes; ++n) {
+        shm_lock(table, n);
+        count += table->stripes[n].lru.count;
+        evictions += table->stripes[n].evictions;
+        shm_unlock(table, n);
+    }
+
+    if (pcount != NULL) {
+        *pcount = count;
+    }
+    if (pevictions != NULL) {
+        *pevictions = evictions;
+    }
+    IB_FTRACE_RET_VOID();
+}
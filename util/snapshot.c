@@ -0,0 +1,626 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; Compile Cache Snapshot Implementation
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include "ironbee_config_auto.h"
+
+#include <ironbee/snapshot.h>
+
+#include <ironbee/debug.h>
+#include <ironbee/hash.h>
+#include <ironbee/list.h>
+#include <ironbee/lock.h>
+#include <ironbee/util.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** File magic. */
+#define SNAP_MAGIC "IBSNAPSH"
+
+/** Written in native byte order to detect foreign files. */
+#define SNAP_BYTE_ORDER 0x01020304
+
+/** Alignment of keys and blobs within the file. */
+#define SNAP_ALIGN 8
+
+/** Round @a n up to SNAP_ALIGN. */
+#define SNAP_PAD(n) (((n) + (SNAP_ALIGN - 1)) & ~((size_t)SNAP_ALIGN - 1))
+
+/**
+ * File header.
+ * @internal
+ */
+typedef struct {
+    char              magic[8];      /**< SNAP_MAGIC */
+    uint32_t          version;       /**< IB_SNAPSHOT_VERSION */
+    uint32_t          byte_order;    /**< SNAP_BYTE_ORDER */
+    uint64_t          config_hash;   /**< Hash of configuration */
+    uint64_t          nentries;      /**< Number of entries */
+    uint64_t          length;        /**< File length */
+} snap_file_header_t;
+
+/**
+ * File entry header.
+ *
+ * Followed by the namespace and its NUL, then the key, padded to
+ * SNAP_ALIGN, then the blob, padded to SNAP_ALIGN.
+ * @internal
+ */
+typedef struct {
+    uint32_t          nslen;         /**< Namespace length, without NUL */
+    uint32_t          klen;          /**< Key length */
+    uint64_t          dlen;          /**< Blob length */
+} snap_file_entry_t;
+
+/**
+ * In-memory entry.
+ * @internal
+ */
+typedef struct {
+    const char       *ns;            /**< Namespace */
+    const void       *key;           /**< Key */
+    size_t            klen;          /**< Length of key */
+    const void       *data;          /**< Blob */
+    size_t            dlen;          /**< Length of blob */
+    int               used;          /**< Looked up or added this run */
+} snap_entry_t;
+
+/**
+ * Snapshot.
+ * @internal
+ */
+struct ib_snapshot_t {
+    ib_mpool_t       *mp;            /**< Memory pool */
+    const char       *path;          /**< Snapshot file */
+    void             *map;           /**< Mapped file or NULL */
+    size_t            map_len;       /**< Length of map */
+    uint64_t          config_hash;   /**< Hash recorded in file */
+    ib_hash_t        *namespaces;    /**< ns -> ib_hash_t of key -> entry */
+    ib_list_t        *entries;       /**< All entries, in file order */
+    size_t            hits;          /**< Successful gets */
+    size_t            misses;        /**< Failed gets */
+    int               dirty;         /**< Entries added or replaced */
+    ib_lock_t         lock;          /**< Serialises access */
+};
+
+uint64_t ib_snapshot_hash(uint64_t hash,
+                          const void *data,
+                          size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    size_t n;
+
+    for (n = 0; n < len; ++n) {
+        hash ^= p[n];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * Memory pool cleanup: unmap the file and destroy the lock.
+ * @internal
+ *
+ * @param[in] data Snapshot
+ *
+ * @returns IB_OK
+ */
+static ib_status_t snap_cleanup(void *data)
+{
+    ib_snapshot_t *snap = (ib_snapshot_t *)data;
+
+    if (snap->map != NULL) {
+        munmap(snap->map, snap->map_len);
+        snap->map = NULL;
+    }
+    ib_lock_destroy(&snap->lock);
+    return IB_OK;
+}
+
+/**
+ * Find the entry for @a ns and @a key.
+ * @internal
+ *
+ * @param[in] snap Snapshot
+ * @param[in] ns Namespace
+ * @param[in] key Key
+ * @param[in] klen Length of @a key
+ * @param[in] create Create the namespace if it does not exist
+ * @param[out] pkeys Address which the namespace's hash is written
+ * @param[out] pentry Address which entry is written
+ *
+ * @returns IB_OK, IB_ENOENT or IB_EALLOC
+ */
+static ib_status_t snap_find(ib_snapshot_t *snap,
+                             const char *ns,
+                             const void *key,
+                             size_t klen,
+                             int create,
+                             ib_hash_t **pkeys,
+                             snap_entry_t **pentry)
+{
+    ib_status_t rc;
+    ib_hash_t *keys;
+    char *ns_copy;
+
+    rc = ib_hash_get(snap->namespaces, &keys, ns);
+    if (rc == IB_ENOENT && create) {
+        ns_copy = ib_mpool_strdup(snap->mp, ns);
+        if (ns_copy == NULL) {
+            return IB_EALLOC;
+        }
+        rc = ib_hash_create(&keys, snap->mp);
+        if (rc != IB_OK) {
+            return rc;
+        }
+        rc = ib_hash_set(snap->namespaces, ns_copy, keys);
+    }
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    *pkeys = keys;
+    return ib_hash_get_ex(keys, pentry, key, klen);
+}
+
+/**
+ * Index the entries of a mapped file.
+ * @internal
+ *
+ * @param[in] snap Snapshot
+ * @param[in] base Mapped file
+ * @param[in] len Length of @a base
+ *
+ * @returns IB_OK, IB_EINVAL if the file is not a valid snapshot, or
+ *          IB_EALLOC
+ */
+static ib_status_t snap_index(ib_snapshot_t *snap,
+                              const char *base,
+                              size_t len)
+{
+    const snap_file_header_t *hdr = (const snap_file_header_t *)base;
+    const snap_file_entry_t *fe;
+    snap_entry_t *e;
+    ib_hash_t *keys;
+    snap_entry_t *existing;
+    size_t off;
+    uint64_t n;
+    ib_status_t rc;
+
+    if (len < sizeof(*hdr)) {
+        return IB_EINVAL;
+    }
+    if ( (memcmp(hdr->magic, SNAP_MAGIC, sizeof(hdr->magic)) != 0) ||
+         (hdr->version != IB_SNAPSHOT_VERSION) ||
+         (hdr->byte_order != SNAP_BYTE_ORDER) ||
+         (hdr->length != len) )
+    {
+        return IB_EINVAL;
+    }
+
+    off = sizeof(*hdr);
+    for (n = 0; n < hdr->nentries; ++n) {
+        size_t need;
+
+        if (len - off < sizeof(*fe)) {
+            return IB_EINVAL;
+        }
+        fe = (const snap_file_entry_t *)(base + off);
+        off += sizeof(*fe);
+
+        need = SNAP_PAD((size_t)fe->nslen + 1 + fe->klen);
+        if ( (fe->dlen > len) || (len - off < need) ||
+             (len - off - need < SNAP_PAD(fe->dlen)) ||
+             (base[off + fe->nslen] != '\0') )
+        {
+            return IB_EINVAL;
+        }
+
+        e = (snap_entry_t *)ib_mpool_calloc(snap->mp, 1, sizeof(*e));
+        if (e == NULL) {
+            return IB_EALLOC;
+        }
+        e->ns = base + off;
+        e->key = base + off + fe->nslen + 1;
+        e->klen = fe->klen;
+        e->data = base + off + need;
+        e->dlen = fe->dlen;
+        off += need + SNAP_PAD(fe->dlen);
+
+        rc = snap_find(snap, e->ns, e->key, e->klen, 1, &keys, &existing);
+        if (rc == IB_OK) {
+            /* Duplicate; keep the first. */
+            continue;
+        }
+        if (rc != IB_ENOENT) {
+            return rc;
+        }
+        rc = ib_hash_set_ex(keys, e->key, e->klen, e);
+        if (rc != IB_OK) {
+            return rc;
+        }
+        rc = ib_list_push(snap->entries, e);
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+
+    snap->config_hash = hdr->config_hash;
+    return IB_OK;
+}
+
+ib_status_t ib_snapshot_open(ib_snapshot_t **psnap,
+                             ib_mpool_t *mp,
+                             const char *path)
+{
+    IB_FTRACE_INIT();
+    ib_snapshot_t *snap;
+    struct stat st;
+    ib_status_t rc;
+    int fd;
+
+    assert(psnap != NULL);
+    assert(mp != NULL);
+    assert(path != NULL);
+
+    snap = (ib_snapshot_t *)ib_mpool_calloc(mp, 1, sizeof(*snap));
+    if (snap == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    snap->mp = mp;
+    snap->path = ib_mpool_strdup(mp, path);
+    if (snap->path == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    rc = ib_hash_create(&snap->namespaces, mp);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    rc = ib_list_create(&snap->entries, mp);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    rc = ib_lock_init(&snap->lock);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    rc = ib_mpool_cleanup_register(mp, snap_cleanup, snap);
+    if (rc != IB_OK) {
+        ib_lock_destroy(&snap->lock);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    *psnap = snap;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            ib_util_log_error("Could not open snapshot \"%s\": %s",
+                              path, strerror(errno));
+        }
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    if ( (fstat(fd, &st) != 0) || (st.st_size == 0) ) {
+        close(fd);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    snap->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (snap->map == MAP_FAILED) {
+        snap->map = NULL;
+        ib_util_log_error("Could not map snapshot \"%s\": %s",
+                          path, strerror(errno));
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    snap->map_len = st.st_size;
+
+    rc = snap_index(snap, (const char *)snap->map, snap->map_len);
+    if (rc == IB_EALLOC) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    if (rc != IB_OK) {
+        ib_util_log_error("Ignoring invalid or incompatible snapshot \"%s\"",
+                          path);
+
+        /* Start over empty; the entries indexed so far are discarded. */
+        rc = ib_hash_create(&snap->namespaces, mp);
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        rc = ib_list_create(&snap->entries, mp);
+        if (rc != IB_OK) {
+            IB_FTRACE_RET_STATUS(rc);
+        }
+        munmap(snap->map, snap->map_len);
+        snap->map = NULL;
+        snap->map_len = 0;
+        snap->config_hash = 0;
+    }
+
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_snapshot_get(ib_snapshot_t *snap,
+                            const char *ns,
+                            const void *key,
+                            size_t klen,
+                            const void **pdata,
+                            size_t *pdlen)
+{
+    IB_FTRACE_INIT();
+    ib_hash_t *keys;
+    snap_entry_t *e;
+    ib_status_t rc;
+
+    assert(snap != NULL);
+    assert(ns != NULL);
+    assert(key != NULL);
+    assert(pdata != NULL);
+    assert(pdlen != NULL);
+
+    ib_lock_lock(&snap->lock);
+    rc = snap_find(snap, ns, key, klen, 0, &keys, &e);
+    if (rc == IB_OK) {
+        e->used = 1;
+        *pdata = e->data;
+        *pdlen = e->dlen;
+        ++snap->hits;
+    }
+    else {
+        ++snap->misses;
+    }
+    ib_lock_unlock(&snap->lock);
+
+    IB_FTRACE_RET_STATUS(rc == IB_OK ? IB_OK : IB_ENOENT);
+}
+
+ib_status_t ib_snapshot_put(ib_snapshot_t *snap,
+                            const char *ns,
+                            const void *key,
+                            size_t klen,
+                            const void *data,
+                            size_t dlen)
+{
+    IB_FTRACE_INIT();
+    ib_hash_t *keys;
+    snap_entry_t *e;
+    void *data_copy;
+    ib_status_t rc;
+
+    assert(snap != NULL);
+    assert(ns != NULL);
+    assert(key != NULL);
+    assert( (data != NULL) || (dlen == 0) );
+
+    ib_lock_lock(&snap->lock);
+
+    data_copy = ib_mpool_memdup(snap->mp, data, dlen);
+    if ( (data_copy == NULL) && (dlen != 0) ) {
+        rc = IB_EALLOC;
+        goto done;
+    }
+
+    rc = snap_find(snap, ns, key, klen, 1, &keys, &e);
+    if (rc == IB_ENOENT) {
+        e = (snap_entry_t *)ib_mpool_calloc(snap->mp, 1, sizeof(*e));
+        if (e == NULL) {
+            rc = IB_EALLOC;
+            goto done;
+        }
+        e->ns = ib_mpool_strdup(snap->mp, ns);
+        e->key = ib_mpool_memdup(snap->mp, key, klen);
+        e->klen = klen;
+        if ( (e->ns == NULL) || ((e->key == NULL) && (klen != 0)) ) {
+            rc = IB_EALLOC;
+            goto done;
+        }
+        rc = ib_hash_set_ex(keys, e->key, e->klen, e);
+        if (rc != IB_OK) {
+            goto done;
+        }
+        rc = ib_list_push(snap->entries, e);
+        if (rc != IB_OK) {
+            goto done;
+        }
+    }
+    else if (rc != IB_OK) {
+        goto done;
+    }
+
+    e->data = data_copy;
+    e->dlen = dlen;
+    e->used = 1;
+    snap->dirty = 1;
+    rc = IB_OK;
+
+done:
+    ib_lock_unlock(&snap->lock);
+    IB_FTRACE_RET_STATUS(rc);
+}
+
+/**
+ * Write @a len bytes of @a data.
+ * @internal
+ *
+ * @param[in] fp File
+ * @param[in] data Data
+ * @param[in] len Length of @a data
+ *
+ * @returns 0 on success, -1 on error
+ */
+static int snap_write(FILE *fp, const void *data, size_t len)
+{
+    if ( (len != 0) && (fwrite(data, len, 1, fp) != 1) ) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Write the padding that follows @a len bytes.
+ * @internal
+ *
+ * @param[in] fp File
+ * @param[in] len Length of the data just written
+ *
+ * @returns 0 on success, -1 on error
+ */
+static int snap_write_pad(FILE *fp, size_t len)
+{
+    static const char zeros[SNAP_ALIGN] = { 0 };
+
+    return snap_write(fp, zeros, SNAP_PAD(len) - len);
+}
+
+ib_status_t ib_snapshot_commit(ib_snapshot_t *snap,
+                               uint64_t config_hash)
+{
+    IB_FTRACE_INIT();
+    snap_file_header_t hdr;
+    snap_file_entry_t fe;
+    const ib_list_node_t *node;
+    const snap_entry_t *e;
+    char *tmp;
+    size_t tmp_len;
+    FILE *fp;
+    int unused = 0;
+    int err = 0;
+
+    assert(snap != NULL);
+
+    ib_lock_lock(&snap->lock);
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SNAP_MAGIC, sizeof(hdr.magic));
+    hdr.version = IB_SNAPSHOT_VERSION;
+    hdr.byte_order = SNAP_BYTE_ORDER;
+    hdr.config_hash = config_hash;
+    hdr.length = sizeof(hdr);
+    IB_LIST_LOOP_CONST(snap->entries, node) {
+        e = (const snap_entry_t *)ib_list_node_data_const(node);
+        if (! e->used) {
+            ++unused;
+            continue;
+        }
+        ++hdr.nentries;
+        hdr.length += sizeof(fe) +
+            SNAP_PAD(strlen(e->ns) + 1 + e->klen) + SNAP_PAD(e->dlen);
+    }
+
+    if ( (snap->map != NULL) && (! snap->dirty) && (unused == 0) &&
+         (snap->config_hash == config_hash) )
+    {
+        ib_lock_unlock(&snap->lock);
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+
+    tmp_len = strlen(snap->path) + 32;
+    tmp = (char *)ib_mpool_alloc(snap->mp, tmp_len);
+    if (tmp == NULL) {
+        ib_lock_unlock(&snap->lock);
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    snprintf(tmp, tmp_len, "%s.%ld.tmp", snap->path, (long)getpid());
+
+    fp = fopen(tmp, "wb");
+    if (fp == NULL) {
+        ib_util_log_error("Could not create snapshot \"%s\": %s",
+                          tmp, strerror(errno));
+        ib_lock_unlock(&snap->lock);
+        IB_FTRACE_RET_STATUS(IB_EOTHER);
+    }
+
+    if (snap_write(fp, &hdr, sizeof(hdr)) != 0) {
+        err = 1;
+    }
+    IB_LIST_LOOP_CONST(snap->entries, node) {
+        size_t nslen;
+
+        e = (const snap_entry_t *)ib_list_node_data_const(node);
+        if ( err || (! e->used) ) {
+            continue;
+        }
+
+        nslen = strlen(e->ns);
+        fe.nslen = (uint32_t)nslen;
+        fe.klen = (uint32_t)e->klen;
+        fe.dlen = e->dlen;
+        if ( (snap_write(fp, &fe, sizeof(fe)) != 0) ||
+             (snap_write(fp, e->ns, nslen + 1) != 0) ||
+             (snap_write(fp, e->key, e->klen) != 0) ||
+             (snap_write_pad(fp, nslen + 1 + e->klen) != 0) ||
+             (snap_write(fp, e->data, e->dlen) != 0) ||
+             (snap_write_pad(fp, e->dlen) != 0) )
+        {
+            err = 1;
+        }
+    }
+
+    if ( (fclose(fp) != 0) || err ) {
+        ib_util_log_error("Could not write snapshot \"%s\"", tmp);
+        unlink(tmp);
+        ib_lock_unlock(&snap->lock);
+        IB_FTRACE_RET_STATUS(IB_EOTHER);
+    }
+
+    if (rename(tmp, snap->path) != 0) {
+        ib_util_log_error("Could not replace snapshot \"%s\": %s",
+                          snap->path, strerror(errno));
+        unlink(tmp);
+        ib_lock_unlock(&snap->lock);
+        IB_FTRACE_RET_STATUS(IB_EOTHER);
+    }
+
+    ib_lock_unlock(&snap->lock);
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+void ib_snapshot_stats(const ib_snapshot_t *snap,
+                       size_t *phits,
+                       size_t *pmisses)
+{
+    assert(snap != NULL);
+
+    if (phits != NULL) {
+        *phits = snap->hits;
+    }
+    if (pmisses != NULL) {
+        *pmisses = snap->misses;
+    }
+}
+
+uint64_t ib_snapshot_config_hash(const ib_snapshot_t *snap)
+{
+    assert(snap != NULL);
+
+    return snap->config_hash;
+}
@@ -0,0 +1,173 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; Symbol Table Utility Functions Implementation
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include "ironbee_config_auto.h"
+
+#include <ironbee/symbol.h>
+
+#include <ironbee/debug.h>
+#include <ironbee/hash.h>
+#include <ironbee/mpool.h>
+
+#include <assert.h>
+#include <ctype.h>
+#include <string.h>
+
+/**
+ * Symbol table.
+ * @internal
+ */
+struct ib_symtab_t {
+    ib_mpool_t      *mp;          /**< Memory pool */
+    ib_hash_t       *symbols;     /**< Name -> ib_symbol_t */
+    int              frozen;      /**< Set once frozen */
+};
+
+ib_status_t ib_symtab_create(ib_symtab_t **psymtab,
+                             ib_mpool_t *mp)
+{
+    IB_FTRACE_INIT();
+    ib_symtab_t *symtab;
+    ib_status_t  rc;
+
+    assert(psymtab != NULL);
+    assert(mp != NULL);
+
+    symtab = (ib_symtab_t *)ib_mpool_calloc(mp, 1, sizeof(*symtab));
+    if (symtab == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    symtab->mp = mp;
+
+    rc = ib_hash_create_nocase(&(symtab->symbols), mp);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    *psymtab = symtab;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_symtab_intern(ib_symtab_t *symtab,
+                             const char *name,
+                             size_t nlen,
+                             const ib_symbol_t **psym)
+{
+    IB_FTRACE_INIT();
+    ib_symbol_t *sym;
+    char        *copy;
+    ib_status_t  rc;
+    size_t       n;
+
+    assert(symtab != NULL);
+    assert(name != NULL);
+    assert(psym != NULL);
+
+    rc = ib_hash_get_ex(symtab->symbols, &sym, name, nlen);
+    if (rc == IB_OK) {
+        *psym = sym;
+        IB_FTRACE_RET_STATUS(IB_OK);
+    }
+    if (symtab->frozen != 0) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    sym = (ib_symbol_t *)ib_mpool_alloc(symtab->mp, sizeof(*sym));
+    copy = (char *)ib_mpool_alloc(symtab->mp, nlen + 1);
+    if ( (sym == NULL) || (copy == NULL) ) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    memcpy(copy, name, nlen);
+    copy[nlen] = '\0';
+
+    sym->name = copy;
+    sym->nlen = nlen;
+    sym->hash = 0;
+    sym->hash_mul = 1;
+    for (n = 0; n < nlen; ++n) {
+        sym->hash = (sym->hash * 33) + tolower((unsigned char)copy[n]);
+        sym->hash_mul *= 33;
+    }
+
+    /* Key the entry by the symbol's own name so lookups by symbol match
+     * by pointer. */
+    rc = ib_hash_set_ex(symtab->symbols, copy, nlen, sym);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    *psym = sym;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+ib_status_t ib_symtab_lookup(const ib_symtab_t *symtab,
+                             const char *name,
+                             size_t nlen,
+                             const ib_symbol_t **psym)
+{
+    IB_FTRACE_INIT();
+    ib_symbol_t *sym;
+    ib_status_t  rc;
+
+    assert(symtab != NULL);
+    assert(name != NULL);
+    assert(psym != NULL);
+
+    rc = ib_hash_get_ex(symtab->symbols, &sym, name, nlen);
+    if (rc != IB_OK) {
+        IB_FTRACE_RET_STATUS(rc);
+    }
+
+    *psym = sym;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+void ib_symtab_freeze(ib_symtab_t *symtab)
+{
+    IB_FTRACE_INIT();
+
+    assert(symtab != NULL);
+
+    symtab->frozen = 1;
+    IB_FTRACE_RET_VOID();
+}
+
+size_t ib_symtab_size(const ib_symtab_t *symtab)
+{
+    IB_FTRACE_INIT();
+
+    assert(symtab != NULL);
+
+    IB_FTRACE_RET_UINT(ib_hash_size(symtab->symbols));
+}
+
+uint32_t ib_symbol_hash(const ib_symbol_t *sym,
+                        uint32_t randomizer)
+{
+    assert(sym != NULL);
+
+    /* djb2 is linear in its seed: after n steps the seed has been
+     * multiplied by 33^n, and the rest is the hash with seed 0. */
+    return (randomizer * sym->hash_mul) + sym->hash;
+}
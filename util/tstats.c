@@ -0,0 +1,254 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee &mdash; Per-Thread Statistics Implementation
+ *
+ * @author Nick LeRoy <nleroy@qualys.com>
+ */
+
+#include "ironbee_config_auto.h"
+
+#include <ironbee/tstats.h>
+
+#include <ironbee/debug.h>
+#include <ironbee/lock.h>
+
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Header of a thread's counter block; the counters follow it.
+ * @internal
+ *
+ * Padded to a cache line so that the counters are aligned too.
+ */
+typedef union tstats_block_t tstats_block_t;
+union tstats_block_t {
+    tstats_block_t  *next;                       /**< Next in registry */
+    char             pad[IB_TSTATS_CACHE_LINE];  /**< Alignment padding */
+};
+
+/**
+ * Registry; typedef in ironbee/tstats.h
+ */
+struct ib_tstats_t {
+    size_t           block_size;     /**< Size of a counter block */
+    pthread_key_t    key;            /**< Key for per-thread block */
+    ib_lock_t        lock;           /**< Protects blocks */
+    tstats_block_t  *blocks;         /**< Registry of thread blocks */
+};
+
+void ib_tstats_hist_record(ib_tstats_hist_t *h, uint64_t ns)
+{
+    uint64_t v = ns;
+    size_t   bucket = 0;
+
+    assert(h != NULL);
+
+    while ( (v >>= 1) != 0) {
+        ++bucket;
+    }
+    if (bucket >= IB_TSTATS_BUCKETS) {
+        bucket = IB_TSTATS_BUCKETS - 1;
+    }
+
+    ++h->count;
+    h->total_ns += ns;
+    if (ns > h->max_ns) {
+        h->max_ns = ns;
+    }
+    ++h->hist[bucket];
+}
+
+void ib_tstats_hist_add(ib_tstats_hist_t *dst,
+                        const ib_tstats_hist_t *src)
+{
+    size_t n;
+
+    assert(dst != NULL);
+    assert(src != NULL);
+
+    dst->count += src->count;
+    dst->total_ns += src->total_ns;
+    if (src->max_ns > dst->max_ns) {
+        dst->max_ns = src->max_ns;
+    }
+    for (n = 0; n < IB_TSTATS_BUCKETS; ++n) {
+        dst->hist[n] += src->hist[n];
+    }
+}
+
+uint64_t ib_tstats_hist_percentile(const ib_tstats_hist_t *h,
+                                   unsigned int pct)
+{
+    uint64_t want;
+    uint64_t seen = 0;
+    size_t   n;
+
+    assert(h != NULL);
+
+    want = (h->count * pct + 99) / 100;
+    for (n = 0; n < IB_TSTATS_BUCKETS; ++n) {
+        seen += h->hist[n];
+        if ( (seen >= want) && (seen != 0) ) {
+            break;
+        }
+    }
+    if (n >= (IB_TSTATS_BUCKETS - 1)) {
+        return h->max_ns;
+    }
+    return (uint64_t)1 << (n + 1);
+}
+
+void ib_tstats_hist_format(const ib_tstats_hist_t *h,
+                           char *buf,
+                           size_t len)
+{
+    size_t used = 0;
+    size_t n;
+
+    assert(h != NULL);
+    assert(buf != NULL);
+    assert(len > 0);
+
+    buf[0] = '\0';
+    for (n = 0; (n < IB_TSTATS_BUCKETS) && (used < len); ++n) {
+        int rv;
+
+        if (h->hist[n] == 0) {
+            continue;
+        }
+        rv = snprintf(buf + used, len - used, "%s%zu:%" PRIu64,
+                      (used == 0) ? "" : " ", n, h->hist[n]);
+        if (rv < 0) {
+            break;
+        }
+        used += (size_t)rv;
+    }
+}
+
+ib_status_t ib_tstats_create(ib_tstats_t **pts,
+                             size_t block_size)
+{
+    IB_FTRACE_INIT();
+    ib_tstats_t *ts;
+    ib_status_t  rc;
+
+    assert(pts != NULL);
+
+    if (block_size == 0) {
+        IB_FTRACE_RET_STATUS(IB_EINVAL);
+    }
+
+    ts = (ib_tstats_t *)calloc(1, sizeof(*ts));
+    if (ts == NULL) {
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+    ts->block_size = block_size;
+
+    rc = ib_lock_init(&ts->lock);
+    if (rc != IB_OK) {
+        free(ts);
+        IB_FTRACE_RET_STATUS(rc);
+    }
+    if (pthread_key_create(&ts->key, NULL) != 0) {
+        ib_lock_destroy(&ts->lock);
+        free(ts);
+        IB_FTRACE_RET_STATUS(IB_EALLOC);
+    }
+
+    *pts = ts;
+    IB_FTRACE_RET_STATUS(IB_OK);
+}
+
+void *ib_tstats_block(ib_tstats_t *ts)
+{
+    tstats_block_t *block;
+    void           *mem;
+    size_t          size;
+
+    assert(ts != NULL);
+
+    block = (tstats_block_t *)pthread_getspecific(ts->key);
+    if (block != NULL) {
+        return block + 1;
+    }
+
+    size = sizeof(*block) + ts->block_size;
+    if (posix_memalign(&mem, IB_TSTATS_CACHE_LINE, size) != 0) {
+        return NULL;
+    }
+    memset(mem, 0, size);
+    block = (tstats_block_t *)mem;
+
+    ib_lock_lock(&ts->lock);
+    block->next = ts->blocks;
+    ts->blocks = block;
+    ib_lock_unlock(&ts->lock);
+
+    pthread_setspecific(ts->key, block);
+    return block + 1;
+}
+
+size_t ib_tstats_foreach(ib_tstats_t *ts,
+                         ib_tstats_block_fn_t fn,
+                         void *cbdata)
+{
+    IB_FTRACE_INIT();
+    const tstats_block_t *block;
+    size_t                num = 0;
+
+    assert(ts != NULL);
+    assert(fn != NULL);
+
+    ib_lock_lock(&ts->lock);
+    for (block = ts->blocks; block != NULL; block = block->next) {
+        fn(block + 1, cbdata);
+        ++num;
+    }
+    ib_lock_unlock(&ts->lock);
+
+    IB_FTRACE_RET_SIZET(num);
+}
+
+void ib_tstats_destroy(ib_tstats_t *ts)
+{
+    IB_FTRACE_INIT();
+    tstats_block_t *block;
+
+    if (ts == NULL) {
+        IB_FTRACE_RET_VOID();
+    }
+
+    block = ts->blocks;
+    while (block != NULL) {
+        tstats_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    pthread_key_delete(ts->key);
+    ib_lock_destroy(&ts->lock);
+    free(ts);
+    IB_FTRACE_RET_VOID();
+}